@@ -47,15 +47,22 @@
 
 #include <sutil.h>
 #include "commonStructs.h"
+#include <Bvh.h>
+#include <BvhIntersector.h>
 #include <Camera.h>
+#include <MeshOptimizer.h>
 #include <OptiXMesh.h>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw_gl2.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <random>
+#include <stdexcept>
 #include <stdint.h>
 
 using namespace optix;
@@ -206,6 +213,9 @@ optix::Aabb createGeometry(
         const std::vector<optix::Matrix4x4>& xforms, 
         const Material glass_material,
         const Material ground_material,
+        const float weld_epsilon,  // negative to disable vertex welding
+        const bool optimize_vertex_cache,
+        const bool use_mesh_cache,
         // output: this is a Group with two GeometryGroup children, for toggling visibility later
         optix::Group& top_group
         )
@@ -231,6 +241,10 @@ optix::Aabb createGeometry(
             mesh.intersection = context->createProgramFromPTXFile( ptx_path, "mesh_intersect_refine" );
             mesh.bounds = context->createProgramFromPTXFile( ptx_path, "mesh_bounds" );
             mesh.material = glass_material;
+            mesh.weld_vertices = weld_epsilon >= 0.0f;
+            mesh.weld_epsilon = weld_epsilon;
+            mesh.optimize_vertex_cache = optimize_vertex_cache;
+            mesh.use_mesh_cache = use_mesh_cache;
 
             loadMesh( filenames[i], mesh, xforms[i] ); 
             geometry_group->addChild( mesh.geom_instance );
@@ -473,6 +487,288 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
 }
 
 
+//------------------------------------------------------------------------------
+//
+// Host-side benchmarks (no OptiX context or window required)
+//
+//------------------------------------------------------------------------------
+
+static double bestOf( int runs, double (*func)( const std::string& ), const std::string& filename )
+{
+    double best = 1e30;
+    for( int i = 0; i < runs; ++i )
+        best = std::min( best, func( filename ) );
+    return best;
+}
+
+
+static double timeMeshLoad( const std::string& filename, bool use_cache )
+{
+    const double t0 = sutil::currentTime();
+    Mesh mesh;
+    MeshLoader loader( filename, use_cache );
+    loader.scanMesh( mesh );
+    allocMesh( mesh );
+    loader.loadMesh( mesh );
+    const double t1 = sutil::currentTime();
+    freeMesh( mesh );
+    return t1 - t0;
+}
+
+
+static double timeSourceLoad( const std::string& filename ) { return timeMeshLoad( filename, false ); }
+static double timeCachedLoad( const std::string& filename ) { return timeMeshLoad( filename, true ); }
+
+static double timeCacheMap( const std::string& filename )
+{
+    const double t0 = sutil::currentTime();
+    Mesh mesh;
+    MeshLoader loader( filename, true );
+    if( !loader.mapMesh( mesh ) )
+        throw std::runtime_error( "No mesh cache for '" + filename + "'" );
+    return sutil::currentTime() - t0;
+}
+
+
+// Compares parsing the mesh sources against the binary mesh cache.
+void benchmarkMeshLoad( const std::vector<std::string>& filenames )
+{
+    const int runs = 5;
+    std::cerr << "Mesh load times in ms (best of " << runs << "):\n"
+              << "  source parse | cache copy | cache map | file\n";
+    for( size_t i = 0; i < filenames.size(); ++i )
+    {
+        const double parse = bestOf( runs, timeSourceLoad, filenames[i] );
+        timeCachedLoad( filenames[i] ); // Make sure the cache is up to date
+        const double copy  = bestOf( runs, timeCachedLoad, filenames[i] );
+        const double map   = bestOf( runs, timeCacheMap,   filenames[i] );
+        std::cerr << "  " << std::setw( 12 ) << parse * 1000.0
+                  << " | " << std::setw( 10 ) << copy * 1000.0
+                  << " | " << std::setw( 9 ) << map * 1000.0
+                  << " | " << filenames[i] << std::endl;
+    }
+}
+
+
+// Welds identical vertices of each mesh and reports the savings.
+void benchmarkWeld( const std::vector<std::string>& filenames )
+{
+    for( size_t i = 0; i < filenames.size(); ++i )
+    {
+        Mesh mesh;
+        MeshLoader loader( filenames[i] );
+        loader.scanMesh( mesh );
+        allocMesh( mesh );
+        loader.loadMesh( mesh );
+
+        const double t0 = sutil::currentTime();
+        const MeshWeldStats stats = weldVertices( mesh );
+        const double t1 = sutil::currentTime();
+        freeMesh( mesh );
+
+        std::cerr << filenames[i] << " (" << ( t1 - t0 ) * 1000.0 << " ms)\n";
+        printWeldStats( stats, std::cerr );
+    }
+}
+
+
+// Reorders each mesh for vertex cache locality and reports the average cache
+// miss ratio (vertices processed per triangle) before and after.
+void benchmarkVertexCache( const std::vector<std::string>& filenames )
+{
+    std::cerr << "ACMR for a 16 entry FIFO cache:\n"
+              << "  before | after | reorder ms | file\n";
+    for( size_t i = 0; i < filenames.size(); ++i )
+    {
+        Mesh mesh;
+        MeshLoader loader( filenames[i] );
+        loader.scanMesh( mesh );
+        allocMesh( mesh );
+        loader.loadMesh( mesh );
+
+        const float  before = vertexCacheMissRatio( mesh );
+        const double t0     = sutil::currentTime();
+        optimizeVertexCache( mesh );
+        const double t1     = sutil::currentTime();
+        const float  after  = vertexCacheMissRatio( mesh );
+        freeMesh( mesh );
+
+        std::cerr << "  " << std::setw( 6 ) << before
+                  << " | " << std::setw( 5 ) << after
+                  << " | " << std::setw( 10 ) << ( t1 - t0 ) * 1000.0
+                  << " | " << filenames[i] << std::endl;
+    }
+}
+
+
+// Builds a binned SAH BVH over each mesh on the host and reports its quality.
+void benchmarkBvh( const std::vector<std::string>& filenames )
+{
+    const int runs = 5;
+    std::cerr << "Host BVH build (best of " << runs << "):\n"
+              << "  build ms |    nodes | depth | SAH cost | memory KB | file\n";
+    for( size_t i = 0; i < filenames.size(); ++i )
+    {
+        Mesh mesh;
+        MeshLoader loader( filenames[i] );
+        loader.scanMesh( mesh );
+        allocMesh( mesh );
+        loader.loadMesh( mesh );
+
+        Bvh bvh;
+        double best = 1e30;
+        for( int r = 0; r < runs; ++r )
+        {
+            const double t0 = sutil::currentTime();
+            bvh.build( mesh );
+            best = std::min( best, sutil::currentTime() - t0 );
+        }
+        freeMesh( mesh );
+
+        const BvhStats stats = bvh.stats();
+        std::cerr << "  " << std::setw( 8 ) << best * 1000.0
+                  << " | " << std::setw( 8 ) << stats.num_nodes
+                  << " | " << std::setw( 5 ) << stats.max_depth
+                  << " | " << std::setw( 8 ) << stats.sah_cost
+                  << " | " << std::setw( 9 ) << stats.memory / 1024.0
+                  << " | " << filenames[i] << std::endl;
+    }
+}
+
+
+// Primary rays of a pinhole camera looking at the mesh, in 2x2 pixel quads so
+// that each packet of four is coherent.
+static void makePrimaryRays( const Mesh& mesh, int size, std::vector<HostRay>& rays )
+{
+    const optix::float3 bbox_min = optix::make_float3( mesh.bbox_min[0], mesh.bbox_min[1], mesh.bbox_min[2] );
+    const optix::float3 bbox_max = optix::make_float3( mesh.bbox_max[0], mesh.bbox_max[1], mesh.bbox_max[2] );
+    const optix::float3 center   = 0.5f * ( bbox_min + bbox_max );
+    const float         radius   = 0.5f * optix::length( bbox_max - bbox_min );
+
+    const optix::float3 eye = center + radius * optix::make_float3( 0.0f, 0.5f, 2.5f );
+    const optix::float3 w   = optix::normalize( center - eye );
+    const optix::float3 u   = optix::normalize( optix::cross( w, optix::make_float3( 0.0f, 1.0f, 0.0f ) ) );
+    const optix::float3 v   = optix::cross( u, w );
+    const float         fov = tanf( 0.5f * 45.0f * M_PIf / 180.0f );
+
+    rays.clear();
+    for( int y = 0; y < size; y += 2 )
+        for( int x = 0; x < size; x += 2 )
+            for( int i = 0; i < 4; ++i )
+            {
+                const float sx = ( 2.0f * ( x + ( i & 1 ) + 0.5f ) / size - 1.0f ) * fov;
+                const float sy = ( 2.0f * ( y + ( i >> 1 ) + 0.5f ) / size - 1.0f ) * fov;
+                const optix::float3 d = optix::normalize( w + sx * u + sy * v );
+                const HostRay ray = { { eye.x, eye.y, eye.z }, 0.0f, { d.x, d.y, d.z }, 1e30f };
+                rays.push_back( ray );
+            }
+}
+
+
+// Rays from random points inside the bounding box in random directions.
+static void makeIncoherentRays( const Mesh& mesh, size_t count, std::vector<HostRay>& rays )
+{
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution<float> rnd( 0.0f, 1.0f );
+    rays.resize( count );
+    for( size_t i = 0; i < count; ++i )
+    {
+        HostRay& ray = rays[i];
+        for( int k = 0; k < 3; ++k )
+            ray.origin[k] = mesh.bbox_min[k] + rnd( rng ) * ( mesh.bbox_max[k] - mesh.bbox_min[k] );
+        const float z   = 1.0f - 2.0f * rnd( rng );
+        const float r   = sqrtf( std::max( 0.0f, 1.0f - z * z ) );
+        const float phi = 2.0f * M_PIf * rnd( rng );
+        ray.direction[0] = r * cosf( phi );
+        ray.direction[1] = r * sinf( phi );
+        ray.direction[2] = z;
+        ray.tmin = 0.0f;
+        ray.tmax = 1e30f;
+    }
+}
+
+
+// Returns the best throughput in Mrays/s over runs and the fraction of hits.
+static double timeRays( const BvhIntersector& intersector, const std::vector<HostRay>& rays, double& hit_ratio )
+{
+    const int runs = 3;
+    std::vector<HostHit> hits( rays.size() );
+    double best = 1e30;
+    for( int r = 0; r < runs; ++r )
+    {
+        const double t0 = sutil::currentTime();
+        intersector.intersect( &rays[0], &hits[0], rays.size() );
+        best = std::min( best, sutil::currentTime() - t0 );
+    }
+
+    size_t num_hits = 0;
+    for( size_t i = 0; i < hits.size(); ++i )
+        num_hits += hits[i].prim_index >= 0;
+    hit_ratio = double( num_hits ) / rays.size();
+    return rays.size() / best * 1e-6;
+}
+
+
+// Casts primary and incoherent rays against the host BVH of each mesh.
+void benchmarkRays( const std::vector<std::string>& filenames )
+{
+    const int size = 1024;
+    std::cerr << "Host closest hit rays, " << size << "x" << size << " per run (best of 3):\n"
+              << "  primary Mrays/s |  hits | incoherent Mrays/s |  hits | file\n";
+    for( size_t i = 0; i < filenames.size(); ++i )
+    {
+        Mesh mesh;
+        MeshLoader loader( filenames[i] );
+        loader.scanMesh( mesh );
+        allocMesh( mesh );
+        loader.loadMesh( mesh );
+
+        Bvh bvh;
+        bvh.build( mesh );
+        const BvhIntersector intersector( bvh, mesh );
+
+        std::vector<HostRay> rays;
+        double primary_hits, incoherent_hits;
+        makePrimaryRays( mesh, size, rays );
+        const double primary = timeRays( intersector, rays, primary_hits );
+        makeIncoherentRays( mesh, rays.size(), rays );
+        const double incoherent = timeRays( intersector, rays, incoherent_hits );
+        freeMesh( mesh );
+
+        std::cerr << "  " << std::setw( 15 ) << primary
+                  << " | " << std::setw( 5 ) << primary_hits
+                  << " | " << std::setw( 18 ) << incoherent
+                  << " | " << std::setw( 5 ) << incoherent_hits
+                  << " | " << filenames[i] << std::endl;
+    }
+}
+
+
+bool runBenchmark( const std::string& name, std::vector<std::string> filenames )
+{
+    if ( filenames.empty() ) {
+        filenames.push_back( std::string( sutil::samplesDir() ) + "/data/teapot_lid.ply" );
+        filenames.push_back( std::string( sutil::samplesDir() ) + "/data/teapot_body.ply" );
+        filenames.push_back( std::string( sutil::samplesDir() ) + "/data/wedding-band.obj" );
+    }
+
+    std::cerr << std::fixed << std::setprecision( 3 );
+    if( name == "load" )
+        benchmarkMeshLoad( filenames );
+    else if( name == "weld" )
+        benchmarkWeld( filenames );
+    else if( name == "cache" )
+        benchmarkVertexCache( filenames );
+    else if( name == "bvh" )
+        benchmarkBvh( filenames );
+    else if( name == "rays" )
+        benchmarkRays( filenames );
+    else
+        return false;
+    return true;
+}
+
+
 //------------------------------------------------------------------------------
 //
 // Main
@@ -487,6 +783,11 @@ void printUsageAndExit( const std::string& argv0 )
         "  -h | --help                  Print this usage message and exit.\n"
         "  -f | --file <output_file>    Save image to file and exit.\n"
         "  -n | --nopbo                 Disable GL interop for display buffer.\n"
+        "  -w | --weld <epsilon>        Weld mesh vertices closer than epsilon (0 for identical ones).\n"
+        "  -o | --optimize              Reorder mesh triangles and vertices for locality.\n"
+        "  -c | --cache                 Load meshes from and save them to <mesh>.meshcache next to the source.\n"
+        "  -b | --benchmark <name>      Run a host-side benchmark on the meshes and exit.\n"
+        "                               <name> is one of: load, weld, cache, bvh, rays\n"
         "App Keystrokes:\n"
         "  q  Quit\n"
         "  s  Save image to '" << SAMPLE_NAME << ".png'\n"
@@ -503,6 +804,10 @@ int main( int argc, char** argv )
 {
     bool use_pbo  = true;
     std::string out_file;
+    std::string benchmark;
+    float weld_epsilon = -1.0f;
+    bool optimize_vertex_cache = false;
+    bool use_mesh_cache = false;
     std::vector<std::string> mesh_files;
     std::vector<optix::Matrix4x4> mesh_xforms;
     for( int i=1; i<argc; ++i )
@@ -526,6 +831,32 @@ int main( int argc, char** argv )
         {
             use_pbo = false;
         }
+        else if( arg == "-w" || arg == "--weld"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            weld_epsilon = static_cast<float>( atof( argv[++i] ) );
+        }
+        else if( arg == "-o" || arg == "--optimize"  )
+        {
+            optimize_vertex_cache = true;
+        }
+        else if( arg == "-c" || arg == "--cache"  )
+        {
+            use_mesh_cache = true;
+        }
+        else if( arg == "-b" || arg == "--benchmark"  )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            benchmark = argv[++i];
+        }
         else if( arg[0] == '-' )
         {
             std::cerr << "Unknown option '" << arg << "'\n";
@@ -538,6 +869,24 @@ int main( int argc, char** argv )
         }
     }
 
+    if( !benchmark.empty() )
+    {
+        try
+        {
+            if( !runBenchmark( benchmark, mesh_files ) )
+            {
+                std::cerr << "Unknown benchmark '" << benchmark << "'\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        catch( std::exception& e )
+        {
+            sutil::reportErrorMessage( e.what() );
+            return 1;
+        }
+        return 0;
+    }
+
     try
     {
         GLFWwindow* window = glfwInitialize();
@@ -567,7 +916,7 @@ int main( int argc, char** argv )
         Material glass_material = createGlassMaterial();
         Material ground_material = createDiffuseMaterial();
         optix::Group top_group;
-        const optix::Aabb aabb = createGeometry( mesh_files, mesh_xforms, glass_material, ground_material, top_group );
+        const optix::Aabb aabb = createGeometry( mesh_files, mesh_xforms, glass_material, ground_material, weld_epsilon, optimize_vertex_cache, use_mesh_cache, top_group );
 
         // Note: lighting comes from miss program
 
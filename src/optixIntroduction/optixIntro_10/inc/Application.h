@@ -59,6 +59,9 @@
 #include "inc/Timer.h"
 #include "inc/Picture.h"
 #include "inc/Texture.h"
+#include "inc/TextureCache.h"
+#include "inc/EnvironmentLoader.h"
+#include "inc/Scene.h"
 
 #include "shaders/vertex_attributes.h"
 #include "shaders/light_definition.h"
@@ -86,20 +89,6 @@ enum GuiState
   GUI_STATE_FOCUS
 };
 
-// Host side GUI material parameters 
-struct MaterialParameterGUI
-{
-  FunctionIndex indexBSDF;  // BSDF index to use in the closest hit program
-  optix::float3 albedo;     // Tint, throughput change for specular materials
-  bool          useAlbedoTexture;
-  bool          useCutoutTexture;
-  bool          thinwalled;
-  optix::float3 absorptionColor; // absorption color and distance scale together build the absorption coefficient
-  float         volumeDistanceScale;
-  float         ior;        // index of refraction
-};
-
-
 class Application
 {
 public:
@@ -111,7 +100,9 @@ public:
               const bool interop, 
               const bool light, 
               const unsigned int miss,
-              std::string const& environment);
+              std::string const& environment,
+              const bool cache,
+              const unsigned int textureCompression);
   ~Application();
 
   bool isValid() const;
@@ -123,6 +114,8 @@ public:
 
   void screenshot(std::string const& filename);
 
+  void finishEnvironment(); // Blocks until the full resolution environment replaced the preview.
+
   void guiNewFrame();
   void guiWindow();
   void guiEventHandler();
@@ -145,11 +138,6 @@ private:
 
   void createScene();
   
-  optix::Geometry createBox();
-  optix::Geometry createPlane(const int tessU, const int tessV, const int upAxis);
-  optix::Geometry createSphere(const int tessU, const int tessV, const float radius, const float maxTheta);
-  optix::Geometry createTorus(const int tessU, const int tessV, const float innerRadius, const float outerRadius);
-  
   optix::Geometry createParallelogram(optix::float3 const& position, optix::float3 const& vecU, optix::float3 const& vecV, optix::float3 const& normal);
 
   optix::Geometry createGeometry(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices);
@@ -157,6 +145,7 @@ private:
   void setAccelerationProperties(optix::Acceleration acceleration);
 
   void createLights();
+  void updateEnvironment();
   
   void updateMaterialParameters();
 
@@ -177,6 +166,8 @@ private:
   bool         m_light;
   unsigned int m_missID;
   std::string m_environmentFilename;
+  bool        m_cache; // Map the environment and its CDFs from an EnvironmentCache file and the compressed textures from BlockCache files, write them when there are none.
+  unsigned int m_textureCompression; // Block compress the material textures: 0 = off, 1 = fast, 2 = normal, 3 = high quality.
 
   // Applicatoin GUI parameters.
   int   m_minPathLength;       // Minimum path length after which Russian Roulette path termination starts.
@@ -248,10 +239,12 @@ private:
   std::vector<LightDefinition> m_lightDefinitions;
   optix::Buffer                m_bufferLightDefinitions;
 
-  Texture m_environmentTexture;
+  Texture           m_environmentTexture;
+  EnvironmentLoader m_environmentLoader; // Decodes the full resolution environment while the preview is rendered.
 
-  Texture m_textureAlbedo;
-  Texture m_textureCutout;
+  TextureCache m_textureCache; // Shares the material textures by file name and content.
+  Texture*     m_textureAlbedo;
+  Texture*     m_textureCutout;
 
   // There are only three types of materials in this demo.
   // The material parameters for these are determined by the parMaterialIndex variable on the GeometryInstance.
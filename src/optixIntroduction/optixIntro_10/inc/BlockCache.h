@@ -0,0 +1,79 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include "inc/BlockCompression.h"
+
+// DAR Whole-file memory mapping from sutil.
+#include <MappedFile.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+// Binary cache of the block compressed texture data written next to its source image (<source>.bccache).
+// It holds the blocks of all images (cubemap faces) and their mipmap levels in the upload order of Texture::createSampler().
+// The key is the block format, the quality preset, and Picture::hashContent() of the decoded images,
+// so a changed source file or a different mipmap generation make the cache stale. Only the encoding is skipped on a hit.
+class BlockCache
+{
+public:
+  BlockCache();
+  ~BlockCache();
+
+  static std::string cacheFilename(std::string const& source);
+
+  // Failure (read-only directory, full disk) is not an error; returns false.
+  static bool write(std::string const& source, BlockFormat format, BlockQuality quality, uint64_t contentHash,
+                    std::vector<unsigned char> const& blocks);
+
+  // Deletes the cache of source. Returns false when there was none.
+  static bool clear(std::string const& source);
+
+  // Maps and validates the cache of source. Returns false when the cache is missing, of a different version, 
+  // or doesn't hold size bytes of blocks for this format, quality, and content.
+  bool open(std::string const& source, BlockFormat format, BlockQuality quality, uint64_t contentHash, size_t size);
+  void close();
+  bool isOpen() const;
+
+  const unsigned char* getBlocks() const; // Valid until close().
+
+private:
+  BlockCache(BlockCache const&);            // Not copyable.
+  BlockCache& operator=(BlockCache const&);
+
+private:
+  MappedFile m_file;
+};
+
+#endif // BLOCK_CACHE_H
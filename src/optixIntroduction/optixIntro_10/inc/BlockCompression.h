@@ -0,0 +1,68 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <stddef.h>
+
+// Block compressed texture formats encoded on the host. Each block holds 4x4 texels in 8 or 16 bytes.
+enum BlockFormat
+{
+  BLOCK_FORMAT_NONE,
+  BLOCK_FORMAT_BC1, // RGB, 8 bytes per block. Two RGB565 endpoints and 2-bit indices.
+  BLOCK_FORMAT_BC3, // RGBA, 16 bytes per block. An interpolated alpha block followed by a BC1 color block.
+  BLOCK_FORMAT_BC5, // RG, 16 bytes per block. Two interpolated channel blocks, meant for tangent space normal maps.
+  BLOCK_FORMAT_BC6H // Unsigned half float RGB, 16 bytes per block.
+};
+
+// Encoder presets. Higher qualities fit the endpoints more carefully and take longer.
+enum BlockQuality
+{
+  BLOCK_QUALITY_FAST,   // Bounding box endpoints.
+  BLOCK_QUALITY_NORMAL, // Principal axis endpoints and one least squares refinement.
+  BLOCK_QUALITY_HIGH    // Several refinements and endpoint searches, and the alternative block modes of BC1 and the channel blocks.
+};
+
+unsigned int getBlockBytes(const BlockFormat format); // 0 for BLOCK_FORMAT_NONE.
+size_t       getBlocksSize(const BlockFormat format, const unsigned int width, const unsigned int height);
+
+// Encodes a width x height image into rows of (width + 3) / 4 blocks, bottom row first like the images, in parallel.
+// The input is RGBA8 for BC1, BC3, and BC5, and RGBA32F for BC6H. Partial blocks at the edges repeat the border texels.
+// BC6H only writes the single region mode with 10-bit endpoints and clamps negative values to zero.
+void encodeBlocks(const BlockFormat format, const BlockQuality quality, const void* rgba,
+                  const unsigned int width, const unsigned int height, unsigned char* blocks);
+
+// Reference decoder of the blocks encodeBlocks() writes, to measure the quality without a device.
+// Writes RGBA8 resp. RGBA32F the way the texture unit returns them: BC1 and BC6H with alpha one, BC5 as (R, G, 0, 1).
+void decodeBlocks(const BlockFormat format, const unsigned char* blocks,
+                  const unsigned int width, const unsigned int height, void* rgba);
+
+#endif // BLOCK_COMPRESSION_H
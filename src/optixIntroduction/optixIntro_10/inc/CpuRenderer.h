@@ -0,0 +1,194 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef CPU_RENDERER_H
+#define CPU_RENDERER_H
+
+#include "shaders/app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
+
+#include "inc/LensShader.h"
+#include "inc/PinholeCamera.h"
+#include "inc/Picture.h"
+
+#include "shaders/vertex_attributes.h"
+#include "shaders/light_definition.h"
+#include "shaders/material_parameter.h"
+#include "shaders/per_ray_data.h"
+
+#include <Bvh.h>
+#include <BvhIntersector.h>
+
+#include <string>
+#include <vector>
+
+
+// Host side reference implementation of the optixIntro_10 renderer for machines without an OptiX capable GPU.
+// It renders the same scene as the Application with the same integrator, closest hit, miss and cutout program bodies,
+// BSDFs, lens shaders and light sampling functions, which are compiled as host code via RT_FUNCTION,
+// and accumulates into an RGBA32F output buffer like sysOutputBuffer.
+// The program glue around rtTrace(), textures and transforms is done on the host: one sutil Bvh per geometry,
+// instance transforms including the SRT motion blur, and image tiles handed out dynamically to all cores.
+// Limitations: No HDR environment map (miss 2) and no denoiser. The cutout opacity uses the path's random numbers.
+class CpuRenderer
+{
+public:
+  CpuRenderer(const int width,
+              const int height,
+              const bool light,
+              const unsigned int miss);
+  ~CpuRenderer();
+
+  bool isValid() const;
+
+  // Accumulates one more sample per pixel, like one launch of the Application.
+  void render();
+
+  // Writes the accumulated radiance with DevIL. The file extension selects the format, e.g. *.hdr keeps the HDR values.
+  bool screenshot(std::string const& filename) const;
+
+  const optix::float4* getOutputBuffer() const;
+
+private:
+  // Texels converted to float RGBA as the OptiX texture sampler returns them (normalized float read mode).
+  struct HostTexture
+  {
+    unsigned int               width;
+    unsigned int               height;
+    std::vector<optix::float4> texels;
+  };
+
+  // The same buffers the Application::createGeometry() function uploads, plus the acceleration structure.
+  struct HostGeometry
+  {
+    std::vector<optix::float3>           positions;
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+    std::vector<VertexAttributesCompact> attributes;
+#else
+    std::vector<VertexAttributes>        attributes;
+#endif
+    std::vector<unsigned int>            indices;
+
+    Bvh             bvh;
+    BvhIntersector* intersector;
+  };
+
+  // Corresponds to a Transform over a GeometryGroup with a single GeometryInstance in the OptiX scene graph.
+  struct HostInstance
+  {
+    const HostGeometry* geometry;
+    int                 materialIndex; // parMaterialIndex, -1 for lights.
+    int                 lightIndex;    // parLightIndex, -1 for materials.
+    bool                cutout;        // Uses the cutout opacity anyhit programs.
+
+    bool             motion;        // Interpolate the SRT motion keys at the ray time, otherwise use the static matrices.
+    optix::Matrix4x4 objectToWorld;
+    optix::Matrix4x4 worldToObject;
+    float            keysSRT[2][16];
+  };
+
+  struct HostHitRecord
+  {
+    const HostInstance* instance;
+    optix::Matrix4x4    worldToObject;
+    float               t;
+    optix::float3       geoNormal; // Object space attributes, like the intersection program reports them.
+    optix::float3       normal;
+    optix::float3       texcoord;
+  };
+
+  // The platform specific parts of the shared program bodies in the shaders/*_functions.h headers.
+  struct HostProgram;
+  struct HostTraceRadiance;
+
+  bool createTexture(const Picture* picture, HostTexture& texture);
+  optix::float4 tex2D(const int id, const float u, const float v) const;
+
+  void initMaterials();
+  void createScene();
+  void createLights();
+  HostGeometry* createGeometry(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices);
+  void addInstance(const HostGeometry* geometry, const int materialIndex, const int lightIndex, optix::Matrix4x4 const& objectToWorld);
+
+  optix::Matrix4x4 getWorldToObject(HostInstance const& instance, const float time) const;
+  void getAttributes(HostGeometry const& geometry, const int primitiveIndex, const float beta, const float gamma, HostHitRecord& hit) const;
+  bool isCutoutIgnored(HostInstance const& instance, optix::float3 const& texcoord, const float time, unsigned int& seed) const;
+  bool intersectScene(optix::float3 const& origin, optix::float3 const& direction, const float tmin, const float tmax, const float time,
+                      unsigned int& seed, HostHitRecord& hit) const;
+
+  void traceRadiance(optix::float3 const& origin, optix::float3 const& direction, const float tmin, const float tmax, const float time, PerRayData& prd) const;
+  bool traceShadow(optix::float3 const& origin, optix::float3 const& direction, const float tmin, const float tmax, const float time, unsigned int& seed) const;
+
+  void closesthit(HostHitRecord const& hit, optix::float3 const& origin, optix::float3 const& direction, const float time, PerRayData& prd) const;
+  void closesthitLight(HostHitRecord const& hit, optix::float3 const& origin, optix::float3 const& direction, PerRayData& prd) const;
+  void miss(PerRayData& prd) const;
+
+  void renderTile(const unsigned int tile);
+
+private:
+  int  m_width;
+  int  m_height;
+  bool m_isValid;
+
+  bool         m_light;
+  unsigned int m_missID;
+
+  // Same defaults as the Application.
+  int        m_minPathLength;
+  int        m_maxPathLength;
+  float      m_sceneEpsilonFactor;
+  LensShader m_cameraType;
+  int        m_shutterType;
+
+  int m_iterationIndex;
+
+  PinholeCamera m_pinholeCamera;
+  optix::float3 m_cameraPosition;
+  optix::float3 m_cameraU;
+  optix::float3 m_cameraV;
+  optix::float3 m_cameraW;
+
+  std::vector<HostTexture>       m_textures; // Texture IDs are 1-based indices, so that RT_TEXTURE_ID_NULL stays invalid.
+  std::vector<MaterialParameter> m_materialParameters;
+  std::vector<LightDefinition>   m_lightDefinitions;
+
+  std::vector<HostGeometry*> m_geometries;
+  std::vector<HostInstance>  m_instances;
+
+  std::vector<optix::float4> m_outputBuffer; // RGBA32F, row 0 is the bottom of the image like sysOutputBuffer.
+
+  unsigned int m_tilesX;
+  unsigned int m_tilesY;
+};
+
+#endif // CPU_RENDERER_H
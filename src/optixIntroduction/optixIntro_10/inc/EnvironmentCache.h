@@ -0,0 +1,92 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef ENVIRONMENT_CACHE_H
+#define ENVIRONMENT_CACHE_H
+
+#include <optixu/optixu_math_namespace.h>
+
+// DAR Whole-file memory mapping from sutil.
+#include <MappedFile.h>
+
+#include <string>
+
+class Texture;
+
+
+// Binary cache of a spherical environment light written next to its source image (<source>.envcache).
+// It holds the RGBA32F texels (bottom row first), both CDFs, the integral, and optionally the alias tables,
+// exactly as Texture::calculateCDF() produced them. Every array starts on a page boundary,
+// so a valid cache is memory mapped and uploaded by Texture::uploadEnvironment() without any copies on the host.
+// It is considered stale when the size, modification time or content hash of the source file no longer matches.
+// Only the full resolution of the source image is cached, never a downsampled preview.
+class EnvironmentCache
+{
+public:
+  EnvironmentCache();
+  ~EnvironmentCache();
+
+  static std::string cacheFilename(std::string const& source);
+
+  // Writes the cache for source from the host data of a Texture after calculateCDF().
+  // sourceWidth and sourceHeight are the resolution stored in the source file. Nothing is written when the texture differs from it.
+  // Failure (read-only directory, full disk) is not an error; returns false.
+  static bool write(std::string const& source, Texture const& texture, unsigned int sourceWidth, unsigned int sourceHeight);
+
+  // Deletes the cache of source. Returns false when there was none.
+  static bool clear(std::string const& source);
+
+  // Maps and validates the cache of source. Returns false when the cache is missing, of a different version, or stale,
+  // when it doesn't hold the source resolution, or when aliasTables are requested and the cache has none.
+  bool open(std::string const& source, bool aliasTables);
+  void close();
+  bool isOpen() const;
+
+  // Valid until close().
+  unsigned int         getWidth() const;
+  unsigned int         getHeight() const;
+  float                getIntegral() const;
+  const float*         getTexels() const;
+  const float*         getCDF_U() const;
+  const float*         getCDF_V() const;
+  const optix::float2* getAlias_U() const; // nullptr when the cache has no alias tables.
+  const optix::float2* getAlias_V() const;
+
+private:
+  EnvironmentCache(EnvironmentCache const&);            // Not copyable.
+  EnvironmentCache& operator=(EnvironmentCache const&);
+
+  const char* getSection(int section) const;
+
+private:
+  MappedFile m_file;
+};
+
+#endif // ENVIRONMENT_CACHE_H
@@ -0,0 +1,88 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef ENVIRONMENT_LOADER_H
+#define ENVIRONMENT_LOADER_H
+
+#include "inc/Texture.h"
+#include "inc/Timer.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+
+// Loads a spherical HDR environment in two steps so that the time to the first frame doesn't depend on its resolution.
+// start() decodes a small preview on the calling thread, which gets rendered right away.
+// A worker thread then decodes the full resolution image and calculates its CDFs on the host.
+// The main thread polls isReady() and uploads and swaps the full resolution environment itself,
+// because the OptiX objects are created through the context on the main thread only.
+// Only Radiance *.hdr files are supported, decoded by the sutil HDRLoader, because DevIL is not thread-safe.
+class EnvironmentLoader
+{
+public:
+  EnvironmentLoader();
+  ~EnvironmentLoader(); // Waits for the worker thread.
+
+  static bool isSupported(std::string const& filename);
+
+  // Fills the preview Texture with host data including the CDFs. Only uploadEnvironment() remains to be done.
+  // Starts the worker thread when the image is bigger than the preview.
+  // With writeCache the full resolution result is also stored in an EnvironmentCache file for the next run.
+  bool start(std::string const& filename, Texture& preview, bool writeCache = false);
+
+  bool isLoading() const; // Worker thread started and its result not taken yet.
+  bool isReady() const;   // The worker thread is done, take() won't block.
+
+  // Waits for the worker thread and returns the full resolution Texture with its host CDFs, or nullptr on failure.
+  // The caller owns the returned Texture.
+  Texture* take();
+
+private:
+  void load(); // The worker thread function.
+
+private:
+  std::string       m_filename;
+  std::thread       m_thread;
+  std::atomic<bool> m_ready;
+  bool              m_loading;
+  bool              m_writeCache;
+  Texture*          m_texture; // Written by the worker thread, read after m_ready is set.
+
+  Timer m_timer; // Started with start(), the phase times below are seconds since then.
+
+  double m_timePreviewDecode;
+  double m_timePreviewCDF;
+  double m_timeDecode;
+  double m_timeCDF;
+  double m_timeCache;
+};
+
+#endif // ENVIRONMENT_LOADER_H
@@ -34,6 +34,7 @@
 #ifndef PICTURE_H
 #define PICTURE_H
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -61,6 +62,34 @@ struct Image
 };
 
 
+// Reconstruction filters for the mipmap generation.
+enum MipmapFilter
+{
+  MIPMAP_FILTER_BOX,   // Area weighted average of the covered texels. The 2x2(x2) average for even extents.
+  MIPMAP_FILTER_KAISER // Kaiser windowed sinc with a radius of two destination texels. Sharper, but can ring.
+};
+
+// Filters the image src into the next smaller mipmap level dst.
+// dst must have the same format and type, the extents (1 < n) ? n >> 1 : 1 of src, and allocated m_pixels.
+// Works for all formats and types of the Image and for non-power-of-two extents.
+// With isSrgb the color components of IL_UNSIGNED_BYTE images are filtered in linear space, alpha never is.
+void downsampleImage(const Image& src, Image& dst, const MipmapFilter filter, const bool isSrgb);
+
+// Transforms which bring decoded images into the lower left origin layout OpenGL and OptiX expect.
+enum ImageOrientation
+{
+  IMAGE_ORIENTATION_KEEP,     // Pixels stay as they are.
+  IMAGE_ORIENTATION_MIRROR_X, // Flip upside down. Reverses the rows of each slice.
+  IMAGE_ORIENTATION_MIRROR_Y  // Mirror left to right. Reverses the pixels of each row.
+};
+
+// Applies the orientation in place without allocating, with SIMD row reversal specialized per pixel size.
+void mirrorImage(Image& image, const ImageOrientation orientation);
+
+// Fills the allocated image.m_pixels from pixels with the same layout and applies the orientation in the same pass.
+void copyImage(Image& image, const void* pixels, const ImageOrientation orientation);
+
+
 class Picture
 {
 public:
@@ -74,16 +103,24 @@ public:
   unsigned int getNumberOfFaces(unsigned int indexImage) const;
   const Image* getImageFace(unsigned int indexImage, unsigned int indexFace) const;
   bool isCubemap() const;
+  const std::string& getFilename() const; // The file of the last successful load(), empty otherwise.
+
+  // 64-bit FNV-1a hash of the extents, formats, types, and pixels of all images and mipmap levels.
+  // Identifies the decoded content independently of the file name, including generated mipmaps.
+  uint64_t hashContent() const;
+
+  // Replaces the mipmaps of all images (resp. cubemap faces) with a complete chain generated from their LOD 0.
+  void generateMipmaps(const MipmapFilter filter, const bool isSrgb);
 
 private:
   unsigned int addImage(unsigned int width, unsigned int height, unsigned int depth, int format, int type);
-  bool copyMipmaps(unsigned int index, std::vector<const void*> const& mipmaps);
-  void setImageData(unsigned int index, const void* pixels, std::vector<const void*> const& mipmaps);
-  void mirrorX(unsigned int index);
-  void mirrorY(unsigned int index);
+  bool copyMipmaps(unsigned int index, std::vector<const void*> const& mipmaps, const ImageOrientation orientation);
+  void buildMipmaps(unsigned int index, const MipmapFilter filter, const bool isSrgb);
+  void setImageData(unsigned int index, const void* pixels, std::vector<const void*> const& mipmaps, const ImageOrientation orientation);
 
 private:
   bool m_isCube; // Track if the picture is a cube map.
+  std::string m_filename;
   std::vector< std::vector<Image> > m_images;
 };
 
@@ -0,0 +1,79 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <optixu/optixu_math_namespace.h>
+
+#include "shaders/vertex_attributes.h"
+#include "shaders/light_definition.h"
+#include "shaders/material_parameter.h"
+
+#include <vector>
+
+// The albedo and cutout opacity textures of the demo materials, relative to sutil::samplesDir().
+#define SCENE_TEXTURE_ALBEDO "/data/NVIDIA_logo.jpg"
+#define SCENE_TEXTURE_CUTOUT "/data/slots_alpha.png"
+
+// Host side GUI material parameters 
+struct MaterialParameterGUI
+{
+  FunctionIndex indexBSDF;  // BSDF index to use in the closest hit program
+  optix::float3 albedo;     // Tint, throughput change for specular materials
+  bool          useAlbedoTexture;
+  bool          useCutoutTexture;
+  bool          thinwalled;
+  optix::float3 absorptionColor; // absorption color and distance scale together build the absorption coefficient
+  float         volumeDistanceScale;
+  float         ior;        // index of refraction
+};
+
+// One object of the demo scene with its tessellation, material and placement.
+// All Geometries in this demo are modeled around the origin in object coordinates.
+struct SceneObject
+{
+  std::vector<VertexAttributes> attributes;
+  std::vector<unsigned int>     indices;
+
+  int   materialIndex;   // parMaterialIndex
+  bool  motion;          // Scale-Rotation-Translation (SRT) motion blur with keysSRT over the motion range [0, 1], otherwise the static matrix.
+  float matrix[16];      // Row-major object to world transformation.
+  float keysSRT[2 * 16]; // RT_MOTIONKEYTYPE_SRT_FLOAT16
+};
+
+// The demo scene description shared by the Application and the CpuRenderer, so that both render the same image.
+void initSceneMaterials(std::vector<MaterialParameterGUI>& materials);
+void convertMaterialParameter(MaterialParameterGUI const& src, const int albedoID, const int cutoutID, MaterialParameter& dst);
+void createSceneObjects(std::vector<SceneObject>& objects);
+void initLightDefinition(LightDefinition& light);
+void initAreaLight(LightDefinition& light);
+
+#endif // SCENE_H
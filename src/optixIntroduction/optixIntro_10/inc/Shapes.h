@@ -0,0 +1,49 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef SHAPES_H
+#define SHAPES_H
+
+#include <optixu/optixu_math_namespace.h>
+
+#include "shaders/vertex_attributes.h"
+
+#include <vector>
+
+// Tessellation of the demo primitives into host side vertex attributes and triangle indices.
+// Used by the shared scene description in Scene.cpp and for the area light geometry by the Application and the CpuRenderer.
+void generateBox(std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices);
+void generatePlane(const int tessU, const int tessV, const int upAxis, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices);
+void generateSphere(const int tessU, const int tessV, const float radius, const float maxTheta, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices);
+void generateTorus(const int tessU, const int tessV, const float innerRadius, const float outerRadius, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices);
+void generateParallelogram(optix::float3 const& position, optix::float3 const& vecU, optix::float3 const& vecV, optix::float3 const& normal,
+                           std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices);
+
+#endif // SHAPES_H
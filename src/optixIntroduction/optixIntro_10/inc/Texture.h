@@ -34,12 +34,15 @@
 
 #include <optix.h>
 #include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_math_namespace.h>
 
+#include "inc/BlockCompression.h"
 #include "inc/Picture.h"
 
 #include <string>
 #include <vector>
 
+class EnvironmentCache;
 
 // Bitfield encoding of the texture channels.
 // These are used to remap user format and user data to the internal format.
@@ -108,6 +111,14 @@
 #define ENC_FIXED_POINT (1 << ENC_MISC_SHIFT)
 #define ENC_ALPHA_ONE   (2 << ENC_MISC_SHIFT)
 
+// Block compression of the createSampler() uploads, see setCompression().
+enum TextureCompression
+{
+  TEXTURE_COMPRESSION_NONE, // Upload the converted texels. Default.
+  TEXTURE_COMPRESSION_AUTO, // BC1 for opaque 8-bit images, BC3 for 8-bit images with alpha below one, BC6H for float images.
+  TEXTURE_COMPRESSION_BC5   // Red and green of 8-bit images only, for tangent space normal maps. Blue reads as zero.
+};
+
 class Texture
 {
 public:
@@ -126,9 +137,17 @@ public:
 
   void setWrapMode(RTwrapmode s, RTwrapmode t, RTwrapmode r);
 
+  // Let createSampler() encode 2D textures and cubemaps into blocks on the host. Other images stay uncompressed.
+  // With useCache the blocks are stored in a BlockCache next to the Picture's file and reused while its content is unchanged.
+  // Needs OptiX 6.0 for the block compressed buffer formats. Older versions upload uncompressed.
+  void setCompression(TextureCompression compression, BlockQuality quality = BLOCK_QUALITY_NORMAL, bool useCache = true);
+  BlockFormat getBlockFormat() const; // The format createSampler() used, BLOCK_FORMAT_NONE when uncompressed.
+  size_t getDeviceSize() const;       // Bytes of the buffer behind the sampler including all uploaded mipmap levels.
+
   unsigned int determineHostEncoding(int format, int type) const;
   bool determineDeviceEncoding(int format, int type);
   void convert( void *dst, const void *src, size_t elements, unsigned int hostEncoding ) const;
+  void convertGeneric( void *dst, const void *src, size_t elements, unsigned int hostEncoding ) const; // The fallback of convert(), also the reference of the conversion benchmark.
 
   optix::TextureSampler getSampler() const;
   int getId() const; // Bindless texture ID.
@@ -140,11 +159,32 @@ public:
   // Special functions for spherical environment textures.
   void createEnvironment();                       // Creates a small white dummy environment.
   bool createEnvironment(const Picture* picture); // Creates a spherical environment from a previously loaded Picture, using Image face 0 and LOD 0 only.
+  bool createEnvironment(const float* rgba, unsigned int width, unsigned int height); // Same from RGBA32F data, bottom row first.
   bool calculateCDF(optix::Context context); // Create cumulative distribution function importacne sampling of spherical environment lights.
+  bool calculateCDF();                           // The host side part of that, needs no OptiX context.
+  void setAliasTables(bool enable);              // Let calculateCDF() also build Vose alias tables. Defaults to USE_ENVIRONMENT_ALIAS_TABLES.
+  bool uploadEnvironment(optix::Context context); // Creates the environment sampler and CDF buffers from the host data of calculateCDF().
+  bool uploadEnvironment(optix::Context context, EnvironmentCache const& cache); // Same from an open EnvironmentCache.
+  void destroy(); // Destroys the OptiX buffers and sampler.
   float getIntegral() const;
   optix::Buffer getBufferCDF_U() const;
   optix::Buffer getBufferCDF_V() const;
+  optix::Buffer getBufferAlias_U() const; // nullptr without alias tables.
+  optix::Buffer getBufferAlias_V() const;
+
+  // The host side data between calculateCDF() and uploadEnvironment(), used by the sampling benchmark and the EnvironmentCache.
+  std::vector<float> const&         getTexels() const;
+  std::vector<float> const&         getCDF_U() const;
+  std::vector<float> const&         getCDF_V() const;
+  std::vector<optix::float2> const& getAlias_U() const;
+  std::vector<optix::float2> const& getAlias_V() const;
   
+private:
+  void uploadEnvironment(optix::Context context, const float* texels, const float* cdfU, const float* cdfV,
+                         const optix::float2* aliasU, const optix::float2* aliasV);
+  BlockFormat determineBlockFormat(const Picture* picture, bool useMipmaps) const;
+  void uploadBlocks(const Picture* picture, unsigned int hostEncoding, unsigned int numLevels);
+
 private:
   unsigned int m_width;
   unsigned int m_height;
@@ -159,11 +199,24 @@ private:
   optix::Buffer         m_buffer; // The format of this buffer defines what kind of texture is behind the sampler!
   optix::TextureSampler m_sampler;
 
+  TextureCompression m_compression;
+  BlockQuality       m_compressionQuality;
+  bool               m_compressionCache;
+  BlockFormat        m_blockFormat; // Of m_buffer. m_format stays the uncompressed format convert() produces for the encoder.
+  size_t             m_deviceSize;
+
   // These fields are only used for spherical environment maps.
   std::vector<float> m_texels;      // Contains HDR RGBA32F texture data, input to CDF generation.
+  std::vector<float> m_cdfU;        // Host CDFs between calculateCDF() and uploadEnvironment().
+  std::vector<float> m_cdfV;
+  bool               m_aliasTables;
+  std::vector<optix::float2> m_aliasU; // Host alias tables, (probability, alias index) per cell.
+  std::vector<optix::float2> m_aliasV;
   float              m_integral;
   optix::Buffer      m_bufferCDF_U;
   optix::Buffer      m_bufferCDF_V;
+  optix::Buffer      m_bufferAlias_U;
+  optix::Buffer      m_bufferAlias_V;
 };
 
 #endif // TEXTURE_H
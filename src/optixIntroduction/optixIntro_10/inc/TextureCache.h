@@ -0,0 +1,91 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <optix.h>
+#include <optixu/optixpp_namespace.h>
+
+#include "inc/Texture.h"
+
+#include <map>
+#include <string>
+
+// Shares Textures among all materials using the same image file with the same sampler settings.
+// Requests are keyed on the canonical path and the settings, so each file is decoded and uploaded only once.
+// A newly decoded image with the same content as a resident one (the same file under another name) with the same settings
+// shares that Texture instead of uploading a copy. Textures are reference counted, the last release() destroys them.
+// Filtering is not part of the key, createSampler() always uses linear filtering, trilinear with mipmaps.
+class TextureCache
+{
+public:
+  TextureCache();
+  ~TextureCache();
+
+  // Returns nullptr when the file can't be loaded. Each returned Texture needs one release().
+  // With useMipmaps, images without a mipmap chain get one generated (box filter, in linear space with useSrgb).
+  // With useCache the compressed blocks are read from and written to a BlockCache next to the file.
+  Texture* acquire(optix::Context context, const std::string& filename, 
+                   const bool useSrgb = false, const bool useMipmaps = false, const bool useUnnormalized = false,
+                   const RTwrapmode wrapMode = RT_WRAP_REPEAT,
+                   const TextureCompression compression = TEXTURE_COMPRESSION_NONE, const BlockQuality quality = BLOCK_QUALITY_NORMAL,
+                   const bool useCache = false);
+  void release(Texture* texture);
+  void clear(); // Destroys all Textures, needs the OptiX context still alive.
+
+  unsigned int getNumberOfRequests() const;
+  float        getHitRate() const;       // Requests which didn't upload a texture, also counting the ones shared by content.
+  size_t       getResidentBytes() const; // Device memory of all cached textures including their mipmaps, block compressed or not.
+  void         printStatistics() const;
+
+private:
+  struct Entry
+  {
+    Texture*     texture;
+    unsigned int references;
+    size_t       bytes;
+    std::string  content; // Key in m_contents.
+  };
+
+  void erase(Entry* entry);
+
+private:
+  std::map<std::string, Entry*> m_files;    // Key: canonical path and sampler settings.
+  std::map<std::string, Entry*> m_contents; // Key: hash of the decoded images and sampler settings.
+  std::map<Texture*, Entry*>    m_textures;
+
+  unsigned int m_requests;
+  unsigned int m_hits;        // Found by file name.
+  unsigned int m_contentHits; // Decoded, but found by content.
+  size_t       m_residentBytes;
+};
+
+#endif // TEXTURE_CACHE_H
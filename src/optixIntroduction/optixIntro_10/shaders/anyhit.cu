@@ -36,6 +36,7 @@
 #include "material_parameter.h"
 #include "per_ray_data.h"
 #include "shader_common.h"
+#include "hit_functions.h"
 
 rtDeclareVariable(optix::Ray, theRay,                  rtCurrentRay, );
 rtDeclareVariable(float,      theIntersectionDistance, rtIntersectionDistance, );
@@ -53,18 +54,21 @@ rtBuffer<MaterialParameter> sysMaterialParameters; // Context global buffer with
 rtDeclareVariable(int,      parMaterialIndex, , ); // Per Material index into the above sysMaterialParameters array.
 
 
-// One anyhit program for the radiance ray for all materials with cutout opacity!
-RT_PROGRAM void anyhit_cutout() // For the radiance ray type.
+// The texture lookup of the shared isCutoutIgnored() test.
+struct CutoutProgram
 {
-  float opacity = 1.0f;
-  const int id = sysMaterialParameters[parMaterialIndex].cutoutID; // Fetch the bindless texture ID for cutout opacity.
-  if (id != RT_TEXTURE_ID_NULL)
+  RT_FUNCTION float4 tex2D(const int id, const float u, const float v) const
   {
-    opacity = intensity(make_float3(optix::rtTex2D<float4>(id, varTexCoord.x, varTexCoord.y))); // RGB intensity defines the opacity. White is opaque.
+    return optix::rtTex2D<float4>(id, u, v);
   }
+};
+
 
-  // Stochastic alpha test to get an alpha blend effect.
-  if (opacity < 1.0f && opacity <= rng(thePrdShadow.seed)) // No need to calculate an expensive random number if the test is going to fail anyway.
+// One anyhit program for the radiance ray for all materials with cutout opacity!
+RT_PROGRAM void anyhit_cutout() // For the radiance ray type.
+{
+  // Fetch the bindless texture ID for cutout opacity.
+  if (isCutoutIgnored(CutoutProgram(), sysMaterialParameters[parMaterialIndex].cutoutID, varTexCoord, thePrdShadow.seed))
   {
     rtIgnoreIntersection();
   }
@@ -80,15 +84,7 @@ RT_PROGRAM void anyhit_shadow()
 
 RT_PROGRAM void anyhit_shadow_cutout() // For the shadow ray type.
 {
-  float opacity = 1.0f;
-  const int id = sysMaterialParameters[parMaterialIndex].cutoutID; // Fetch the bindless texture ID for cutout opacity.
-  if (id != RT_TEXTURE_ID_NULL)
-  {
-    opacity = intensity(make_float3(optix::rtTex2D<float4>(id, varTexCoord.x, varTexCoord.y))); // RGB intensity defines the opacity. White is opaque.
-  }
-
-  // Stochastic alpha test to get an alpha blend effect.
-  if (opacity < 1.0f && opacity <= rng(thePrdShadow.seed)) // No need to calculate an expensive random number if the test is going to fail anyway.
+  if (isCutoutIgnored(CutoutProgram(), sysMaterialParameters[parMaterialIndex].cutoutID, varTexCoord, thePrdShadow.seed))
   {
     rtIgnoreIntersection();
   }
@@ -98,4 +94,3 @@ RT_PROGRAM void anyhit_shadow_cutout() // For the shadow ray type.
     rtTerminateRay();
   }
 }
-
@@ -63,4 +63,14 @@
 // 1 == Enable  all OptiX exceptions, rtPrintfs and rtAssert functionality. (Really only for debugging, big performance hit!)
 #define USE_DEBUG_EXCEPTIONS 0
 
+// 0 == Store the interleaved 48 bytes VertexAttributes per vertex in the attributesBuffer.
+// 1 == Store the float3 position in a separate positionsBuffer and the compact 12 bytes VertexAttributesCompact
+//      (octahedral encoded tangent and normal, half2 texture coordinates) in the attributesBuffer. 24 bytes per vertex.
+#define USE_COMPACT_VERTEX_ATTRIBUTES 1
+
+// 0 == Importance-sample the spherical environment light with two binary searches over the CDFs. 
+// 1 == Importance-sample it with Vose alias tables in constant time. Needs 8 bytes per texel in addition to the CDFs.
+//      Run optixIntro_10 --benchmark to compare the sample distribution and throughput of both methods on the CPU.
+#define USE_ENVIRONMENT_ALIAS_TABLES 0
+
 #endif // APP_CONFIG_H
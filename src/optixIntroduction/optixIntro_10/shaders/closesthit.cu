@@ -36,6 +36,7 @@
 #include "material_parameter.h"
 #include "light_definition.h"
 #include "shader_common.h"
+#include "hit_functions.h"
 
 // Context global variables provided by the renderer system.
 rtDeclareVariable(rtObject, sysTopObject, , );
@@ -66,116 +67,65 @@ rtBuffer< rtCallableProgramId<float4(MaterialParameter const& parameters, State
 
 rtBuffer< rtCallableProgramId<void(float3 const& point, const float2 sample, LightSample& lightSample)> > sysSampleLight;
 
-RT_PROGRAM void closesthit()
+// The platform specific parts of the shared closesthitMaterial() body.
+struct ClosesthitProgram
 {
-  State state; // All in world space coordinates!
-
-  state.geoNormal = optix::normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, varGeoNormal));
-  state.normal    = optix::normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, varNormal));
-  state.texcoord  = varTexCoord;
+  RT_FUNCTION float4 tex2D(const int id, const float u, const float v) const
+  {
+    return optix::rtTex2D<float4>(id, u, v);
+  }
 
-  thePrd.pos      = theRay.origin + theRay.direction * theIntersectionDistance; // Advance the path to the hit position in world coordinates.
-  thePrd.distance = theIntersectionDistance; // Return the current path segment distance, needed for absorption calculations in the integrator.
+  RT_FUNCTION void sampleBSDF(MaterialParameter const& parameters, State const& state, PerRayData& prd) const
+  {
+    sysSampleBSDF[parameters.indexBSDF](parameters, state, prd);
+  }
 
-  // Explicitly include edge-on cases as frontface condition!
-  // Keeps the material stack from overflowing at silhouttes.
-  // Prevents that silhouettes of thin-walled materials use the backface material.
-  // Using the true geometry normal attribute as originally defined on the frontface!
-  thePrd.flags |= (0.0f <= optix::dot(thePrd.wo, state.geoNormal)) ? (FLAG_FRONTFACE | FLAG_HIT) : FLAG_HIT;
+  RT_FUNCTION float4 evalBSDF(MaterialParameter const& parameters, State const& state, PerRayData const& prd, float3 const& wiL) const
+  {
+    return sysEvalBSDF[parameters.indexBSDF](parameters, state, prd, wiL);
+  }
 
-  if ((thePrd.flags & FLAG_FRONTFACE) == 0) // Looking at the backface?
+  RT_FUNCTION int getNumLights() const
   {
-    // Means geometric normal and shading normal are always defined on the side currently looked at.
-    // This gives the backfaces of opaque BSDFs a defined result.
-    state.geoNormal = -state.geoNormal;
-    state.normal    = -state.normal;
-    // Do not recalculate the frontface condition!
+    return sysNumLights;
   }
 
-  // A material system with support for arbitrary mesh lights would evaluate its emission here.
-  // But since only parallelogram area lights are supported, those get a dedicated closest hit program to simplify this demo.
-  thePrd.radiance  = make_float3(0.0f);
+  RT_FUNCTION void sampleLight(float3 const& point, const float2 sample, LightSample& lightSample) const
+  {
+    const LightType lightType = sysLightDefinitions[lightSample.index].type;
 
-  MaterialParameter parameters = sysMaterialParameters[parMaterialIndex]; // Copy the material parameters locally to be able to fetch texture data once.
+    sysSampleLight[lightType](point, sample, lightSample);
+  }
 
-  if (parameters.albedoID != RT_TEXTURE_ID_NULL)
+  RT_FUNCTION float getSceneEpsilon() const
   {
-    const float3 texColor = make_float3(optix::rtTex2D<float4>(parameters.albedoID, state.texcoord.x, state.texcoord.y));
-    
-    // Modulate the incoming color with the texture.
-    parameters.albedo *= texColor;               // linear color, resp. if the texture has been uint8 and readmode set to use sRGB, then sRGB.
-    //parameters.albedo *= powf(texColor, 2.2f); // sRGB gamma correction done manually.
+    return sysSceneEpsilon;
   }
 
-#if USE_DENOISER
-#if USE_DENOISER_ALBEDO
-  thePrd.albedo = parameters.albedo;
-#if USE_DENOISER_NORMAL
-    thePrd.normal = state.normal;
-#endif
-#endif
-#endif
-
-  // Start fresh with the next BSDF sample.  (Either of these values remaining zero is an end-of-path condition.)
-  thePrd.f_over_pdf = make_float3(0.0f);
-  thePrd.pdf        = 0.0f;
+  RT_FUNCTION bool traceShadow(float3 const& origin, float3 const& direction, const float tmin, const float tmax, unsigned int& seed) const
+  {
+    PerRayData_shadow prdShadow;
+      
+    prdShadow.seed    = seed; // For potential stochastic cutout opacity sampling.
+    prdShadow.visible = true; // Initialize for miss.
 
-  // Only the last diffuse hit is tracked for multiple importance sampling of implicit light hits.
-  thePrd.flags = (thePrd.flags & ~FLAG_DIFFUSE) | parameters.flags; // FLAG_THINWALLED can be set directly from the material parameters.
+    optix::Ray ray = optix::make_Ray(origin, direction, 1, tmin, tmax); // Shadow ray.
+    rtTrace(sysTopObject, ray, theCurrentTime, prdShadow);
 
-  sysSampleBSDF[parameters.indexBSDF](parameters, state, thePrd);
+    seed = prdShadow.seed; // Continue the RNG state!
 
-#if USE_NEXT_EVENT_ESTIMATION
-  // Direct lighting if the sampled BSDF was diffuse and any light is in the scene.
-  if ((thePrd.flags & FLAG_DIFFUSE) && 0 < sysNumLights)
-  {
-    const float2 sample = rng2(thePrd.seed); // Use lower dimension samples for the position. (Irrelevant for the LCG).
+    return prdShadow.visible;
+  }
+};
 
-    LightSample lightSample; // Sample one of many lights. 
-  
-    // The caller picks the light to sample. Make sure the index stays in the bounds of the sysLightDefinitions array.
-    lightSample.index = optix::clamp(static_cast<int>(floorf(rng(thePrd.seed) * sysNumLights)), 0, sysNumLights - 1); 
+RT_PROGRAM void closesthit()
+{
+  State state; // All in world space coordinates!
 
-    const LightType lightType = sysLightDefinitions[lightSample.index].type;
+  state.geoNormal = optix::normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, varGeoNormal));
+  state.normal    = optix::normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, varNormal));
+  state.texcoord  = varTexCoord;
 
-    sysSampleLight[lightType](thePrd.pos, sample, lightSample);
-  
-    if (0.0f < lightSample.pdf) // Useful light sample?
-    {
-      // Evaluate the BSDF in the light sample direction. Normally cheaper than shooting rays.
-      // Returns BSDF f in .xyz and the BSDF pdf in .w
-      const float4 bsdf_pdf = sysEvalBSDF[parameters.indexBSDF](parameters, state, thePrd, lightSample.direction);
-
-      if (0.0f < bsdf_pdf.w && isNotNull(make_float3(bsdf_pdf)))
-      {
-        // Do the visibility check of the light sample.
-        PerRayData_shadow prdShadow;
-      
-        prdShadow.seed    = thePrd.seed; // For potential stochastic cutout opacity sampling.
-        prdShadow.visible = true;        // Initialize for miss.
-
-        // Note that the sysSceneEpsilon is applied on both sides of the shadow ray [t_min, t_max] interval 
-        // to prevent self intersections with the actual light geometry in the scene!
-        optix::Ray ray = optix::make_Ray(thePrd.pos, lightSample.direction, 1, sysSceneEpsilon, lightSample.distance - sysSceneEpsilon); // Shadow ray.
-        rtTrace(sysTopObject, ray, theCurrentTime, prdShadow);
-
-        thePrd.seed = prdShadow.seed; // Continue the RNG state!
-
-        if (prdShadow.visible)
-        {
-          if (thePrd.flags & FLAG_VOLUME) // Supporting nested materials includes having lights inside a volume.
-          {
-            // Calculate the transmittance along the light sample's distance in case it's inside a volume.
-            // The light must be in the same volume or it would have been shadowed!
-            lightSample.emission *= expf(-lightSample.distance * thePrd.extinction);
-          }
-
-          const float misWeight = powerHeuristic(lightSample.pdf, bsdf_pdf.w);
-
-          thePrd.radiance += make_float3(bsdf_pdf) * lightSample.emission * (misWeight * optix::dot(lightSample.direction, state.normal) / lightSample.pdf);
-        }
-      }
-    }
-  }
-#endif // USE_NEXT_EVENT_ESTIMATION
+  // Copy the material parameters locally to be able to fetch texture data once.
+  closesthitMaterial(ClosesthitProgram(), sysMaterialParameters[parMaterialIndex], state, theRay.origin, theRay.direction, theIntersectionDistance, thePrd);
 }
@@ -0,0 +1,182 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef ENVIRONMENT_SAMPLING_H
+#define ENVIRONMENT_SAMPLING_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+
+// Importance sampling of spherical environment maps with the tables generated in Texture::calculateCDF().
+// Both routines map a uniform sample in [0, 1)^2 to the normalized texture coordinate (u, v) of the environment texture.
+// The table arguments are rtBufferId on the device and the HostTable1D/HostTable2D views below on the host,
+// which allows to test and benchmark the exact same code without OptiX.
+
+// Two binary searches over the marginal CDF cdfV (height + 1 entries) and the conditional CDF cdfU of the selected row ((width + 1) * height entries).
+// Both CDFs include the leading 0.0f and the trailing 1.0f.
+template <typename TableU, typename TableV>
+RT_FUNCTION optix::float2 sampleEnvironmentCDF(TableU const& cdfU, TableV const& cdfV, const optix::float2 sample)
+{
+  const unsigned int sizeU = static_cast<unsigned int>(cdfU.size().x);
+  const unsigned int sizeV = static_cast<unsigned int>(cdfV.size());
+
+  unsigned int ilo = 0;          // Use this for full spherical lighting. (This matches the result of indirect environment lighting.)
+  unsigned int ihi = sizeV - 1 ; // Index on the last entry containing 1.0f. Can never be reached with the sample in the range [0.0f, 1.0f).
+
+  // Binary search the row index to look up.
+  while (ilo != ihi - 1) // When a pair of limits have been found, the lower index indicates the cell to use.
+  {
+    const unsigned int i = (ilo + ihi) >> 1;
+    const float cdf = cdfV[i];
+    if (sample.y < cdf) // If the cdf is greater than the sample, use that as new higher limit.
+    {
+      ihi = i;
+    }
+    else // If the sample is greater than or equal to the CDF value, use that as new lower limit.
+    {
+      ilo = i; 
+    }
+  }
+
+  optix::uint2 index; // 2D index used in the next binary search.
+  index.y = ilo; // This is the row we found.
+    
+  // Binary search the column index to look up.
+  ilo = 0;
+  ihi = sizeU - 1; // Index on the last entry containing 1.0f. Can never be reached with the sample in the range [0.0f, 1.0f).
+  while (ilo != ihi - 1) // When a pair of limits have been found, the lower index indicates the cell to use.
+  {
+    index.x = (ilo + ihi) >> 1;
+    const float cdf = cdfU[index];
+    if (sample.x < cdf) // If the CDF value is greater than the sample, use that as new higher limit.
+    {
+      ihi = index.x;
+    }
+    else // If the sample is greater than or equal to the CDF value, use that as new lower limit.
+    {
+      ilo = index.x; 
+    }
+  }
+
+  index.x = ilo; // The column result.
+
+  // Continuous sampling of the CDF.
+  const float cdfLowerU = cdfU[index];
+  const float cdfUpperU = cdfU[optix::make_uint2(index.x + 1, index.y)];
+  const float du = (sample.x - cdfLowerU) / (cdfUpperU - cdfLowerU);
+
+  const float cdfLowerV = cdfV[index.y];
+  const float cdfUpperV = cdfV[index.y + 1];
+  const float dv = (sample.y - cdfLowerV) / (cdfUpperV - cdfLowerV);
+
+  // Texture lookup coordinates.
+  return optix::make_float2((float(index.x) + du) / float(sizeU - 1),
+                            (float(index.y) + dv) / float(sizeV - 1));
+}
+
+// Picks a cell of a Vose alias table with a single lookup.
+// Each entry holds the probability to keep the cell in .x and the index of its alias cell in .y.
+// The fraction of the scaled sample decides between the two and is remapped to [0, 1) to place the sample inside the cell.
+RT_FUNCTION unsigned int sampleAlias(const optix::float2 entry, const unsigned int cell, float& fraction)
+{
+  if (fraction < entry.x)
+  {
+    fraction /= entry.x;
+    return cell;
+  }
+  fraction = (fraction - entry.x) / (1.0f - entry.x);
+  return static_cast<unsigned int>(entry.y);
+}
+
+// Constant time sampling with the marginal alias table aliasV (height entries) and the conditional alias tables aliasU (width * height entries).
+// Picks the texels with the same probabilities as sampleEnvironmentCDF(), but not the same texel for the same sample.
+template <typename TableU, typename TableV>
+RT_FUNCTION optix::float2 sampleEnvironmentAlias(TableU const& aliasU, TableV const& aliasV, const optix::float2 sample)
+{
+  const unsigned int sizeU = static_cast<unsigned int>(aliasU.size().x);
+  const unsigned int sizeV = static_cast<unsigned int>(aliasV.size());
+
+  const float sv = sample.y * float(sizeV);
+  optix::uint2 index;
+  index.y = optix::min(static_cast<unsigned int>(sv), sizeV - 1); // Guard against rounding up for samples just below 1.0f.
+  float dv = sv - float(index.y);
+  index.y = sampleAlias(aliasV[index.y], index.y, dv);
+
+  const float su = sample.x * float(sizeU);
+  index.x = optix::min(static_cast<unsigned int>(su), sizeU - 1);
+  float du = su - float(index.x);
+  index.x = sampleAlias(aliasU[index], index.x, du);
+
+  // Texture lookup coordinates.
+  return optix::make_float2((float(index.x) + du) / float(sizeU),
+                            (float(index.y) + dv) / float(sizeV));
+}
+
+#ifndef __CUDACC__
+// Host side views of the tables with the same interface as the rtBufferId used in the device code.
+template <typename T>
+struct HostTable1D
+{
+  const T*     data;
+  unsigned int width;
+
+  unsigned int size() const
+  {
+    return width;
+  }
+  T const& operator[](const unsigned int i) const
+  {
+    return data[i];
+  }
+};
+
+template <typename T>
+struct HostTable2D
+{
+  const T*     data;
+  unsigned int width;
+  unsigned int height;
+
+  optix::uint2 size() const
+  {
+    return optix::make_uint2(width, height);
+  }
+  T const& operator[](const optix::uint2 i) const
+  {
+    return data[i.y * width + i.x];
+  }
+};
+#endif
+
+#endif // ENVIRONMENT_SAMPLING_H
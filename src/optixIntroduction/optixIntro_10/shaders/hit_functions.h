@@ -0,0 +1,220 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef HIT_FUNCTIONS_H
+#define HIT_FUNCTIONS_H
+
+#include "app_config.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "rt_function.h"
+#include "per_ray_data.h"
+#include "material_parameter.h"
+#include "light_definition.h"
+#include "shader_common.h"
+
+// The bodies of the closest hit and anyhit programs.
+// The Program argument provides the platform specific parts as const member functions:
+//   optix::float4 tex2D(const int id, const float u, const float v)
+//   void          sampleBSDF(MaterialParameter const& parameters, State const& state, PerRayData& prd)
+//   optix::float4 evalBSDF(MaterialParameter const& parameters, State const& state, PerRayData const& prd, optix::float3 const& wiL)
+//   int           getNumLights()
+//   void          sampleLight(optix::float3 const& point, const optix::float2 sample, LightSample& lightSample) // lightSample.index is set.
+//   float         getSceneEpsilon()
+//   bool          traceShadow(optix::float3 const& origin, optix::float3 const& direction, const float tmin, const float tmax, unsigned int& seed) // true when visible.
+// On the device these are the bindless callable programs, rtTex2D() and rtTrace(), on the host the CpuRenderer implements them.
+
+// The state holds the world space geometry and shading normals and the texture coordinate of the hit.
+template <typename Program>
+RT_FUNCTION void closesthitMaterial(Program const& program, MaterialParameter parameters, State& state,
+                                    optix::float3 const& origin, optix::float3 const& direction, const float distance, PerRayData& prd)
+{
+  prd.pos      = origin + direction * distance; // Advance the path to the hit position in world coordinates.
+  prd.distance = distance; // Return the current path segment distance, needed for absorption calculations in the integrator.
+
+  // Explicitly include edge-on cases as frontface condition!
+  // Keeps the material stack from overflowing at silhouttes.
+  // Prevents that silhouettes of thin-walled materials use the backface material.
+  // Using the true geometry normal attribute as originally defined on the frontface!
+  prd.flags |= (0.0f <= optix::dot(prd.wo, state.geoNormal)) ? (FLAG_FRONTFACE | FLAG_HIT) : FLAG_HIT;
+
+  if ((prd.flags & FLAG_FRONTFACE) == 0) // Looking at the backface?
+  {
+    // Means geometric normal and shading normal are always defined on the side currently looked at.
+    // This gives the backfaces of opaque BSDFs a defined result.
+    state.geoNormal = -state.geoNormal;
+    state.normal    = -state.normal;
+    // Do not recalculate the frontface condition!
+  }
+
+  // A material system with support for arbitrary mesh lights would evaluate its emission here.
+  // But since only parallelogram area lights are supported, those get a dedicated closest hit program to simplify this demo.
+  prd.radiance = optix::make_float3(0.0f);
+
+  if (parameters.albedoID != RT_TEXTURE_ID_NULL)
+  {
+    const optix::float3 texColor = optix::make_float3(program.tex2D(parameters.albedoID, state.texcoord.x, state.texcoord.y));
+    
+    // Modulate the incoming color with the texture.
+    parameters.albedo *= texColor;               // linear color, resp. if the texture has been uint8 and readmode set to use sRGB, then sRGB.
+    //parameters.albedo *= powf(texColor, 2.2f); // sRGB gamma correction done manually.
+  }
+
+#if USE_DENOISER
+#if USE_DENOISER_ALBEDO
+  prd.albedo = parameters.albedo;
+#if USE_DENOISER_NORMAL
+  prd.normal = state.normal;
+#endif
+#endif
+#endif
+
+  // Start fresh with the next BSDF sample.  (Either of these values remaining zero is an end-of-path condition.)
+  prd.f_over_pdf = optix::make_float3(0.0f);
+  prd.pdf        = 0.0f;
+
+  // Only the last diffuse hit is tracked for multiple importance sampling of implicit light hits.
+  prd.flags = (prd.flags & ~FLAG_DIFFUSE) | parameters.flags; // FLAG_THINWALLED can be set directly from the material parameters.
+
+  program.sampleBSDF(parameters, state, prd);
+
+#if USE_NEXT_EVENT_ESTIMATION
+  const int numLights = program.getNumLights();
+
+  // Direct lighting if the sampled BSDF was diffuse and any light is in the scene.
+  if ((prd.flags & FLAG_DIFFUSE) && 0 < numLights)
+  {
+    const optix::float2 sample = rng2(prd.seed); // Use lower dimension samples for the position. (Irrelevant for the LCG).
+
+    LightSample lightSample; // Sample one of many lights. 
+  
+    // The caller picks the light to sample. Make sure the index stays in the bounds of the light definitions array.
+    lightSample.index = optix::clamp(static_cast<int>(floorf(rng(prd.seed) * numLights)), 0, numLights - 1); 
+
+    program.sampleLight(prd.pos, sample, lightSample);
+  
+    if (0.0f < lightSample.pdf) // Useful light sample?
+    {
+      // Evaluate the BSDF in the light sample direction. Normally cheaper than shooting rays.
+      // Returns BSDF f in .xyz and the BSDF pdf in .w
+      const optix::float4 bsdf_pdf = program.evalBSDF(parameters, state, prd, lightSample.direction);
+
+      if (0.0f < bsdf_pdf.w && isNotNull(optix::make_float3(bsdf_pdf)))
+      {
+        // Note that the scene epsilon is applied on both sides of the shadow ray [t_min, t_max] interval 
+        // to prevent self intersections with the actual light geometry in the scene!
+        const float sceneEpsilon = program.getSceneEpsilon();
+
+        // Do the visibility check of the light sample. Continues the RNG state for potential stochastic cutout opacity sampling.
+        if (program.traceShadow(prd.pos, lightSample.direction, sceneEpsilon, lightSample.distance - sceneEpsilon, prd.seed))
+        {
+          if (prd.flags & FLAG_VOLUME) // Supporting nested materials includes having lights inside a volume.
+          {
+            // Calculate the transmittance along the light sample's distance in case it's inside a volume.
+            // The light must be in the same volume or it would have been shadowed!
+            lightSample.emission *= optix::expf(-lightSample.distance * prd.extinction);
+          }
+
+          const float misWeight = powerHeuristic(lightSample.pdf, bsdf_pdf.w);
+
+          prd.radiance += optix::make_float3(bsdf_pdf) * lightSample.emission * (misWeight * optix::dot(lightSample.direction, state.normal) / lightSample.pdf);
+        }
+      }
+    }
+  }
+#endif // USE_NEXT_EVENT_ESTIMATION
+}
+
+// Very simple closest hit body just for rectangle area lights. The geoNormal is in world space.
+RT_FUNCTION void closesthitLight(LightDefinition const& light, optix::float3 const& geoNormal,
+                                 optix::float3 const& origin, optix::float3 const& direction, const float distance, PerRayData& prd)
+{
+  prd.pos      = origin + direction * distance; // Advance the path to the hit position in world coordinates.
+  prd.distance = distance; // Return the current path segment distance, needed for absorption calculations in the integrator.
+
+  const float cosTheta = optix::dot(prd.wo, geoNormal);
+  prd.flags |= (0.0f <= cosTheta) ? (FLAG_FRONTFACE | FLAG_HIT) : FLAG_HIT;
+
+  prd.radiance = optix::make_float3(0.0f); // Backside is black.
+
+#if USE_DENOISER
+#if USE_DENOISER_ALBEDO
+  prd.albedo   = optix::make_float3(0.0f); // Backside is black.
+#if USE_DENOISER_NORMAL
+  prd.normal   = -light.normal;
+#endif
+#endif
+#endif
+
+  if (prd.flags & FLAG_FRONTFACE) // Looking at the front face?
+  {
+    prd.radiance = light.emission;
+
+#if USE_DENOISER
+#if USE_DENOISER_ALBEDO
+    prd.albedo   = light.emission;
+#if USE_DENOISER_NORMAL
+    prd.normal   = light.normal;
+#endif
+#endif
+#endif
+
+#if USE_NEXT_EVENT_ESTIMATION
+    const float pdfLight = (prd.distance * prd.distance) / (light.area * cosTheta); // Solid angle pdf. Assumes light.area != 0.0f.
+    // If it's an implicit light hit from a diffuse scattering event and the light emission was not returning a zero pdf.
+    if ((prd.flags & FLAG_DIFFUSE) && DENOMINATOR_EPSILON < pdfLight)
+    {
+      // Scale the emission with the power heuristic between the previous BSDF sample pdf and this implicit light sample pdf.
+      prd.radiance *= powerHeuristic(prd.pdf, pdfLight);
+    }
+#endif // USE_NEXT_EVENT_ESTIMATION
+  }
+
+  // Lights have no other material properties than emission in this demo. Terminate the path.
+  prd.flags |= (FLAG_LIGHT | FLAG_TERMINATE);
+}
+
+// The stochastic alpha test of the cutout opacity anyhit programs. Returns true when the intersection is ignored.
+template <typename Program>
+RT_FUNCTION bool isCutoutIgnored(Program const& program, const int cutoutID, optix::float3 const& texcoord, unsigned int& seed)
+{
+  float opacity = 1.0f;
+  if (cutoutID != RT_TEXTURE_ID_NULL)
+  {
+    opacity = intensity(optix::make_float3(program.tex2D(cutoutID, texcoord.x, texcoord.y))); // RGB intensity defines the opacity. White is opaque.
+  }
+
+  // Stochastic alpha test to get an alpha blend effect.
+  return (opacity < 1.0f && opacity <= rng(seed)); // No need to calculate an expensive random number if the test is going to fail anyway.
+}
+
+#endif // HIT_FUNCTIONS_H
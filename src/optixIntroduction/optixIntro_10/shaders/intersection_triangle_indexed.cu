@@ -33,7 +33,12 @@
 
 #include "vertex_attributes.h"
 
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+rtBuffer<float3>                  positionsBuffer;
+rtBuffer<VertexAttributesCompact> attributesBuffer;
+#else
 rtBuffer<VertexAttributes> attributesBuffer;
+#endif
 rtBuffer<uint3>            indicesBuffer;
 
 // Attributes.
@@ -49,6 +54,11 @@ RT_PROGRAM void intersection_triangle_indexed(int primitiveIndex)
 {
   const uint3 indices = indicesBuffer[primitiveIndex];
 
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+  const float3 v0 = positionsBuffer[indices.x];
+  const float3 v1 = positionsBuffer[indices.y];
+  const float3 v2 = positionsBuffer[indices.z];
+#else
   VertexAttributes const& a0 = attributesBuffer[indices.x];
   VertexAttributes const& a1 = attributesBuffer[indices.y];
   VertexAttributes const& a2 = attributesBuffer[indices.z];
@@ -56,6 +66,7 @@ RT_PROGRAM void intersection_triangle_indexed(int primitiveIndex)
   const float3 v0 = a0.vertex;
   const float3 v1 = a1.vertex;
   const float3 v2 = a2.vertex;
+#endif
 
   float3 n;
   float  t;
@@ -69,6 +80,13 @@ RT_PROGRAM void intersection_triangle_indexed(int primitiveIndex)
       // Barycentric interpolation:
       const float alpha = 1.0f - beta - gamma;
 
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+      // Only decode the vertex attributes of the potential closest hit.
+      const VertexAttributes a0 = unpackVertexAttributes(v0, attributesBuffer[indices.x]);
+      const VertexAttributes a1 = unpackVertexAttributes(v1, attributesBuffer[indices.y]);
+      const VertexAttributes a2 = unpackVertexAttributes(v2, attributesBuffer[indices.z]);
+#endif
+
       // Note: No normalization on the TBN attributes here for performance reasons.
       //       It's done after the transformation into world space anyway.
       varGeoNormal      = n;
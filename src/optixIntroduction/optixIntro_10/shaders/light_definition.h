@@ -60,11 +60,11 @@ struct LightDefinition
   rtBufferId<float, 2> idEnvironmentCDF_U;   // rtBufferId fields are integers.
   rtBufferId<float, 1> idEnvironmentCDF_V;
   float                environmentIntegral;
+  rtBufferId<optix::float2, 2> idEnvironmentAlias_U; // Only valid with USE_ENVIRONMENT_ALIAS_TABLES.
+  rtBufferId<optix::float2, 1> idEnvironmentAlias_V;
 
   // Manual padding to float4 alignment goes here.
   float         unused0;
-  float         unused1;
-  float         unused2;
 };
 
 struct LightSample
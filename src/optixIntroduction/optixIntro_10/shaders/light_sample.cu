@@ -34,6 +34,8 @@
 #include "rt_function.h"
 #include "per_ray_data.h"
 #include "light_definition.h"
+#include "light_functions.h"
+#include "environment_sampling.h"
 #include "shader_common.h"
 
 #include "rt_assert.h"
@@ -44,30 +46,11 @@ rtDeclareVariable(int,    sysNumLights, , ); // PERF Used many times and faster
 rtDeclareVariable(float,  sysEnvironmentRotation, , );
 
 
-RT_FUNCTION void unitSquareToSphere(const float u, const float v, float3& p, float& pdf)
-{
-  p.z = 1.0f - 2.0f * u;
-  float r = 1.0f - p.z * p.z;
-  r = (0.0f < r) ? sqrtf(r) : 0.0f;
-  
-  const float phi = v * 2.0f * M_PIf;
-  p.x = r * cosf(phi);
-  p.y = r * sinf(phi);
-
-  pdf = 0.25f * M_1_PIf;  // == 1.0f / (4.0f * M_PIf)
-}
-
 // Note that all light sampling routines return lightSample.direction and lightSample.distance in world space!
 
 RT_CALLABLE_PROGRAM void sample_light_constant(float3 const& point, const float2 sample, LightSample& lightSample)
 {
-  unitSquareToSphere(sample.x, sample.y, lightSample.direction, lightSample.pdf);
-
-  // Environment lights do not set the light sample position!
-  lightSample.distance = RT_DEFAULT_MAX; // Environment light.
-
-  // Explicit light sample. White scaled by inverse probabilty to hit this light.
-  lightSample.emission = make_float3(sysNumLights);
+  sampleLightConstant(sysNumLights, sample, lightSample);
 }
 
 RT_CALLABLE_PROGRAM void sample_light_environment(float3 const& point, const float2 sample, LightSample& lightSample)
@@ -75,61 +58,15 @@ RT_CALLABLE_PROGRAM void sample_light_environment(float3 const& point, const flo
   const LightDefinition light = sysLightDefinitions[0]; // The environment light is always placed into the first entry.
 
   // Importance-sample the spherical environment light direction.
-  const unsigned int sizeU = static_cast<unsigned int>(light.idEnvironmentCDF_U.size().x);
-  const unsigned int sizeV = static_cast<unsigned int>(light.idEnvironmentCDF_V.size());
-
-  unsigned int ilo = 0;          // Use this for full spherical lighting. (This matches the result of indirect environment lighting.)
-  unsigned int ihi = sizeV - 1 ; // Index on the last entry containing 1.0f. Can never be reached with the sample in the range [0.0f, 1.0f).
-
-  // Binary search the row index to look up.
-  while (ilo != ihi - 1) // When a pair of limits have been found, the lower index indicates the cell to use.
-  {
-    const unsigned int i = (ilo + ihi) >> 1;
-    const float cdf = light.idEnvironmentCDF_V[i];
-    if (sample.y < cdf) // If the cdf is greater than the sample, use that as new higher limit.
-    {
-      ihi = i;
-    }
-    else // If the sample is greater than or equal to the CDF value, use that as new lower limit.
-    {
-      ilo = i; 
-    }
-  }
-
-  uint2 index; // 2D index used in the next binary search.
-  index.y = ilo; // This is the row we found.
-    
-  // Binary search the column index to look up.
-  ilo = 0;
-  ihi = sizeU - 1; // Index on the last entry containing 1.0f. Can never be reached with the sample in the range [0.0f, 1.0f).
-  while (ilo != ihi - 1) // When a pair of limits have been found, the lower index indicates the cell to use.
-  {
-    index.x = (ilo + ihi) >> 1;
-    const float cdf = light.idEnvironmentCDF_U[index];
-    if (sample.x < cdf) // If the CDF value is greater than the sample, use that as new higher limit.
-    {
-      ihi = index.x;
-    }
-    else // If the sample is greater than or equal to the CDF value, use that as new lower limit.
-    {
-      ilo = index.x; 
-    }
-  }
-
-  index.x = ilo; // The column result.
-
-  // Continuous sampling of the CDF.
-  const float cdfLowerU = light.idEnvironmentCDF_U[index];
-  const float cdfUpperU = light.idEnvironmentCDF_U[make_uint2(index.x + 1, index.y)];
-  const float du = (sample.x - cdfLowerU) / (cdfUpperU - cdfLowerU);
-
-  const float cdfLowerV = light.idEnvironmentCDF_V[index.y];
-  const float cdfUpperV = light.idEnvironmentCDF_V[index.y + 1];
-  const float dv = (sample.y - cdfLowerV) / (cdfUpperV - cdfLowerV);
+#if USE_ENVIRONMENT_ALIAS_TABLES
+  const float2 uv = sampleEnvironmentAlias(light.idEnvironmentAlias_U, light.idEnvironmentAlias_V, sample);
+#else
+  const float2 uv = sampleEnvironmentCDF(light.idEnvironmentCDF_U, light.idEnvironmentCDF_V, sample);
+#endif
 
   // Texture lookup coordinates.
-  const float u = (float(index.x) + du) / float(sizeU - 1);
-  const float v = (float(index.y) + dv) / float(sizeV - 1);
+  const float u = uv.x;
+  const float v = uv.y;
 
   // Light sample direction vector polar coordinates. This is where the environment rotation happens!
   // DAR FIXME Use a light.matrix to rotate the resulting vector instead.
@@ -156,23 +93,5 @@ RT_CALLABLE_PROGRAM void sample_light_environment(float3 const& point, const flo
 
 RT_CALLABLE_PROGRAM void sample_light_parallelogram(float3 const& point, const float2 sample, LightSample& lightSample)
 {
-  lightSample.pdf = 0.0f; // Default return, invalid light sample (backface, edge on, or too near to the surface)
-
-  const LightDefinition light = sysLightDefinitions[lightSample.index]; // The light index is picked by the caller!
-
-  lightSample.position  = light.position + light.vecU * sample.x + light.vecV * sample.y; // The light sample position in world coordinates.
-  lightSample.direction = lightSample.position - point; // Sample direction from surface point to light sample position.
-  lightSample.distance  = optix::length(lightSample.direction);
-  if (DENOMINATOR_EPSILON < lightSample.distance)
-  {
-    lightSample.direction /= lightSample.distance; // Normalized direction to light.
- 
-    const float cosTheta = optix::dot(-lightSample.direction, light.normal);
-    if (DENOMINATOR_EPSILON < cosTheta) // Only emit light on the front side.
-    {
-      // Explicit light sample, must scale the emission by inverse probabilty to hit this light.
-      lightSample.emission = light.emission * float(sysNumLights); 
-      lightSample.pdf      = (lightSample.distance * lightSample.distance) / (light.area * cosTheta); // Solid angle pdf. Assumes light.area != 0.0f.
-    }
-  }
+  sampleLightParallelogram(sysLightDefinitions[lightSample.index], sysNumLights, point, sample, lightSample); // The light index is picked by the caller!
 }
@@ -35,6 +35,7 @@
 #include "per_ray_data.h"
 #include "light_definition.h"
 #include "shader_common.h"
+#include "miss_functions.h"
 
 rtDeclareVariable(optix::Ray, theRay, rtCurrentRay, );
 
@@ -48,71 +49,21 @@ rtDeclareVariable(float, sysEnvironmentRotation, , );
 // Not actually a light. Never appears inside the sysLightDefinitions.
 RT_PROGRAM void miss_environment_null()
 {
-  thePrd.radiance = make_float3(0.0f);
-
-#if USE_DENOISER
-#if USE_DENOISER_ALBEDO
-  thePrd.albedo   = make_float3(0.0f);
-#endif
-#endif
-
-  thePrd.flags |= FLAG_TERMINATE; // Not a light.
+  missEnvironmentNull(thePrd);
 }
 
 RT_PROGRAM void miss_environment_constant()
 {
-#if USE_NEXT_EVENT_ESTIMATION
-  // If the last surface intersection was a diffuse which was directly lit with multiple importance sampling,
-  // then calculate light emission with multiple importance sampling as well.
-  const float weightMIS = (thePrd.flags & FLAG_DIFFUSE) ? powerHeuristic(thePrd.pdf, 0.25f * M_1_PIf) : 1.0f;
-  thePrd.radiance = make_float3(weightMIS); // Constant white emission multiplied by MIS weight.
-#else
-  thePrd.radiance = make_float3(1.0f); // Constant white emission.
-#endif
-
-#if USE_DENOISER
-#if USE_DENOISER_ALBEDO
-  thePrd.albedo = make_float3(1.0f); // Constant white emission.
-#endif
-#endif
-
-  thePrd.flags |= (FLAG_LIGHT | FLAG_TERMINATE);
+  missEnvironmentConstant(thePrd);
 }
 
 RT_PROGRAM void miss_environment_mapping()
 {
   const LightDefinition light = sysLightDefinitions[0];
   
-  const float3 R = theRay.direction;
-  // The seam u == 0.0 == 1.0 is in positive z-axis direction.
-  // Compensate for the environment rotation done inside the direct lighting.
-  const float u     = (atan2f(R.x, -R.z) + M_PIf) * 0.5f * M_1_PIf + sysEnvironmentRotation; // DAR FIXME Use a light.matrix to rotate the environment.
-  const float theta = acosf(-R.y);     // theta == 0.0f is south pole, theta == M_PIf is north pole.
-  const float v     = theta * M_1_PIf; // Texture is with origin at lower left, v == 0.0f is south pole.
-  
-  const float3 emission = make_float3(optix::rtTex2D<float4>(light.idEnvironmentTexture, u, v));
-
-#if USE_NEXT_EVENT_ESTIMATION
-  float weightMIS = 1.0f;
-  // If the last surface intersection was a diffuse event which was directly lit with multiple importance sampling,
-  // then calculate light emission with multiple importance sampling for this implicit light hit as well.
-  if (thePrd.flags & FLAG_DIFFUSE)
-  {
-    // For simplicity we pretend that we perfectly importance-sampled the actual texture-filtered environment map
-    // and not the Gaussian smoothed one used to actually generate the CDFs.
-    const float pdfLight = intensity(emission) / light.environmentIntegral;
-    weightMIS = powerHeuristic(thePrd.pdf, pdfLight);
-  }
-  thePrd.radiance = emission * weightMIS;
-#else
-  thePrd.radiance = emission;
-#endif
+  const float2 texcoord = getEnvironmentTexcoord(theRay.direction, sysEnvironmentRotation);
 
-#if USE_DENOISER
-#if USE_DENOISER_ALBEDO
-  thePrd.albedo = emission;
-#endif
-#endif
+  const float3 emission = make_float3(optix::rtTex2D<float4>(light.idEnvironmentTexture, texcoord.x, texcoord.y));
 
-  thePrd.flags |= (FLAG_LIGHT | FLAG_TERMINATE);
+  missEnvironmentMapping(light, emission, thePrd);
 }
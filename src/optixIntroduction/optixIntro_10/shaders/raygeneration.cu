@@ -34,6 +34,7 @@
 #include "rt_function.h"
 #include "per_ray_data.h"
 #include "shader_common.h"
+#include "integrator_functions.h"
 
 #include "rt_assert.h"
 
@@ -65,186 +66,15 @@ rtBuffer< rtCallableProgramId<void(const float2 pixel, const float2 screen, cons
 rtDeclareVariable(uint2, theLaunchDim,   rtLaunchDim, );
 rtDeclareVariable(uint2, theLaunchIndex, rtLaunchIndex, );
 
-RT_FUNCTION void integrator(PerRayData& prd, float3& radiance
-#if USE_DENOISER
-#if USE_DENOISER_ALBEDO
-                           , float3& albedo
-#if USE_DENOISER_NORMAL
-                           , float3& normal
-#endif
-#endif
-#endif
-)
+// Shoots the radiance rays of the shared integrator() into the OptiX scene.
+struct TraceRadiance
 {
-  // This renderer supports nested volumes. Four levels is plenty enough for most cases.
-  // The absorption coefficient and IOR of the volume the ray is currently inside.
-  float4 absorptionStack[MATERIAL_STACK_SIZE]; // .xyz == absorptionCoefficient (sigma_a), .w == index of refraction
-
-  radiance = make_float3(0.0f); // Start with black.
-
-#if USE_DENOISER
-#if USE_DENOISER_ALBEDO
-  albedo   = make_float3(0.0f); // Start with black.
-#if USE_DENOISER_NORMAL
-  normal     = make_float3(0.0f); // Start with null vector.
-  prd.normal = make_float3(0.0f); // Start with null vector. Important if nothing is hit!
-#endif
-#endif
-#endif
-
-  // case 0: Standard stochastic motion blur.
-  float time = rng(prd.seed); // Set the time of this path to a random value in the range [0, 1).
-  
-  switch (sysShutterType) // In case another camera shutter is active reuse that random value.
+  RT_FUNCTION void operator()(const float3 origin, const float3 direction, const float time, PerRayData& prd) const
   {
-    case 1: // Rolling shutter from top to bottom. 
-      // Note that launchIndex (0, 0) is as the bottom left corner, which matches what OpenGL expects as texture orientation.
-      // Each row gets a different time plus some stochastic antialiasing on that line.
-      time = (float(theLaunchDim.y - 1 - theLaunchIndex.y) + time) / float(theLaunchDim.y);
-      break;
-    case 2: // Rolling shutter from bottom to top. 
-      time = (float(theLaunchIndex.y) + time) / float(theLaunchDim.y);
-      break;
-    case 3: // Rolling shutter from left to right.
-      time = (float(theLaunchIndex.x) + time) / float(theLaunchDim.x);
-      break;
-    case 4: // Rolling shutter from right to left.
-      time = (float(theLaunchDim.x - 1 - theLaunchIndex.x) + time) / float(theLaunchDim.x);
-      break;
-  }
-        
-  float3 throughput = make_float3(1.0f); // The throughput for the next radiance, starts with 1.0f.
-
-  int stackIdx = MATERIAL_STACK_EMPTY; // Start with empty nested materials stack.
-  int depth = 0;                       // Path segment index. Primary ray is 0.
-
-  prd.absorption_ior = make_float4(0.0f, 0.0f, 0.0f, 1.0f); // Assume primary ray starts in vacuum.
- 
-  prd.flags = 0;
-
-  // Russian Roulette path termination after a specified number of bounces needs the current depth.
-  while (depth < sysPathLengths.y)
-  {
-    prd.wo        = -prd.wi;           // Direction to observer.
-    prd.ior       = make_float2(1.0f); // Reset the volume IORs.
-    prd.distance  = RT_DEFAULT_MAX;    // Shoot the next ray with maximum length.
-    prd.flags    &= FLAG_CLEAR_MASK;   // Clear all non-persistent flags. In this demo only the last diffuse surface interaction stays.
-
-    // Handle volume absorption of nested materials.
-    if (MATERIAL_STACK_FIRST <= stackIdx) // Inside a volume?
-    {
-      prd.flags     |= FLAG_VOLUME;                            // Indicate that we're inside a volume. => At least absorption calculation needs to happen.
-      prd.extinction = make_float3(absorptionStack[stackIdx]); // There is only volume absorption in this demo, no volume scattering.
-      prd.ior.x      = absorptionStack[stackIdx].w;            // The IOR of the volume we're inside. Needed for eta calculations in transparent materials.
-      if (MATERIAL_STACK_FIRST <= stackIdx - 1)
-      {
-        prd.ior.y = absorptionStack[stackIdx - 1].w; // The IOR of the surrounding volume. Needed when potentially leaving a volume to calculate eta in transparent materials.
-      }
-    }
-
-    // Note that the primary rays (or volume scattering miss cases) wouldn't normally offset the ray t_min by sysSceneEpsilon. Keep it simple here.
-    optix::Ray ray = optix::make_Ray(prd.pos, prd.wi, 0, sysSceneEpsilon, prd.distance);
-    // Note that this time defines the semantic variable rtCurrentTime in the other program domains.
-    rtTrace(sysTopObject, ray, time, prd); 
-
-    // This renderer supports nested volumes.
-    if (prd.flags & FLAG_VOLUME)
-    {
-      // We're inside a volume. Calculate the extinction along the current path segment in any case.
-      // The transmittance along the current path segment inside a volume needs to attenuate the ray throughput with the extinction
-      // before it modulates the radiance of the hitpoint.
-      throughput *= expf(-prd.distance * prd.extinction);
-    }
-
-    radiance += throughput * prd.radiance;
-
-#if USE_DENOISER
-#if USE_DENOISER_ALBEDO
-    // In physical terms, the albedo is a single color value approximating the ratio of radiant exitance to the irradiance under uniform lighting.
-    // The albedo value can be approximated for simple materials by using the diffuse color of the first hit,
-    // or for layered materials by using a weighted sum of the individual BRDFs albedo values.
-    // For some objects such as perfect mirrors, the quality of the result might be improved by using the albedo value of a subsequent hit instead.
-
-    // When no albedo has been written before and the hit was diffuse or a light, write the albedo.
-    // DAR This makes glass materials and motion blur on specular surfaces in the demo a little noisier,
-    // but should definitely be used with high frequency textures behind transparent or around reflective materials.
-    if (!(prd.flags & FLAG_ALBEDO) && (prd.flags & (FLAG_DIFFUSE | FLAG_LIGHT)))
-    {
-      // The albedo buffer should contain the surface appearance under uniform lighting in linear color space in the range [0.0f, 1.0f].
-      // Clamp the final albedo result to that range here, because it captured the radiance when hitting lights either directly or via specular events.
-      albedo = optix::clamp(throughput * prd.albedo, 0.0f, 1.0f);
-
-      prd.flags |= FLAG_ALBEDO; // This flag is persistent along the path and prevents that the albedo is written more than once.
-    }
-
-#if USE_DENOISER_NORMAL
-    // The normal buffer is expected to contain the surface normals of the primary hit in camera space.
-    // The camera space is assumed to be right handed such that the camera is looking down
-    // the negative z-axis, and the up direction is along the y-axis. The x-axis points to the right.
-    if (depth == 0 && (prd.flags & FLAG_HIT)) // Miss event keeps the null-vector.
-    {
-      // Note the input sysCameraU|V|W vectors are unnormalized and build a left-handed coordinate system.
-      // They are also not necessarily perpendicular to each other, because the generic pinhole camera system
-      // would allow sheared projections, but that's not used on these OptiX introduction examples. 
-      
-      // Project the world space normal into camera space.
-      // Using the normalized camera basis vectors here as camera space to get consistent results
-      // independently of the UVW vector lengths.
-      // The end result looks like a normal map without scale and bias.
-      // Normals pointing at the camera position will be blue.
-      normal = make_float3( optix::dot(prd.normal, optix::normalize(sysCameraU)), 
-                            optix::dot(prd.normal, optix::normalize(sysCameraV)), 
-                           -optix::dot(prd.normal, optix::normalize(sysCameraW))); // Negative W to make it right-handed.
-    }
-#endif
-#endif
-#endif
-
-    // Path termination by miss shader or sample() routines.
-    // If terminate is true, f_over_pdf and pdf might be undefined.
-    if ((prd.flags & FLAG_TERMINATE) || prd.pdf <= 0.0f || isNull(prd.f_over_pdf))
-    {
-      break;
-    }
-
-    // PERF f_over_pdf already contains the proper throughput adjustment for diffuse materials: f * (fabsf(optix::dot(prd.wi, state.normal)) / prd.pdf);
-    throughput *= prd.f_over_pdf;
-
-    // Unbiased Russian Roulette path termination.
-    if (sysPathLengths.x <= depth) // Start termination after a minimum number of bounces.
-    {
-      const float probability = fmaxf(throughput); // DAR Other options: // intensity(throughput); // fminf(0.5f, intensity(throughput));
-      if (probability < rng(prd.seed)) // Paths with lower probability to continue are terminated earlier.
-      {
-        break;
-      }
-      throughput /= probability; // Path isn't terminated. Adjust the throughput so that the average is right again.
-    }
-
-    // Adjust the material volume stack if the geometry is not thin-walled but a border between two volumes 
-    // and the outgoing ray direction was a transmission.
-    if ((prd.flags & (FLAG_THINWALLED | FLAG_TRANSMISSION)) == FLAG_TRANSMISSION) 
-    {
-      // Transmission.
-      if (prd.flags & FLAG_FRONTFACE) // Entered a new volume?
-      {
-        // Push the entered material's volume properties onto the volume stack.
-        //rtAssert((stackIdx < MATERIAL_STACK_LAST), 1); // Overflow?
-        stackIdx = min(stackIdx + 1, MATERIAL_STACK_LAST);
-        absorptionStack[stackIdx] = prd.absorption_ior;
-      }
-      else // Exited the current volume?
-      {
-        // Pop the top of stack material volume.
-        // This assert fires and is intended because I tuned the frontface checks so that there are more exits than enters at silhouettes.
-        //rtAssert((MATERIAL_STACK_EMPTY < stackIdx), 0); // Underflow?
-        stackIdx = max(stackIdx - 1, MATERIAL_STACK_EMPTY);
-      }
-    }
-
-    ++depth; // Next path segment.
+    optix::Ray ray = optix::make_Ray(origin, direction, 0, sysSceneEpsilon, prd.distance);
+    rtTrace(sysTopObject, ray, time, prd);
   }
-}
+};
 
 RT_PROGRAM void raygeneration()
 {
@@ -269,12 +99,12 @@ RT_PROGRAM void raygeneration()
 #endif
 
   // In this case a unidirectional path tracer.
-  integrator(prd, radiance
+  integrator(TraceRadiance(), theLaunchIndex, theLaunchDim, sysPathLengths, sysShutterType, prd, radiance
 #if USE_DENOISER
 #if USE_DENOISER_ALBEDO
             , albedo
 #if USE_DENOISER_NORMAL
-            , normal
+            , sysCameraU, sysCameraV, sysCameraW, normal
 #endif
 #endif
 #endif
@@ -32,7 +32,12 @@
 #define RT_FUNCTION_H
 
 #ifndef RT_FUNCTION
+#if defined(__CUDACC__)
 #define RT_FUNCTION __forceinline__ __device__
+#else
+// Host compilation of the shader helper functions, used by the CpuRenderer.
+#define RT_FUNCTION inline
+#endif
 #endif
 
 #endif // RT_FUNCTION_H
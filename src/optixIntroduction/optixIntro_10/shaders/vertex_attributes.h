@@ -31,6 +31,11 @@
 #ifndef VERTEX_ATTRIBUTES_H
 #define VERTEX_ATTRIBUTES_H
 
+#include "app_config.h"
+
+#include <optixu/optixu_math_namespace.h>
+
+// Uncompressed vertex layout. This is what the geometry generators produce.
 struct VertexAttributes
 {
   optix::float3 vertex;
@@ -39,4 +44,184 @@ struct VertexAttributes
   optix::float3 texcoord;
 };
 
+// Compact vertex layout used when USE_COMPACT_VERTEX_ATTRIBUTES is enabled.
+// The position is kept as float3 in its own buffer ("positionsBuffer") because the Trbvh and Sbvh builders need it unquantized.
+// The remaining attributes are stored in 12 bytes, which makes 24 bytes per vertex instead of 48.
+struct VertexAttributesCompact
+{
+  unsigned int tangent;  // Octahedral encoded unit vector, two snorm16 values.
+  unsigned int normal;   // Octahedral encoded unit vector, two snorm16 values.
+  unsigned int texcoord; // Two half floats (u, v). The third texture coordinate component is always 0.0f and not stored.
+};
+
+// The packing routines are used on the host to fill the buffers and on the device to decode the attributes.
+#if defined(__CUDACC__)
+#define PACK_FUNCTION __forceinline__ __host__ __device__
+#else
+#define PACK_FUNCTION inline
+#endif
+
+PACK_FUNCTION float signNotZero(const float f)
+{
+  return (0.0f <= f) ? 1.0f : -1.0f;
+}
+
+// Octahedral normal vector encoding, see "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al., JCGT 2014.
+// Zero length vectors are encoded as (0, 0, 1).
+PACK_FUNCTION unsigned int encodeOctahedral(const optix::float3& v)
+{
+  float x = 0.0f;
+  float y = 0.0f;
+
+  const float l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+  if (0.0f < l1)
+  {
+    x = v.x / l1;
+    y = v.y / l1;
+    if (v.z < 0.0f) // Fold the lower hemisphere over the diagonals.
+    {
+      const float t = x;
+      x = (1.0f - fabsf(y)) * signNotZero(t);
+      y = (1.0f - fabsf(t)) * signNotZero(y);
+    }
+  }
+
+  const int qx = (int) floorf(optix::clamp(x, -1.0f, 1.0f) * 32767.0f + 0.5f);
+  const int qy = (int) floorf(optix::clamp(y, -1.0f, 1.0f) * 32767.0f + 0.5f);
+
+  return ((unsigned int) qx & 0xFFFFu) | (((unsigned int) qy & 0xFFFFu) << 16);
+}
+
+// Returns a normalized vector.
+PACK_FUNCTION optix::float3 decodeOctahedral(const unsigned int p)
+{
+  const float x = optix::fmaxf((float) ((short) (p & 0xFFFFu)) / 32767.0f, -1.0f);
+  const float y = optix::fmaxf((float) ((short) (p >> 16))     / 32767.0f, -1.0f);
+
+  optix::float3 v = optix::make_float3(x, y, 1.0f - fabsf(x) - fabsf(y));
+  if (v.z < 0.0f)
+  {
+    const float t = v.x;
+    v.x = (1.0f - fabsf(v.y)) * signNotZero(t);
+    v.y = (1.0f - fabsf(t))   * signNotZero(v.y);
+  }
+  return optix::normalize(v);
+}
+
+PACK_FUNCTION unsigned int floatAsUint(const float f)
+{
+  union { float f; unsigned int u; } bits;
+  bits.f = f;
+  return bits.u;
+}
+
+PACK_FUNCTION float uintAsFloat(const unsigned int u)
+{
+  union { float f; unsigned int u; } bits;
+  bits.u = u;
+  return bits.f;
+}
+
+// IEEE 754 binary32 to binary16 conversion with round to nearest even.
+PACK_FUNCTION unsigned short floatToHalf(const float f)
+{
+  const unsigned int u    = floatAsUint(f);
+  const unsigned int sign = (u >> 16) & 0x8000u;
+  const unsigned int a    = u & 0x7FFFFFFFu;
+
+  if (0x7F800000u <= a) // Infinity or NaN.
+  {
+    return (unsigned short) (sign | ((0x7F800000u < a) ? 0x7E00u : 0x7C00u));
+  }
+  if (0x477FF000u <= a) // 65520.0f and above round to infinity.
+  {
+    return (unsigned short) (sign | 0x7C00u);
+  }
+  if (a < 0x38800000u) // Below the smallest normal half, 2^-14.
+  {
+    if (a < 0x33000000u) // At most 2^-25, which rounds to zero.
+    {
+      return (unsigned short) sign;
+    }
+    const unsigned int exponent = a >> 23;
+    const unsigned int mantissa = (a & 0x007FFFFFu) | 0x00800000u;
+    const unsigned int shift    = 126u - exponent; // In [14, 24].
+
+    unsigned int h = mantissa >> shift;
+
+    const unsigned int remainder = mantissa & ((1u << shift) - 1u);
+    const unsigned int halfway   = 1u << (shift - 1u);
+    if (halfway < remainder || (remainder == halfway && (h & 1u)))
+    {
+      ++h;
+    }
+    return (unsigned short) (sign | h);
+  }
+
+  unsigned int h = (a - 0x38000000u) >> 13; // Rebias the exponent from 127 to 15.
+
+  const unsigned int remainder = a & 0x1FFFu;
+  if (0x1000u < remainder || (remainder == 0x1000u && (h & 1u)))
+  {
+    ++h; // A carry into the exponent is the correct result.
+  }
+  return (unsigned short) (sign | h);
+}
+
+PACK_FUNCTION float halfToFloat(const unsigned short h)
+{
+#if defined(__CUDA_ARCH__)
+  float f;
+  asm("cvt.f32.f16 %0, %1;" : "=f"(f) : "h"(h));
+  return f;
+#else
+  const unsigned int sign     = ((unsigned int) h & 0x8000u) << 16;
+  const unsigned int exponent = ((unsigned int) h >> 10) & 0x1Fu;
+  const unsigned int mantissa =  (unsigned int) h & 0x03FFu;
+
+  if (exponent == 0x1Fu) // Infinity or NaN.
+  {
+    return uintAsFloat(sign | 0x7F800000u | (mantissa << 13));
+  }
+  if (exponent != 0u)
+  {
+    return uintAsFloat(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+  }
+  const float f = (float) mantissa * (1.0f / 16777216.0f); // Zero or denormalized half, mantissa * 2^-24.
+  return (sign) ? -f : f;
+#endif
+}
+
+PACK_FUNCTION unsigned int packHalf2(const float u, const float v)
+{
+  return (unsigned int) floatToHalf(u) | ((unsigned int) floatToHalf(v) << 16);
+}
+
+PACK_FUNCTION optix::float2 unpackHalf2(const unsigned int p)
+{
+  return optix::make_float2(halfToFloat((unsigned short) (p & 0xFFFFu)), halfToFloat((unsigned short) (p >> 16)));
+}
+
+PACK_FUNCTION void packVertexAttributes(VertexAttributes const& attributes, optix::float3& position, VertexAttributesCompact& compact)
+{
+  position         = attributes.vertex;
+  compact.tangent  = encodeOctahedral(attributes.tangent);
+  compact.normal   = encodeOctahedral(attributes.normal);
+  compact.texcoord = packHalf2(attributes.texcoord.x, attributes.texcoord.y);
+}
+
+PACK_FUNCTION VertexAttributes unpackVertexAttributes(const optix::float3& position, VertexAttributesCompact const& compact)
+{
+  VertexAttributes attributes;
+
+  const optix::float2 texcoord = unpackHalf2(compact.texcoord);
+
+  attributes.vertex   = position;
+  attributes.tangent  = decodeOctahedral(compact.tangent);
+  attributes.normal   = decodeOctahedral(compact.normal);
+  attributes.texcoord = optix::make_float3(texcoord.x, texcoord.y, 0.0f);
+
+  return attributes;
+}
+
 #endif // VERTEX_ATTRIBUTES_H
@@ -34,7 +34,6 @@
 #include <optixu/optixpp_namespace.h>
 #include <optixu/optixu_math_namespace.h>
 #include <optixu/optixu_matrix_namespace.h>
-#include <optixu/optixu_quaternion_namespace.h>
 
 #include <algorithm>
 #include <cstring>
@@ -47,6 +46,7 @@
 // DAR Only for sutil::samplesPTXDir() and sutil::writeBufferToFile()
 #include <sutil.h>
 
+#include "inc/EnvironmentCache.h"
 #include "inc/MyAssert.h"
 
 // DAR HACK Taken from per_ray_data.h. I don't need any of the rest of it in this source.
@@ -73,7 +73,9 @@ Application::Application(GLFWwindow* window,
                          const bool interop, 
                          const bool light, 
                          const unsigned int miss,
-                         std::string const& environment)
+                         std::string const& environment,
+                         const bool cache,
+                         const unsigned int textureCompression)
 : m_window(window)
 , m_width(width)
 , m_height(height)
@@ -83,6 +85,8 @@ Application::Application(GLFWwindow* window,
 , m_light(light)
 , m_missID(miss)
 , m_environmentFilename(environment)
+, m_cache(cache)
+, m_textureCompression(textureCompression)
 {
   // Setup ImGui binding.
   ImGui::CreateContext();
@@ -164,6 +168,9 @@ Application::Application(GLFWwindow* window,
 
   m_frames = 0; // Samples per pixel. 0 == render forever.
 
+  m_textureAlbedo = nullptr;
+  m_textureCutout = nullptr;
+
   // GLSL shaders objects and program. 
   // In OptiX 5.1.0 the denoiser supports HDR beauty buffers which this example demonstrates.
   // Means the previous raygeneration entry point doing the tonemapping inside the CommandList can go away again
@@ -211,6 +218,7 @@ Application::~Application()
   // DAR FIXME Do any other destruction here.
   if (m_isValid)
   {
+    m_textureCache.clear(); // Destroys the texture samplers and buffers while the context is alive.
     m_context->destroy();
   }
 
@@ -651,6 +659,11 @@ bool Application::render()
 
   try
   {
+    if (m_environmentLoader.isReady())
+    {
+      updateEnvironment();
+    }
+
     optix::float3 cameraPosition;
     optix::float3 cameraU;
     optix::float3 cameraV;
@@ -1239,6 +1252,28 @@ optix::Geometry Application::createGeometry(std::vector<VertexAttributes> const&
   {
     geometry = m_context->createGeometry();
 
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+    optix::Buffer positionsBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, attributes.size());
+
+    optix::Buffer attributesBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+    attributesBuffer->setElementSize(sizeof(VertexAttributesCompact));
+    attributesBuffer->setSize(attributes.size());
+
+    optix::float3*           positions = static_cast<optix::float3*>(positionsBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    VertexAttributesCompact* compact   = static_cast<VertexAttributesCompact*>(attributesBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+
+    // The quantization error is checked by the "--benchmark vertices" option.
+    for (size_t i = 0; i < attributes.size(); ++i)
+    {
+      packVertexAttributes(attributes[i], positions[i], compact[i]);
+    }
+
+    attributesBuffer->unmap();
+    positionsBuffer->unmap();
+
+    std::cout << "createGeometry(): Vertex memory = " << attributes.size() * (sizeof(optix::float3) + sizeof(VertexAttributesCompact))
+              << " bytes (compact), " << attributes.size() * sizeof(VertexAttributes) << " bytes (uncompressed)" << std::endl;
+#else
     optix::Buffer attributesBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
     attributesBuffer->setElementSize(sizeof(VertexAttributes));
     attributesBuffer->setSize(attributes.size());
@@ -1247,8 +1282,11 @@ optix::Geometry Application::createGeometry(std::vector<VertexAttributes> const&
     memcpy(dst, attributes.data(), sizeof(VertexAttributes) * attributes.size());
     attributesBuffer->unmap();
 
+    std::cout << "createGeometry(): Vertex memory = " << attributes.size() * sizeof(VertexAttributes) << " bytes (uncompressed)" << std::endl;
+#endif
+
     optix::Buffer indicesBuffer = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT3, indices.size() / 3);
-    dst = indicesBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    void *dst = indicesBuffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
     memcpy(dst, indices.data(), sizeof(optix::uint3) * indices.size() / 3);
     indicesBuffer->unmap();
 
@@ -1260,6 +1298,9 @@ optix::Geometry Application::createGeometry(std::vector<VertexAttributes> const&
     MY_ASSERT(it != m_mapOfPrograms.end()); 
     geometry->setIntersectionProgram(it->second);
 
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+    geometry["positionsBuffer"]->setBuffer(positionsBuffer);
+#endif
     geometry["attributesBuffer"]->setBuffer(attributesBuffer);
     geometry["indicesBuffer"]->setBuffer(indicesBuffer);
     geometry->setPrimitiveCount((unsigned int)(indices.size()) / 3);
@@ -1425,20 +1466,10 @@ void Application::updateMaterialParameters()
 
   for (size_t i = 0; i < m_guiMaterialParameters.size(); ++i, ++dst)
   {
-    MaterialParameterGUI& src = m_guiMaterialParameters[i];
-        
-    dst->indexBSDF = src.indexBSDF;
-    dst->albedo     = src.albedo;
-    dst->albedoID   = (src.useAlbedoTexture) ? m_textureAlbedo.getId() : RT_TEXTURE_ID_NULL;
-    dst->cutoutID   = (src.useCutoutTexture) ? m_textureCutout.getId() : RT_TEXTURE_ID_NULL;
-    dst->flags      = (src.thinwalled) ? FLAG_THINWALLED : 0;
-    // Calculate the effective absorption coefficient from the GUI parameters. This is one reason why there are two structures.
-    // Prevent logf(0.0f) which results in infinity.
-    const float x = (0.0f < src.absorptionColor.x) ? -logf(src.absorptionColor.x) : RT_DEFAULT_MAX;
-    const float y = (0.0f < src.absorptionColor.y) ? -logf(src.absorptionColor.y) : RT_DEFAULT_MAX;
-    const float z = (0.0f < src.absorptionColor.z) ? -logf(src.absorptionColor.z) : RT_DEFAULT_MAX;
-    dst->absorption = optix::make_float3(x, y, z) * src.volumeDistanceScale;
-    dst->ior = src.ior;
+    convertMaterialParameter(m_guiMaterialParameters[i],
+                             (m_textureAlbedo) ? m_textureAlbedo->getId() : RT_TEXTURE_ID_NULL,
+                             (m_textureCutout) ? m_textureCutout->getId() : RT_TEXTURE_ID_NULL,
+                             *dst);
   }
 
   m_bufferMaterialParameters->unmap();
@@ -1446,71 +1477,20 @@ void Application::updateMaterialParameters()
 
 void Application::initMaterials()
 {
-  Picture* picture = new Picture;
+  // BC1 for opaque and BC3 for translucent 8-bit images. With the cache on, the encoded blocks are stored next to the image files.
+  const TextureCompression compression = (m_textureCompression) ? TEXTURE_COMPRESSION_AUTO : TEXTURE_COMPRESSION_NONE;
+  const BlockQuality       quality     = (m_textureCompression == 1) ? BLOCK_QUALITY_FAST : 
+                                         (m_textureCompression == 3) ? BLOCK_QUALITY_HIGH : BLOCK_QUALITY_NORMAL;
 
-  std::string textureFilename = std::string(sutil::samplesDir()) + "/data/NVIDIA_logo.jpg";
-  picture->load(textureFilename);
-  m_textureAlbedo.createSampler(m_context, picture);
+  m_textureAlbedo = m_textureCache.acquire(m_context, std::string(sutil::samplesDir()) + SCENE_TEXTURE_ALBEDO,
+                                           false, false, false, RT_WRAP_REPEAT, compression, quality, m_cache);
+  m_textureCutout = m_textureCache.acquire(m_context, std::string(sutil::samplesDir()) + SCENE_TEXTURE_CUTOUT,
+                                           false, false, false, RT_WRAP_REPEAT, compression, quality, m_cache);
 
-  textureFilename = std::string(sutil::samplesDir()) + "/data/slots_alpha.png";
-  picture->load(textureFilename);
-  m_textureCutout.createSampler(m_context, picture);
-
-  delete picture;
+  m_textureCache.printStatistics();
 
   // Setup GUI material parameters, one for each of the implemented BSDFs.
-  // Cutout opacity is not an option which can be switched dynamically in this demo.
-  // That would require to use the anyhit cutout version for all materials which is a performance impact.
-  // Currently only the object which uses this material parameter instance has the cutout opacity assigned.
-
-  // It's recommended that cutout opacity materials are always thin-walled.
-  // Transparent volumetric materials would look strange otherwise.
-
-  MaterialParameterGUI parameters;
-
-  // Lambert material (for the floor)
-  parameters.indexBSDF           = INDEX_BSDF_DIFFUSE_REFLECTION; // Index into sysSampleBSDF and sysEvalBSDF.
-  parameters.albedo              = optix::make_float3(0.5f); // Grey. (Modulates the albedo texture.)
-  parameters.useAlbedoTexture    = true; // Enabled just to distinguish the resulting image from the non HDR DL Denoiser used in optixIntro_09.
-  parameters.useCutoutTexture    = false;
-  parameters.thinwalled          = false;
-  parameters.absorptionColor     = optix::make_float3(1.0f);
-  parameters.volumeDistanceScale = 1.0f;
-  parameters.ior                 = 1.5f;
-  m_guiMaterialParameters.push_back(parameters); // 0
-
-  // Lambert material with cutout opacity.
-  parameters.indexBSDF           = INDEX_BSDF_DIFFUSE_REFLECTION;
-  parameters.albedo              = optix::make_float3(0.6f, 0.0f, 0.0f); // Red.
-  parameters.useAlbedoTexture    = false;
-  parameters.useCutoutTexture    = true;
-  parameters.thinwalled          = true; // Materials with cutout opacity should always be thinwalled.
-  parameters.absorptionColor     = optix::make_float3(0.25f);
-  parameters.volumeDistanceScale = 1.0f;
-  parameters.ior                 = 1.5f;
-  m_guiMaterialParameters.push_back(parameters); // 1
-
-  // Water material.
-  parameters.indexBSDF           = INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION;
-  parameters.albedo              = optix::make_float3(1.0f);
-  parameters.useAlbedoTexture    = false;
-  parameters.useCutoutTexture    = false;
-  parameters.thinwalled          = false;
-  parameters.absorptionColor     = optix::make_float3(0.980392f, 0.729412f, 0.470588f); // My favorite test color.
-  parameters.volumeDistanceScale = 1.0f;
-  parameters.ior                 = 1.33f; // Water
-  m_guiMaterialParameters.push_back(parameters); // 2
-
-  // Tinted mirror material.
-  parameters.indexBSDF           = INDEX_BSDF_SPECULAR_REFLECTION;
-  parameters.albedo              = optix::make_float3(0.2f, 0.2f, 0.8f); // Not full primary color to get nice HDR highlights.
-  parameters.useAlbedoTexture    = false;
-  parameters.useCutoutTexture    = false;
-  parameters.thinwalled          = false;
-  parameters.absorptionColor     = optix::make_float3(0.6f, 0.6f, 0.8f);
-  parameters.volumeDistanceScale = 1.0f;
-  parameters.ior                 = 1.33f;
-  m_guiMaterialParameters.push_back(parameters); // 3
+  initSceneMaterials(m_guiMaterialParameters);
     
   try
   {
@@ -1582,191 +1562,53 @@ void Application::createScene()
     
     m_context["sysTopObject"]->set(m_rootGroup); // This is where the rtTrace calls start the BVH traversal. (Same for radiance and shadow rays.)
 
-    unsigned int count;
-
     // Demo code only!
     // Mind that these local OptiX objects will leak when not cleaning up the scene properly on changes.
     // Destroying the OptiX context will clean them up at program exit though.
 
-    // Add a ground plane on the xz-plane at y = 0.0f.
-    optix::Geometry geoPlane = createPlane(1, 1, 1);
+    // The same objects the CpuRenderer uses. Each gets its own Geometry, Acceleration and Transform.
+    std::vector<SceneObject> objects;
+    createSceneObjects(objects);
 
-    optix::GeometryInstance giPlane = m_context->createGeometryInstance(); // This connects Geometries with Materials.
-    giPlane->setGeometry(geoPlane);
-    giPlane->setMaterialCount(1);
-    giPlane->setMaterial(0, (m_guiMaterialParameters[0].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
-    giPlane["parMaterialIndex"]->setInt(0); // This is all! This defines which material parameters in sysMaterialParameters to use.
-
-    optix::Acceleration accPlane = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accPlane);
-    
-    optix::GeometryGroup ggPlane = m_context->createGeometryGroup(); // This connects GeometryInstances with Acceleration structures. (All OptiX nodes with "Group" in the name hold an Acceleration.)
-    ggPlane->setAcceleration(accPlane);
-    ggPlane->setChildCount(1);
-    ggPlane->setChild(0, giPlane);
-
-    // Scale the plane to go from -8 to 8.
-    float trafoPlane[16] =
+    for (size_t i = 0; i < objects.size(); ++i)
     {
-      8.0f, 0.0f, 0.0f, 0.0f,
-      0.0f, 8.0f, 0.0f, 0.0f,
-      0.0f, 0.0f, 8.0f, 0.0f,
-      0.0f, 0.0f, 0.0f, 1.0f
-    };
-    optix::Matrix4x4 matrixPlane(trafoPlane);
-
-    optix::Transform trPlane = m_context->createTransform();
-    trPlane->setChild(ggPlane);
-    trPlane->setMatrix(false, matrixPlane.getData(), matrixPlane.inverse().getData());
-    
-    count = m_rootGroup->getChildCount();
-    m_rootGroup->setChildCount(count + 1);
-    m_rootGroup->setChild(count, trPlane);
+      SceneObject const& object = objects[i];
 
-    // Add a box (no tessellation here, using just 12 triangles)
-    optix::Geometry geoBox = createBox();
+      optix::Geometry geometry = createGeometry(object.attributes, object.indices);
 
-    optix::GeometryInstance giBox = m_context->createGeometryInstance();
-    giBox->setGeometry(geoBox);
-    giBox->setMaterialCount(1);
-    giBox->setMaterial(0, (m_guiMaterialParameters[1].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
-    giBox["parMaterialIndex"]->setInt(1); // This one has cutout opacity.
+      optix::GeometryInstance gi = m_context->createGeometryInstance(); // This connects Geometries with Materials.
+      gi->setGeometry(geometry);
+      gi->setMaterialCount(1);
+      gi->setMaterial(0, (m_guiMaterialParameters[object.materialIndex].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
+      gi["parMaterialIndex"]->setInt(object.materialIndex); // This is all! This defines which material parameters in sysMaterialParameters to use.
 
-    optix::Acceleration accBox = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accBox);
+      optix::Acceleration acceleration = m_context->createAcceleration(m_builder);
+      setAccelerationProperties(acceleration);
     
-    optix::GeometryGroup ggBox = m_context->createGeometryGroup();
-    ggBox->setAcceleration(accBox);
-    ggBox->setChildCount(1);
-    ggBox->setChild(0, giBox);
-
-    float trafoBox[16] =
-    {
-      1.0f, 0.0f, 0.0f, -3.0f, // Move to the left.
-      0.0f, 1.0f, 0.0f, 1.25f, // The box is modeled with unit coordinates in the range [-1, 1], Move it above the floor plane.
-      0.0f, 0.0f, 1.0f, 0.0f,
-      0.0f, 0.0f, 0.0f, 1.0f
-    };
-    optix::Matrix4x4 matrixBox(trafoBox);
-
-    optix::Transform trBox = m_context->createTransform();
-    trBox->setChild(ggBox);
-    trBox->setMatrix(false, matrixBox.getData(), matrixBox.inverse().getData());
-    
-    count = m_rootGroup->getChildCount();
-    m_rootGroup->setChildCount(count + 1);
-    m_rootGroup->setChild(count, trBox);
+      optix::GeometryGroup gg = m_context->createGeometryGroup(); // This connects GeometryInstances with Acceleration structures. (All OptiX nodes with "Group" in the name hold an Acceleration.)
+      gg->setAcceleration(acceleration);
+      gg->setChildCount(1);
+      gg->setChild(0, gi);
 
-    // Add a tessellated sphere with 180 longitudes and 90 latitudes, radius 1.0f and fully closed at the upper pole.
-    optix::Geometry geoSphere = createSphere(180, 90, 1.0f, M_PIf);
+      optix::Transform tr = m_context->createTransform();
+      tr->setChild(gg);
 
-    optix::GeometryInstance giSphere = m_context->createGeometryInstance();
-    giSphere->setGeometry(geoSphere);
-    giSphere->setMaterialCount(1);
-    giSphere->setMaterial(0, (m_guiMaterialParameters[2].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
-    giSphere["parMaterialIndex"]->setInt(2); // Water material.
-
-    optix::Acceleration accSphere = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accSphere);
-    
-    optix::GeometryGroup ggSphere = m_context->createGeometryGroup();
-    ggSphere->setAcceleration(accSphere);
-    ggSphere->setChildCount(1);
-    ggSphere->setChild(0, giSphere);
-
-    optix::Transform trSphere = m_context->createTransform();
-    trSphere->setChild(ggSphere);
-
-#if 0 // Motion blur disabled to show the denoiser better on caustics through the water sphere.
-    // Implement linear motion blur via the Transform on the sphere.
-    float keysLinear[2 * 12] = 
-    {
-      1.0f, 0.0f, 0.0f, 0.0f,
-      0.0f, 1.0f, 0.0f, 1.25f,
-      0.0f, 0.0f, 1.0f, 0.0f,
-
-      1.0f, 0.0f, 0.0f, 0.0f,
-      0.0f, 1.0f, 0.0f, 1.25f,
-      0.0f, 0.0f, 1.0f, 2.5f  // Move 2.5f units in positive z-axis direction.
-    };
-
-    trSphere->setMotionKeys(2, RT_MOTIONKEYTYPE_MATRIX_FLOAT12, keysLinear);
-    trSphere->setMotionRange(0.0f, 1.0f); // Defaults.
-#else
-    float trafoSphere[16] =
-    {
-      1.0f, 0.0f, 0.0f, 0.0f,  // In the center, to the right of the box.
-      0.0f, 1.0f, 0.0f, 1.25f, // The sphere is modeled with radius 1.0f. Move it above the floor plane.
-      0.0f, 0.0f, 1.0f, 0.0f,
-      0.0f, 0.0f, 0.0f, 1.0f
-    };
-    optix::Matrix4x4 matrixSphere(trafoSphere);
-
-    trSphere->setMatrix(false, matrixSphere.getData(), matrixSphere.inverse().getData());
-#endif
-
-    count = m_rootGroup->getChildCount();
-    m_rootGroup->setChildCount(count + 1);
-    m_rootGroup->setChild(count, trSphere);
-
-    // Add a torus. 
-    optix::Geometry geoTorus = createTorus(180, 180, 0.75f, 0.25f);
-
-    optix::GeometryInstance giTorus = m_context->createGeometryInstance();
-    giTorus->setGeometry(geoTorus);
-    giTorus->setMaterialCount(1);
-    giTorus->setMaterial(0, (m_guiMaterialParameters[3].useCutoutTexture) ? m_cutoutMaterial : m_opaqueMaterial);
-    giTorus["parMaterialIndex"]->setInt(3); // Using parameters in sysMaterialParameters[4].
-
-    optix::Acceleration accTorus = m_context->createAcceleration(m_builder);
-    setAccelerationProperties(accTorus);
-    
-    optix::GeometryGroup ggTorus = m_context->createGeometryGroup();
-    ggTorus->setAcceleration(accTorus);
-    ggTorus->setChildCount(1);
-    ggTorus->setChild(0, giTorus);
-
-    optix::Transform trTorus = m_context->createTransform();
-    trTorus->setChild(ggTorus);
-
-#if 1 // Keep motion blur active on the torus to show it together with the denoiser.
-
-    // Implement Scale-Rotation-Translation (SRT) motion blur on the torus.
-    // Move to the right, along the positive x-axis and roll around that axis by 180 degrees.
-
-    // Rotation angle is in degrees in the optixQuaternion class.
-    const optix::float3 axis = optix::make_float3(1.0f, 0.0f, 0.0f);
-    const optix::Quaternion quat0(axis,   0.0f);
-    const optix::Quaternion quat1(axis, 180.0f);
-    
-    float keysSRT[2 * 16] = 
-    {
-      // Refer to the OptiX Programming Guide which explains what these 16 values per motion key are doing.
-      // All Geometries in this demo are modeled around the origin in object coordinates, which is the pivot point (px, py, pz) for the rotation.
-      //sx,   a,    b,    px,   sy,   c,    py,   sz,   pz,   qx,          qy,          qz,          qw,          tx,   ty,    tz
-        1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, quat0.m_q.x, quat0.m_q.y, quat0.m_q.z, quat0.m_q.w, 2.5f, 1.25f, 0.0f,
-        1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, quat1.m_q.x, quat1.m_q.y, quat1.m_q.z, quat1.m_q.w, 5.0f, 1.25f, 0.0f
-    };
-
-    trTorus->setMotionKeys(2, RT_MOTIONKEYTYPE_SRT_FLOAT16, keysSRT);
-    trTorus->setMotionRange(0.0f, 1.0f); // Defaults.
-#else
-    float trafoTorus[16] =
-    {
-      1.0f, 0.0f, 0.0f, 2.5f,  // Move it to the right of the sphere.
-      0.0f, 1.0f, 0.0f, 1.25f, // The torus has an outer radius of 0.5f. Move it above the floor plane.
-      0.0f, 0.0f, 1.0f, 0.0f,
-      0.0f, 0.0f, 0.0f, 1.0f
-    };
-
-    optix::Matrix4x4 matrixTorus(trafoTorus);
+      if (object.motion)
+      {
+        tr->setMotionKeys(2, RT_MOTIONKEYTYPE_SRT_FLOAT16, object.keysSRT);
+        tr->setMotionRange(0.0f, 1.0f); // Defaults.
+      }
+      else
+      {
+        optix::Matrix4x4 matrix(object.matrix);
 
-    trTorus->setMatrix(false, matrixTorus.getData(), matrixTorus.inverse().getData());
-#endif
+        tr->setMatrix(false, matrix.getData(), matrix.inverse().getData());
+      }
 
-    count = m_rootGroup->getChildCount();
-    m_rootGroup->setChildCount(count + 1);
-    m_rootGroup->setChild(count, trTorus);
+      const unsigned int count = m_rootGroup->getChildCount();
+      m_rootGroup->setChildCount(count + 1);
+      m_rootGroup->setChild(count, tr);
+    }
 
     createLights(); // Put lights into the scene.
   }
@@ -1784,10 +1626,17 @@ void Application::setAccelerationProperties(optix::Acceleration acceleration)
   // Using the fast Trbvh builder which does splitting has a positive effect on the rendering performanc as well!
   if (m_builder == std::string("Trbvh") || m_builder == std::string("Sbvh"))
   {
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+    // The compact layout keeps the float x,y,z positions in their own tightly packed buffer.
+    acceleration->setProperty("vertex_buffer_name", "positionsBuffer");
+    MY_ASSERT(sizeof(optix::float3) == 12) ;
+    acceleration->setProperty("vertex_buffer_stride", "12");
+#else
     // This requires that the position is the first element and it must be float x,y,z.
     acceleration->setProperty("vertex_buffer_name", "attributesBuffer");
     MY_ASSERT(sizeof(VertexAttributes) == 48) ;
     acceleration->setProperty("vertex_buffer_stride", "48");
+#endif
 
     acceleration->setProperty("index_buffer_name", "indicesBuffer");
     MY_ASSERT(sizeof(optix::uint3) == 12) ;
@@ -1800,18 +1649,7 @@ void Application::createLights()
 {
   LightDefinition light;
 
-  // Unused in environment lights. 
-  light.position = optix::make_float3(0.0f, 0.0f, 0.0f);
-  light.vecU     = optix::make_float3(1.0f, 0.0f, 0.0f);
-  light.vecV     = optix::make_float3(0.0f, 1.0f, 0.0f);
-  light.normal   = optix::make_float3(0.0f, 0.0f, 1.0f);
-  light.area     = 1.0f;
-  light.emission = optix::make_float3(1.0f, 1.0f, 1.0f);
-  // Fields with bindless texture and buffer IDs and the integral for a spherical environment map.
-  light.idEnvironmentTexture = RT_TEXTURE_ID_NULL;
-  light.environmentIntegral  = 1.0f;
-  light.idEnvironmentCDF_U   = RT_BUFFER_ID_NULL;
-  light.idEnvironmentCDF_V   = RT_BUFFER_ID_NULL;
+  initLightDefinition(light);
 
   // The environment light is expected in sysLightDefinitions[0]!
   // All other lights are indexed by their position inside the array.
@@ -1830,15 +1668,52 @@ void Application::createLights()
 
   case 2: // HDR Environment mapping with loaded texture.
     {
-      Picture* picture = new Picture; // Separating image file handling from OptiX texture handling.
-      picture->load(m_environmentFilename);
+      Timer timer;
+      timer.start();
+
+      EnvironmentCache cache;
+      if (m_cache && cache.open(m_environmentFilename, USE_ENVIRONMENT_ALIAS_TABLES != 0))
+      {
+        // Texels and CDFs of a previous run are uploaded directly from the memory mapped cache file.
+        m_environmentTexture.uploadEnvironment(m_context, cache);
+        cache.close();
+
+        std::cout << "createLights(): Environment cache hit " << EnvironmentCache::cacheFilename(m_environmentFilename)
+                  << ", map and upload = " << timer.getTime() << " seconds" << std::endl;
+      }
+      else
+      {
+        if (m_cache)
+        {
+          std::cout << "createLights(): Environment cache miss " << EnvironmentCache::cacheFilename(m_environmentFilename) << std::endl;
+        }
+
+        // Radiance *.hdr files start with a low resolution preview. The full resolution replaces it inside render() when it's ready.
+        if (EnvironmentLoader::isSupported(m_environmentFilename) && m_environmentLoader.start(m_environmentFilename, m_environmentTexture, m_cache))
+        {
+          m_environmentTexture.uploadEnvironment(m_context);
+        }
+        else
+        {
+          Picture* picture = new Picture; // Separating image file handling from OptiX texture handling.
+          picture->load(m_environmentFilename);
 
-      m_environmentTexture.createEnvironment(picture);
+          m_environmentTexture.createEnvironment(picture);
 
-      delete picture;
+          delete picture;
   
-      // Generate the CDFs for direct environment lighting and the environment texture sampler itself.
-      m_environmentTexture.calculateCDF(m_context);
+          // Generate the CDFs for direct environment lighting and the environment texture sampler itself.
+          m_environmentTexture.calculateCDF();
+          if (m_cache)
+          {
+            // DevIL always loads the full resolution.
+            EnvironmentCache::write(m_environmentFilename, m_environmentTexture, m_environmentTexture.getWidth(), m_environmentTexture.getHeight());
+          }
+          m_environmentTexture.uploadEnvironment(m_context);
+
+          std::cout << "createLights(): Environment load, CDF and upload = " << timer.getTime() << " seconds" << std::endl;
+        }
+      }
     }
 
     light.type = LIGHT_ENVIRONMENT;
@@ -1848,6 +1723,10 @@ void Application::createLights()
     light.idEnvironmentTexture = m_environmentTexture.getId();
     light.idEnvironmentCDF_U   = m_environmentTexture.getBufferCDF_U()->getId();
     light.idEnvironmentCDF_V   = m_environmentTexture.getBufferCDF_V()->getId();
+#if USE_ENVIRONMENT_ALIAS_TABLES
+    light.idEnvironmentAlias_U = m_environmentTexture.getBufferAlias_U()->getId();
+    light.idEnvironmentAlias_V = m_environmentTexture.getBufferAlias_V()->getId();
+#endif
     light.environmentIntegral  = m_environmentTexture.getIntegral(); // DAR PERF Could bake the factor 2.0f * M_PIf * M_PIf into the sysEnvironmentIntegral here.
 
     m_lightDefinitions.push_back(light);
@@ -1856,14 +1735,7 @@ void Application::createLights()
 
   if (m_light)  // Add a square area light over the scene objects.
   {
-    light.type      = LIGHT_PARALLELOGRAM;                    // A geometric area light with diffuse emission distribution function.
-    light.position  = optix::make_float3(-0.5f, 4.0f, -0.5f); // Corner position.
-    light.vecU      = optix::make_float3(1.0f, 0.0f, 0.0f);   // To the right.
-    light.vecV      = optix::make_float3(0.0f, 0.0f, 1.0f);   // To the front. 
-    optix::float3 n = optix::cross(light.vecU, light.vecV);   // Length of the cross product is the area.
-    light.area     = optix::length(n);                        // Calculate the world space area of that rectangle, unit is [m^2]
-    light.normal   = n / light.area;                          // Normalized normal
-    light.emission = optix::make_float3(100.0f);              // Radiant exitance in Watt/m^2.
+    initAreaLight(light);
 
     int lightIndex = int(m_lightDefinitions.size()); // This becomes this light's parLightIndex value.
     m_lightDefinitions.push_back(light);
@@ -1911,3 +1783,57 @@ void Application::createLights()
   m_context["sysNumLights"]->setInt(int(m_lightDefinitions.size())); // PERF Used often and faster to read than sysLightDefinitions.size().
 }
 
+// Swaps the full resolution environment from the EnvironmentLoader in for the preview.
+void Application::updateEnvironment()
+{
+  Timer timer;
+  timer.start();
+
+  Texture* texture = m_environmentLoader.take(); // Blocks when the worker thread isn't done yet.
+  if (texture == nullptr)
+  {
+    return;
+  }
+
+  if (texture->uploadEnvironment(m_context))
+  {
+    m_environmentTexture.destroy(); // The preview.
+    m_environmentTexture = *texture;
+
+    LightDefinition& light = m_lightDefinitions[0]; // The environment light is expected in sysLightDefinitions[0]!
+
+    light.idEnvironmentTexture = m_environmentTexture.getId();
+    light.idEnvironmentCDF_U   = m_environmentTexture.getBufferCDF_U()->getId();
+    light.idEnvironmentCDF_V   = m_environmentTexture.getBufferCDF_V()->getId();
+#if USE_ENVIRONMENT_ALIAS_TABLES
+    light.idEnvironmentAlias_U = m_environmentTexture.getBufferAlias_U()->getId();
+    light.idEnvironmentAlias_V = m_environmentTexture.getBufferAlias_V()->getId();
+#endif
+    light.environmentIntegral  = m_environmentTexture.getIntegral();
+
+    void* dst = static_cast<LightDefinition*>(m_bufferLightDefinitions->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    memcpy(dst, m_lightDefinitions.data(), sizeof(LightDefinition) * m_lightDefinitions.size());
+    m_bufferLightDefinitions->unmap();
+
+    restartAccumulation();
+
+    std::cout << "updateEnvironment(): upload and swap = " << timer.getTime() << " seconds" << std::endl;
+  }
+  delete texture;
+}
+
+void Application::finishEnvironment()
+{
+  try
+  {
+    if (m_environmentLoader.isLoading())
+    {
+      updateEnvironment();
+    }
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+  }
+}
+
@@ -0,0 +1,155 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/BlockCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+
+// File layout.
+static const char     CACHE_MAGIC[8] = { 'O', 'P', 'T', 'I', 'X', 'B', 'C', 'C' };
+static const uint32_t CACHE_VERSION  = 1;
+
+struct CacheHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t headerSize;
+  uint32_t format;
+  uint32_t quality;
+  uint64_t contentHash;
+  uint64_t size; // Of the blocks following the header.
+};
+
+
+BlockCache::BlockCache()
+{
+}
+
+BlockCache::~BlockCache()
+{
+  close();
+}
+
+std::string BlockCache::cacheFilename(std::string const& source)
+{
+  return source + ".bccache";
+}
+
+bool BlockCache::write(std::string const& source, BlockFormat format, BlockQuality quality, uint64_t contentHash,
+                       std::vector<unsigned char> const& blocks)
+{
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+
+  memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version     = CACHE_VERSION;
+  header.headerSize  = sizeof(CacheHeader);
+  header.format      = format;
+  header.quality     = quality;
+  header.contentHash = contentHash;
+  header.size        = blocks.size();
+
+  // Write to a temporary file first so that concurrent readers never see a partially written cache.
+  const std::string filename    = cacheFilename(source);
+  const std::string filenameTmp = filename + ".tmp";
+  {
+    std::ofstream out(filenameTmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(blocks.data()), static_cast<std::streamsize>(blocks.size()));
+
+    if (!out)
+    {
+      out.close();
+      remove(filenameTmp.c_str());
+      return false;
+    }
+  }
+
+  remove(filename.c_str());
+  if (rename(filenameTmp.c_str(), filename.c_str()) != 0)
+  {
+    remove(filenameTmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool BlockCache::clear(std::string const& source)
+{
+  return remove(cacheFilename(source).c_str()) == 0;
+}
+
+bool BlockCache::open(std::string const& source, BlockFormat format, BlockQuality quality, uint64_t contentHash, size_t size)
+{
+  close();
+
+  if (!m_file.open(cacheFilename(source)))
+  {
+    return false;
+  }
+
+  const CacheHeader& header = *reinterpret_cast<const CacheHeader*>(m_file.data());
+
+  const bool valid = sizeof(CacheHeader) <= m_file.size() &&
+                     memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                     header.version     == CACHE_VERSION       &&
+                     header.headerSize  == sizeof(CacheHeader) &&
+                     header.format      == uint32_t(format)    &&
+                     header.quality     == uint32_t(quality)   &&
+                     header.contentHash == contentHash         &&
+                     header.size        == size                &&
+                     sizeof(CacheHeader) + size == m_file.size();
+  if (!valid)
+  {
+    close();
+  }
+  return valid;
+}
+
+void BlockCache::close()
+{
+  m_file.close();
+}
+
+bool BlockCache::isOpen() const
+{
+  return m_file.isOpen();
+}
+
+const unsigned char* BlockCache::getBlocks() const
+{
+  return reinterpret_cast<const unsigned char*>(m_file.data()) + sizeof(CacheHeader);
+}
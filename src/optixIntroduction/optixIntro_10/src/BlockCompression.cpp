@@ -0,0 +1,954 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/BlockCompression.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+// DAR Fork-join helpers from sutil to encode the block rows in parallel.
+#include <Parallel.h>
+
+#include "inc/MyAssert.h"
+
+// Minimum number of block rows per parallelFor range.
+#define BLOCK_GRAIN 4
+
+// BC6H mode 11: one region, 10-bit endpoints stored as they are, 4-bit indices.
+#define BC6H_MODE_11 0x03
+
+// The interpolation weights of the 4-bit BC6H indices in 64ths.
+static const int weightsBC6H[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+// Little-endian bit fields inside one block.
+
+static void writeBits(unsigned char* block, unsigned int& position, const unsigned int value, const unsigned int bits)
+{
+  for (unsigned int i = 0; i < bits; ++i, ++position)
+  {
+    if ((value >> i) & 1)
+    {
+      block[position >> 3] |= static_cast<unsigned char>(1 << (position & 7));
+    }
+  }
+}
+
+static unsigned int readBits(const unsigned char* block, unsigned int& position, const unsigned int bits)
+{
+  unsigned int value = 0;
+  for (unsigned int i = 0; i < bits; ++i, ++position)
+  {
+    value |= ((block[position >> 3] >> (position & 7)) & 1u) << i;
+  }
+  return value;
+}
+
+
+// Endpoint fitting shared by the color and the half float blocks.
+// Returns two endpoints spanning the 16 points along their main direction, e0 at the larger end.
+static void fitEndpoints(const float points[16][3], const BlockQuality quality, float* e0, float* e1)
+{
+  float mean[3] = { 0.0f, 0.0f, 0.0f };
+  float lo[3]   = { points[0][0], points[0][1], points[0][2] };
+  float hi[3]   = { points[0][0], points[0][1], points[0][2] };
+
+  for (int i = 0; i < 16; ++i)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      mean[c] += points[i][c];
+      lo[c] = std::min(lo[c], points[i][c]);
+      hi[c] = std::max(hi[c], points[i][c]);
+    }
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    mean[c] *= 1.0f / 16.0f;
+  }
+
+  // Covariance matrix xx, xy, xz, yy, yz, zz.
+  float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+  for (int i = 0; i < 16; ++i)
+  {
+    const float x = points[i][0] - mean[0];
+    const float y = points[i][1] - mean[1];
+    const float z = points[i][2] - mean[2];
+    cov[0] += x * x;
+    cov[1] += x * y;
+    cov[2] += x * z;
+    cov[3] += y * y;
+    cov[4] += y * z;
+    cov[5] += z * z;
+  }
+
+  if (quality == BLOCK_QUALITY_FAST)
+  {
+    // Bounding box diagonal. Channels which fall while the widest channel rises get their ends swapped.
+    int widest = 0;
+    for (int c = 1; c < 3; ++c)
+    {
+      if (hi[widest] - lo[widest] < hi[c] - lo[c])
+      {
+        widest = c;
+      }
+    }
+    static const int covIndex[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+    for (int c = 0; c < 3; ++c)
+    {
+      const bool falling = (c != widest && cov[covIndex[widest][c]] < 0.0f);
+      e0[c] = (falling) ? lo[c] : hi[c];
+      e1[c] = (falling) ? hi[c] : lo[c];
+
+      // Inset by 1/16 of the range, the interpolated entries cover the interior better than the extremes.
+      const float inset = (e0[c] - e1[c]) * (1.0f / 16.0f);
+      e0[c] -= inset;
+      e1[c] += inset;
+    }
+    return;
+  }
+
+  // Principal axis by power iteration, starting at the bounding box diagonal.
+  float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+  for (int iteration = 0; iteration < 8; ++iteration)
+  {
+    const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+    const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+    const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+
+    const float m = std::max(fabsf(x), std::max(fabsf(y), fabsf(z)));
+    if (m <= 0.0f)
+    {
+      break;
+    }
+    axis[0] = x / m;
+    axis[1] = y / m;
+    axis[2] = z / m;
+  }
+
+  const float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+  if (length2 <= 0.0f) // All points are equal.
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      e0[c] = mean[c];
+      e1[c] = mean[c];
+    }
+    return;
+  }
+
+  float tMin =  1.0e30f;
+  float tMax = -1.0e30f;
+  for (int i = 0; i < 16; ++i)
+  {
+    const float t = ((points[i][0] - mean[0]) * axis[0] + (points[i][1] - mean[1]) * axis[1] + (points[i][2] - mean[2]) * axis[2]) / length2;
+    tMin = std::min(tMin, t);
+    tMax = std::max(tMax, t);
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    e0[c] = mean[c] + axis[c] * tMax;
+    e1[c] = mean[c] + axis[c] * tMin;
+  }
+}
+
+// Least squares endpoints for fixed indices. weights[j] is the share of endpoint 0 in palette entry j.
+// Returns false when all points use entries of the same weight, which leaves the system singular.
+static bool solveEndpoints(const float points[16][3], const unsigned int* indices, const float* weights, float* e0, float* e1)
+{
+  float aa = 0.0f;
+  float ab = 0.0f;
+  float bb = 0.0f;
+  float ax[3] = { 0.0f, 0.0f, 0.0f };
+  float bx[3] = { 0.0f, 0.0f, 0.0f };
+
+  for (int i = 0; i < 16; ++i)
+  {
+    const float a = weights[indices[i]];
+    const float b = 1.0f - a;
+
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (int c = 0; c < 3; ++c)
+    {
+      ax[c] += a * points[i][c];
+      bx[c] += b * points[i][c];
+    }
+  }
+
+  const float det = aa * bb - ab * ab;
+  if (fabsf(det) < 1.0e-6f)
+  {
+    return false;
+  }
+  const float invDet = 1.0f / det;
+  for (int c = 0; c < 3; ++c)
+  {
+    e0[c] = (ax[c] * bb - bx[c] * ab) * invDet;
+    e1[c] = (bx[c] * aa - ax[c] * ab) * invDet;
+  }
+  return true;
+}
+
+
+// BC1 color blocks, also the color part of BC3.
+
+static unsigned int quantizeChannel(const float value, const int maximum)
+{
+  const int q = static_cast<int>(value * float(maximum) / 255.0f + 0.5f);
+  return static_cast<unsigned int>(std::max(0, std::min(maximum, q)));
+}
+
+static unsigned int packRGB565(const float* color)
+{
+  return (quantizeChannel(color[0], 31) << 11) | (quantizeChannel(color[1], 63) << 5) | quantizeChannel(color[2], 31);
+}
+
+static void unpackRGB565(const unsigned int color, int* rgb)
+{
+  const int r = (color >> 11) & 0x1F;
+  const int g = (color >>  5) & 0x3F;
+  const int b =  color        & 0x1F;
+
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// The palette exactly as decodeColorBlock() computes it.
+static void paletteColor(const unsigned int c0, const unsigned int c1, const bool fourColors, int palette[4][3])
+{
+  int a[3];
+  int b[3];
+  unpackRGB565(c0, a);
+  unpackRGB565(c1, b);
+
+  for (int c = 0; c < 3; ++c)
+  {
+    palette[0][c] = a[c];
+    palette[1][c] = b[c];
+    if (fourColors)
+    {
+      palette[2][c] = (2 * a[c] + b[c] + 1) / 3;
+      palette[3][c] = (a[c] + 2 * b[c] + 1) / 3;
+    }
+    else
+    {
+      palette[2][c] = (a[c] + b[c] + 1) / 2;
+      palette[3][c] = 0; // Transparent black, never selected for opaque images.
+    }
+  }
+}
+
+struct ColorCandidate
+{
+  unsigned int c0;
+  unsigned int c1;
+  bool         fourColors;
+  unsigned int indices[16];
+  int          error;
+};
+
+// Endpoint 0 greater than endpoint 1 selects the four color mode of BC1, otherwise it decodes three colors.
+static void evaluateColor(const int texels[16][3], unsigned int c0, unsigned int c1, const bool fourColors, ColorCandidate& candidate)
+{
+  if ((fourColors && c0 < c1) || (!fourColors && c1 < c0))
+  {
+    std::swap(c0, c1);
+  }
+
+  int palette[4][3];
+  paletteColor(c0, c1, fourColors, palette);
+
+  const int count = (fourColors) ? 4 : 3;
+
+  candidate.c0         = c0;
+  candidate.c1         = c1;
+  candidate.fourColors = fourColors;
+  candidate.error      = 0;
+
+  for (int i = 0; i < 16; ++i)
+  {
+    int best = INT_MAX;
+    for (int j = 0; j < count; ++j)
+    {
+      const int dr = texels[i][0] - palette[j][0];
+      const int dg = texels[i][1] - palette[j][1];
+      const int db = texels[i][2] - palette[j][2];
+      const int d  = dr * dr + dg * dg + db * db;
+      if (d < best)
+      {
+        best = d;
+        candidate.indices[i] = j;
+      }
+    }
+    candidate.error += best;
+  }
+}
+
+// Alternates between least squares endpoints and index selection while the error drops.
+static void refineColor(const int texels[16][3], const float points[16][3], const int iterations, ColorCandidate& best)
+{
+  static const float weights4[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+  static const float weights3[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+
+  ColorCandidate current = best;
+  for (int iteration = 0; iteration < iterations; ++iteration)
+  {
+    float e0[3];
+    float e1[3];
+    if (!solveEndpoints(points, current.indices, (current.fourColors) ? weights4 : weights3, e0, e1))
+    {
+      break;
+    }
+    evaluateColor(texels, packRGB565(e0), packRGB565(e1), current.fourColors, current);
+    if (best.error <= current.error)
+    {
+      break;
+    }
+    best = current;
+  }
+}
+
+static void encodeColorBlock(const unsigned char* rgba, const BlockQuality quality, const bool threeColorMode, unsigned char* block)
+{
+  int   texels[16][3];
+  float points[16][3];
+  for (int i = 0; i < 16; ++i)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      texels[i][c] = rgba[i * 4 + c];
+      points[i][c] = float(rgba[i * 4 + c]);
+    }
+  }
+
+  float e0[3];
+  float e1[3];
+  fitEndpoints(points, quality, e0, e1);
+
+  const int iterations = (quality == BLOCK_QUALITY_FAST) ? 0 : (quality == BLOCK_QUALITY_NORMAL) ? 1 : 4;
+
+  ColorCandidate best;
+  evaluateColor(texels, packRGB565(e0), packRGB565(e1), true, best);
+  refineColor(texels, points, iterations, best);
+
+  // The three color mode has a midpoint which is better for some blocks with two dominant colors.
+  if (quality == BLOCK_QUALITY_HIGH && threeColorMode && best.error != 0)
+  {
+    ColorCandidate three;
+    evaluateColor(texels, packRGB565(e0), packRGB565(e1), false, three);
+    refineColor(texels, points, iterations, three);
+    if (three.error < best.error)
+    {
+      best = three;
+    }
+  }
+
+  uint32_t indices = 0;
+  for (int i = 0; i < 16; ++i)
+  {
+    indices |= best.indices[i] << (i * 2);
+  }
+  memset(block, 0, 8);
+  unsigned int position = 0;
+  writeBits(block, position, best.c0, 16);
+  writeBits(block, position, best.c1, 16);
+  writeBits(block, position, indices, 32);
+}
+
+static void decodeColorBlock(const unsigned char* block, const bool alwaysFourColors, unsigned char* rgba)
+{
+  unsigned int position = 0;
+  const unsigned int c0 = readBits(block, position, 16);
+  const unsigned int c1 = readBits(block, position, 16);
+
+  const bool fourColors = alwaysFourColors || c1 < c0;
+
+  int palette[4][3];
+  paletteColor(c0, c1, fourColors, palette);
+
+  for (int i = 0; i < 16; ++i)
+  {
+    const unsigned int index = readBits(block, position, 2);
+    for (int c = 0; c < 3; ++c)
+    {
+      rgba[i * 4 + c] = static_cast<unsigned char>(palette[index][c]);
+    }
+    rgba[i * 4 + 3] = (!fourColors && index == 3) ? 0 : 255;
+  }
+}
+
+
+// Interpolated single channel blocks (BC4), the alpha of BC3 and both channels of BC5.
+
+// Endpoint 0 greater than endpoint 1 selects eight interpolated values, otherwise six plus 0 and 255.
+static void paletteChannel(const int a0, const int a1, int palette[8])
+{
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a1 < a0)
+  {
+    for (int i = 1; i < 7; ++i)
+    {
+      palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+    }
+  }
+  else
+  {
+    for (int i = 1; i < 5; ++i)
+    {
+      palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+struct ChannelCandidate
+{
+  int          a0;
+  int          a1;
+  unsigned int indices[16];
+  int          error;
+};
+
+static void evaluateChannel(const int values[16], const int a0, const int a1, ChannelCandidate& candidate)
+{
+  int palette[8];
+  paletteChannel(a0, a1, palette);
+
+  candidate.a0    = a0;
+  candidate.a1    = a1;
+  candidate.error = 0;
+
+  for (int i = 0; i < 16; ++i)
+  {
+    int best = INT_MAX;
+    for (int j = 0; j < 8; ++j)
+    {
+      const int d = (values[i] - palette[j]) * (values[i] - palette[j]);
+      if (d < best)
+      {
+        best = d;
+        candidate.indices[i] = j;
+      }
+    }
+    candidate.error += best;
+  }
+}
+
+static void encodeChannelBlock(const unsigned char* texels, const int stride, const BlockQuality quality, unsigned char* block)
+{
+  int values[16];
+  int lo = 255;
+  int hi = 0;
+  int loInner = 255; // Range without the exact 0 and 255 of the six value mode.
+  int hiInner = 0;
+  for (int i = 0; i < 16; ++i)
+  {
+    values[i] = texels[i * stride];
+    lo = std::min(lo, values[i]);
+    hi = std::max(hi, values[i]);
+    if (0 < values[i] && values[i] < 255)
+    {
+      loInner = std::min(loInner, values[i]);
+      hiInner = std::max(hiInner, values[i]);
+    }
+  }
+
+  ChannelCandidate best;
+  evaluateChannel(values, hi, lo, best); // Eight values, or the exact value when hi == lo.
+
+  if (best.error != 0 && quality != BLOCK_QUALITY_FAST)
+  {
+    // Insetting the endpoints can reduce the error of the interpolated values.
+    const int inset = (quality == BLOCK_QUALITY_HIGH) ? 3 : 1;
+
+    ChannelCandidate candidate;
+    for (int d0 = 0; d0 <= inset; ++d0)
+    {
+      for (int d1 = 0; d1 <= inset; ++d1)
+      {
+        if (lo + d1 < hi - d0)
+        {
+          evaluateChannel(values, hi - d0, lo + d1, candidate);
+          if (candidate.error < best.error)
+          {
+            best = candidate;
+          }
+        }
+        // Six values between the inner range, with 0 and 255 exact.
+        if (quality == BLOCK_QUALITY_HIGH && (lo == 0 || hi == 255) && loInner + d1 <= hiInner - d0)
+        {
+          evaluateChannel(values, loInner + d1, hiInner - d0, candidate);
+          if (candidate.error < best.error)
+          {
+            best = candidate;
+          }
+        }
+      }
+    }
+  }
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 16; ++i)
+  {
+    indices |= uint64_t(best.indices[i]) << (i * 3);
+  }
+  block[0] = static_cast<unsigned char>(best.a0);
+  block[1] = static_cast<unsigned char>(best.a1);
+  for (int i = 0; i < 6; ++i)
+  {
+    block[2 + i] = static_cast<unsigned char>(indices >> (i * 8));
+  }
+}
+
+static void decodeChannelBlock(const unsigned char* block, unsigned char* texels, const int stride)
+{
+  unsigned int position = 0;
+  const int a0 = readBits(block, position, 8);
+  const int a1 = readBits(block, position, 8);
+
+  int palette[8];
+  paletteChannel(a0, a1, palette);
+
+  for (int i = 0; i < 16; ++i)
+  {
+    texels[i * stride] = static_cast<unsigned char>(palette[readBits(block, position, 3)]);
+  }
+}
+
+
+// BC6H unsigned half float blocks.
+
+// Non-negative float to the bits of the nearest half, clamped to the largest finite half. Negative values and NaN become zero.
+static unsigned int floatToHalf(const float f)
+{
+  if (!(0.0f < f))
+  {
+    return 0;
+  }
+  if (65504.0f <= f)
+  {
+    return 0x7BFF;
+  }
+  if (f < 6.103515625e-05f) // Subnormal halves are multiples of 2^-24. Rounding up to 1024 gives the smallest normal half.
+  {
+    return static_cast<unsigned int>(f * 16777216.0f + 0.5f);
+  }
+
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+
+  const uint32_t exponent = ((bits >> 23) & 0xFF) - 127 + 15;
+  const uint32_t mantissa = bits & 0x7FFFFF;
+
+  uint32_t h = (exponent << 10) | (mantissa >> 13);
+
+  const uint32_t rest = mantissa & 0x1FFF; // Round to nearest even. A carry correctly increments the exponent.
+  if (0x1000 < rest || (rest == 0x1000 && (h & 1)))
+  {
+    ++h;
+  }
+  return std::min(h, 0x7BFFu);
+}
+
+static float halfToFloat(const unsigned int h)
+{
+  const int exponent = (h >> 10) & 0x1F;
+  const int mantissa = h & 0x3FF;
+
+  if (exponent == 0)
+  {
+    return ldexpf(float(mantissa), -24);
+  }
+  return ldexpf(float(mantissa | 0x400), exponent - 25); // Unsigned BC6H never decodes to infinity or NaN.
+}
+
+static int unquantizeHalf(const int q)
+{
+  if (q == 0)
+  {
+    return 0;
+  }
+  if (q == 1023)
+  {
+    return 0xFFFF;
+  }
+  return ((q << 16) + 0x8000) >> 10;
+}
+
+// The 10-bit endpoint which decodes closest to the half bits h. Undoes the final scaling (x * 31) >> 6 of the decoder.
+static int quantizeHalf(const float h)
+{
+  const float u = h * 64.0f / 31.0f;
+  const int   q = static_cast<int>(floorf((u - 32.0f) / 64.0f + 0.5f));
+  return std::max(0, std::min(1023, q));
+}
+
+// The half bits of palette entry index as the decoder computes them.
+static int interpolateHalf(const int q0, const int q1, const int index)
+{
+  const int a = unquantizeHalf(q0);
+  const int b = unquantizeHalf(q1);
+  const int w = weightsBC6H[index];
+  return (((a * (64 - w) + b * w + 32) >> 6) * 31) >> 6;
+}
+
+struct HalfCandidate
+{
+  int          q0[3];
+  int          q1[3];
+  unsigned int indices[16];
+  int64_t      error;
+};
+
+// The error is measured on the half bits, which are close to logarithmic and weight dark and bright texels alike.
+static void evaluateHalf(const int texels[16][3], HalfCandidate& candidate)
+{
+  int palette[16][3];
+  for (int j = 0; j < 16; ++j)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      palette[j][c] = interpolateHalf(candidate.q0[c], candidate.q1[c], j);
+    }
+  }
+
+  candidate.error = 0;
+  for (int i = 0; i < 16; ++i)
+  {
+    int64_t best = LLONG_MAX;
+    for (int j = 0; j < 16; ++j)
+    {
+      const int64_t dr = texels[i][0] - palette[j][0];
+      const int64_t dg = texels[i][1] - palette[j][1];
+      const int64_t db = texels[i][2] - palette[j][2];
+      const int64_t d  = dr * dr + dg * dg + db * db;
+      if (d < best)
+      {
+        best = d;
+        candidate.indices[i] = j;
+      }
+    }
+    candidate.error += best;
+  }
+}
+
+static void encodeHalfBlock(const float* rgba, const BlockQuality quality, unsigned char* block)
+{
+  int   texels[16][3];
+  float points[16][3];
+  for (int i = 0; i < 16; ++i)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      texels[i][c] = floatToHalf(rgba[i * 4 + c]);
+      points[i][c] = float(texels[i][c]);
+    }
+  }
+
+  float e0[3];
+  float e1[3];
+  fitEndpoints(points, quality, e0, e1);
+
+  HalfCandidate best;
+  for (int c = 0; c < 3; ++c)
+  {
+    best.q0[c] = quantizeHalf(e0[c]);
+    best.q1[c] = quantizeHalf(e1[c]);
+  }
+  evaluateHalf(texels, best);
+
+  float weights[16];
+  for (int j = 0; j < 16; ++j)
+  {
+    weights[j] = 1.0f - float(weightsBC6H[j]) / 64.0f;
+  }
+
+  const int iterations = (quality == BLOCK_QUALITY_FAST) ? 0 : (quality == BLOCK_QUALITY_NORMAL) ? 1 : 4;
+
+  HalfCandidate current = best;
+  for (int iteration = 0; iteration < iterations && best.error != 0; ++iteration)
+  {
+    if (!solveEndpoints(points, current.indices, weights, e0, e1))
+    {
+      break;
+    }
+    for (int c = 0; c < 3; ++c)
+    {
+      current.q0[c] = quantizeHalf(e0[c]);
+      current.q1[c] = quantizeHalf(e1[c]);
+    }
+    evaluateHalf(texels, current);
+    if (best.error <= current.error)
+    {
+      break;
+    }
+    best = current;
+  }
+
+  // Quantization of the least squares endpoints isn't optimal. Try the neighboring endpoint values.
+  if (quality == BLOCK_QUALITY_HIGH)
+  {
+    for (int pass = 0; pass < 2 && best.error != 0; ++pass)
+    {
+      for (int e = 0; e < 6; ++e)
+      {
+        for (int delta = -1; delta <= 1; delta += 2)
+        {
+          HalfCandidate candidate = best;
+          int& q = (e < 3) ? candidate.q0[e] : candidate.q1[e - 3];
+          q += delta;
+          if (0 <= q && q <= 1023)
+          {
+            evaluateHalf(texels, candidate);
+            if (candidate.error < best.error)
+            {
+              best = candidate;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // The anchor index of texel 0 is stored without its most significant bit, which must be zero.
+  if (8 <= best.indices[0])
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      std::swap(best.q0[c], best.q1[c]);
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+      best.indices[i] = 15 - best.indices[i]; // The weights are symmetric.
+    }
+  }
+
+  memset(block, 0, 16);
+  unsigned int position = 0;
+  writeBits(block, position, BC6H_MODE_11, 5);
+  for (int c = 0; c < 3; ++c)
+  {
+    writeBits(block, position, best.q0[c], 10);
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    writeBits(block, position, best.q1[c], 10);
+  }
+  writeBits(block, position, best.indices[0], 3);
+  for (int i = 1; i < 16; ++i)
+  {
+    writeBits(block, position, best.indices[i], 4);
+  }
+}
+
+static void decodeHalfBlock(const unsigned char* block, float* rgba)
+{
+  unsigned int position = 0;
+  if (readBits(block, position, 5) != BC6H_MODE_11)
+  {
+    MY_ASSERT(!"decodeHalfBlock() Only mode 11 is supported.");
+    memset(rgba, 0, 16 * 4 * sizeof(float));
+    return;
+  }
+
+  int q0[3];
+  int q1[3];
+  for (int c = 0; c < 3; ++c)
+  {
+    q0[c] = readBits(block, position, 10);
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    q1[c] = readBits(block, position, 10);
+  }
+
+  for (int i = 0; i < 16; ++i)
+  {
+    const int index = readBits(block, position, (i == 0) ? 3 : 4);
+    for (int c = 0; c < 3; ++c)
+    {
+      rgba[i * 4 + c] = halfToFloat(interpolateHalf(q0[c], q1[c], index));
+    }
+    rgba[i * 4 + 3] = 1.0f;
+  }
+}
+
+
+unsigned int getBlockBytes(const BlockFormat format)
+{
+  switch (format)
+  {
+    case BLOCK_FORMAT_BC1:
+      return 8;
+    case BLOCK_FORMAT_BC3:
+    case BLOCK_FORMAT_BC5:
+    case BLOCK_FORMAT_BC6H:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+size_t getBlocksSize(const BlockFormat format, const unsigned int width, const unsigned int height)
+{
+  return size_t((width + 3) / 4) * size_t((height + 3) / 4) * getBlockBytes(format);
+}
+
+// Copies the 4x4 RGBA texels of one block, repeating the border texels of partial blocks.
+template<typename T>
+static void gatherBlock(const T* rgba, const unsigned int width, const unsigned int height, const unsigned int bx, const unsigned int by, T* texels)
+{
+  for (unsigned int y = 0; y < 4; ++y)
+  {
+    const size_t sy = std::min(by * 4 + y, height - 1);
+    for (unsigned int x = 0; x < 4; ++x)
+    {
+      const size_t sx = std::min(bx * 4 + x, width - 1);
+      memcpy(texels + (y * 4 + x) * 4, rgba + (sy * width + sx) * 4, 4 * sizeof(T));
+    }
+  }
+}
+
+template<typename T>
+static void scatterBlock(const T* texels, const unsigned int width, const unsigned int height, const unsigned int bx, const unsigned int by, T* rgba)
+{
+  for (unsigned int y = 0; y < 4 && by * 4 + y < height; ++y)
+  {
+    for (unsigned int x = 0; x < 4 && bx * 4 + x < width; ++x)
+    {
+      memcpy(rgba + (size_t(by * 4 + y) * width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4 * sizeof(T));
+    }
+  }
+}
+
+void encodeBlocks(const BlockFormat format, const BlockQuality quality, const void* rgba,
+                  const unsigned int width, const unsigned int height, unsigned char* blocks)
+{
+  MY_ASSERT(format != BLOCK_FORMAT_NONE && 0 < width && 0 < height);
+
+  const unsigned int blocksX = (width  + 3) / 4;
+  const unsigned int blocksY = (height + 3) / 4;
+  const unsigned int bytes   = getBlockBytes(format);
+
+  sutil::parallelFor(blocksY, BLOCK_GRAIN, [&](size_t begin, size_t end, size_t)
+  {
+    for (size_t by = begin; by < end; ++by)
+    {
+      for (unsigned int bx = 0; bx < blocksX; ++bx)
+      {
+        unsigned char* block = blocks + (by * blocksX + bx) * bytes;
+
+        if (format == BLOCK_FORMAT_BC6H)
+        {
+          float texels[16 * 4];
+          gatherBlock(static_cast<const float*>(rgba), width, height, bx, static_cast<unsigned int>(by), texels);
+          encodeHalfBlock(texels, quality, block);
+          continue;
+        }
+
+        unsigned char texels[16 * 4];
+        gatherBlock(static_cast<const unsigned char*>(rgba), width, height, bx, static_cast<unsigned int>(by), texels);
+
+        switch (format)
+        {
+          case BLOCK_FORMAT_BC1:
+            encodeColorBlock(texels, quality, true, block);
+            break;
+          case BLOCK_FORMAT_BC3:
+            encodeChannelBlock(texels + 3, 4, quality, block);
+            encodeColorBlock(texels, quality, false, block + 8); // BC3 colors always decode in the four color mode.
+            break;
+          case BLOCK_FORMAT_BC5:
+            encodeChannelBlock(texels + 0, 4, quality, block);
+            encodeChannelBlock(texels + 1, 4, quality, block + 8);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+  });
+}
+
+void decodeBlocks(const BlockFormat format, const unsigned char* blocks,
+                  const unsigned int width, const unsigned int height, void* rgba)
+{
+  MY_ASSERT(format != BLOCK_FORMAT_NONE && 0 < width && 0 < height);
+
+  const unsigned int blocksX = (width  + 3) / 4;
+  const unsigned int blocksY = (height + 3) / 4;
+  const unsigned int bytes   = getBlockBytes(format);
+
+  for (unsigned int by = 0; by < blocksY; ++by)
+  {
+    for (unsigned int bx = 0; bx < blocksX; ++bx)
+    {
+      const unsigned char* block = blocks + (size_t(by) * blocksX + bx) * bytes;
+
+      if (format == BLOCK_FORMAT_BC6H)
+      {
+        float texels[16 * 4];
+        decodeHalfBlock(block, texels);
+        scatterBlock(texels, width, height, bx, by, static_cast<float*>(rgba));
+        continue;
+      }
+
+      unsigned char texels[16 * 4];
+      switch (format)
+      {
+        case BLOCK_FORMAT_BC1:
+          decodeColorBlock(block, false, texels);
+          break;
+        case BLOCK_FORMAT_BC3:
+          decodeColorBlock(block + 8, true, texels);
+          decodeChannelBlock(block, texels + 3, 4);
+          break;
+        case BLOCK_FORMAT_BC5:
+          decodeChannelBlock(block,     texels + 0, 4);
+          decodeChannelBlock(block + 8, texels + 1, 4);
+          for (int i = 0; i < 16; ++i)
+          {
+            texels[i * 4 + 2] = 0;
+            texels[i * 4 + 3] = 255;
+          }
+          break;
+        default:
+          break;
+      }
+      scatterBlock(texels, width, height, bx, by, static_cast<unsigned char*>(rgba));
+    }
+  }
+}
@@ -26,14 +26,14 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "inc/Application.h"
+#include "inc/Shapes.h"
 
 #include <cstring>
 #include <iostream>
 #include <sstream>
 
 // A simple unit cube built from 12 triangles.
-optix::Geometry Application::createBox()
+void generateBox(std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices)
 {
   float left   = -1.0f;
   float right  =  1.0f;
@@ -42,8 +42,6 @@ optix::Geometry Application::createBox()
   float back   = -1.0f;
   float front  =  1.0f;
 
-  std::vector<VertexAttributes> attributes;
-  
   VertexAttributes attrib;
 
   // Left.
@@ -167,8 +165,6 @@ optix::Geometry Application::createBox()
   attributes.push_back(attrib);
 
 
-  std::vector<unsigned int> indices;
-
   for (unsigned int i = 0; i < 6; ++i)
   {
     const unsigned int idx = i * 4; // Four attributes per box face.
@@ -183,8 +179,6 @@ optix::Geometry Application::createBox()
   }
 
   std::cout << "createBox(): Vertices = " << attributes.size() <<  ", Triangles = " << indices.size() / 3 << std::endl;
-
-  return createGeometry(attributes, indices);
 }
 
 
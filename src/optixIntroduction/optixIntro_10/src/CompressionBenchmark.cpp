@@ -0,0 +1,354 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/CompressionBenchmark.h"
+
+#include "inc/BlockCompression.h"
+#include "inc/Timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Extents of the throughput measurement, and odd extents with partial blocks for the tests.
+#define BENCHMARK_WIDTH  1024
+#define BENCHMARK_HEIGHT 1024
+#define ODD_WIDTH        333
+#define ODD_HEIGHT       101
+
+// Smallest value of the logarithmic HDR error, below that all values count as black.
+#define HDR_BLACK 6.103515625e-05f
+
+
+struct NamedFormat
+{
+  BlockFormat format;
+  const char* name;
+  float       minimumPSNR[3]; // Per quality preset on the odd sized synthetic image of this format, about 1.5 dB below the current results.
+};
+
+static const NamedFormat blockFormats[] =
+{
+  { BLOCK_FORMAT_BC1,  "BC1",  { 34.0f, 35.5f, 35.5f } },
+  { BLOCK_FORMAT_BC3,  "BC3",  { 35.0f, 36.5f, 36.5f } },
+  { BLOCK_FORMAT_BC5,  "BC5",  { 42.5f, 43.5f, 44.0f } },
+  { BLOCK_FORMAT_BC6H, "BC6H", { 50.5f, 52.0f, 52.0f } }
+};
+
+static const char* qualityNames[] = { "fast", "normal", "high" };
+
+
+static unsigned char toByte(const float value)
+{
+  return static_cast<unsigned char>(std::max(0.0f, std::min(255.0f, value + 0.5f)));
+}
+
+// Smooth gradients, a sine pattern, hard edges and noise, like a texture atlas of photos and decals.
+// Alpha has opaque, transparent, and soft regions.
+static void createColorImage(const unsigned int width, const unsigned int height, std::vector<unsigned char>& rgba)
+{
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> noise(-6.0f, 6.0f);
+
+  rgba.resize(size_t(width) * height * 4);
+  for (unsigned int y = 0; y < height; ++y)
+  {
+    for (unsigned int x = 0; x < width; ++x)
+    {
+      const float u = float(x) / float(width);
+      const float v = float(y) / float(height);
+
+      float r = 255.0f * u;
+      float g = 128.0f + 100.0f * sinf(u * 20.0f) * cosf(v * 13.0f);
+      float b = 255.0f * v * (1.0f - u);
+      if (((x / 37) + (y / 29)) % 5 == 0) // Hard edged decals.
+      {
+        r = 240.0f - r * 0.5f;
+        b = 30.0f;
+      }
+
+      const float radius = sqrtf((u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f));
+      const float a = std::max(0.0f, std::min(255.0f, (0.45f - radius) * 2000.0f));
+
+      unsigned char* p = &rgba[(size_t(y) * width + x) * 4];
+      p[0] = toByte(r + noise(rng));
+      p[1] = toByte(g + noise(rng));
+      p[2] = toByte(b + noise(rng));
+      p[3] = toByte(a);
+    }
+  }
+}
+
+// Tangent space normals of a bump pattern, (x, y) * 0.5 + 0.5 in red and green.
+static void createNormalImage(const unsigned int width, const unsigned int height, std::vector<unsigned char>& rgba)
+{
+  rgba.resize(size_t(width) * height * 4);
+  for (unsigned int y = 0; y < height; ++y)
+  {
+    for (unsigned int x = 0; x < width; ++x)
+    {
+      const float u = float(x) / float(width)  * 6.2831853f * 8.0f;
+      const float v = float(y) / float(height) * 6.2831853f * 5.0f;
+
+      float nx = -0.6f * cosf(u) * sinf(v);
+      float ny = -0.6f * sinf(u) * cosf(v);
+      const float nz = 1.0f;
+      const float length = sqrtf(nx * nx + ny * ny + nz * nz);
+      nx /= length;
+      ny /= length;
+
+      unsigned char* p = &rgba[(size_t(y) * width + x) * 4];
+      p[0] = toByte((nx * 0.5f + 0.5f) * 255.0f);
+      p[1] = toByte((ny * 0.5f + 0.5f) * 255.0f);
+      p[2] = 255;
+      p[3] = 255;
+    }
+  }
+}
+
+// An environment-like HDR image over eight orders of magnitude with a bright sun.
+static void createHdrImage(const unsigned int width, const unsigned int height, std::vector<float>& rgba)
+{
+  std::mt19937 rng(5678);
+  std::uniform_real_distribution<float> noise(0.95f, 1.05f);
+
+  rgba.resize(size_t(width) * height * 4);
+  for (unsigned int y = 0; y < height; ++y)
+  {
+    for (unsigned int x = 0; x < width; ++x)
+    {
+      const float u = float(x) / float(width);
+      const float v = float(y) / float(height);
+
+      const float sky = powf(10.0f, v * 6.0f - 3.0f);
+      const float du  = u - 0.7f;
+      const float dv  = v - 0.8f;
+      const float sun = 20000.0f * expf(-(du * du + dv * dv) * 4000.0f);
+
+      float* p = &rgba[(size_t(y) * width + x) * 4];
+      p[0] = (sky * (0.6f + 0.4f * sinf(u * 30.0f)) + sun) * noise(rng);
+      p[1] = (sky * 0.8f + sun) * noise(rng);
+      p[2] = (sky * (1.0f - 0.5f * u) + sun * 0.9f) * noise(rng);
+      p[3] = 1.0f;
+    }
+  }
+}
+
+// PSNR of the channels the format stores.
+static double psnrColor(const BlockFormat format, const std::vector<unsigned char>& reference, const std::vector<unsigned char>& decoded)
+{
+  const int channels = (format == BLOCK_FORMAT_BC1) ? 3 : (format == BLOCK_FORMAT_BC5) ? 2 : 4;
+
+  double sum = 0.0;
+  size_t count = 0;
+  for (size_t i = 0; i < reference.size(); i += 4)
+  {
+    for (int c = 0; c < channels; ++c)
+    {
+      const double d = double(reference[i + c]) - double(decoded[i + c]);
+      sum += d * d;
+      ++count;
+    }
+  }
+  const double mse = sum / double(count);
+  return (0.0 < mse) ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// PSNR of log2(value), relative to the logarithmic range of the reference RGB values.
+static double psnrHdr(const std::vector<float>& reference, const std::vector<float>& decoded)
+{
+  float lo =  1.0e30f;
+  float hi = -1.0e30f;
+
+  double sum = 0.0;
+  size_t count = 0;
+  for (size_t i = 0; i < reference.size(); i += 4)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      const float a = log2f(std::max(HDR_BLACK, reference[i + c]));
+      const float b = log2f(std::max(HDR_BLACK, decoded[i + c]));
+      lo = std::min(lo, a);
+      hi = std::max(hi, a);
+      sum += double(a - b) * double(a - b);
+      ++count;
+    }
+  }
+  const double mse  = sum / double(count);
+  const double peak = double(hi - lo);
+  return (0.0 < mse) ? 10.0 * log10(peak * peak / mse) : 99.0;
+}
+
+// Encodes and decodes the synthetic image of the format. Returns the PSNR and the encoding time.
+static double measure(const BlockFormat format, const BlockQuality quality, const unsigned int width, const unsigned int height, double& seconds)
+{
+  std::vector<unsigned char> blocks(getBlocksSize(format, width, height));
+
+  Timer timer;
+  if (format == BLOCK_FORMAT_BC6H)
+  {
+    std::vector<float> reference;
+    createHdrImage(width, height, reference);
+
+    timer.start();
+    encodeBlocks(format, quality, reference.data(), width, height, blocks.data());
+    seconds = timer.getTime();
+
+    std::vector<float> decoded(reference.size());
+    decodeBlocks(format, blocks.data(), width, height, decoded.data());
+    return psnrHdr(reference, decoded);
+  }
+
+  std::vector<unsigned char> reference;
+  if (format == BLOCK_FORMAT_BC5)
+  {
+    createNormalImage(width, height, reference);
+  }
+  else
+  {
+    createColorImage(width, height, reference);
+  }
+
+  timer.start();
+  encodeBlocks(format, quality, reference.data(), width, height, blocks.data());
+  seconds = timer.getTime();
+
+  std::vector<unsigned char> decoded(reference.size());
+  decodeBlocks(format, blocks.data(), width, height, decoded.data());
+  return psnrColor(format, reference, decoded);
+}
+
+// Constant images need no interpolation. The channel blocks and BC6H reproduce any value, BC1 colors which RGB565 represents.
+static bool testConstant()
+{
+  bool passed = true;
+
+  const unsigned char color[4] = { 132, 77, 255, 201 }; // 132 = 16 << 3 | 16 >> 2, 77 = 19 << 2 | 19 >> 4.
+
+  std::vector<unsigned char> rgba(16 * 4);
+  for (int i = 0; i < 16; ++i)
+  {
+    memcpy(&rgba[i * 4], color, 4);
+  }
+
+  const BlockFormat formats[3] = { BLOCK_FORMAT_BC1, BLOCK_FORMAT_BC3, BLOCK_FORMAT_BC5 };
+  for (int f = 0; f < 3; ++f)
+  {
+    for (int q = BLOCK_QUALITY_FAST; q <= BLOCK_QUALITY_HIGH; ++q)
+    {
+      unsigned char block[16];
+      unsigned char decoded[16 * 4];
+      encodeBlocks(formats[f], BlockQuality(q), rgba.data(), 4, 4, block);
+      decodeBlocks(formats[f], block, 4, 4, decoded);
+
+      const int channels = (formats[f] == BLOCK_FORMAT_BC1) ? 3 : (formats[f] == BLOCK_FORMAT_BC5) ? 2 : 4;
+      for (int i = 0; i < 16; ++i)
+      {
+        if (memcmp(&decoded[i * 4], color, channels) != 0)
+        {
+          std::cerr << "ERROR: testConstant() " << blockFormats[f].name << " " << qualityNames[q] << " texel " << i << " differs." << std::endl;
+          passed = false;
+          break;
+        }
+      }
+    }
+  }
+
+  // Halves which 10-bit endpoints represent exactly after the unquantization.
+  std::vector<float> hdr(16 * 4);
+  const float values[3] = { 0.0f, 1.0f, 65504.0f };
+  for (int v = 0; v < 3; ++v)
+  {
+    for (int i = 0; i < 16 * 4; ++i)
+    {
+      hdr[i] = values[v];
+    }
+    unsigned char block[16];
+    float decoded[16 * 4];
+    encodeBlocks(BLOCK_FORMAT_BC6H, BLOCK_QUALITY_NORMAL, hdr.data(), 4, 4, block);
+    decodeBlocks(BLOCK_FORMAT_BC6H, block, 4, 4, decoded);
+    for (int i = 0; i < 16 * 4; ++i)
+    {
+      if ((i & 3) == 3) // BC6H decodes alpha as one.
+      {
+        continue;
+      }
+      // The largest half differs by the finish scaling of the decoder in its last bits.
+      if (fabsf(decoded[i] - values[v]) > values[v] * 0.002f)
+      {
+        std::cerr << "ERROR: testConstant() BC6H value " << values[v] << " decodes to " << decoded[i] << "." << std::endl;
+        passed = false;
+        break;
+      }
+    }
+  }
+  return passed;
+}
+
+
+bool benchmarkCompression()
+{
+  const int numFormats = sizeof(blockFormats) / sizeof(blockFormats[0]);
+
+  bool passed = testConstant();
+
+  for (int f = 0; f < numFormats; ++f)
+  {
+    for (int q = BLOCK_QUALITY_FAST; q <= BLOCK_QUALITY_HIGH; ++q)
+    {
+      double seconds;
+      const double psnr = measure(blockFormats[f].format, BlockQuality(q), ODD_WIDTH, ODD_HEIGHT, seconds);
+      if (psnr < blockFormats[f].minimumPSNR[q])
+      {
+        std::cerr << "ERROR: benchmarkCompression() " << blockFormats[f].name << " " << qualityNames[q] << " PSNR " << psnr 
+                  << " dB of " << ODD_WIDTH << " x " << ODD_HEIGHT << " is below " << blockFormats[f].minimumPSNR[q] << " dB." << std::endl;
+        passed = false;
+      }
+    }
+  }
+
+  std::cout << "benchmarkCompression(): " << BENCHMARK_WIDTH << " x " << BENCHMARK_HEIGHT << " images, tests " << ((passed) ? "passed" : "FAILED") << std::endl;
+  std::cout << "  Mtexels/s and PSNR in dB (BC6H of log2): fast, normal, high" << std::endl;
+
+  for (int f = 0; f < numFormats; ++f)
+  {
+    std::cout << "  " << blockFormats[f].name << ":";
+    for (int q = BLOCK_QUALITY_FAST; q <= BLOCK_QUALITY_HIGH; ++q)
+    {
+      double seconds;
+      const double psnr = measure(blockFormats[f].format, BlockQuality(q), BENCHMARK_WIDTH, BENCHMARK_HEIGHT, seconds);
+      std::cout << "  " << double(BENCHMARK_WIDTH) * double(BENCHMARK_HEIGHT) * 1.0e-6 / seconds << " " << psnr;
+    }
+    std::cout << std::endl;
+  }
+
+  return passed;
+}
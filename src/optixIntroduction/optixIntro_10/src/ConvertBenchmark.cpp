@@ -0,0 +1,203 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/ConvertBenchmark.h"
+
+#include "inc/Texture.h"
+#include "inc/Timer.h"
+
+#include <IL/il.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Pixels of the throughput measurement and the number of runs of which the fastest counts.
+#define BENCHMARK_PIXELS (1024 * 1024)
+#define BENCHMARK_RUNS   5
+// Pixels of the validation. Odd, so that the SIMD loops leave a remainder for the scalar ones.
+#define VALIDATION_PIXELS 4099
+
+
+struct NamedEnum
+{
+  int         value;
+  const char* name;
+};
+
+static const NamedEnum formats[] =
+{
+  { IL_LUMINANCE,       "LUMINANCE"       },
+  { IL_ALPHA,           "ALPHA"           },
+  { IL_LUMINANCE_ALPHA, "LUMINANCE_ALPHA" },
+  { IL_RGB,             "RGB"             },
+  { IL_BGR,             "BGR"             },
+  { IL_RGBA,            "RGBA"            },
+  { IL_BGRA,            "BGRA"            }
+};
+
+static const NamedEnum types[] =
+{
+  { IL_BYTE,           "BYTE"           },
+  { IL_UNSIGNED_BYTE,  "UNSIGNED_BYTE"  },
+  { IL_SHORT,          "SHORT"          },
+  { IL_UNSIGNED_SHORT, "UNSIGNED_SHORT" },
+  { IL_INT,            "INT"            },
+  { IL_UNSIGNED_INT,   "UNSIGNED_INT"   },
+  { IL_FLOAT,          "FLOAT"          }
+};
+
+static unsigned int numberOfChannels(const unsigned int encoding)
+{
+  return (encoding >> ENC_CHANNELS_SHIFT) & ENC_MASK;
+}
+
+static unsigned int sizeOfType(const int type)
+{
+  switch (type)
+  {
+    case IL_BYTE:
+    case IL_UNSIGNED_BYTE:
+      return 1;
+    case IL_SHORT:
+    case IL_UNSIGNED_SHORT:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+// Random components. Floats stay in [0, 1) to not produce NaNs from random bits.
+static void randomPixels(const int type, std::vector<unsigned char>& data, std::mt19937& rng)
+{
+  if (type == IL_FLOAT)
+  {
+    float* p = reinterpret_cast<float*>(data.data());
+    for (size_t i = 0; i < data.size() / sizeof(float); ++i)
+    {
+      p[i] = float(rng() >> 8) * (1.0f / 16777216.0f);
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+      data[i] = static_cast<unsigned char>(rng());
+    }
+  }
+}
+
+template<typename Func>
+static double bestTime(Func func)
+{
+  double best = 1.0e30;
+  for (int run = 0; run < BENCHMARK_RUNS; ++run)
+  {
+    Timer timer;
+    timer.start();
+    func();
+    best = std::min(best, timer.getTime());
+  }
+  return best;
+}
+
+
+bool benchmarkConvert()
+{
+  const int numFormats = sizeof(formats) / sizeof(formats[0]);
+  const int numTypes   = sizeof(types)   / sizeof(types[0]);
+
+  std::mt19937 rng(12345);
+
+  bool passed = true;
+
+  // Validation of all host and device type pairs. Only the equal types take the specialized kernels, the others check the dispatch.
+  for (int f = 0; f < numFormats; ++f)
+  {
+    for (int s = 0; s < numTypes; ++s)
+    {
+      for (int d = 0; d < numTypes; ++d)
+      {
+        Texture texture;
+        texture.determineDeviceEncoding(formats[f].value, types[d].value);
+        const unsigned int hostEncoding = texture.determineHostEncoding(formats[f].value, types[s].value);
+
+        std::vector<unsigned char> src(VALIDATION_PIXELS * numberOfChannels(hostEncoding) * sizeOfType(types[s].value));
+        randomPixels(types[s].value, src, rng);
+
+        std::vector<unsigned char> reference(VALIDATION_PIXELS * texture.getElementSize(), 0xCD);
+        std::vector<unsigned char> result(reference.size(), 0xAB);
+
+        texture.convertGeneric(reference.data(), src.data(), VALIDATION_PIXELS, hostEncoding);
+        texture.convert(result.data(), src.data(), VALIDATION_PIXELS, hostEncoding);
+
+        if (memcmp(reference.data(), result.data(), reference.size()) != 0)
+        {
+          std::cerr << "ERROR: benchmarkConvert() " << formats[f].name << " " << types[s].name 
+                    << " to " << types[d].name << " differs from the generic remapper." << std::endl;
+          passed = false;
+        }
+      }
+    }
+  }
+
+  std::cout << "benchmarkConvert(): " << BENCHMARK_PIXELS << " pixels to RGBA of the same type, validation " << ((passed) ? "passed" : "FAILED") << std::endl;
+  std::cout << "  MB/s of device data: generic, convert, memcpy" << std::endl;
+
+  for (int f = 0; f < numFormats; ++f)
+  {
+    for (int t = 0; t < numTypes; ++t)
+    {
+      Texture texture;
+      texture.determineDeviceEncoding(formats[f].value, types[t].value);
+      const unsigned int hostEncoding = texture.determineHostEncoding(formats[f].value, types[t].value);
+
+      std::vector<unsigned char> src(size_t(BENCHMARK_PIXELS) * numberOfChannels(hostEncoding) * sizeOfType(types[t].value));
+      randomPixels(types[t].value, src, rng);
+
+      const size_t bytes = size_t(BENCHMARK_PIXELS) * texture.getElementSize();
+      std::vector<unsigned char> dst(bytes);
+
+      const double timeGeneric = bestTime([&]() { texture.convertGeneric(dst.data(), src.data(), BENCHMARK_PIXELS, hostEncoding); });
+      const double timeConvert = bestTime([&]() { texture.convert(dst.data(), src.data(), BENCHMARK_PIXELS, hostEncoding); });
+      // The reference is a plain copy of the device data size.
+      std::vector<unsigned char> copy(bytes);
+      const double timeMemcpy  = bestTime([&]() { memcpy(dst.data(), copy.data(), bytes); });
+
+      const double megabytes = double(bytes) / (1024.0 * 1024.0);
+
+      std::cout << "  " << formats[f].name << " " << types[t].name << ": " 
+                << megabytes / timeGeneric << ", " << megabytes / timeConvert << ", " << megabytes / timeMemcpy 
+                << " (speedup " << timeGeneric / timeConvert << ")" << std::endl;
+    }
+  }
+
+  return passed;
+}
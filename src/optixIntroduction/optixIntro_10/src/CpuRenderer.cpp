@@ -0,0 +1,834 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/CpuRenderer.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
+
+#include <IL/il.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// DAR Only for sutil::samplesDir() and the host side fork-join helpers.
+#include <sutil.h>
+#include <Parallel.h>
+
+#include "inc/Scene.h"
+#include "inc/Shapes.h"
+#include "inc/Texture.h"
+#include "inc/MyAssert.h"
+
+// The device functions of the BSDF, lens shader and light sampling callable programs, compiled as host code.
+#include "shaders/rt_function.h"
+#include "shaders/shader_common.h"
+#include "shaders/bsdf_functions.h"
+#include "shaders/lens_functions.h"
+#include "shaders/light_functions.h"
+#include "shaders/hit_functions.h"
+#include "shaders/miss_functions.h"
+#include "shaders/integrator_functions.h"
+
+// Width and height of the image tiles the worker threads fetch from a shared counter.
+// Small tiles keep all cores busy until the end of a launch, even when the path lengths differ a lot over the image.
+#define TILE_SIZE 16
+
+
+static optix::float3 transformPoint(optix::Matrix4x4 const& matrix, optix::float3 const& p)
+{
+  const float* m = matrix.getData();
+  return optix::make_float3(m[0] * p.x + m[1] * p.y + m[ 2] * p.z + m[ 3],
+                            m[4] * p.x + m[5] * p.y + m[ 6] * p.z + m[ 7],
+                            m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11]);
+}
+
+static optix::float3 transformVector(optix::Matrix4x4 const& matrix, optix::float3 const& v)
+{
+  const float* m = matrix.getData();
+  return optix::make_float3(m[0] * v.x + m[1] * v.y + m[ 2] * v.z,
+                            m[4] * v.x + m[5] * v.y + m[ 6] * v.z,
+                            m[8] * v.x + m[9] * v.y + m[10] * v.z);
+}
+
+// Same as rtTransformNormal(RT_OBJECT_TO_WORLD, n): Multiplication with the transposed inverse matrix.
+static optix::float3 transformNormal(optix::Matrix4x4 const& worldToObject, optix::float3 const& n)
+{
+  const float* m = worldToObject.getData();
+  return optix::make_float3(m[0] * n.x + m[4] * n.y + m[ 8] * n.z,
+                            m[1] * n.x + m[5] * n.y + m[ 9] * n.z,
+                            m[2] * n.x + m[6] * n.y + m[10] * n.z);
+}
+
+// Builds the object to world matrix from the 16 values of an RT_MOTIONKEYTYPE_SRT_FLOAT16 motion key:
+// sx, a, b, pvx, sy, c, pvy, sz, pvz, qx, qy, qz, qw, tx, ty, tz.
+static optix::Matrix4x4 matrixFromSRT(const float* key)
+{
+  const float sx  = key[0];
+  const float a   = key[1];
+  const float b   = key[2];
+  const float pvx = key[3];
+  const float sy  = key[4];
+  const float c   = key[5];
+  const float pvy = key[6];
+  const float sz  = key[7];
+  const float pvz = key[8];
+
+  float qx = key[9];
+  float qy = key[10];
+  float qz = key[11];
+  float qw = key[12];
+
+  const float len = sqrtf(qx * qx + qy * qy + qz * qz + qw * qw);
+  if (0.0f < len)
+  {
+    qx /= len;
+    qy /= len;
+    qz /= len;
+    qw /= len;
+  }
+
+  const float scale[16] =
+  {
+    sx,   a,    b,    pvx,
+    0.0f, sy,   c,    pvy,
+    0.0f, 0.0f, sz,   pvz,
+    0.0f, 0.0f, 0.0f, 1.0f
+  };
+
+  const float rotationTranslation[16] =
+  {
+    1.0f - 2.0f * (qy * qy + qz * qz), 2.0f * (qx * qy - qz * qw),        2.0f * (qx * qz + qy * qw),        key[13],
+    2.0f * (qx * qy + qz * qw),        1.0f - 2.0f * (qx * qx + qz * qz), 2.0f * (qy * qz - qx * qw),        key[14],
+    2.0f * (qx * qz - qy * qw),        2.0f * (qy * qz + qx * qw),        1.0f - 2.0f * (qx * qx + qy * qy), key[15],
+    0.0f,                              0.0f,                              0.0f,                              1.0f
+  };
+
+  return optix::Matrix4x4(rotationTranslation) * optix::Matrix4x4(scale);
+}
+
+
+CpuRenderer::CpuRenderer(const int width,
+                         const int height,
+                         const bool light,
+                         const unsigned int miss)
+: m_width(std::max(1, width))
+, m_height(std::max(1, height))
+, m_isValid(false)
+, m_light(light)
+, m_missID(miss)
+, m_minPathLength(2)
+, m_maxPathLength(6)
+, m_sceneEpsilonFactor(500)
+, m_cameraType(LENS_SHADER_PINHOLE)
+, m_shutterType(0)
+, m_iterationIndex(0)
+, m_tilesX(0)
+, m_tilesY(0)
+{
+  if (m_missID == 2)
+  {
+    std::cerr << "ERROR: CpuRenderer() The HDR environment light (miss 2) is not supported. Use miss 0 or 1." << std::endl;
+    return;
+  }
+
+  m_pinholeCamera.setViewport(m_width, m_height);
+  m_pinholeCamera.getFrustum(m_cameraPosition, m_cameraU, m_cameraV, m_cameraW);
+
+  m_outputBuffer.resize(m_width * m_height);
+
+  m_tilesX = (m_width  + TILE_SIZE - 1) / TILE_SIZE;
+  m_tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+
+  try
+  {
+    initMaterials();
+    createScene();
+
+    m_isValid = true;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "ERROR: CpuRenderer() " << e.what() << std::endl;
+  }
+}
+
+CpuRenderer::~CpuRenderer()
+{
+  for (size_t i = 0; i < m_geometries.size(); ++i)
+  {
+    delete m_geometries[i]->intersector;
+    delete m_geometries[i];
+  }
+}
+
+bool CpuRenderer::isValid() const
+{
+  return m_isValid;
+}
+
+const optix::float4* CpuRenderer::getOutputBuffer() const
+{
+  return m_outputBuffer.data();
+}
+
+
+bool CpuRenderer::createTexture(const Picture* picture, HostTexture& texture)
+{
+  const Image* image = picture->getImageFace(0, 0);
+  if (image == nullptr || image->m_depth != 1)
+  {
+    std::cerr << "ERROR: CpuRenderer::createTexture() Picture doesn't contain a 2D image for LOD 0 of face 0." << std::endl;
+    return false;
+  }
+
+  // Reuse the Texture pixel format conversion into the four component device formats. This doesn't create any OptiX objects.
+  Texture converter;
+
+  const unsigned int hostEncoding = converter.determineHostEncoding(image->m_format, image->m_type);
+  if (!converter.determineDeviceEncoding(image->m_format, image->m_type))
+  {
+    return false;
+  }
+
+  const size_t count = size_t(image->m_width) * image->m_height;
+
+  std::vector<unsigned char> data(count * converter.getElementSize());
+  converter.convert(data.data(), image->m_pixels, count, hostEncoding);
+
+  texture.width  = image->m_width;
+  texture.height = image->m_height;
+  texture.texels.resize(count);
+
+  // Apply the read mode the Texture class selects: Normalized float for the fixed point formats, element type for float.
+  for (size_t i = 0; i < count; ++i)
+  {
+    optix::float4& texel = texture.texels[i];
+
+    switch (image->m_type)
+    {
+      case IL_UNSIGNED_BYTE:
+      {
+        const unsigned char* c = data.data() + i * 4;
+        texel = optix::make_float4(c[0], c[1], c[2], c[3]) / 255.0f;
+        break;
+      }
+      case IL_UNSIGNED_SHORT:
+      {
+        const unsigned short* c = reinterpret_cast<const unsigned short*>(data.data()) + i * 4;
+        texel = optix::make_float4(c[0], c[1], c[2], c[3]) / 65535.0f;
+        break;
+      }
+      case IL_FLOAT:
+        texel = reinterpret_cast<const optix::float4*>(data.data())[i];
+        break;
+      default:
+        std::cerr << "ERROR: CpuRenderer::createTexture() Unsupported image data type." << std::endl;
+        return false;
+    }
+  }
+  return true;
+}
+
+// Bilinear filtering with wrap mode repeat and normalized coordinates, the texture sampler settings of Texture::createSampler().
+optix::float4 CpuRenderer::tex2D(const int id, const float u, const float v) const
+{
+  HostTexture const& texture = m_textures[id - 1];
+
+  const float x = (u - floorf(u)) * float(texture.width)  - 0.5f;
+  const float y = (v - floorf(v)) * float(texture.height) - 0.5f;
+
+  const float fx = floorf(x);
+  const float fy = floorf(y);
+  const float wx = x - fx;
+  const float wy = y - fy;
+
+  const int w = int(texture.width);
+  const int h = int(texture.height);
+
+  const int x0 = (int(fx) + w) % w;
+  const int y0 = (int(fy) + h) % h;
+  const int x1 = (x0 + 1) % w;
+  const int y1 = (y0 + 1) % h;
+
+  const optix::float4 t00 = texture.texels[y0 * w + x0];
+  const optix::float4 t10 = texture.texels[y0 * w + x1];
+  const optix::float4 t01 = texture.texels[y1 * w + x0];
+  const optix::float4 t11 = texture.texels[y1 * w + x1];
+
+  return optix::lerp(optix::lerp(t00, t10, wx), optix::lerp(t01, t11, wx), wy);
+}
+
+
+// Same materials as Application::initMaterials() and Application::updateMaterialParameters().
+void CpuRenderer::initMaterials()
+{
+  Picture* picture = new Picture;
+
+  HostTexture textureAlbedo;
+  std::string textureFilename = std::string(sutil::samplesDir()) + SCENE_TEXTURE_ALBEDO;
+  if (!picture->load(textureFilename) || !createTexture(picture, textureAlbedo))
+  {
+    delete picture;
+    throw std::runtime_error("Could not load " + textureFilename);
+  }
+  m_textures.push_back(textureAlbedo);
+  const int idAlbedo = int(m_textures.size());
+
+  HostTexture textureCutout;
+  textureFilename = std::string(sutil::samplesDir()) + SCENE_TEXTURE_CUTOUT;
+  if (!picture->load(textureFilename) || !createTexture(picture, textureCutout))
+  {
+    delete picture;
+    throw std::runtime_error("Could not load " + textureFilename);
+  }
+  m_textures.push_back(textureCutout);
+  const int idCutout = int(m_textures.size());
+
+  delete picture;
+
+  std::vector<MaterialParameterGUI> materials;
+  initSceneMaterials(materials);
+
+  m_materialParameters.resize(materials.size());
+  for (size_t i = 0; i < materials.size(); ++i)
+  {
+    convertMaterialParameter(materials[i], idAlbedo, idCutout, m_materialParameters[i]);
+  }
+}
+
+
+// Mirrors Application::createGeometry(), including the compact vertex attributes round trip, and builds the BVH.
+CpuRenderer::HostGeometry* CpuRenderer::createGeometry(std::vector<VertexAttributes> const& attributes, std::vector<unsigned int> const& indices)
+{
+  HostGeometry* geometry = new HostGeometry;
+  m_geometries.push_back(geometry);
+
+  geometry->positions.resize(attributes.size());
+  geometry->attributes.resize(attributes.size());
+
+  for (size_t i = 0; i < attributes.size(); ++i)
+  {
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+    packVertexAttributes(attributes[i], geometry->positions[i], geometry->attributes[i]);
+#else
+    geometry->positions[i]  = attributes[i].vertex;
+    geometry->attributes[i] = attributes[i];
+#endif
+  }
+
+  geometry->indices = indices;
+
+  MY_ASSERT(sizeof(optix::float3) == 12);
+  geometry->bvh.build(&geometry->positions[0].x, int32_t(geometry->positions.size()), sizeof(optix::float3),
+                      reinterpret_cast<const int32_t*>(geometry->indices.data()), int32_t(geometry->indices.size() / 3));
+
+  geometry->intersector = new BvhIntersector(geometry->bvh, &geometry->positions[0].x, sizeof(optix::float3),
+                                             reinterpret_cast<const int32_t*>(geometry->indices.data()));
+  return geometry;
+}
+
+void CpuRenderer::addInstance(const HostGeometry* geometry, const int materialIndex, const int lightIndex, optix::Matrix4x4 const& objectToWorld)
+{
+  HostInstance instance;
+
+  instance.geometry      = geometry;
+  instance.materialIndex = materialIndex;
+  instance.lightIndex    = lightIndex;
+  instance.cutout        = (0 <= materialIndex && m_materialParameters[materialIndex].cutoutID != RT_TEXTURE_ID_NULL);
+  instance.motion        = false;
+  instance.objectToWorld = objectToWorld;
+  instance.worldToObject = objectToWorld.inverse();
+
+  m_instances.push_back(instance);
+}
+
+
+// Same objects as Application::createScene(). Every Transform with its GeometryGroup becomes one HostInstance.
+void CpuRenderer::createScene()
+{
+  std::vector<SceneObject> objects;
+  createSceneObjects(objects);
+
+  for (size_t i = 0; i < objects.size(); ++i)
+  {
+    SceneObject const& object = objects[i];
+
+    addInstance(createGeometry(object.attributes, object.indices), object.materialIndex, -1, optix::Matrix4x4(object.matrix));
+
+    if (object.motion)
+    {
+      HostInstance& instance = m_instances.back();
+      instance.motion = true;
+      memcpy(instance.keysSRT, object.keysSRT, sizeof(instance.keysSRT));
+    }
+  }
+
+  createLights();
+
+  size_t triangles = 0;
+  for (size_t i = 0; i < m_instances.size(); ++i)
+  {
+    triangles += m_instances[i].geometry->indices.size() / 3;
+  }
+  std::cout << "CpuRenderer::createScene(): Instances = " << m_instances.size() << ", Triangles = " << triangles << std::endl;
+}
+
+// Same lights as Application::createLights() for the black and the constant white environment.
+void CpuRenderer::createLights()
+{
+  LightDefinition light;
+
+  initLightDefinition(light);
+
+  // The environment light is expected in m_lightDefinitions[0]!
+  if (m_missID == 1) // Constant environment light.
+  {
+    light.type = LIGHT_ENVIRONMENT;
+    light.area = 4.0f * M_PIf; // Unused.
+
+    m_lightDefinitions.push_back(light);
+  }
+
+  if (m_light)  // Add a square area light over the scene objects.
+  {
+    initAreaLight(light);
+
+    const int lightIndex = int(m_lightDefinitions.size());
+    m_lightDefinitions.push_back(light);
+
+    std::vector<VertexAttributes> attributes;
+    std::vector<unsigned int>     indices;
+
+    generateParallelogram(light.position, light.vecU, light.vecV, light.normal, attributes, indices);
+
+    // Area lights are defined in world space.
+    addInstance(createGeometry(attributes, indices), -1, lightIndex, optix::Matrix4x4::identity());
+  }
+}
+
+
+optix::Matrix4x4 CpuRenderer::getWorldToObject(HostInstance const& instance, const float time) const
+{
+  if (!instance.motion)
+  {
+    return instance.worldToObject;
+  }
+
+  // The motion range is [0.0f, 1.0f] with two keys. All SRT components are interpolated linearly, the quaternion is renormalized.
+  const float t = optix::clamp(time, 0.0f, 1.0f);
+
+  float key[16];
+  for (int i = 0; i < 16; ++i)
+  {
+    key[i] = optix::lerp(instance.keysSRT[0][i], instance.keysSRT[1][i], t);
+  }
+  return matrixFromSRT(key).inverse();
+}
+
+// Same as the intersection program: Barycentric interpolation of the (decoded) vertex attributes in object space.
+void CpuRenderer::getAttributes(HostGeometry const& geometry, const int primitiveIndex, const float beta, const float gamma, HostHitRecord& hit) const
+{
+  const unsigned int* tri = &geometry.indices[primitiveIndex * 3];
+
+#if USE_COMPACT_VERTEX_ATTRIBUTES
+  const VertexAttributes a0 = unpackVertexAttributes(geometry.positions[tri[0]], geometry.attributes[tri[0]]);
+  const VertexAttributes a1 = unpackVertexAttributes(geometry.positions[tri[1]], geometry.attributes[tri[1]]);
+  const VertexAttributes a2 = unpackVertexAttributes(geometry.positions[tri[2]], geometry.attributes[tri[2]]);
+#else
+  VertexAttributes const& a0 = geometry.attributes[tri[0]];
+  VertexAttributes const& a1 = geometry.attributes[tri[1]];
+  VertexAttributes const& a2 = geometry.attributes[tri[2]];
+#endif
+
+  const float alpha = 1.0f - beta - gamma;
+
+  hit.normal   = a0.normal   * alpha + a1.normal   * beta + a2.normal   * gamma;
+  hit.texcoord = a0.texcoord * alpha + a1.texcoord * beta + a2.texcoord * gamma;
+}
+
+// The platform specific parts of the shared closest hit and cutout opacity bodies in hit_functions.h.
+struct CpuRenderer::HostProgram
+{
+  HostProgram(CpuRenderer const& renderer, const float time)
+  : renderer(renderer)
+  , time(time)
+  {
+  }
+
+  optix::float4 tex2D(const int id, const float u, const float v) const
+  {
+    return renderer.tex2D(id, u, v);
+  }
+
+  // sysSampleBSDF[parameters.indexBSDF]
+  void sampleBSDF(MaterialParameter const& parameters, State const& state, PerRayData& prd) const
+  {
+    switch (parameters.indexBSDF)
+    {
+      case INDEX_BSDF_DIFFUSE_REFLECTION:
+        sampleDiffuseReflection(parameters, state, prd);
+        break;
+      case INDEX_BSDF_SPECULAR_REFLECTION:
+        sampleSpecularReflection(parameters, state, prd);
+        break;
+      case INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION:
+        sampleSpecularReflectionTransmission(parameters, state, prd);
+        break;
+      default:
+        MY_ASSERT(!"Unknown BSDF index");
+        break;
+    }
+  }
+
+  // sysEvalBSDF[parameters.indexBSDF]. The specular BSDFs share the black eval_bsdf_specular_reflection program.
+  optix::float4 evalBSDF(MaterialParameter const& parameters, State const& state, PerRayData const& prd, optix::float3 const& wiL) const
+  {
+    if (parameters.indexBSDF == INDEX_BSDF_DIFFUSE_REFLECTION)
+    {
+      return evalDiffuseReflection(parameters, state, prd, wiL);
+    }
+    return evalSpecularReflection(parameters, state, prd, wiL);
+  }
+
+  int getNumLights() const
+  {
+    return int(renderer.m_lightDefinitions.size());
+  }
+
+  // sysSampleLight[lightType]
+  void sampleLight(optix::float3 const& point, const optix::float2 sample, LightSample& lightSample) const
+  {
+    LightDefinition const& light = renderer.m_lightDefinitions[lightSample.index];
+
+    lightSample.pdf = 0.0f;
+    switch (light.type)
+    {
+      case LIGHT_ENVIRONMENT:
+        sampleLightConstant(getNumLights(), sample, lightSample);
+        break;
+      case LIGHT_PARALLELOGRAM:
+        sampleLightParallelogram(light, getNumLights(), point, sample, lightSample);
+        break;
+    }
+  }
+
+  float getSceneEpsilon() const
+  {
+    return renderer.m_sceneEpsilonFactor * 1e-7f;
+  }
+
+  bool traceShadow(optix::float3 const& origin, optix::float3 const& direction, const float tmin, const float tmax, unsigned int& seed) const
+  {
+    return renderer.traceShadow(origin, direction, tmin, tmax, time, seed);
+  }
+
+  CpuRenderer const& renderer;
+  const float        time; // rtCurrentTime
+};
+
+// The rtTrace() of the shared integrator() in integrator_functions.h.
+struct CpuRenderer::HostTraceRadiance
+{
+  explicit HostTraceRadiance(CpuRenderer const& renderer)
+  : renderer(renderer)
+  {
+  }
+
+  void operator()(optix::float3 const& origin, optix::float3 const& direction, const float time, PerRayData& prd) const
+  {
+    renderer.traceRadiance(origin, direction, renderer.m_sceneEpsilonFactor * 1e-7f, prd.distance, time, prd);
+  }
+
+  CpuRenderer const& renderer;
+};
+
+
+// The stochastic alpha test of the anyhit_cutout and anyhit_shadow_cutout programs.
+bool CpuRenderer::isCutoutIgnored(HostInstance const& instance, optix::float3 const& texcoord, const float time, unsigned int& seed) const
+{
+  return ::isCutoutIgnored(HostProgram(*this, time), m_materialParameters[instance.materialIndex].cutoutID, texcoord, seed);
+}
+
+// The closest accepted hit over all instances in the open interval (tmin, tmax).
+// Instances are tested one after the other, there are only a handful of them in this scene.
+bool CpuRenderer::intersectScene(optix::float3 const& origin, optix::float3 const& direction, const float tmin, const float tmax, const float time,
+                                 unsigned int& seed, HostHitRecord& hit) const
+{
+  bool isHit = false;
+  float tClosest = tmax;
+
+  for (size_t i = 0; i < m_instances.size(); ++i)
+  {
+    HostInstance const& instance = m_instances[i];
+
+    const optix::Matrix4x4 worldToObject = getWorldToObject(instance, time);
+
+    // The object space direction is not normalized, so that the intersection distances stay in world space units.
+    const optix::float3 o = transformPoint(worldToObject, origin);
+    const optix::float3 d = transformVector(worldToObject, direction);
+
+    HostRay ray = { { o.x, o.y, o.z }, tmin, { d.x, d.y, d.z }, tClosest };
+    HostHit hostHit;
+
+    for (;;)
+    {
+      instance.geometry->intersector->intersect(ray, hostHit);
+      if (hostHit.prim_index < 0)
+      {
+        break;
+      }
+
+      HostHitRecord candidate;
+      getAttributes(*instance.geometry, hostHit.prim_index, hostHit.beta, hostHit.gamma, candidate);
+
+      // rtIgnoreIntersection() continues the traversal behind the ignored hit.
+      if (instance.cutout && isCutoutIgnored(instance, candidate.texcoord, time, seed))
+      {
+        ray.tmin = hostHit.t;
+        continue;
+      }
+
+      isHit    = true;
+      tClosest = hostHit.t;
+
+      hit = candidate;
+      hit.instance      = &instance;
+      hit.worldToObject = worldToObject;
+      hit.t             = hostHit.t;
+      hit.geoNormal     = optix::make_float3(hostHit.geometric_normal[0], hostHit.geometric_normal[1], hostHit.geometric_normal[2]);
+      break;
+    }
+  }
+  return isHit;
+}
+
+
+void CpuRenderer::traceRadiance(optix::float3 const& origin, optix::float3 const& direction, const float tmin, const float tmax, const float time, PerRayData& prd) const
+{
+  HostHitRecord hit;
+
+  if (!intersectScene(origin, direction, tmin, tmax, time, prd.seed, hit))
+  {
+    miss(prd);
+  }
+  else if (0 <= hit.instance->lightIndex)
+  {
+    closesthitLight(hit, origin, direction, prd);
+  }
+  else
+  {
+    closesthit(hit, origin, direction, time, prd);
+  }
+}
+
+// Returns true when nothing blocks the shadow ray. All geometry is opaque for shadow rays except for the cutout opacity.
+bool CpuRenderer::traceShadow(optix::float3 const& origin, optix::float3 const& direction, const float tmin, const float tmax, const float time, unsigned int& seed) const
+{
+  HostHitRecord hit;
+
+  return !intersectScene(origin, direction, tmin, tmax, time, seed, hit);
+}
+
+
+// closesthit.cu
+void CpuRenderer::closesthit(HostHitRecord const& hit, optix::float3 const& origin, optix::float3 const& direction, const float time, PerRayData& prd) const
+{
+  State state; // All in world space coordinates!
+
+  state.geoNormal = optix::normalize(transformNormal(hit.worldToObject, hit.geoNormal));
+  state.normal    = optix::normalize(transformNormal(hit.worldToObject, hit.normal));
+  state.texcoord  = hit.texcoord;
+
+  closesthitMaterial(HostProgram(*this, time), m_materialParameters[hit.instance->materialIndex], state, origin, direction, hit.t, prd);
+}
+
+// closesthit_light.cu
+void CpuRenderer::closesthitLight(HostHitRecord const& hit, optix::float3 const& origin, optix::float3 const& direction, PerRayData& prd) const
+{
+  const optix::float3 geoNormal = optix::normalize(transformNormal(hit.worldToObject, hit.geoNormal));
+
+  ::closesthitLight(m_lightDefinitions[hit.instance->lightIndex], geoNormal, origin, direction, hit.t, prd);
+}
+
+// miss_environment_null() and miss_environment_constant() in miss.cu
+void CpuRenderer::miss(PerRayData& prd) const
+{
+  if (m_missID == 0)
+  {
+    missEnvironmentNull(prd);
+  }
+  else
+  {
+    missEnvironmentConstant(prd);
+  }
+}
+
+
+// Mirrors raygeneration() in raygeneration.cu for all pixels of one tile.
+void CpuRenderer::renderTile(const unsigned int tile)
+{
+  const unsigned int x0 = (tile % m_tilesX) * TILE_SIZE;
+  const unsigned int y0 = (tile / m_tilesX) * TILE_SIZE;
+  const unsigned int x1 = std::min(x0 + TILE_SIZE, (unsigned int) m_width);
+  const unsigned int y1 = std::min(y0 + TILE_SIZE, (unsigned int) m_height);
+
+  const optix::float2 screen = optix::make_float2(float(m_width), float(m_height));
+
+  for (unsigned int y = y0; y < y1; ++y)
+  {
+    for (unsigned int x = x0; x < x1; ++x)
+    {
+      PerRayData prd;
+
+      // Initialize the random number generator seed from the linear pixel index and the iteration index.
+      prd.seed = tea<8>(y * m_width + x, m_iterationIndex);
+
+      const optix::float2 pixel  = optix::make_float2(float(x), float(y));
+      const optix::float2 sample = rng2(prd.seed);
+
+      // sysLensShader[sysCameraType]
+      switch (m_cameraType)
+      {
+        case LENS_SHADER_PINHOLE:
+          lensPinhole(m_cameraPosition, m_cameraU, m_cameraV, m_cameraW, pixel, screen, sample, prd.pos, prd.wi);
+          break;
+        case LENS_SHADER_FISHEYE:
+          lensFisheye(m_cameraPosition, m_cameraU, m_cameraV, m_cameraW, pixel, screen, sample, prd.pos, prd.wi);
+          break;
+        case LENS_SHADER_SPHERE:
+          lensSphere(m_cameraPosition, m_cameraU, m_cameraV, m_cameraW, pixel, screen, sample, prd.pos, prd.wi);
+          break;
+      }
+
+      optix::float3 radiance;
+#if USE_DENOISER
+#if USE_DENOISER_ALBEDO
+      optix::float3 albedo; // There is no denoiser on the host, the albedo is discarded.
+#if USE_DENOISER_NORMAL
+      optix::float3 normal;
+#endif
+#endif
+#endif
+
+      integrator(HostTraceRadiance(*this), optix::make_uint2(x, y), optix::make_uint2(m_width, m_height),
+                 optix::make_int2(m_minPathLength, m_maxPathLength), m_shutterType, prd, radiance
+#if USE_DENOISER
+#if USE_DENOISER_ALBEDO
+                , albedo
+#if USE_DENOISER_NORMAL
+                , m_cameraU, m_cameraV, m_cameraW, normal
+#endif
+#endif
+#endif
+      );
+
+      // NaN values will never go away. Filter them out before they can arrive in the output buffer.
+      if (std::isnan(radiance.x) || std::isnan(radiance.y) || std::isnan(radiance.z))
+      {
+        continue;
+      }
+
+      optix::float4& dst = m_outputBuffer[y * m_width + x];
+
+      if (0 < m_iterationIndex)
+      {
+        const float t = 1.0f / (float) (m_iterationIndex + 1);
+
+        dst = optix::make_float4(optix::lerp(optix::make_float3(dst), radiance, t), 1.0f);
+      }
+      else
+      {
+        // m_iterationIndex 0 will fill the buffer.
+        dst = optix::make_float4(radiance, 1.0f);
+      }
+    }
+  }
+}
+
+void CpuRenderer::render()
+{
+  if (!m_isValid)
+  {
+    return;
+  }
+
+  // The worker threads keep fetching the next unrendered tile until all are done.
+  // That balances the load dynamically like work stealing, but the tiles are all the same size, so a single shared counter is enough.
+  const unsigned int numTiles = m_tilesX * m_tilesY;
+
+  std::atomic<unsigned int> nextTile(0);
+
+  sutil::parallelFor(sutil::numThreads(), 1, [&](size_t, size_t, size_t)
+  {
+    for (unsigned int tile = nextTile++; tile < numTiles; tile = nextTile++)
+    {
+      renderTile(tile);
+    }
+  });
+
+  ++m_iterationIndex;
+}
+
+bool CpuRenderer::screenshot(std::string const& filename) const
+{
+  ILuint imageID;
+
+  ilGenImages(1, (ILuint *) &imageID);
+  ilBindImage(imageID);
+
+  // The first row of the output buffer is the bottom of the image.
+  ilEnable(IL_ORIGIN_SET);
+  ilOriginFunc(IL_ORIGIN_LOWER_LEFT);
+
+  bool success = ilTexImage(m_width, m_height, 1, 4, IL_RGBA, IL_FLOAT, const_cast<optix::float4*>(m_outputBuffer.data())) == IL_TRUE;
+  if (success)
+  {
+    ilEnable(IL_FILE_OVERWRITE);
+    success = ilSaveImage((const ILstring) filename.c_str()) == IL_TRUE;
+  }
+
+  ilDeleteImages(1, &imageID);
+
+  if (success)
+  {
+    std::cerr << "Wrote " << filename << std::endl;
+  }
+  else
+  {
+    std::cerr << "ERROR: CpuRenderer::screenshot() Could not write " << filename << std::endl;
+  }
+  return success;
+}
@@ -0,0 +1,314 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/EnvironmentCache.h"
+
+#include "inc/Texture.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+
+// File layout.
+static const char     CACHE_MAGIC[8]  = { 'O', 'P', 'T', 'I', 'X', 'E', 'N', 'V' };
+static const uint32_t CACHE_VERSION   = 2; // 2: Source resolution in the header. Version 1 files could hold a downsampled preview.
+static const uint64_t CACHE_ALIGNMENT = 4096; // Every section starts on a page boundary.
+
+enum CacheSection
+{
+  SECTION_TEXELS = 0,
+  SECTION_CDF_U,
+  SECTION_CDF_V,
+  SECTION_ALIAS_U, // Empty when the texture had no alias tables.
+  SECTION_ALIAS_V,
+  NUM_SECTIONS
+};
+
+struct CacheHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t headerSize;
+  uint32_t width;
+  uint32_t height;
+  float    integral;
+  uint32_t hasAlias;
+  uint32_t sourceWidth; // Resolution stored in the source image, must match width and height.
+  uint32_t sourceHeight;
+  uint64_t sourceSize; // Stamp of the source image.
+  int64_t  sourceTime;
+  uint64_t sourceHash;
+  uint64_t fileSize;
+  uint64_t offset[NUM_SECTIONS];
+  uint64_t size[NUM_SECTIONS];
+};
+
+
+static uint64_t alignUp(const uint64_t x)
+{
+  return (x + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+}
+
+// Expected section sizes for the given resolution.
+static void sectionSizes(const uint64_t width, const uint64_t height, const bool hasAlias, uint64_t* size)
+{
+  size[SECTION_TEXELS]  = width * height * 4 * sizeof(float);
+  size[SECTION_CDF_U]   = (width + 1) * height * sizeof(float);
+  size[SECTION_CDF_V]   = (height + 1) * sizeof(float);
+  size[SECTION_ALIAS_U] = (hasAlias) ? width * height * sizeof(optix::float2) : 0;
+  size[SECTION_ALIAS_V] = (hasAlias) ? height * sizeof(optix::float2) : 0;
+}
+
+
+EnvironmentCache::EnvironmentCache()
+{
+}
+
+EnvironmentCache::~EnvironmentCache()
+{
+  close();
+}
+
+std::string EnvironmentCache::cacheFilename(std::string const& source)
+{
+  return source + ".envcache";
+}
+
+bool EnvironmentCache::write(std::string const& source, Texture const& texture, unsigned int sourceWidth, unsigned int sourceHeight)
+{
+  const uint64_t width  = texture.getWidth();
+  const uint64_t height = texture.getHeight();
+
+  // A downsampled image would be mapped as the full environment by later runs.
+  if (width != sourceWidth || height != sourceHeight)
+  {
+    return false;
+  }
+
+  const bool hasAlias = !texture.getAlias_U().empty();
+
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+
+  sectionSizes(width, height, hasAlias, header.size);
+
+  // Only complete host data can be cached, not after uploadEnvironment() cleared it.
+  if (texture.getTexels().size() * sizeof(float) != header.size[SECTION_TEXELS] ||
+      texture.getCDF_U().size()  * sizeof(float) != header.size[SECTION_CDF_U]  ||
+      texture.getCDF_V().size()  * sizeof(float) != header.size[SECTION_CDF_V]  ||
+      texture.getAlias_U().size() * sizeof(optix::float2) != header.size[SECTION_ALIAS_U] ||
+      texture.getAlias_V().size() * sizeof(optix::float2) != header.size[SECTION_ALIAS_V])
+  {
+    return false;
+  }
+
+  if (!MappedFile::stat(source, header.sourceSize, header.sourceTime) ||
+      !MappedFile::hash(source, header.sourceHash))
+  {
+    return false;
+  }
+
+  memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version      = CACHE_VERSION;
+  header.headerSize   = sizeof(CacheHeader);
+  header.width        = texture.getWidth();
+  header.height       = texture.getHeight();
+  header.integral     = texture.getIntegral();
+  header.hasAlias     = (hasAlias) ? 1 : 0;
+  header.sourceWidth  = sourceWidth;
+  header.sourceHeight = sourceHeight;
+
+  const char* data[NUM_SECTIONS] =
+  {
+    reinterpret_cast<const char*>(texture.getTexels().data()),
+    reinterpret_cast<const char*>(texture.getCDF_U().data()),
+    reinterpret_cast<const char*>(texture.getCDF_V().data()),
+    reinterpret_cast<const char*>(texture.getAlias_U().data()),
+    reinterpret_cast<const char*>(texture.getAlias_V().data())
+  };
+
+  uint64_t offset = alignUp(sizeof(CacheHeader));
+  for (int s = 0; s < NUM_SECTIONS; ++s)
+  {
+    header.offset[s] = offset;
+    offset = alignUp(offset + header.size[s]);
+  }
+  header.fileSize = offset;
+
+  // Write to a temporary file first so that concurrent readers never see a partially written cache.
+  const std::string filename    = cacheFilename(source);
+  const std::string filenameTmp = filename + ".tmp";
+  {
+    std::ofstream out(filenameTmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      return false;
+    }
+
+    const std::vector<char> padding(CACHE_ALIGNMENT, 0);
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t pos = sizeof(header);
+    for (int s = 0; s < NUM_SECTIONS; ++s)
+    {
+      out.write(padding.data(), static_cast<std::streamsize>(header.offset[s] - pos));
+      if (header.size[s])
+      {
+        out.write(data[s], static_cast<std::streamsize>(header.size[s]));
+      }
+      pos = header.offset[s] + header.size[s];
+    }
+    out.write(padding.data(), static_cast<std::streamsize>(header.fileSize - pos));
+
+    if (!out)
+    {
+      out.close();
+      remove(filenameTmp.c_str());
+      return false;
+    }
+  }
+
+  remove(filename.c_str());
+  if (rename(filenameTmp.c_str(), filename.c_str()) != 0)
+  {
+    remove(filenameTmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool EnvironmentCache::clear(std::string const& source)
+{
+  return remove(cacheFilename(source).c_str()) == 0;
+}
+
+bool EnvironmentCache::open(std::string const& source, bool aliasTables)
+{
+  close();
+
+  if (!m_file.open(cacheFilename(source)))
+  {
+    return false;
+  }
+
+  const CacheHeader& header = *reinterpret_cast<const CacheHeader*>(m_file.data());
+
+  bool valid = sizeof(CacheHeader) <= m_file.size() &&
+               memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+               header.version    == CACHE_VERSION       &&
+               header.headerSize == sizeof(CacheHeader) &&
+               header.fileSize   == m_file.size()       &&
+               header.width      == header.sourceWidth  &&
+               header.height     == header.sourceHeight &&
+               (header.hasAlias || !aliasTables);
+
+  if (valid)
+  {
+    uint64_t size[NUM_SECTIONS];
+    sectionSizes(header.width, header.height, header.hasAlias != 0, size);
+
+    for (int s = 0; valid && s < NUM_SECTIONS; ++s)
+    {
+      valid = header.size[s] == size[s] && header.offset[s] <= header.fileSize && header.size[s] <= header.fileSize - header.offset[s];
+    }
+  }
+
+  // Compare the source stamp against the file on disk. The hash reads the whole source, but is still much cheaper than decoding it.
+  if (valid)
+  {
+    uint64_t size;
+    int64_t  time;
+    uint64_t hash;
+    valid = MappedFile::stat(source, size, time) && size == header.sourceSize && time == header.sourceTime &&
+            MappedFile::hash(source, hash) && hash == header.sourceHash;
+  }
+
+  if (!valid)
+  {
+    close();
+  }
+  return valid;
+}
+
+void EnvironmentCache::close()
+{
+  m_file.close();
+}
+
+bool EnvironmentCache::isOpen() const
+{
+  return m_file.isOpen();
+}
+
+const char* EnvironmentCache::getSection(int section) const
+{
+  const CacheHeader& header = *reinterpret_cast<const CacheHeader*>(m_file.data());
+  return (header.size[section]) ? m_file.data() + header.offset[section] : nullptr;
+}
+
+unsigned int EnvironmentCache::getWidth() const
+{
+  return reinterpret_cast<const CacheHeader*>(m_file.data())->width;
+}
+
+unsigned int EnvironmentCache::getHeight() const
+{
+  return reinterpret_cast<const CacheHeader*>(m_file.data())->height;
+}
+
+float EnvironmentCache::getIntegral() const
+{
+  return reinterpret_cast<const CacheHeader*>(m_file.data())->integral;
+}
+
+const float* EnvironmentCache::getTexels() const
+{
+  return reinterpret_cast<const float*>(getSection(SECTION_TEXELS));
+}
+
+const float* EnvironmentCache::getCDF_U() const
+{
+  return reinterpret_cast<const float*>(getSection(SECTION_CDF_U));
+}
+
+const float* EnvironmentCache::getCDF_V() const
+{
+  return reinterpret_cast<const float*>(getSection(SECTION_CDF_V));
+}
+
+const optix::float2* EnvironmentCache::getAlias_U() const
+{
+  return reinterpret_cast<const optix::float2*>(getSection(SECTION_ALIAS_U));
+}
+
+const optix::float2* EnvironmentCache::getAlias_V() const
+{
+  return reinterpret_cast<const optix::float2*>(getSection(SECTION_ALIAS_V));
+}
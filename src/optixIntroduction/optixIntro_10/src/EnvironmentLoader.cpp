@@ -0,0 +1,201 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/EnvironmentLoader.h"
+#include "inc/EnvironmentCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+// DAR Thread-safe Radiance HDR decoder with a fast preview mode.
+#include <HDRLoader.h>
+
+#include "inc/MyAssert.h"
+
+// Maximum width of the preview environment. Its size is independent of the full resolution image.
+#define ENVIRONMENT_PREVIEW_WIDTH 512
+
+
+// The HDRLoader returns the top row first, the environment textures expect the bottom row first like DevIL loads them.
+static void mirrorRows(float* rgba, const unsigned int width, const unsigned int height)
+{
+  const size_t stride = size_t(width) * 4;
+
+  for (unsigned int y = 0; y < height / 2; ++y)
+  {
+    std::swap_ranges(rgba + y * stride, rgba + (y + 1) * stride, rgba + (height - 1 - y) * stride);
+  }
+}
+
+
+EnvironmentLoader::EnvironmentLoader()
+: m_ready(false)
+, m_loading(false)
+, m_writeCache(false)
+, m_texture(nullptr)
+, m_timePreviewDecode(0.0)
+, m_timePreviewCDF(0.0)
+, m_timeDecode(0.0)
+, m_timeCDF(0.0)
+, m_timeCache(0.0)
+{
+}
+
+EnvironmentLoader::~EnvironmentLoader()
+{
+  if (m_thread.joinable())
+  {
+    m_thread.join();
+  }
+  delete m_texture;
+}
+
+bool EnvironmentLoader::isSupported(std::string const& filename)
+{
+  std::string::size_type last = filename.find_last_of('.');
+  if (last == std::string::npos)
+  {
+    return false;
+  }
+  std::string ext = filename.substr(last, std::string::npos);
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return std::tolower(c); });
+
+  return (ext == std::string(".hdr"));
+}
+
+bool EnvironmentLoader::start(std::string const& filename, Texture& preview, bool writeCache)
+{
+  MY_ASSERT(!m_loading);
+
+  m_filename   = filename;
+  m_writeCache = writeCache;
+  m_timer.restart();
+
+  HDRLoader hdr(filename, false, ENVIRONMENT_PREVIEW_WIDTH);
+  if (hdr.failed())
+  {
+    return false;
+  }
+  mirrorRows(hdr.raster(), hdr.width(), hdr.height());
+  m_timePreviewDecode = m_timer.getTime();
+
+  preview.createEnvironment(hdr.raster(), hdr.width(), hdr.height());
+  preview.calculateCDF();
+  m_timePreviewCDF = m_timer.getTime();
+
+  std::cout << "EnvironmentLoader::start(): Preview " << hdr.width() << " x " << hdr.height()
+            << ", decode = " << m_timePreviewDecode << " seconds, CDF = " << m_timePreviewCDF - m_timePreviewDecode << " seconds" << std::endl;
+
+  // Images which didn't need to be downsampled are already complete.
+  if (hdr.width() == hdr.sourceWidth())
+  {
+    if (m_writeCache)
+    {
+      EnvironmentCache::write(m_filename, preview, hdr.sourceWidth(), hdr.sourceHeight());
+    }
+    return true;
+  }
+
+  m_ready   = false;
+  m_loading = true;
+  m_thread  = std::thread(&EnvironmentLoader::load, this);
+
+  return true;
+}
+
+bool EnvironmentLoader::isLoading() const
+{
+  return m_loading;
+}
+
+bool EnvironmentLoader::isReady() const
+{
+  return m_loading && m_ready;
+}
+
+Texture* EnvironmentLoader::take()
+{
+  if (!m_loading)
+  {
+    return nullptr;
+  }
+
+  m_thread.join();
+  m_loading = false;
+
+  Texture* texture = m_texture;
+  m_texture = nullptr;
+
+  if (texture)
+  {
+    std::cout << "EnvironmentLoader::take(): Full resolution " << texture->getWidth() << " x " << texture->getHeight()
+              << ", decode = " << m_timeDecode - m_timePreviewCDF << " seconds, CDF = " << m_timeCDF - m_timeDecode
+              << " seconds, cache write = " << m_timeCache - m_timeCDF << " seconds, ready after " << m_timeCache << " seconds" << std::endl;
+  }
+  else
+  {
+    std::cerr << "ERROR: EnvironmentLoader::take() Loading " << m_filename << " failed. Keeping the preview." << std::endl;
+  }
+  return texture;
+}
+
+void EnvironmentLoader::load()
+{
+  Texture* texture = nullptr;
+
+  try
+  {
+    HDRLoader hdr(m_filename);
+    if (!hdr.failed())
+    {
+      mirrorRows(hdr.raster(), hdr.width(), hdr.height());
+      m_timeDecode = m_timer.getTime();
+
+      texture = new Texture;
+      texture->createEnvironment(hdr.raster(), hdr.width(), hdr.height());
+      texture->calculateCDF();
+      m_timeCDF = m_timer.getTime();
+
+      if (m_writeCache && !EnvironmentCache::write(m_filename, *texture, hdr.sourceWidth(), hdr.sourceHeight()))
+      {
+        std::cerr << "WARNING: EnvironmentLoader::load() Writing " << EnvironmentCache::cacheFilename(m_filename) << " failed." << std::endl;
+      }
+      m_timeCache = m_timer.getTime();
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "ERROR: EnvironmentLoader::load() " << e.what() << std::endl;
+    delete texture;
+    texture = nullptr;
+  }
+
+  m_texture = texture;
+  m_ready   = true; // Publishes m_texture and the times to the main thread.
+}
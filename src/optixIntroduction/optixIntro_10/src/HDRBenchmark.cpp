@@ -0,0 +1,79 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/HDRBenchmark.h"
+
+#include "inc/Timer.h"
+
+#include <HDRLoader.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Number of loads of which the fastest counts.
+#define BENCHMARK_RUNS 5
+
+
+static double timeLoad(std::string const& filename, const bool useStreamReader)
+{
+  double best = 1.0e30;
+
+  for (int run = 0; run < BENCHMARK_RUNS; ++run)
+  {
+    Timer timer;
+    timer.start();
+    HDRLoader hdr(filename, useStreamReader);
+    best = std::min(best, timer.getTime());
+  }
+  return best;
+}
+
+
+bool benchmarkHDRLoader(std::string const& filename)
+{
+  const HDRLoader reference(filename, true);
+  const HDRLoader hdr(filename);
+  if (reference.failed() || hdr.failed())
+  {
+    std::cerr << "ERROR: benchmarkHDRLoader() Loading " << filename << " failed." << std::endl;
+    return false;
+  }
+
+  const bool identical = hdr.width() == reference.width() && hdr.height() == reference.height() &&
+                         memcmp(hdr.raster(), reference.raster(), size_t(hdr.width()) * hdr.height() * 4 * sizeof(float)) == 0;
+
+  const double timeStream = timeLoad(filename, true);
+  const double timeMapped = timeLoad(filename, false);
+
+  std::cout << "benchmarkHDRLoader(): " << filename << " (" << hdr.width() << " x " << hdr.height() << ")" << std::endl;
+  std::cout << "  stream reader = " << timeStream << " seconds, mapped reader = " << timeMapped << " seconds, speedup = " << timeStream / timeMapped
+            << ", pixels " << (identical ? "identical (passed)" : "differ (FAILED)") << std::endl;
+
+  return identical;
+}
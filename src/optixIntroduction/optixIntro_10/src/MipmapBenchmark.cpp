@@ -0,0 +1,346 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/MipmapBenchmark.h"
+
+#include "inc/Picture.h"
+#include "inc/Timer.h"
+
+#include <IL/il.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// LOD 0 extents of the throughput measurement.
+#define BENCHMARK_WIDTH  1024
+#define BENCHMARK_HEIGHT 1024
+
+
+struct NamedEnum
+{
+  int         value;
+  const char* name;
+};
+
+static const NamedEnum formats[] =
+{
+  { IL_LUMINANCE,       "LUMINANCE"       },
+  { IL_ALPHA,           "ALPHA"           },
+  { IL_LUMINANCE_ALPHA, "LUMINANCE_ALPHA" },
+  { IL_RGB,             "RGB"             },
+  { IL_BGR,             "BGR"             },
+  { IL_RGBA,            "RGBA"            },
+  { IL_BGRA,            "BGRA"            }
+};
+
+static const NamedEnum types[] =
+{
+  { IL_BYTE,           "BYTE"           },
+  { IL_UNSIGNED_BYTE,  "UNSIGNED_BYTE"  },
+  { IL_SHORT,          "SHORT"          },
+  { IL_UNSIGNED_SHORT, "UNSIGNED_SHORT" },
+  { IL_INT,            "INT"            },
+  { IL_UNSIGNED_INT,   "UNSIGNED_INT"   },
+  { IL_FLOAT,          "FLOAT"          }
+};
+
+
+// Generates the complete mipmap chain of base the same way Picture::generateMipmaps() does.
+static void createChain(const Image& base, const MipmapFilter filter, const bool isSrgb, std::vector<Image>& chain)
+{
+  unsigned int levels = 1;
+  for (unsigned int n = std::max(base.m_width, std::max(base.m_height, base.m_depth)); 1 < n; n >>= 1)
+  {
+    ++levels;
+  }
+
+  chain.clear();
+  chain.reserve(levels); // Image has no assignment operator, only the deep copy constructor.
+  chain.push_back(base);
+
+  for (unsigned int i = 1; i < levels; ++i)
+  {
+    const Image& src = chain[i - 1];
+
+    chain.push_back(Image((1 < src.m_width)  ? src.m_width  >> 1 : 1,
+                          (1 < src.m_height) ? src.m_height >> 1 : 1,
+                          (1 < src.m_depth)  ? src.m_depth  >> 1 : 1,
+                          src.m_format, src.m_type));
+
+    Image& dst = chain.back();
+    dst.m_pixels = new unsigned char[dst.m_nob];
+    downsampleImage(src, dst, filter, isSrgb);
+  }
+}
+
+static unsigned int sizeOfComponent(const int type)
+{
+  switch (type)
+  {
+    case IL_BYTE:
+    case IL_UNSIGNED_BYTE:
+      return 1;
+    case IL_SHORT:
+    case IL_UNSIGNED_SHORT:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+// A typical component value per type, away from zero and with the low bits set.
+static void constantComponent(const int type, unsigned char* value)
+{
+  const signed char    b  = -77;
+  const unsigned char  ub = 200;
+  const short          s  = -12345;
+  const unsigned short us = 54321;
+  const int            i  = -123456789;
+  const unsigned int   ui = 3000000001u;
+  const float          f  = 0.3f;
+
+  switch (type)
+  {
+    case IL_BYTE:           memcpy(value, &b,  sizeof(b));  break;
+    case IL_UNSIGNED_BYTE:  memcpy(value, &ub, sizeof(ub)); break;
+    case IL_SHORT:          memcpy(value, &s,  sizeof(s));  break;
+    case IL_UNSIGNED_SHORT: memcpy(value, &us, sizeof(us)); break;
+    case IL_INT:            memcpy(value, &i,  sizeof(i));  break;
+    case IL_UNSIGNED_INT:   memcpy(value, &ui, sizeof(ui)); break;
+    case IL_FLOAT:          memcpy(value, &f,  sizeof(f));  break;
+  }
+}
+
+// Filters with normalized weights must reproduce constant images on all levels. 
+// Integer components exactly, float components within rounding.
+static bool testConstant(const int format, const int type, const unsigned int width, const unsigned int height, const unsigned int depth,
+                         const MipmapFilter filter, const bool isSrgb)
+{
+  const unsigned int size = sizeOfComponent(type);
+
+  unsigned char value[4];
+  constantComponent(type, value);
+
+  Image base(width, height, depth, format, type);
+  base.m_pixels = new unsigned char[base.m_nob];
+  for (unsigned int i = 0; i < base.m_nob; i += size)
+  {
+    memcpy(base.m_pixels + i, value, size);
+  }
+
+  std::vector<Image> chain;
+  createChain(base, filter, isSrgb, chain);
+
+  for (size_t level = 1; level < chain.size(); ++level)
+  {
+    const Image& image = chain[level];
+    for (unsigned int i = 0; i < image.m_nob; i += size)
+    {
+      bool equal;
+      if (type == IL_FLOAT)
+      {
+        float a;
+        float b;
+        memcpy(&a, image.m_pixels + i, size);
+        memcpy(&b, value, size);
+        equal = (fabsf(a - b) <= 1.0e-6f);
+      }
+      else
+      {
+        equal = (memcmp(image.m_pixels + i, value, size) == 0);
+      }
+      if (!equal)
+      {
+        std::cerr << "ERROR: testConstant() LOD " << level << " of " << width << " x " << height << " x " << depth 
+                  << " format " << format << " type " << type << " filter " << filter << " sRGB " << isSrgb << " differs." << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The box filter of even extents is the exact average of 2x2 texels, rounded half up.
+template<typename S>
+static bool testBox(const int format, const int type, const unsigned int maximum)
+{
+  std::mt19937 rng(4711);
+
+  Image base(64, 32, 1, format, type);
+  base.m_pixels = new unsigned char[base.m_nob];
+
+  S* src = reinterpret_cast<S*>(base.m_pixels);
+
+  const size_t count = base.m_nob / sizeof(S);
+  for (size_t i = 0; i < count; ++i)
+  {
+    src[i] = static_cast<S>(rng() % (unsigned long long)(maximum + 1ull));
+  }
+
+  std::vector<Image> chain;
+  createChain(base, MIPMAP_FILTER_BOX, false, chain);
+
+  const Image& level = chain[1];
+  const S* dst = reinterpret_cast<const S*>(level.m_pixels);
+
+  const size_t row = base.m_bpl / sizeof(S);
+  const size_t components = base.m_bpp / sizeof(S);
+  for (unsigned int y = 0; y < level.m_height; ++y)
+  {
+    for (unsigned int x = 0; x < level.m_width; ++x)
+    {
+      for (size_t c = 0; c < components; ++c)
+      {
+        const S* p = src + 2 * y * row + 2 * x * components + c;
+        const unsigned long long sum = (unsigned long long) p[0] + p[components] + p[row] + p[row + components];
+        const S expected = static_cast<S>((sum + 2) / 4);
+        if (dst[(y * level.m_width + x) * components + c] != expected)
+        {
+          std::cerr << "ERROR: testBox() type " << type << " texel (" << x << ", " << y << ") differs." << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// A checkerboard of black and white averages to 50% linear intensity, which is 188 in sRGB, not 128. Alpha is always linear.
+static bool testSrgb()
+{
+  Image base(64, 64, 1, IL_RGBA, IL_UNSIGNED_BYTE);
+  base.m_pixels = new unsigned char[base.m_nob];
+  for (unsigned int y = 0; y < base.m_height; ++y)
+  {
+    for (unsigned int x = 0; x < base.m_width; ++x)
+    {
+      memset(base.m_pixels + y * base.m_bpl + x * base.m_bpp, ((x ^ y) & 1) ? 255 : 0, base.m_bpp);
+    }
+  }
+
+  bool passed = true;
+  for (int srgb = 0; srgb < 2; ++srgb)
+  {
+    std::vector<Image> chain;
+    createChain(base, MIPMAP_FILTER_BOX, srgb != 0, chain);
+
+    const unsigned char color = (srgb) ? 188 : 128;
+    for (size_t level = 1; level < chain.size(); ++level)
+    {
+      const Image& image = chain[level];
+      for (unsigned int i = 0; i < image.m_nob; i += 4)
+      {
+        const unsigned char* p = image.m_pixels + i;
+        if (p[0] != color || p[1] != color || p[2] != color || p[3] != 128)
+        {
+          std::cerr << "ERROR: testSrgb() sRGB " << srgb << " LOD " << level << " is (" 
+                    << int(p[0]) << ", " << int(p[1]) << ", " << int(p[2]) << ", " << int(p[3]) << ")." << std::endl;
+          passed = false;
+          break;
+        }
+      }
+    }
+  }
+  return passed;
+}
+
+
+bool benchmarkMipmaps()
+{
+  const int numFormats = sizeof(formats) / sizeof(formats[0]);
+  const int numTypes   = sizeof(types)   / sizeof(types[0]);
+
+  bool passed = true;
+
+  for (int f = 0; f < numFormats; ++f)
+  {
+    for (int t = 0; t < numTypes; ++t)
+    {
+      for (int filter = MIPMAP_FILTER_BOX; filter <= MIPMAP_FILTER_KAISER; ++filter)
+      {
+        for (int srgb = 0; srgb < 2; ++srgb)
+        {
+          passed = testConstant(formats[f].value, types[t].value, 333, 101, 1, MipmapFilter(filter), srgb != 0) && passed;
+          passed = testConstant(formats[f].value, types[t].value, 17, 9, 5, MipmapFilter(filter), srgb != 0) && passed;
+        }
+      }
+    }
+  }
+  passed = testBox<unsigned char>(IL_RGBA, IL_UNSIGNED_BYTE, 255) && passed;
+  passed = testBox<unsigned short>(IL_RGB, IL_UNSIGNED_SHORT, 65535) && passed;
+  passed = testBox<unsigned int>(IL_LUMINANCE, IL_UNSIGNED_INT, 4294967295u) && passed;
+  passed = testSrgb() && passed;
+
+  std::cout << "benchmarkMipmaps(): " << BENCHMARK_WIDTH << " x " << BENCHMARK_HEIGHT << " complete chains, tests " << ((passed) ? "passed" : "FAILED") << std::endl;
+  std::cout << "  Mtexels/s of LOD 0: box, Kaiser" << std::endl;
+
+  std::mt19937 rng(12345);
+
+  for (int f = 0; f < numFormats; ++f)
+  {
+    for (int t = 0; t < numTypes; ++t)
+    {
+      Image base(BENCHMARK_WIDTH, BENCHMARK_HEIGHT, 1, formats[f].value, types[t].value);
+      base.m_pixels = new unsigned char[base.m_nob];
+      for (unsigned int i = 0; i < base.m_nob; ++i)
+      {
+        base.m_pixels[i] = static_cast<unsigned char>(rng());
+      }
+      if (types[t].value == IL_FLOAT) // Keep random bytes from forming NaNs.
+      {
+        float* p = reinterpret_cast<float*>(base.m_pixels);
+        for (unsigned int i = 0; i < base.m_nob / sizeof(float); ++i)
+        {
+          p[i] = float(rng() & 0xFFFF) / 65535.0f;
+        }
+      }
+
+      std::cout << "  " << formats[f].name << " " << types[t].name << ":";
+
+      for (int filter = MIPMAP_FILTER_BOX; filter <= MIPMAP_FILTER_KAISER; ++filter)
+      {
+        // sRGB only changes the conversion of IL_UNSIGNED_BYTE color, measure the more expensive path.
+        std::vector<Image> chain;
+
+        Timer timer;
+        timer.start();
+        createChain(base, MipmapFilter(filter), true, chain);
+        const double seconds = timer.getTime();
+
+        std::cout << " " << double(BENCHMARK_WIDTH) * double(BENCHMARK_HEIGHT) * 1.0e-6 / seconds;
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  return passed;
+}
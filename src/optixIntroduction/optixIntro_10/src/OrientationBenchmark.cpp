@@ -0,0 +1,258 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/OrientationBenchmark.h"
+
+#include "inc/Picture.h"
+#include "inc/Timer.h"
+
+#include <IL/il.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Cubemap face extents of the throughput measurement and the number of runs of which the fastest counts.
+#define BENCHMARK_SIZE 2048
+#define BENCHMARK_RUNS 5
+
+
+struct PixelFormat
+{
+  int          format;
+  int          type;
+  const char*  name;
+};
+
+// One format and type per pixel size of the DevIL images: 1, 2, 3, 4, 6, 8, 12, and 16 bytes.
+static const PixelFormat pixelFormats[] =
+{
+  { IL_LUMINANCE, IL_UNSIGNED_BYTE,  "LUMINANCE UNSIGNED_BYTE" },
+  { IL_LUMINANCE, IL_UNSIGNED_SHORT, "LUMINANCE UNSIGNED_SHORT" },
+  { IL_RGB,       IL_UNSIGNED_BYTE,  "RGB UNSIGNED_BYTE" },
+  { IL_RGBA,      IL_UNSIGNED_BYTE,  "RGBA UNSIGNED_BYTE" },
+  { IL_RGB,       IL_UNSIGNED_SHORT, "RGB UNSIGNED_SHORT" },
+  { IL_RGBA,      IL_UNSIGNED_SHORT, "RGBA UNSIGNED_SHORT" },
+  { IL_RGB,       IL_FLOAT,          "RGB FLOAT" },
+  { IL_RGBA,      IL_FLOAT,          "RGBA FLOAT" }
+};
+
+
+static void fillRandom(Image& image, std::mt19937& rng)
+{
+  for (unsigned int i = 0; i < image.m_nob; ++i)
+  {
+    image.m_pixels[i] = static_cast<unsigned char>(rng());
+  }
+}
+
+// Per-pixel reference of the orientation, reading src and writing the transformed image to dst.
+static void referenceOrientation(const Image& src, Image& dst, const ImageOrientation orientation)
+{
+  for (unsigned int z = 0; z < src.m_depth; ++z)
+  {
+    for (unsigned int y = 0; y < src.m_height; ++y)
+    {
+      for (unsigned int x = 0; x < src.m_width; ++x)
+      {
+        const unsigned int xd = (orientation == IMAGE_ORIENTATION_MIRROR_Y) ? src.m_width  - 1 - x : x;
+        const unsigned int yd = (orientation == IMAGE_ORIENTATION_MIRROR_X) ? src.m_height - 1 - y : y;
+
+        memcpy(dst.m_pixels + z * dst.m_bps + yd * dst.m_bpl + xd * dst.m_bpp,
+               src.m_pixels + z * src.m_bps + y  * src.m_bpl + x  * src.m_bpp, src.m_bpp);
+      }
+    }
+  }
+}
+
+static bool testOrientation(const PixelFormat& pf, const unsigned int width, const unsigned int height, const unsigned int depth, std::mt19937& rng)
+{
+  Image source(width, height, depth, pf.format, pf.type);
+  source.m_pixels = new unsigned char[source.m_nob];
+  fillRandom(source, rng);
+
+  bool passed = true;
+
+  for (int o = IMAGE_ORIENTATION_KEEP; o <= IMAGE_ORIENTATION_MIRROR_Y; ++o)
+  {
+    const ImageOrientation orientation = ImageOrientation(o);
+
+    Image expected(width, height, depth, pf.format, pf.type);
+    expected.m_pixels = new unsigned char[expected.m_nob];
+    referenceOrientation(source, expected, orientation);
+
+    Image copied(width, height, depth, pf.format, pf.type);
+    copied.m_pixels = new unsigned char[copied.m_nob];
+    copyImage(copied, source.m_pixels, orientation);
+
+    Image mirrored(source);
+    mirrorImage(mirrored, orientation);
+
+    if (memcmp(copied.m_pixels, expected.m_pixels, expected.m_nob) != 0 ||
+        memcmp(mirrored.m_pixels, expected.m_pixels, expected.m_nob) != 0)
+    {
+      std::cerr << "ERROR: testOrientation() " << pf.name << " " << width << " x " << height << " x " << depth 
+                << " orientation " << o << " differs." << std::endl;
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+
+// The former Picture::load() path: copy the pixels, then mirror each level into a newly allocated array.
+static void orientAllocating(Image& image, const void* pixels, const ImageOrientation orientation)
+{
+  memcpy(image.m_pixels, pixels, image.m_nob);
+
+  if (orientation == IMAGE_ORIENTATION_KEEP)
+  {
+    return;
+  }
+
+  unsigned char* dstPixels = new unsigned char[image.m_nob];
+  for (unsigned int z = 0; z < image.m_depth; ++z)
+  {
+    for (unsigned int y = 0; y < image.m_height; ++y)
+    {
+      const unsigned char* srcLine = image.m_pixels + z * image.m_bps + y * image.m_bpl;
+      if (orientation == IMAGE_ORIENTATION_MIRROR_X)
+      {
+        memcpy(dstPixels + z * image.m_bps + (image.m_height - 1 - y) * image.m_bpl, srcLine, image.m_bpl);
+      }
+      else
+      {
+        unsigned char* dstLine = dstPixels + z * image.m_bps + y * image.m_bpl;
+        for (unsigned int x = 0; x < image.m_width; ++x)
+        {
+          memcpy(dstLine + (image.m_width - 1 - x) * image.m_bpp, srcLine + x * image.m_bpp, image.m_bpp);
+        }
+      }
+    }
+  }
+  delete[] image.m_pixels;
+  image.m_pixels = dstPixels;
+}
+
+// Orients all mipmap levels of six cubemap faces like a DDS cubemap: four faces mirrored left to right, two upside down.
+// Method 0 is the former allocating path, 1 copies and mirrors in place, 2 is the fused copy.
+static double timeCubemap(const PixelFormat& pf, const std::vector<Image>& decoded, const int method)
+{
+  double best = 1.0e30;
+
+  for (int run = 0; run < BENCHMARK_RUNS; ++run)
+  {
+    std::vector< std::vector<Image> > faces(6);
+    for (int face = 0; face < 6; ++face)
+    {
+      faces[face].reserve(decoded.size());
+      for (size_t level = 0; level < decoded.size(); ++level)
+      {
+        faces[face].push_back(Image(decoded[level].m_width, decoded[level].m_height, 1, pf.format, pf.type));
+        faces[face].back().m_pixels = new unsigned char[decoded[level].m_nob];
+      }
+    }
+
+    Timer timer;
+    timer.start();
+    for (int face = 0; face < 6; ++face)
+    {
+      const ImageOrientation orientation = (face == 2 || face == 3) ? IMAGE_ORIENTATION_MIRROR_X : IMAGE_ORIENTATION_MIRROR_Y;
+
+      for (size_t level = 0; level < decoded.size(); ++level)
+      {
+        Image& image = faces[face][level];
+        switch (method)
+        {
+          case 0:
+            orientAllocating(image, decoded[level].m_pixels, orientation);
+            break;
+          case 1:
+            memcpy(image.m_pixels, decoded[level].m_pixels, image.m_nob);
+            mirrorImage(image, orientation);
+            break;
+          default:
+            copyImage(image, decoded[level].m_pixels, orientation);
+            break;
+        }
+      }
+    }
+    best = std::min(best, timer.getTime());
+  }
+  return best;
+}
+
+
+bool benchmarkOrientation()
+{
+  const int numFormats = sizeof(pixelFormats) / sizeof(pixelFormats[0]);
+
+  std::mt19937 rng(4711);
+
+  bool passed = true;
+
+  // Widths around the 16 and 32 byte SIMD blocks, odd heights to have a middle row.
+  const unsigned int widths[] = { 1, 2, 3, 5, 8, 15, 16, 17, 33, 100, 257 };
+  for (int f = 0; f < numFormats; ++f)
+  {
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+    {
+      passed = testOrientation(pixelFormats[f], widths[w], 7, 1, rng) && passed;
+      passed = testOrientation(pixelFormats[f], widths[w], 4, 3, rng) && passed;
+    }
+  }
+
+  std::cout << "benchmarkOrientation(): " << BENCHMARK_SIZE << " x " << BENCHMARK_SIZE << " cubemaps with mipmaps, tests " << ((passed) ? "passed" : "FAILED") << std::endl;
+  std::cout << "  ms: allocating mirror, in-place mirror, fused copy; peak extra MB of the allocating mirror" << std::endl;
+
+  for (int f = 0; f < numFormats; ++f)
+  {
+    std::vector<Image> decoded;
+    for (unsigned int size = BENCHMARK_SIZE; ; size >>= 1)
+    {
+      decoded.push_back(Image(size, size, 1, pixelFormats[f].format, pixelFormats[f].type));
+      decoded.back().m_pixels = new unsigned char[decoded.back().m_nob];
+      fillRandom(decoded.back(), rng);
+      if (size == 1)
+      {
+        break;
+      }
+    }
+
+    std::cout << "  " << pixelFormats[f].name << ":";
+    for (int method = 0; method < 3; ++method)
+    {
+      std::cout << " " << timeCubemap(pixelFormats[f], decoded, method) * 1000.0;
+    }
+    std::cout << "; " << double(decoded[0].m_nob) / (1024.0 * 1024.0) << std::endl;
+  }
+
+  return passed;
+}
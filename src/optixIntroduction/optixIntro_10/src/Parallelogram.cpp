@@ -27,15 +27,15 @@
  */
 
 #include "inc/Application.h"
+#include "inc/Shapes.h"
 
 #include <cstring>
 #include <iostream>
 #include <sstream>
 
 // Parallelogram from footpoint position, spanned by unnormalized vectors vecU and vecV, normal is normalized and on the CCW frontface.
-optix::Geometry Application::createParallelogram(optix::float3 const& position, optix::float3 const& vecU, optix::float3 const& vecV, optix::float3 const& normal)
+void generateParallelogram(optix::float3 const& position, optix::float3 const& vecU, optix::float3 const& vecV, optix::float3 const& normal, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices)
 {
-  std::vector<VertexAttributes> attributes;
   
   VertexAttributes attrib;
 
@@ -59,8 +59,6 @@ optix::Geometry Application::createParallelogram(optix::float3 const& position,
   attrib.texcoord  = optix::make_float3(0.0f, 1.0f, 0.0f);
   attributes.push_back(attrib);
 
-  std::vector<unsigned int> indices;
-
   indices.push_back(0);
   indices.push_back(1);
   indices.push_back(2);
@@ -70,6 +68,14 @@ optix::Geometry Application::createParallelogram(optix::float3 const& position,
   indices.push_back(0);
 
   std::cout << "createParallelogram(): Vertices = " << attributes.size() <<  ", Triangles = " << indices.size() / 3 << std::endl;
+}
+
+optix::Geometry Application::createParallelogram(optix::float3 const& position, optix::float3 const& vecU, optix::float3 const& vecV, optix::float3 const& normal)
+{
+  std::vector<VertexAttributes> attributes;
+  std::vector<unsigned int>     indices;
+
+  generateParallelogram(position, vecU, vecV, normal, attributes, indices);
 
   return createGeometry(attributes, indices);
 }
@@ -36,11 +36,25 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <cstring>
 #include <iostream>
+#include <limits>
+
+// DAR Fork-join helpers from sutil to generate the mipmaps in parallel.
+#include <Parallel.h>
 
 #include "inc/MyAssert.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PICTURE_SSE 1
+#endif
+
+#ifndef M_PI
+#define M_PI  3.14159265358979323846264338327950288419716939937510
+#endif
+
 
 static unsigned int numberOfComponents(int format)
 {
@@ -181,6 +195,660 @@ static unsigned int numberOfMipmaps(unsigned int w, unsigned int h, unsigned int
 }
 
 
+// Mipmap generation
+
+// Radius of the Kaiser windowed sinc in destination texels and the shape parameter of the Kaiser window.
+#define KAISER_RADIUS 2.0
+#define KAISER_ALPHA  4.0
+
+// Minimum number of rows per parallelFor range.
+#define MIPMAP_GRAIN 8
+
+// Number of linear intervals of the sRGB encoding lookup.
+#define SRGB_BUCKETS 4096
+
+// The source texels and weights which are summed up into the destination texels along one axis.
+struct MipmapTaps
+{
+  std::vector<unsigned int> offset; // The taps of destination texel i are [offset[i], offset[i + 1]).
+  std::vector<unsigned int> index;  // Source texel of each tap.
+  std::vector<double>       weight; // Normalized weight of each tap. Double for the 32-bit integer components.
+};
+
+// Zeroth order modified Bessel function of the first kind. The power series converges quickly for the small arguments here.
+static double besselI0(const double x)
+{
+  const double q = 0.25 * x * x;
+
+  double sum  = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 64 && 1.0e-16 * sum < term; ++k)
+  {
+    term *= q / double(k * k);
+    sum  += term;
+  }
+  return sum;
+}
+
+// Kaiser windowed sinc at the distance t in destination texels.
+static double kaiserSinc(const double t)
+{
+  const double x = t / KAISER_RADIUS;
+  if (1.0 <= fabs(x))
+  {
+    return 0.0;
+  }
+  const double sinc = (fabs(t) < 1.0e-6) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+  return sinc * besselI0(KAISER_ALPHA * sqrt(1.0 - x * x)) / besselI0(KAISER_ALPHA);
+}
+
+// Builds the filter taps which reduce srcCount texels to dstCount texels along one axis.
+// Non-power-of-two extents get a polyphase filter, each destination texel covers srcCount / dstCount source texels.
+// Taps outside the image are clamped to the border texels.
+static void buildMipmapTaps(const unsigned int srcCount, const unsigned int dstCount, const MipmapFilter filter, MipmapTaps& taps)
+{
+  const double scale = double(srcCount) / double(dstCount); // 1.0 when the axis is not reduced anymore.
+
+  taps.offset.resize(dstCount + 1);
+  taps.index.clear();
+  taps.weight.clear();
+
+  for (unsigned int i = 0; i < dstCount; ++i)
+  {
+    const size_t first = taps.index.size();
+
+    taps.offset[i] = static_cast<unsigned int>(first);
+
+    if (filter == MIPMAP_FILTER_BOX || scale == 1.0)
+    {
+      // The area of the source texels inside the footprint [lo, hi) of the destination texel.
+      const double lo = double(i)     * scale;
+      const double hi = double(i + 1) * scale;
+      for (unsigned int s = static_cast<unsigned int>(lo); double(s) < hi && s < srcCount; ++s)
+      {
+        const double w = std::min(hi, double(s + 1)) - std::max(lo, double(s));
+        if (0.0 < w)
+        {
+          taps.index.push_back(s);
+          taps.weight.push_back(w);
+        }
+      }
+    }
+    else
+    {
+      const double center = (double(i) + 0.5) * scale;
+      const int lo = static_cast<int>(floor(center - KAISER_RADIUS * scale));
+      const int hi = static_cast<int>(ceil(center + KAISER_RADIUS * scale));
+      for (int s = lo; s <= hi; ++s)
+      {
+        const double w = kaiserSinc((double(s) + 0.5 - center) / scale);
+        if (w != 0.0)
+        {
+          const unsigned int index = static_cast<unsigned int>(std::min(std::max(s, 0), int(srcCount) - 1));
+          // Clamped taps land on the same border texel. Merge them.
+          if (first < taps.index.size() && taps.index.back() == index)
+          {
+            taps.weight.back() += w;
+          }
+          else
+          {
+            taps.index.push_back(index);
+            taps.weight.push_back(w);
+          }
+        }
+      }
+    }
+
+    double sum = 0.0;
+    for (size_t j = first; j < taps.weight.size(); ++j)
+    {
+      sum += taps.weight[j];
+    }
+    for (size_t j = first; j < taps.weight.size(); ++j)
+    {
+      taps.weight[j] /= sum;
+    }
+  }
+  taps.offset[dstCount] = static_cast<unsigned int>(taps.index.size());
+}
+
+// Number of leading components which hold color. These are sRGB encoded in sRGB images, alpha never is.
+static unsigned int numberOfColorComponents(int format)
+{
+  switch (format)
+  {
+    case IL_RGB:
+    case IL_BGR:
+    case IL_RGBA:
+    case IL_BGRA:
+      return 3;
+
+    case IL_LUMINANCE:
+    case IL_LUMINANCE_ALPHA:
+      return 1;
+
+    default: // IL_ALPHA
+      return 0;
+  }
+}
+
+// Lookup tables for the sRGB conversion of 8-bit components. Linear values are kept in the [0, 255] range of the other components.
+struct SrgbTables
+{
+  SrgbTables()
+  {
+    for (unsigned int i = 0; i < 256; ++i)
+    {
+      toLinear[i] = static_cast<float>(255.0 * decode(double(i) / 255.0));
+    }
+    for (unsigned int i = 0; i < 255; ++i)
+    {
+      threshold[i] = static_cast<float>(255.0 * decode((double(i) + 0.5) / 255.0));
+    }
+    unsigned int code = 0;
+    for (unsigned int i = 0; i < SRGB_BUCKETS; ++i)
+    {
+      const float lo = float(i) * (255.0f / float(SRGB_BUCKETS));
+      while (code < 255 && threshold[code] <= lo)
+      {
+        ++code;
+      }
+      bucket[i] = static_cast<unsigned char>(code);
+    }
+  }
+
+  static double decode(const double c)
+  {
+    return (c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+  }
+
+  // The rounded sRGB encoding of v is the number of thresholds at or below v.
+  // The buckets are fine enough that the search from the code at the bucket start takes at most a few steps.
+  unsigned char encode(const float v) const
+  {
+    if (!(0.0f < v)) // Also catches NaN.
+    {
+      return 0;
+    }
+    if (255.0f <= v)
+    {
+      return 255;
+    }
+    unsigned int code = bucket[static_cast<unsigned int>(v * (float(SRGB_BUCKETS) / 255.0f))];
+    while (code < 255 && threshold[code] <= v)
+    {
+      ++code;
+    }
+    return static_cast<unsigned char>(code);
+  }
+
+  float         toLinear[256];
+  float         threshold[255];         // The linear value at which the sRGB encoding switches from i to i + 1.
+  unsigned char bucket[SRGB_BUCKETS];   // The sRGB encoding of the start of each equally sized linear interval.
+};
+
+static const SrgbTables& srgbTables()
+{
+  static const SrgbTables tables; // Thread-safe initialization.
+  return tables;
+}
+
+template<typename S, typename T>
+static void decodeComponents(const unsigned char* src, T* dst, const size_t count)
+{
+  const S* s = reinterpret_cast<const S*>(src);
+  for (size_t i = 0; i < count; ++i)
+  {
+    dst[i] = static_cast<T>(s[i]);
+  }
+}
+
+// Rounds to the nearest integer value and clamps to the range of S. Filters with negative lobes overshoot.
+template<typename S, typename T>
+static void encodeComponents(const T* src, unsigned char* dst, const size_t count)
+{
+  const T lo = static_cast<T>(std::numeric_limits<S>::min());
+  const T hi = static_cast<T>(std::numeric_limits<S>::max());
+
+  S* d = reinterpret_cast<S*>(dst);
+  for (size_t i = 0; i < count; ++i)
+  {
+    d[i] = static_cast<S>(floor(std::min(std::max(src[i], lo), hi) + T(0.5)));
+  }
+}
+
+// Converts one row of components of the image into the filter type T. colors > 0 selects the sRGB decoding of the leading color components.
+template<typename T>
+static void decodeRow(const Image& image, const unsigned char* src, T* dst, const unsigned int colors)
+{
+  const unsigned int components = numberOfComponents(image.m_format);
+  const size_t count = size_t(image.m_width) * components;
+
+  switch (image.m_type)
+  {
+    case IL_BYTE:
+      decodeComponents<signed char>(src, dst, count);
+      break;
+    case IL_UNSIGNED_BYTE:
+      decodeComponents<unsigned char>(src, dst, count);
+      if (colors)
+      {
+        const float* toLinear = srgbTables().toLinear;
+        for (size_t i = 0; i < count; i += components)
+        {
+          for (unsigned int c = 0; c < colors; ++c)
+          {
+            dst[i + c] = static_cast<T>(toLinear[src[i + c]]);
+          }
+        }
+      }
+      break;
+    case IL_SHORT:
+      decodeComponents<short>(src, dst, count);
+      break;
+    case IL_UNSIGNED_SHORT:
+      decodeComponents<unsigned short>(src, dst, count);
+      break;
+    case IL_INT:
+      decodeComponents<int>(src, dst, count);
+      break;
+    case IL_UNSIGNED_INT:
+      decodeComponents<unsigned int>(src, dst, count);
+      break;
+    case IL_FLOAT:
+      decodeComponents<float>(src, dst, count);
+      break;
+  }
+}
+
+// Converts one row of filtered components back into the type of the image.
+template<typename T>
+static void encodeRow(const Image& image, const T* src, unsigned char* dst, const unsigned int colors)
+{
+  const unsigned int components = numberOfComponents(image.m_format);
+  const size_t count = size_t(image.m_width) * components;
+
+  switch (image.m_type)
+  {
+    case IL_BYTE:
+      encodeComponents<signed char>(src, dst, count);
+      break;
+    case IL_UNSIGNED_BYTE:
+      encodeComponents<unsigned char>(src, dst, count);
+      if (colors)
+      {
+        const SrgbTables& tables = srgbTables();
+        for (size_t i = 0; i < count; i += components)
+        {
+          for (unsigned int c = 0; c < colors; ++c)
+          {
+            dst[i + c] = tables.encode(static_cast<float>(src[i + c]));
+          }
+        }
+      }
+      break;
+    case IL_SHORT:
+      encodeComponents<short>(src, dst, count);
+      break;
+    case IL_UNSIGNED_SHORT:
+      encodeComponents<unsigned short>(src, dst, count);
+      break;
+    case IL_INT:
+      encodeComponents<int>(src, dst, count);
+      break;
+    case IL_UNSIGNED_INT:
+      encodeComponents<unsigned int>(src, dst, count);
+      break;
+    case IL_FLOAT:
+      for (size_t i = 0; i < count; ++i)
+      {
+        reinterpret_cast<float*>(dst)[i] = static_cast<float>(src[i]);
+      }
+      break;
+  }
+}
+
+// Horizontal pass: Filters the components of one row with the taps of the x-axis.
+template<typename T>
+static void filterRow(const T* src, T* dst, const MipmapTaps& taps, const unsigned int components)
+{
+  const size_t width = taps.offset.size() - 1;
+  for (size_t x = 0; x < width; ++x)
+  {
+    T* out = dst + x * components;
+    for (unsigned int c = 0; c < components; ++c)
+    {
+      out[c] = T(0);
+    }
+    for (unsigned int t = taps.offset[x]; t < taps.offset[x + 1]; ++t)
+    {
+      const T  w  = static_cast<T>(taps.weight[t]);
+      const T* in = src + size_t(taps.index[t]) * components;
+      for (unsigned int c = 0; c < components; ++c)
+      {
+        out[c] += w * in[c];
+      }
+    }
+  }
+}
+
+// Vertical and depth passes: dst += weight * src over count components.
+template<typename T>
+static void accumulateRow(const T* src, T* dst, const double weight, const size_t count)
+{
+  const T w = static_cast<T>(weight);
+  for (size_t i = 0; i < count; ++i)
+  {
+    dst[i] += w * src[i];
+  }
+}
+
+#if PICTURE_SSE
+// Four component float texels fit exactly into one SSE register.
+static void filterRow(const float* src, float* dst, const MipmapTaps& taps, const unsigned int components)
+{
+  if (components != 4)
+  {
+    filterRow<float>(src, dst, taps, components);
+    return;
+  }
+
+  const size_t width = taps.offset.size() - 1;
+  for (size_t x = 0; x < width; ++x)
+  {
+    __m128 sum = _mm_setzero_ps();
+    for (unsigned int t = taps.offset[x]; t < taps.offset[x + 1]; ++t)
+    {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(static_cast<float>(taps.weight[t])), _mm_loadu_ps(src + size_t(taps.index[t]) * 4)));
+    }
+    _mm_storeu_ps(dst + x * 4, sum);
+  }
+}
+
+static void accumulateRow(const float* src, float* dst, const double weight, const size_t count)
+{
+  const float  f = static_cast<float>(weight);
+  const __m128 w = _mm_set1_ps(f);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+  }
+  for (; i < count; ++i)
+  {
+    dst[i] += f * src[i];
+  }
+}
+#endif
+
+// Sums the rows of src selected by the taps of the destination index i into dst. stride is the distance between the source rows.
+template<typename T>
+static void filterRows(const T* src, const size_t stride, T* dst, const size_t count, const MipmapTaps& taps, const unsigned int i)
+{
+  std::fill(dst, dst + count, T(0));
+  for (unsigned int t = taps.offset[i]; t < taps.offset[i + 1]; ++t)
+  {
+    accumulateRow(src + taps.index[t] * stride, dst, taps.weight[t], count);
+  }
+}
+
+// Separable filter: The horizontal pass decodes the source rows, the vertical resp. depth pass encodes the destination rows.
+// T is float, resp. double for 32-bit integer components which don't fit into the float mantissa.
+template<typename T>
+static void downsample(const Image& src, Image& dst, const MipmapFilter filter, const bool isSrgb)
+{
+  const unsigned int components = numberOfComponents(src.m_format);
+  const unsigned int colors     = (isSrgb && src.m_type == IL_UNSIGNED_BYTE) ? numberOfColorComponents(src.m_format) : 0;
+
+  MipmapTaps tapsX;
+  MipmapTaps tapsY;
+  MipmapTaps tapsZ;
+
+  buildMipmapTaps(src.m_width,  dst.m_width,  filter, tapsX);
+  buildMipmapTaps(src.m_height, dst.m_height, filter, tapsY);
+  buildMipmapTaps(src.m_depth,  dst.m_depth,  filter, tapsZ);
+
+  const size_t count   = size_t(dst.m_width) * components; // Components per destination row.
+  const bool   isLayer = (src.m_depth == dst.m_depth);      // No depth pass needed.
+
+  std::vector<T> bufferX(count * src.m_height * src.m_depth);
+
+  // The source rows are contiguous over all slices because m_bps == m_height * m_bpl.
+  sutil::parallelFor(size_t(src.m_height) * src.m_depth, MIPMAP_GRAIN, [&](size_t begin, size_t end, size_t)
+  {
+    std::vector<T> row(size_t(src.m_width) * components);
+    for (size_t r = begin; r < end; ++r)
+    {
+      decodeRow(src, src.m_pixels + r * src.m_bpl, row.data(), colors);
+      filterRow(row.data(), bufferX.data() + r * count, tapsX, components);
+    }
+  });
+
+  std::vector<T> bufferY((isLayer) ? 0 : count * dst.m_height * src.m_depth);
+
+  sutil::parallelFor(size_t(dst.m_height) * src.m_depth, MIPMAP_GRAIN, [&](size_t begin, size_t end, size_t)
+  {
+    std::vector<T> row(count);
+    for (size_t r = begin; r < end; ++r)
+    {
+      const size_t z = r / dst.m_height;
+      const size_t y = r % dst.m_height;
+      if (isLayer)
+      {
+        filterRows(bufferX.data() + z * src.m_height * count, count, row.data(), count, tapsY, static_cast<unsigned int>(y));
+        encodeRow(dst, row.data(), dst.m_pixels + r * dst.m_bpl, colors);
+      }
+      else
+      {
+        filterRows(bufferX.data() + z * src.m_height * count, count, bufferY.data() + r * count, count, tapsY, static_cast<unsigned int>(y));
+      }
+    }
+  });
+
+  if (!isLayer)
+  {
+    sutil::parallelFor(size_t(dst.m_height) * dst.m_depth, MIPMAP_GRAIN, [&](size_t begin, size_t end, size_t)
+    {
+      std::vector<T> row(count);
+      for (size_t r = begin; r < end; ++r)
+      {
+        const size_t z = r / dst.m_height;
+        const size_t y = r % dst.m_height;
+        filterRows(bufferY.data() + y * count, dst.m_height * count, row.data(), count, tapsZ, static_cast<unsigned int>(z));
+        encodeRow(dst, row.data(), dst.m_pixels + r * dst.m_bpl, colors);
+      }
+    });
+  }
+}
+
+void downsampleImage(const Image& src, Image& dst, const MipmapFilter filter, const bool isSrgb)
+{
+  MY_ASSERT(src.m_pixels != nullptr && dst.m_pixels != nullptr);
+  MY_ASSERT(src.m_format == dst.m_format && src.m_type == dst.m_type);
+  MY_ASSERT(dst.m_width  == ((1 < src.m_width)  ? src.m_width  >> 1 : 1) &&
+            dst.m_height == ((1 < src.m_height) ? src.m_height >> 1 : 1) &&
+            dst.m_depth  == ((1 < src.m_depth)  ? src.m_depth  >> 1 : 1));
+
+  if (src.m_type == IL_INT || src.m_type == IL_UNSIGNED_INT)
+  {
+    downsample<double>(src, dst, filter, isSrgb);
+  }
+  else
+  {
+    downsample<float>(src, dst, filter, isSrgb);
+  }
+}
+
+
+// Orientation transforms. 
+// All pixel sizes of the DevIL formats and types are 1, 2, 3, 4, 6, 8, 12, or 16 bytes.
+
+template<unsigned int BPP>
+struct PixelBytes
+{
+  unsigned char bytes[BPP];
+};
+
+#if PICTURE_SSE
+// Reverses the order of the 16 / BPP pixels inside one 16 byte block.
+template<unsigned int BPP> static __m128i reverseBlock(__m128i v);
+
+template<> __m128i reverseBlock<16>(__m128i v)
+{
+  return v;
+}
+
+template<> __m128i reverseBlock<8>(__m128i v)
+{
+  return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+template<> __m128i reverseBlock<4>(__m128i v)
+{
+  return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+template<> __m128i reverseBlock<2>(__m128i v)
+{
+  v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+  v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+  return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+template<> __m128i reverseBlock<1>(__m128i v)
+{
+  // Swap the bytes inside each 16-bit word, then reverse the words.
+  return reverseBlock<2>(_mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+}
+#endif
+
+// Mirrors the pixels of one row in place. 
+// The SIMD path swaps 16 byte blocks from both ends inwards, the middle of less than two blocks is done per pixel.
+template<unsigned int BPP>
+static void reverseRow(unsigned char* row, const unsigned int width)
+{
+  unsigned char* lo = row;
+  unsigned char* hi = row + size_t(width) * BPP;
+
+#if PICTURE_SSE
+  // Pixels of 3, 6, or 12 bytes straddle the blocks. The template argument only keeps these instantiations compiling.
+  if ((16 % BPP) == 0)
+  {
+    while (32 <= hi - lo)
+    {
+      hi -= 16;
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(lo), reverseBlock<(16 % BPP) ? 1 : BPP>(b));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(hi), reverseBlock<(16 % BPP) ? 1 : BPP>(a));
+      lo += 16;
+    }
+  }
+#endif
+
+  std::reverse(reinterpret_cast<PixelBytes<BPP>*>(lo), reinterpret_cast<PixelBytes<BPP>*>(hi));
+}
+
+typedef void (*ReverseRowFunc)(unsigned char* row, const unsigned int width);
+
+static ReverseRowFunc reverseRowFunc(const unsigned int bpp)
+{
+  switch (bpp)
+  {
+    case 1:  return reverseRow<1>;
+    case 2:  return reverseRow<2>;
+    case 3:  return reverseRow<3>;
+    case 4:  return reverseRow<4>;
+    case 6:  return reverseRow<6>;
+    case 8:  return reverseRow<8>;
+    case 12: return reverseRow<12>;
+    case 16: return reverseRow<16>;
+  }
+  MY_ASSERT(!"reverseRowFunc() Unexpected pixel size");
+  return nullptr;
+}
+
+// Exchanges the contents of two non-overlapping rows.
+static void swapRows(unsigned char* a, unsigned char* b, const size_t bytes)
+{
+  size_t i = 0;
+#if PICTURE_SSE
+  for (; i + 16 <= bytes; i += 16)
+  {
+    const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(a + i), vb);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + i), va);
+  }
+#endif
+  std::swap_ranges(a + i, a + bytes, b + i);
+}
+
+void mirrorImage(Image& image, const ImageOrientation orientation)
+{
+  MY_ASSERT(image.m_pixels != nullptr);
+
+  if (orientation == IMAGE_ORIENTATION_MIRROR_X)
+  {
+    for (unsigned int z = 0; z < image.m_depth; ++z)
+    {
+      unsigned char* slice = image.m_pixels + size_t(z) * image.m_bps;
+      for (unsigned int y = 0; y < image.m_height / 2; ++y)
+      {
+        swapRows(slice + size_t(y) * image.m_bpl, slice + size_t(image.m_height - 1 - y) * image.m_bpl, image.m_bpl);
+      }
+    }
+  }
+  else if (orientation == IMAGE_ORIENTATION_MIRROR_Y)
+  {
+    const ReverseRowFunc reverse = reverseRowFunc(image.m_bpp);
+
+    const size_t rows = size_t(image.m_height) * image.m_depth;
+    for (size_t r = 0; r < rows; ++r)
+    {
+      reverse(image.m_pixels + r * image.m_bpl, image.m_width);
+    }
+  }
+}
+
+void copyImage(Image& image, const void* pixels, const ImageOrientation orientation)
+{
+  MY_ASSERT(image.m_pixels != nullptr && pixels != nullptr);
+
+  const unsigned char* src = static_cast<const unsigned char*>(pixels);
+
+  if (orientation == IMAGE_ORIENTATION_MIRROR_X)
+  {
+    for (unsigned int z = 0; z < image.m_depth; ++z)
+    {
+      for (unsigned int y = 0; y < image.m_height; ++y)
+      {
+        memcpy(image.m_pixels + size_t(z) * image.m_bps + size_t(image.m_height - 1 - y) * image.m_bpl,
+               src            + size_t(z) * image.m_bps + size_t(y) * image.m_bpl, image.m_bpl);
+      }
+    }
+  }
+  else if (orientation == IMAGE_ORIENTATION_MIRROR_Y)
+  {
+    const ReverseRowFunc reverse = reverseRowFunc(image.m_bpp);
+
+    // Each row is reversed while it's still in the cache after the copy.
+    const size_t rows = size_t(image.m_height) * image.m_depth;
+    for (size_t r = 0; r < rows; ++r)
+    {
+      unsigned char* row = image.m_pixels + r * image.m_bpl;
+      memcpy(row, src + r * image.m_bpl, image.m_bpl);
+      reverse(row, image.m_width);
+    }
+  }
+  else
+  {
+    memcpy(image.m_pixels, src, image.m_nob);
+  }
+}
+
+
 Picture::Picture()
 : m_isCube(false)
 {
@@ -215,11 +883,58 @@ bool Picture::isCubemap() const
   return m_isCube;
 }
 
+const std::string& Picture::getFilename() const
+{
+  return m_filename;
+}
+
+static uint64_t hashBytes(const void* data, const size_t size, uint64_t hash)
+{
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= p[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t Picture::hashContent() const
+{
+  uint64_t hash = 14695981039346656037ull;
+
+  const unsigned int isCube = (m_isCube) ? 1 : 0;
+  hash = hashBytes(&isCube, sizeof(isCube), hash);
+
+  for (size_t indexImage = 0; indexImage < m_images.size(); ++indexImage)
+  {
+    for (size_t indexFace = 0; indexFace < m_images[indexImage].size(); ++indexFace)
+    {
+      const Image& image = m_images[indexImage][indexFace];
+
+      const unsigned int header[5] = { image.m_width, image.m_height, image.m_depth, 
+                                       static_cast<unsigned int>(image.m_format), static_cast<unsigned int>(image.m_type) };
+      hash = hashBytes(header, sizeof(header), hash);
+      hash = hashBytes(image.m_pixels, image.m_nob, hash);
+    }
+  }
+  return hash;
+}
+
+void Picture::generateMipmaps(const MipmapFilter filter, const bool isSrgb)
+{
+  for (unsigned int index = 0; index < m_images.size(); ++index)
+  {
+    buildMipmaps(index, filter, isSrgb);
+  }
+}
+
 bool Picture::load(const std::string& filename)
 {
   bool success = false;
 
   m_images.clear(); // Each load() wipes previously loaded image data.
+  m_filename.clear();
 
   std::string foundFile = filename; // DAR FIXME Search at least the current working directory.
   if (foundFile.empty())
@@ -397,23 +1112,21 @@ bool Picture::load(const std::string& filename)
           ilActiveMipmap(0);
         }
 
-        setImageData(index, (const void*) ilGetData(), mipmaps);
+        // Determine how the decoded image needs to be oriented and apply that while copying the pixels.
+        ImageOrientation orientation = IMAGE_ORIENTATION_KEEP;
 
         if (isDDS && m_isCube)
         {
-          // WARNING:
-          // This piece of code MUST NOT be visited twice for the same image,
-          // because this would falsify the desired effect!
           // The images at this position are flipped at the x-axis (due to DevIL)
           // flipping at x-axis will result in original image
           // mirroring at y-axis will result in rotating the image 180 degree
           if (face == 0 || face == 1 || face == 4 || face == 5) // px, nx, pz, nz
           {
-            mirrorY(index); // mirror over y-axis
+            orientation = IMAGE_ORIENTATION_MIRROR_Y; // mirror over y-axis
           }
           else // py, ny
           {
-            mirrorX(index); // flip over x-axis
+            orientation = IMAGE_ORIENTATION_MIRROR_X; // flip over x-axis
           }
         }
 
@@ -424,10 +1137,13 @@ bool Picture::load(const std::string& filename)
           // for DDS cubemaps we handle the separate face rotations above
           // DAR FIXME This should only happen for DDS images. 
           // All others are flipped by DevIL because I set the origin to lower left. Handle DDS images the same?
-          mirrorX(index); // reverse rows 
+          orientation = IMAGE_ORIENTATION_MIRROR_X; // reverse rows 
         }
+
+        setImageData(index, (const void*) ilGetData(), mipmaps, orientation);
       }
     }
+    m_filename = filename;
     success = true;
   }
 
@@ -441,6 +1157,7 @@ bool Picture::load(const std::string& filename)
 void Picture::clear()
 {
   m_images.clear();
+  m_filename.clear();
 }
 
 
@@ -460,33 +1177,28 @@ unsigned int Picture::addImage(unsigned int width,
   return (unsigned int)(m_images.size() - 1);
 }
 
-bool Picture::copyMipmaps(unsigned int index, std::vector<const void*> const& mipmaps)
+bool Picture::copyMipmaps(unsigned int index, std::vector<const void*> const& mipmaps, const ImageOrientation orientation)
 {
   std::vector<Image>& images = m_images[index];
   
   MY_ASSERT(images.size()); // must hold at least the top level image
   
-  // Release existing mipmaps.
-  if (1 < images.size())
-  {
-    for (size_t i = 1; i < images.size(); ++i)
-    {
-      delete[] images[i].m_pixels;
-    }
-    images.resize(1);
-  }
+  // Release existing mipmaps. The Image destructor deletes the pixels.
+  images.resize(1);
 
   unsigned int numMipmaps = numberOfMipmaps(images[0].m_width, images[0].m_height, images[0].m_depth); // Includes LOD 0.
-  images.reserve(numMipmaps); // This needs the deep copy constructor!
   
-  // This demo doesn't contain code to generate mipmaps from arbitrary input data formats.
-  // If the provided number of mipmaps doesn't match the required number, keep only the LOD 0 image.
+  // If the provided number of mipmaps doesn't match the required number, generate the whole chain from the LOD 0 image.
+  // Whether the color is sRGB encoded is not known here, so this filters the components as they are.
   if (numMipmaps != mipmaps.size() + 1) // numMipmaps contains the base image LOD 0 as well, mipmaps doesn't.
   {
-    MY_ASSERT(!"Number of required mipmaps does not match number of provided mipmaps.");
-    return false; // This will leave the mipmaps unpopulated. There is no mipmap generation code present in this demo.
+    std::cerr << "WARNING: copyMipmaps() Number of provided mipmaps " << mipmaps.size() << " does not match " << numMipmaps - 1 << ", generating them.\n";
+    buildMipmaps(index, MIPMAP_FILTER_BOX, false);
+    return true;
   }
 
+  images.reserve(numMipmaps); // This needs the deep copy constructor!
+
   Image* src = &images[0];
 
   unsigned int w = src->m_width;
@@ -511,92 +1223,61 @@ bool Picture::copyMipmaps(unsigned int index, std::vector<const void*> const& mi
     Image* dst = &images.back(); // points to newly created Image
 
     dst->m_pixels = new unsigned char[dst->m_nob];
-    memcpy(dst->m_pixels, mipmaps[i], dst->m_nob);
+    copyImage(*dst, mipmaps[i], orientation);
   }
   return true; // succeeded if we get here
 }
 
-void Picture::setImageData(unsigned int index, const void* pixels, std::vector<const void*> const& mipmaps)
+void Picture::buildMipmaps(unsigned int index, const MipmapFilter filter, const bool isSrgb)
 {
   MY_ASSERT(index < m_images.size());
 
-  Image* image = &m_images[index][0]; // LOD 0 image
+  std::vector<Image>& images = m_images[index];
+  
+  MY_ASSERT(images.size() && images[0].m_pixels); // Needs the top level image.
 
-  if (image->m_pixels)
-  {
-    delete[] image->m_pixels;
-    image->m_pixels = nullptr;
-  }
+  images.resize(1);
 
-  image->m_pixels = new unsigned char[image->m_nob];
-
-  memcpy(image->m_pixels, pixels, image->m_nob);
+  const unsigned int numMipmaps = numberOfMipmaps(images[0].m_width, images[0].m_height, images[0].m_depth); // Includes LOD 0.
+  images.reserve(numMipmaps); // This needs the deep copy constructor!
 
-  // Consider mipmaps passed through mipmaps vector.
-  if (!mipmaps.empty())
+  for (unsigned int i = 1; i < numMipmaps; ++i)
   {
-    copyMipmaps(index, mipmaps);
-  }
-}
+    const Image& src = images[i - 1];
 
-void Picture::mirrorX(unsigned int index)
-{
-  MY_ASSERT(index < m_images.size());
+    const unsigned int w = (1 < src.m_width)  ? src.m_width  >> 1 : 1;
+    const unsigned int h = (1 < src.m_height) ? src.m_height >> 1 : 1;
+    const unsigned int d = (1 < src.m_depth)  ? src.m_depth  >> 1 : 1;
 
-  // Flip all images upside down.
-  for (size_t i = 0; i < m_images[index].size(); ++i)
-  {
-    Image* image = &m_images[index][i];
+    images.push_back(Image(w, h, d, src.m_format, src.m_type)); // Doesn't reallocate, src stays valid.
 
-    const unsigned char* srcPixels = image->m_pixels;
-    unsigned char*       dstPixels = new unsigned char[image->m_nob];
+    Image& dst = images.back();
 
-    for (unsigned int z = 0; z < image->m_depth; ++z) 
-    {
-      for (unsigned int y = 0; y < image->m_height; ++y) 
-      {
-        const unsigned char* srcLine = srcPixels + z * image->m_bps + y * image->m_bpl;
-        unsigned char*       dstLine = dstPixels + z * image->m_bps + (image->m_height - 1 - y) * image->m_bpl;
-      
-        memcpy(dstLine, srcLine, image->m_bpl);
-      }
-    }
-    delete[] image->m_pixels;
-    image->m_pixels = dstPixels;
+    dst.m_pixels = new unsigned char[dst.m_nob];
+    downsampleImage(src, dst, filter, isSrgb);
   }
 }
 
-void Picture::mirrorY(unsigned int index)
+void Picture::setImageData(unsigned int index, const void* pixels, std::vector<const void*> const& mipmaps, const ImageOrientation orientation)
 {
   MY_ASSERT(index < m_images.size());
 
-  // Mirror all images left to right.
-  for (size_t i = 0; i < m_images[index].size(); ++i)
-  {
-    Image* image = &m_images[index][i];
-
-    const unsigned char* srcPixels = image->m_pixels;
-    unsigned char*       dstPixels = new unsigned char[image->m_nob];
+  Image* image = &m_images[index][0]; // LOD 0 image
 
-    for (unsigned int z = 0; z < image->m_depth; ++z) 
-    {
-      for (unsigned int y = 0; y < image->m_height; ++y) 
-      {
-        const unsigned char* srcLine = srcPixels + z * image->m_bps + y * image->m_bpl;
-        unsigned char*       dstLine = dstPixels + z * image->m_bps + y * image->m_bpl;
+  if (image->m_pixels)
+  {
+    delete[] image->m_pixels;
+    image->m_pixels = nullptr;
+  }
 
-        for (unsigned int x = 0; x < image->m_width; ++x) 
-        {
-          const unsigned char* srcPixel = srcLine + x * image->m_bpp;
-          unsigned char*       dstPixel = dstLine + (image->m_width - 1 - x) * image->m_bpp;
+  image->m_pixels = new unsigned char[image->m_nob];
 
-          memcpy(dstPixel, srcPixel, image->m_bpp);
-        }
-      }
-    }
+  copyImage(*image, pixels, orientation);
 
-    delete[] image->m_pixels;
-    image->m_pixels = dstPixels;
+  // Consider mipmaps passed through mipmaps vector.
+  if (!mipmaps.empty())
+  {
+    copyMipmaps(index, mipmaps, orientation);
   }
 }
 
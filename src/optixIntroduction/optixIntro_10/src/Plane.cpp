@@ -26,7 +26,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "inc/Application.h"
+#include "inc/Shapes.h"
 
 #include <cstring>
 #include <iostream>
@@ -34,7 +34,7 @@
 
 #include "inc/MyAssert.h"
 
-optix::Geometry Application::createPlane(const int tessU, const int tessV, const int upAxis)
+void generatePlane(const int tessU, const int tessV, const int upAxis, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices)
 {
   MY_ASSERT(1 <= tessU && 1 <= tessV);
 
@@ -43,8 +43,6 @@ optix::Geometry Application::createPlane(const int tessU, const int tessV, const
   
   optix::float3 corner;
 
-  std::vector<VertexAttributes> attributes;
-  
   VertexAttributes attrib;
 
   switch (upAxis)
@@ -116,8 +114,6 @@ optix::Geometry Application::createPlane(const int tessU, const int tessV, const
       break;
   }
 
-  std::vector<unsigned int> indices;
-  
   const unsigned int stride = tessU + 1;
   for (int j = 0; j < tessV; ++j)
   {
@@ -134,6 +130,4 @@ optix::Geometry Application::createPlane(const int tessU, const int tessV, const
   }
 
   std::cout << "createPlane(" << upAxis << "): Vertices = " << attributes.size() <<  ", Triangles = " << indices.size() / 3 << std::endl;
-
-  return createGeometry(attributes, indices);
 }
@@ -0,0 +1,342 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/SamplingBenchmark.h"
+
+#include "inc/Texture.h"
+#include "inc/Timer.h"
+
+#include "shaders/environment_sampling.h"
+
+#include <HDRLoader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI  3.14159265358979323846264338327950288419716939937510
+#endif
+
+// Number of samples per method. Enough for a few thousand samples per histogram bin.
+#define BENCHMARK_SAMPLES (1 << 22)
+// Histogram resolution of the distribution test. Not aligned to the texels, so it also checks the sampling inside the texels.
+#define BENCHMARK_BINS_U 64
+#define BENCHMARK_BINS_V 32
+// Maximum absolute error of the float CDFs against the double precision reference.
+#define CDF_TOLERANCE 1.0e-6
+
+
+// Range of histogram bins [first, last) overlapped by the texel i of cells texels.
+// Texels may span several bins and bins may span several texels, so any image size works.
+static void texelBins(const unsigned int i, const unsigned int cells, const unsigned int bins,
+                      unsigned int& first, unsigned int& last)
+{
+  first = static_cast<unsigned int>(double(i) * double(bins) / double(cells));
+  last  = std::min(static_cast<unsigned int>(ceil(double(i + 1) * double(bins) / double(cells))), bins);
+}
+
+// Fraction of the texel i of cells texels which falls into the histogram bin.
+static double texelWeight(const unsigned int i, const unsigned int cells, const unsigned int bins, const unsigned int bin)
+{
+  const double lo = double(i)     * double(bins) / double(cells);
+  const double hi = double(i + 1) * double(bins) / double(cells);
+
+  return std::max(std::min(hi, double(bin + 1)) - std::max(lo, double(bin)), 0.0) / (hi - lo);
+}
+
+// Expected probability per histogram bin of the piecewise constant distribution described by the CDFs.
+static void expectedHistogram(Texture const& texture, const unsigned int binsU, const unsigned int binsV, std::vector<double>& histogram)
+{
+  const unsigned int width  = texture.getWidth();
+  const unsigned int height = texture.getHeight();
+
+  const float* cdfU = texture.getCDF_U().data();
+  const float* cdfV = texture.getCDF_V().data();
+
+  histogram.assign(binsU * binsV, 0.0);
+
+  for (unsigned int y = 0; y < height; ++y)
+  {
+    const double pv = double(cdfV[y + 1]) - double(cdfV[y]);
+    
+    unsigned int firstV;
+    unsigned int lastV;
+    texelBins(y, height, binsV, firstV, lastV);
+
+    const float* row = cdfU + y * (width + 1);
+    for (unsigned int x = 0; x < width; ++x)
+    {
+      const double p = pv * (double(row[x + 1]) - double(row[x]));
+
+      unsigned int firstU;
+      unsigned int lastU;
+      texelBins(x, width, binsU, firstU, lastU);
+
+      for (unsigned int binV = firstV; binV < lastV; ++binV)
+      {
+        const double weightV = texelWeight(y, height, binsV, binV);
+        for (unsigned int binU = firstU; binU < lastU; ++binU)
+        {
+          histogram[binV * binsU + binU] += p * weightV * texelWeight(x, width, binsU, binU);
+        }
+      }
+    }
+  }
+}
+
+// Straightforward double precision implementation of Texture::calculateCDF() with the 2D 3x3 Gaussian filter.
+// Returns the unnormalized row and marginal function values, from which the exact CDFs follow.
+static double referenceCDF(const float* rgba, const unsigned int width, const unsigned int height,
+                           std::vector<double>& cdfU, std::vector<double>& cdfV)
+{
+  const double weights[3] = { 0.106507, 0.786986, 0.106507 }; // exp(-2) / (1 + 2 * exp(-2)) and 1 / (1 + 2 * exp(-2))
+
+  cdfU.assign((width + 1) * height, 0.0);
+  cdfV.assign(height + 1, 0.0);
+
+  double sum = 0.0;
+  for (unsigned int y = 0; y < height; ++y)
+  {
+    const double sinTheta = sin(M_PI * (double(y) + 0.5) / double(height));
+    double* row = cdfU.data() + y * (width + 1);
+
+    for (unsigned int x = 0; x < width; ++x)
+    {
+      double value = 0.0;
+      for (int j = -1; j <= 1; ++j)
+      {
+        const unsigned int yy = std::min(std::max(int(y) + j, 0), int(height) - 1); // clamp
+        for (int i = -1; i <= 1; ++i)
+        {
+          const unsigned int xx = (x + width + i) % width; // repeat
+          const float* p = rgba + (yy * width + xx) * 4;
+          value += weights[j + 1] * weights[i + 1] * (double(p[0]) + double(p[1]) + double(p[2])) / 3.0;
+        }
+      }
+      row[x + 1] = row[x] + value * sinTheta;
+
+      const float* p = rgba + (y * width + x) * 4;
+      sum += (double(p[0]) + double(p[1]) + double(p[2])) / 3.0 * sinTheta;
+    }
+    cdfV[y + 1] = cdfV[y] + row[width];
+
+    for (unsigned int x = 1; x <= width; ++x)
+    {
+      row[x] = (row[width] != 0.0) ? row[x] / row[width] : double(x) / double(width);
+    }
+  }
+
+  const double integral = cdfV[height];
+  for (unsigned int y = 1; y <= height; ++y)
+  {
+    cdfV[y] = (integral != 0.0) ? cdfV[y] / integral : double(y) / double(height);
+  }
+  
+  return sum * 2.0 * M_PI * M_PI / double(width * height);
+}
+
+// Bounds the error of the float CDFs and the integral of the texture against the double precision reference.
+static bool testCDF(Texture const& texture, const float* rgba)
+{
+  const unsigned int width  = texture.getWidth();
+  const unsigned int height = texture.getHeight();
+
+  Timer timer;
+  timer.start();
+
+  std::vector<double> cdfU;
+  std::vector<double> cdfV;
+  const double integral = referenceCDF(rgba, width, height, cdfU, cdfV);
+
+  const double timeReference = timer.getTime();
+
+  double errorU = 0.0;
+  for (size_t i = 0; i < cdfU.size(); ++i)
+  {
+    errorU = std::max(errorU, fabs(double(texture.getCDF_U()[i]) - cdfU[i]));
+  }
+  double errorV = 0.0;
+  for (size_t i = 0; i < cdfV.size(); ++i)
+  {
+    errorV = std::max(errorV, fabs(double(texture.getCDF_V()[i]) - cdfV[i]));
+  }
+  const double errorIntegral = fabs(double(texture.getIntegral()) - integral) / integral;
+
+  const bool passed = (errorU <= CDF_TOLERANCE) && (errorV <= CDF_TOLERANCE) && (errorIntegral <= CDF_TOLERANCE);
+
+  std::cout << "  Reference CDFs = " << timeReference << " seconds, max error CDF_U = " << errorU << ", CDF_V = " << errorV
+            << ", relative error integral = " << errorIntegral << (passed ? " (passed)" : " (FAILED)") << std::endl;
+
+  return passed;
+}
+
+// Pearson's chi-square test of the sampled texture coordinates against the expected bin probabilities.
+// Bins expecting less than five samples are lumped together. Returns false for deviations of more than five sigma.
+static bool testDistribution(const char* name, std::vector<optix::float2> const& uv,
+                             const unsigned int binsU, const unsigned int binsV, std::vector<double> const& expected)
+{
+  std::vector<unsigned int> counts(binsU * binsV, 0);
+
+  for (size_t i = 0; i < uv.size(); ++i)
+  {
+    const unsigned int u = std::min(static_cast<unsigned int>(uv[i].x * float(binsU)), binsU - 1);
+    const unsigned int v = std::min(static_cast<unsigned int>(uv[i].y * float(binsV)), binsV - 1);
+    counts[v * binsU + u]++;
+  }
+
+  const double samples = double(uv.size());
+
+  double chi2 = 0.0;
+  int    dof  = -1; // Sum of the counts is fixed.
+  double restExpected = 0.0;
+  double restObserved = 0.0;
+
+  for (size_t i = 0; i < counts.size(); ++i)
+  {
+    const double e = expected[i] * samples;
+    if (e < 5.0)
+    {
+      restExpected += e;
+      restObserved += counts[i];
+      continue;
+    }
+    chi2 += (counts[i] - e) * (counts[i] - e) / e;
+    ++dof;
+  }
+  if (5.0 <= restExpected)
+  {
+    chi2 += (restObserved - restExpected) * (restObserved - restExpected) / restExpected;
+    ++dof;
+  }
+  else if (restObserved != 0.0 && restExpected == 0.0) // Samples where the distribution is zero.
+  {
+    chi2 = HUGE_VAL;
+  }
+
+  const bool passed = (0 < dof) && (chi2 - double(dof) <= 5.0 * sqrt(2.0 * double(dof)));
+
+  std::cout << "  " << name << ": chi-square = " << chi2 << " for " << dof << " degrees of freedom "
+            << (passed ? "(passed)" : "(FAILED)") << std::endl;
+
+  return passed;
+}
+
+// Best of three runs to get stable throughput numbers.
+template <typename Sampler>
+static double timeSampling(std::vector<optix::float2> const& samples, std::vector<optix::float2>& uv, Sampler sampler)
+{
+  Timer timer;
+  double best = 0.0;
+
+  for (int run = 0; run < 3; ++run)
+  {
+    timer.restart();
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+      uv[i] = sampler(samples[i]);
+    }
+    const double seconds = timer.getTime();
+    best = (run == 0) ? seconds : std::min(best, seconds);
+  }
+  return double(samples.size()) / best * 1.0e-6;
+}
+
+bool benchmarkEnvironmentSampling(std::string const& filename)
+{
+  Timer timer;
+  timer.start();
+
+  HDRLoader hdr(filename);
+  if (hdr.failed())
+  {
+    std::cerr << "ERROR: benchmarkEnvironmentSampling() Loading " << filename << " failed." << std::endl;
+    return false;
+  }
+
+  // The benchmark doesn't care that the rows are upside down here.
+  Texture texture;
+  texture.setAliasTables(true);
+  texture.createEnvironment(hdr.raster(), hdr.width(), hdr.height());
+
+  const double timeLoad = timer.getTime();
+  texture.calculateCDF();
+  const double timeTables = timer.getTime() - timeLoad;
+
+  const unsigned int width  = texture.getWidth();
+  const unsigned int height = texture.getHeight();
+
+  std::cout << "benchmarkEnvironmentSampling(): " << filename << " (" << width << " x " << height << ")" << std::endl;
+  std::cout << "  CDFs and alias tables = " << timeTables << " seconds" << std::endl;
+
+  bool passed = testCDF(texture, hdr.raster());
+
+  const HostTable2D<float> cdfU = { texture.getCDF_U().data(), width + 1, height };
+  const HostTable1D<float> cdfV = { texture.getCDF_V().data(), height + 1 };
+
+  const HostTable2D<optix::float2> aliasU = { texture.getAlias_U().data(), width, height };
+  const HostTable1D<optix::float2> aliasV = { texture.getAlias_V().data(), height };
+
+  // 24 bit uniform samples in [0, 1) like the device random number generator returns.
+  std::mt19937 rng(12345);
+  std::vector<optix::float2> samples(BENCHMARK_SAMPLES);
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    const float u = float(rng() >> 8) * (1.0f / 16777216.0f);
+    const float v = float(rng() >> 8) * (1.0f / 16777216.0f);
+    samples[i] = optix::make_float2(u, v);
+  }
+
+  const unsigned int binsU = std::min(width,  static_cast<unsigned int>(BENCHMARK_BINS_U));
+  const unsigned int binsV = std::min(height, static_cast<unsigned int>(BENCHMARK_BINS_V));
+
+  std::vector<double> expected;
+  expectedHistogram(texture, binsU, binsV, expected);
+
+  std::vector<optix::float2> uv(samples.size());
+
+  const double rateCDF = timeSampling(samples, uv, [&](const optix::float2 sample)
+  {
+    return sampleEnvironmentCDF(cdfU, cdfV, sample);
+  });
+  std::cout << "  CDF:   " << rateCDF << " Msamples/s" << std::endl;
+  passed = testDistribution("CDF  ", uv, binsU, binsV, expected) && passed;
+
+  const double rateAlias = timeSampling(samples, uv, [&](const optix::float2 sample)
+  {
+    return sampleEnvironmentAlias(aliasU, aliasV, sample);
+  });
+  std::cout << "  Alias: " << rateAlias << " Msamples/s, speedup " << rateAlias / rateCDF << std::endl;
+  passed = testDistribution("Alias", uv, binsU, binsV, expected) && passed;
+
+  return passed;
+}
@@ -0,0 +1,247 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shaders/app_config.h"
+
+#include "inc/Scene.h"
+#include "inc/Shapes.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_quaternion_namespace.h>
+
+#include <cmath>
+#include <cstring>
+
+#include "shaders/per_ray_data.h"
+
+
+void initSceneMaterials(std::vector<MaterialParameterGUI>& materials)
+{
+  // Setup GUI material parameters, one for each of the implemented BSDFs.
+  // Cutout opacity is not an option which can be switched dynamically in this demo.
+  // That would require to use the anyhit cutout version for all materials which is a performance impact.
+  // Currently only the object which uses this material parameter instance has the cutout opacity assigned.
+
+  // It's recommended that cutout opacity materials are always thin-walled.
+  // Transparent volumetric materials would look strange otherwise.
+
+  MaterialParameterGUI parameters;
+
+  // Lambert material (for the floor)
+  parameters.indexBSDF           = INDEX_BSDF_DIFFUSE_REFLECTION; // Index into sysSampleBSDF and sysEvalBSDF.
+  parameters.albedo              = optix::make_float3(0.5f); // Grey. (Modulates the albedo texture.)
+  parameters.useAlbedoTexture    = true; // Enabled just to distinguish the resulting image from the non HDR DL Denoiser used in optixIntro_09.
+  parameters.useCutoutTexture    = false;
+  parameters.thinwalled          = false;
+  parameters.absorptionColor     = optix::make_float3(1.0f);
+  parameters.volumeDistanceScale = 1.0f;
+  parameters.ior                 = 1.5f;
+  materials.push_back(parameters); // 0
+
+  // Lambert material with cutout opacity.
+  parameters.indexBSDF           = INDEX_BSDF_DIFFUSE_REFLECTION;
+  parameters.albedo              = optix::make_float3(0.6f, 0.0f, 0.0f); // Red.
+  parameters.useAlbedoTexture    = false;
+  parameters.useCutoutTexture    = true;
+  parameters.thinwalled          = true; // Materials with cutout opacity should always be thinwalled.
+  parameters.absorptionColor     = optix::make_float3(0.25f);
+  parameters.volumeDistanceScale = 1.0f;
+  parameters.ior                 = 1.5f;
+  materials.push_back(parameters); // 1
+
+  // Water material.
+  parameters.indexBSDF           = INDEX_BSDF_SPECULAR_REFLECTION_TRANSMISSION;
+  parameters.albedo              = optix::make_float3(1.0f);
+  parameters.useAlbedoTexture    = false;
+  parameters.useCutoutTexture    = false;
+  parameters.thinwalled          = false;
+  parameters.absorptionColor     = optix::make_float3(0.980392f, 0.729412f, 0.470588f); // My favorite test color.
+  parameters.volumeDistanceScale = 1.0f;
+  parameters.ior                 = 1.33f; // Water
+  materials.push_back(parameters); // 2
+
+  // Tinted mirror material.
+  parameters.indexBSDF           = INDEX_BSDF_SPECULAR_REFLECTION;
+  parameters.albedo              = optix::make_float3(0.2f, 0.2f, 0.8f); // Not full primary color to get nice HDR highlights.
+  parameters.useAlbedoTexture    = false;
+  parameters.useCutoutTexture    = false;
+  parameters.thinwalled          = false;
+  parameters.absorptionColor     = optix::make_float3(0.6f, 0.6f, 0.8f);
+  parameters.volumeDistanceScale = 1.0f;
+  parameters.ior                 = 1.33f;
+  materials.push_back(parameters); // 3
+}
+
+// The albedoID and cutoutID are the bindless texture IDs to use when the GUI parameters enable the textures.
+void convertMaterialParameter(MaterialParameterGUI const& src, const int albedoID, const int cutoutID, MaterialParameter& dst)
+{
+  dst.indexBSDF  = src.indexBSDF;
+  dst.albedo     = src.albedo;
+  dst.albedoID   = (src.useAlbedoTexture) ? albedoID : RT_TEXTURE_ID_NULL;
+  dst.cutoutID   = (src.useCutoutTexture) ? cutoutID : RT_TEXTURE_ID_NULL;
+  dst.flags      = (src.thinwalled) ? FLAG_THINWALLED : 0;
+  // Calculate the effective absorption coefficient from the GUI parameters. This is one reason why there are two structures.
+  // Prevent logf(0.0f) which results in infinity.
+  const float x = (0.0f < src.absorptionColor.x) ? -logf(src.absorptionColor.x) : RT_DEFAULT_MAX;
+  const float y = (0.0f < src.absorptionColor.y) ? -logf(src.absorptionColor.y) : RT_DEFAULT_MAX;
+  const float z = (0.0f < src.absorptionColor.z) ? -logf(src.absorptionColor.z) : RT_DEFAULT_MAX;
+  dst.absorption = optix::make_float3(x, y, z) * src.volumeDistanceScale;
+  dst.ior        = src.ior;
+}
+
+
+// Scene testing all materials on a plane, a box, a sphere and a torus.
+void createSceneObjects(std::vector<SceneObject>& objects)
+{
+  objects.resize(4);
+
+  // Add a ground plane on the xz-plane at y = 0.0f.
+  SceneObject& plane = objects[0];
+
+  generatePlane(1, 1, 1, plane.attributes, plane.indices);
+
+  // Scale the plane to go from -8 to 8.
+  const float trafoPlane[16] =
+  {
+    8.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 8.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 8.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f
+  };
+  plane.materialIndex = 0;
+  plane.motion        = false;
+  memcpy(plane.matrix, trafoPlane, sizeof(trafoPlane));
+
+  // Add a box (no tessellation here, using just 12 triangles)
+  SceneObject& box = objects[1];
+
+  generateBox(box.attributes, box.indices);
+
+  const float trafoBox[16] =
+  {
+    1.0f, 0.0f, 0.0f, -3.0f, // Move to the left.
+    0.0f, 1.0f, 0.0f, 1.25f, // The box is modeled with unit coordinates in the range [-1, 1], Move it above the floor plane.
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f
+  };
+  box.materialIndex = 1; // This one has cutout opacity.
+  box.motion        = false;
+  memcpy(box.matrix, trafoBox, sizeof(trafoBox));
+
+  // Add a tessellated sphere with 180 longitudes and 90 latitudes, radius 1.0f and fully closed at the upper pole.
+  SceneObject& sphere = objects[2];
+
+  generateSphere(180, 90, 1.0f, M_PIf, sphere.attributes, sphere.indices);
+
+  // Motion blur disabled to show the denoiser better on caustics through the water sphere.
+  const float trafoSphere[16] =
+  {
+    1.0f, 0.0f, 0.0f, 0.0f,  // In the center, to the right of the box.
+    0.0f, 1.0f, 0.0f, 1.25f, // The sphere is modeled with radius 1.0f. Move it above the floor plane.
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f
+  };
+  sphere.materialIndex = 2; // Water material.
+  sphere.motion        = false;
+  memcpy(sphere.matrix, trafoSphere, sizeof(trafoSphere));
+
+  // Add a torus. 
+  SceneObject& torus = objects[3];
+
+  generateTorus(180, 180, 0.75f, 0.25f, torus.attributes, torus.indices);
+
+  torus.materialIndex = 3; // Tinted mirror material.
+
+  const float trafoTorus[16] =
+  {
+    1.0f, 0.0f, 0.0f, 2.5f,  // Move it to the right of the sphere.
+    0.0f, 1.0f, 0.0f, 1.25f, // The torus has an outer radius of 0.5f. Move it above the floor plane.
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f
+  };
+  memcpy(torus.matrix, trafoTorus, sizeof(trafoTorus));
+
+#if 1 // Keep motion blur active on the torus to show it together with the denoiser.
+
+  // Implement Scale-Rotation-Translation (SRT) motion blur on the torus.
+  // Move to the right, along the positive x-axis and roll around that axis by 180 degrees.
+
+  // Rotation angle is in degrees in the optixQuaternion class.
+  const optix::float3 axis = optix::make_float3(1.0f, 0.0f, 0.0f);
+  const optix::Quaternion quat0(axis,   0.0f);
+  const optix::Quaternion quat1(axis, 180.0f);
+    
+  const float keysSRT[2 * 16] = 
+  {
+    // Refer to the OptiX Programming Guide which explains what these 16 values per motion key are doing.
+    // All Geometries in this demo are modeled around the origin in object coordinates, which is the pivot point (px, py, pz) for the rotation.
+    //sx,   a,    b,    px,   sy,   c,    py,   sz,   pz,   qx,          qy,          qz,          qw,          tx,   ty,    tz
+      1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, quat0.m_q.x, quat0.m_q.y, quat0.m_q.z, quat0.m_q.w, 2.5f, 1.25f, 0.0f,
+      1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, quat1.m_q.x, quat1.m_q.y, quat1.m_q.z, quat1.m_q.w, 5.0f, 1.25f, 0.0f
+  };
+
+  torus.motion = true;
+  memcpy(torus.keysSRT, keysSRT, sizeof(keysSRT));
+#else
+  torus.motion = false;
+#endif
+}
+
+
+// Defaults for all fields. Position, vectors and area are unused in environment lights.
+void initLightDefinition(LightDefinition& light)
+{
+  light.type     = LIGHT_ENVIRONMENT;
+  light.position = optix::make_float3(0.0f, 0.0f, 0.0f);
+  light.vecU     = optix::make_float3(1.0f, 0.0f, 0.0f);
+  light.vecV     = optix::make_float3(0.0f, 1.0f, 0.0f);
+  light.normal   = optix::make_float3(0.0f, 0.0f, 1.0f);
+  light.area     = 1.0f;
+  light.emission = optix::make_float3(1.0f, 1.0f, 1.0f);
+  // Fields with bindless texture and buffer IDs and the integral for a spherical environment map.
+  light.idEnvironmentTexture = RT_TEXTURE_ID_NULL;
+  light.environmentIntegral  = 1.0f;
+  light.idEnvironmentCDF_U   = RT_BUFFER_ID_NULL;
+  light.idEnvironmentCDF_V   = RT_BUFFER_ID_NULL;
+  light.idEnvironmentAlias_U = RT_BUFFER_ID_NULL;
+  light.idEnvironmentAlias_V = RT_BUFFER_ID_NULL;
+}
+
+// A square area light over the scene objects.
+void initAreaLight(LightDefinition& light)
+{
+  light.type      = LIGHT_PARALLELOGRAM;                    // A geometric area light with diffuse emission distribution function.
+  light.position  = optix::make_float3(-0.5f, 4.0f, -0.5f); // Corner position.
+  light.vecU      = optix::make_float3(1.0f, 0.0f, 0.0f);   // To the right.
+  light.vecV      = optix::make_float3(0.0f, 0.0f, 1.0f);   // To the front. 
+  optix::float3 n = optix::cross(light.vecU, light.vecV);   // Length of the cross product is the area.
+  light.area     = optix::length(n);                        // Calculate the world space area of that rectangle, unit is [m^2]
+  light.normal   = n / light.area;                          // Normalized normal
+  light.emission = optix::make_float3(100.0f);              // Radiant exitance in Watt/m^2.
+}
@@ -26,7 +26,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "inc/Application.h"
+#include "inc/Shapes.h"
 
 #include <cstring>
 #include <iostream>
@@ -34,14 +34,12 @@
 
 #include "inc/MyAssert.h"
 
-optix::Geometry Application::createSphere(const int tessU, const int tessV, const float radius, const float maxTheta)
+void generateSphere(const int tessU, const int tessV, const float radius, const float maxTheta, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices)
 {
   MY_ASSERT(3 <= tessU && 3 <= tessV);
 
-  std::vector<VertexAttributes> attributes;
   attributes.reserve((tessU + 1) * tessV);
 
-  std::vector<unsigned int> indices;
   indices.reserve(6 * tessU * (tessV - 1));
 
   float phi_step   = 2.0f * M_PIf / (float) tessU;
@@ -103,6 +101,4 @@ optix::Geometry Application::createSphere(const int tessU, const int tessV, cons
   }
   
   std::cout << "createSphere(): Vertices = " << attributes.size() <<  ", Triangles = " << indices.size() / 3 << std::endl;
-
-  return createGeometry(attributes, indices);
 }
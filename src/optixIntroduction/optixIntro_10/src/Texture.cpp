@@ -26,7 +26,11 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "shaders/app_config.h"
+
 #include "inc/Texture.h"
+#include "inc/BlockCache.h"
+#include "inc/EnvironmentCache.h"
 
 #include <IL/il.h>
 
@@ -37,9 +41,21 @@
 #include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <vector>
+
+// DAR Fork-join helpers from sutil to calculate the CDFs in parallel.
+#include <Parallel.h>
 
 #include "inc/MyAssert.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#define TEXTURE_SSE 1
+#endif
+
 
 #ifndef M_PI
 #define M_PI  3.14159265358979323846264338327950288419716939937510
@@ -54,11 +70,19 @@ Texture::Texture()
 , m_format(RT_FORMAT_UNSIGNED_BYTE)
 , m_readMode(RT_TEXTURE_READ_NORMALIZED_FLOAT)
 , m_indexMode(RT_TEXTURE_INDEX_NORMALIZED_COORDINATES)
+, m_aliasTables(USE_ENVIRONMENT_ALIAS_TABLES != 0)
 , m_integral(0.0f)
 , m_bufferCDF_U(nullptr)
 , m_bufferCDF_V(nullptr)
+, m_bufferAlias_U(nullptr)
+, m_bufferAlias_V(nullptr)
 , m_buffer(nullptr)
 , m_sampler(nullptr)
+, m_compression(TEXTURE_COMPRESSION_NONE)
+, m_compressionQuality(BLOCK_QUALITY_NORMAL)
+, m_compressionCache(true)
+, m_blockFormat(BLOCK_FORMAT_NONE)
+, m_deviceSize(0)
 {
 }
 
@@ -78,9 +102,21 @@ Texture::Texture(const Texture &rhs)
 , m_buffer(rhs.m_buffer)
 , m_sampler(rhs.m_sampler)
 , m_texels(rhs.m_texels)
+, m_cdfU(rhs.m_cdfU)
+, m_cdfV(rhs.m_cdfV)
+, m_aliasTables(rhs.m_aliasTables)
+, m_aliasU(rhs.m_aliasU)
+, m_aliasV(rhs.m_aliasV)
 , m_integral(rhs.m_integral)
 , m_bufferCDF_U(rhs.m_bufferCDF_U)
 , m_bufferCDF_V(rhs.m_bufferCDF_V)
+, m_bufferAlias_U(rhs.m_bufferAlias_U)
+, m_bufferAlias_V(rhs.m_bufferAlias_V)
+, m_compression(rhs.m_compression)
+, m_compressionQuality(rhs.m_compressionQuality)
+, m_compressionCache(rhs.m_compressionCache)
+, m_blockFormat(rhs.m_blockFormat)
+, m_deviceSize(rhs.m_deviceSize)
 {
 }
  
@@ -98,13 +134,80 @@ Texture& Texture::operator=(const Texture & rhs)
     m_buffer      = rhs.m_buffer;
     m_sampler     = rhs.m_sampler;
     m_texels      = rhs.m_texels;
+    m_cdfU        = rhs.m_cdfU;
+    m_cdfV        = rhs.m_cdfV;
+    m_aliasTables = rhs.m_aliasTables;
+    m_aliasU      = rhs.m_aliasU;
+    m_aliasV      = rhs.m_aliasV;
     m_integral    = rhs.m_integral;
     m_bufferCDF_U = rhs.m_bufferCDF_U;
     m_bufferCDF_V = rhs.m_bufferCDF_V;
+    m_bufferAlias_U = rhs.m_bufferAlias_U;
+    m_bufferAlias_V = rhs.m_bufferAlias_V;
+    m_compression        = rhs.m_compression;
+    m_compressionQuality = rhs.m_compressionQuality;
+    m_compressionCache   = rhs.m_compressionCache;
+    m_blockFormat        = rhs.m_blockFormat;
+    m_deviceSize         = rhs.m_deviceSize;
   }
   return *this;
 }
 
+// The OptiX buffer formats of the block compressed textures.
+static RTformat blockBufferFormat(const BlockFormat format)
+{
+#if (OPTIX_VERSION >= 60000)
+  switch (format)
+  {
+    case BLOCK_FORMAT_BC1:
+      return RT_FORMAT_UNSIGNED_BC1;
+    case BLOCK_FORMAT_BC3:
+      return RT_FORMAT_UNSIGNED_BC3;
+    case BLOCK_FORMAT_BC5:
+      return RT_FORMAT_UNSIGNED_BC5;
+    case BLOCK_FORMAT_BC6H:
+      return RT_FORMAT_UNSIGNED_BC6H;
+    default:
+      break;
+  }
+#endif
+  MY_ASSERT(!"blockBufferFormat() No buffer format for this block format.");
+  return RT_FORMAT_UNKNOWN;
+}
+
+// Only unsigned byte images are checked, these are the ones which get BC1 or BC3.
+static bool hasTranslucency(const Image* image)
+{
+  unsigned int offset;
+  unsigned int stride;
+  switch (image->m_format)
+  {
+    case IL_RGBA:
+    case IL_BGRA:
+      offset = 3;
+      stride = 4;
+      break;
+    case IL_LUMINANCE_ALPHA:
+      offset = 1;
+      stride = 2;
+      break;
+    case IL_ALPHA:
+      offset = 0;
+      stride = 1;
+      break;
+    default:
+      return false;
+  }
+  for (unsigned int i = offset; i < image->m_nob; i += stride)
+  {
+    if (image->m_pixels[i] != 255)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool Texture::createSampler(optix::Context context,
                             const Picture* picture,
                             bool useSrgb,         // = false // Affects the read mode. Only applied to unsigned byte formats.
@@ -145,6 +248,13 @@ bool Texture::createSampler(optix::Context context,
       m_height = image->m_height;
       m_depth  = image->m_depth;
 
+      m_blockFormat = determineBlockFormat(picture, useMipmaps && 1 < numFaces);
+
+      // Block compressed buffers are sized in blocks. The read mode of the uncompressed format applies.
+      const RTformat     bufferFormat = (m_blockFormat != BLOCK_FORMAT_NONE) ? blockBufferFormat(m_blockFormat) : m_format;
+      const unsigned int bufferWidth  = (m_blockFormat != BLOCK_FORMAT_NONE) ? (m_width  + 3) / 4 : m_width;
+      const unsigned int bufferHeight = (m_blockFormat != BLOCK_FORMAT_NONE) ? (m_height + 3) / 4 : m_height;
+
       m_sampler = context->createTextureSampler();
 
       // Set working wrap mode defaults.
@@ -198,7 +308,7 @@ bool Texture::createSampler(optix::Context context,
         else if (1 < m_height) // 2D Texture
         {
           MY_ASSERT(m_depth == 1);
-          m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, m_width, m_height);
+          m_buffer = context->createBuffer(RT_BUFFER_INPUT, bufferFormat, bufferWidth, bufferHeight);
         }
         else if (1 <= m_width) // 1D Texture.
         {
@@ -221,7 +331,7 @@ bool Texture::createSampler(optix::Context context,
         if (m_width == m_height && m_depth == 1) // Cubemap images are each square and a single slices.
         {
           // The six cubemap sides are downloaded as six slices in a 3D texture!
-          m_buffer = context->createBuffer(RT_BUFFER_INPUT | RT_BUFFER_CUBEMAP, m_format, m_width, m_height, 6);
+          m_buffer = context->createBuffer(RT_BUFFER_INPUT | RT_BUFFER_CUBEMAP, bufferFormat, bufferWidth, bufferHeight, 6);
 
           if (useMipmaps && 1 < numFaces)
           {
@@ -242,8 +352,13 @@ bool Texture::createSampler(optix::Context context,
     }
 
     // If the TextureSampler and Buffer could be created, fill the buffer with the pixel data.
+    m_deviceSize = 0;
 
-    if (!isCubemap) // 1D, 2D 3D with optional mipmaps. No layered texture support in this routine!
+    if (m_blockFormat != BLOCK_FORMAT_NONE)
+    {
+      uploadBlocks(picture, hostEncoding, (useMipmaps) ? numFaces : 1);
+    }
+    else if (!isCubemap) // 1D, 2D 3D with optional mipmaps. No layered texture support in this routine!
     {
       unsigned int numFaces = picture->getNumberOfFaces(0); // This is the number of mipmap levels including LOD 0.
 
@@ -256,6 +371,8 @@ bool Texture::createSampler(optix::Context context,
           void *dst = m_buffer->map(indexFace, RT_BUFFER_MAP_WRITE_DISCARD);
           convert(dst, image->m_pixels, image->m_width * image->m_height * image->m_depth, hostEncoding);
           m_buffer->unmap(indexFace);
+
+          m_deviceSize += size_t(image->m_width) * image->m_height * image->m_depth * getElementSize();
         }
       }
     }
@@ -281,6 +398,8 @@ bool Texture::createSampler(optix::Context context,
 
             convert(dst, image->m_pixels, image->m_width * image->m_height, hostEncoding); // 2D!
             m_buffer->unmap(indexFace);
+
+            m_deviceSize += size_t(image->m_width) * image->m_height * getElementSize();
           }
         }
       }
@@ -296,6 +415,135 @@ bool Texture::createSampler(optix::Context context,
 
 
 // Use with standard texture sampler declarations.
+BlockFormat Texture::determineBlockFormat(const Picture* picture, bool useMipmaps) const
+{
+  if (m_compression == TEXTURE_COMPRESSION_NONE)
+  {
+    return BLOCK_FORMAT_NONE;
+  }
+  // Only 2D textures and cubemaps with whole blocks. 
+  // The buffer derives the mipmap extents by halving the blocks, which only matches the images for power-of-two extents.
+  if (m_depth != 1 || m_height == 1 || (m_width & 3) != 0 || (m_height & 3) != 0 ||
+      (useMipmaps && ((m_width & (m_width - 1)) != 0 || (m_height & (m_height - 1)) != 0)))
+  {
+    return BLOCK_FORMAT_NONE;
+  }
+
+  BlockFormat format = BLOCK_FORMAT_NONE;
+
+  const Image* image = picture->getImageFace(0, 0);
+  if (image->m_type == IL_UNSIGNED_BYTE)
+  {
+    if (m_compression == TEXTURE_COMPRESSION_BC5)
+    {
+      format = BLOCK_FORMAT_BC5;
+    }
+    else
+    {
+      format = BLOCK_FORMAT_BC1; // Half the size of BC3 when all images are opaque.
+      for (unsigned int indexImage = 0; indexImage < picture->getNumberOfImages(); ++indexImage)
+      {
+        if (hasTranslucency(picture->getImageFace(indexImage, 0)))
+        {
+          format = BLOCK_FORMAT_BC3;
+          break;
+        }
+      }
+    }
+  }
+  else if (image->m_type == IL_FLOAT && m_compression == TEXTURE_COMPRESSION_AUTO)
+  {
+    format = BLOCK_FORMAT_BC6H;
+  }
+
+#if (OPTIX_VERSION < 60000)
+  if (format != BLOCK_FORMAT_NONE)
+  {
+    static bool warned = false;
+    if (!warned)
+    {
+      std::cerr << "WARNING: createSampler() Block compressed textures need OptiX 6.0, uploading uncompressed." << std::endl;
+      warned = true;
+    }
+    format = BLOCK_FORMAT_NONE;
+  }
+#endif
+
+  return format;
+}
+
+// Encodes the uploaded levels of all images into blocks, or maps them from the BlockCache, and fills m_buffer.
+void Texture::uploadBlocks(const Picture* picture, unsigned int hostEncoding, unsigned int numLevels)
+{
+  const unsigned int numImages = picture->getNumberOfImages(); // 1, or the 6 cubemap faces.
+
+  // Offsets of the blocks of each image and level in the cache order, image-major.
+  std::vector<size_t> offsets(numImages * numLevels + 1, 0);
+  for (unsigned int indexImage = 0; indexImage < numImages; ++indexImage)
+  {
+    for (unsigned int level = 0; level < numLevels; ++level)
+    {
+      const unsigned int k = indexImage * numLevels + level;
+      const Image* image = picture->getImageFace(indexImage, level);
+      offsets[k + 1] = offsets[k] + getBlocksSize(m_blockFormat, image->m_width, image->m_height);
+    }
+  }
+
+  const std::string& filename = picture->getFilename();
+
+  const bool     useCache    = m_compressionCache && !filename.empty();
+  const uint64_t contentHash = (useCache) ? picture->hashContent() : 0;
+
+  BlockCache                 cache;
+  std::vector<unsigned char> encoded;
+  const unsigned char*       blocks;
+
+  if (useCache && cache.open(filename, m_blockFormat, m_compressionQuality, contentHash, offsets.back()))
+  {
+    blocks = cache.getBlocks();
+  }
+  else
+  {
+    encoded.resize(offsets.back());
+
+    std::vector<unsigned char> texels; // RGBA8 or RGBA32F, the uncompressed m_format, which is the encoder's input.
+    for (unsigned int indexImage = 0; indexImage < numImages; ++indexImage)
+    {
+      for (unsigned int level = 0; level < numLevels; ++level)
+      {
+        const Image* image = picture->getImageFace(indexImage, level);
+        const size_t count = size_t(image->m_width) * image->m_height;
+
+        texels.resize(count * getElementSize());
+        convert(texels.data(), image->m_pixels, count, hostEncoding);
+        encodeBlocks(m_blockFormat, m_compressionQuality, texels.data(), image->m_width, image->m_height,
+                     encoded.data() + offsets[indexImage * numLevels + level]);
+      }
+    }
+    if (useCache)
+    {
+      BlockCache::write(filename, m_blockFormat, m_compressionQuality, contentHash, encoded);
+    }
+    blocks = encoded.data();
+  }
+
+  // Each mipmap level holds the blocks of all cubemap faces one after the other.
+  for (unsigned int level = 0; level < numLevels; ++level)
+  {
+    unsigned char* dst = static_cast<unsigned char*>(m_buffer->map(level, RT_BUFFER_MAP_WRITE_DISCARD));
+    for (unsigned int indexImage = 0; indexImage < numImages; ++indexImage)
+    {
+      const unsigned int k = indexImage * numLevels + level;
+      const size_t size = offsets[k + 1] - offsets[k];
+
+      memcpy(dst, blocks + offsets[k], size);
+      dst += size;
+      m_deviceSize += size;
+    }
+    m_buffer->unmap(level);
+  }
+}
+
 optix::TextureSampler Texture::getSampler() const
 {
   return m_sampler;
@@ -314,6 +562,23 @@ void Texture::setWrapMode(RTwrapmode s, RTwrapmode t, RTwrapmode r)
   m_sampler->setWrapMode(2, r);
 }
 
+void Texture::setCompression(TextureCompression compression, BlockQuality quality, bool useCache)
+{
+  m_compression        = compression;
+  m_compressionQuality = quality;
+  m_compressionCache   = useCache;
+}
+
+BlockFormat Texture::getBlockFormat() const
+{
+  return m_blockFormat;
+}
+
+size_t Texture::getDeviceSize() const
+{
+  return m_deviceSize;
+}
+
 unsigned int Texture::getWidth() const
 {
   return m_width;
@@ -909,6 +1174,202 @@ PFNREMAP remappers[7][7] =
 };
 
 
+// Specialized conversions for what createSampler() actually uploads:
+// determineDeviceEncoding() keeps the component type and always expands to four channels,
+// so every host layout becomes RGBA of the same type. These are remapCopy<T> unrolled at compile time per layout.
+// R, G, B, A are the source channel indices. -1 writes zero into the color channels resp. the alpha one value into alpha.
+template<typename T, unsigned int CHANNELS, int R, int G, int B, int A>
+static void expandScalar(T* dst, const T* src, size_t count)
+{
+  const T one = getAlphaOne<T>();
+
+  while (count--)
+  {
+    dst[0] = (0 <= R) ? src[(0 <= R) ? R : 0] : T(0);
+    dst[1] = (0 <= G) ? src[(0 <= G) ? G : 0] : T(0);
+    dst[2] = (0 <= B) ? src[(0 <= B) ? B : 0] : T(0);
+    dst[3] = (0 <= A) ? src[(0 <= A) ? A : 0] : one;
+    dst += 4;
+    src += CHANNELS;
+  }
+}
+
+#if TEXTURE_SSE
+// Source lane of a destination channel for the SIMD shuffles. Missing channels read lane 0 and get masked.
+#define EXPAND_LANE(C) ((0 <= (C)) ? (C) : 0)
+
+// Number of pixels from the start which can load four components without reading past the end of the source.
+static size_t expandLoads(const size_t count, const unsigned int channels, const unsigned int components)
+{
+  return (components <= count * channels) ? (count * channels - components) / channels + 1 : 0;
+}
+
+// Shuffles the pixels in SIMD registers, one per component size. Returns the number of pixels done, the scalar loop does the rest.
+// oneBits is the bit pattern of the alpha one value in the lowest bits.
+template<unsigned int SIZE>
+struct ExpandSimd
+{
+  template<unsigned int CHANNELS, int R, int G, int B, int A>
+  static size_t run(void* /* dst */, const void* /* src */, size_t /* count */, unsigned int /* oneBits */)
+  {
+    return 0;
+  }
+};
+
+// 32-bit components: One pixel per register.
+template<>
+struct ExpandSimd<4>
+{
+  template<unsigned int CHANNELS, int R, int G, int B, int A>
+  static size_t run(void* dst, const void* src, size_t count, unsigned int oneBits)
+  {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+    unsigned char*       d = reinterpret_cast<unsigned char*>(dst);
+
+    const __m128i mask     = _mm_set_epi32((0 <= A) ? -1 : 0, (0 <= B) ? -1 : 0, (0 <= G) ? -1 : 0, (0 <= R) ? -1 : 0);
+    const __m128i constant = _mm_set_epi32((0 <= A) ?  0 : int(oneBits), 0, 0, 0);
+
+    const size_t n = expandLoads(count, CHANNELS, 4);
+    for (size_t i = 0; i < n; ++i)
+    {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * CHANNELS * 4));
+      x = _mm_shuffle_epi32(x, _MM_SHUFFLE(EXPAND_LANE(A), EXPAND_LANE(B), EXPAND_LANE(G), EXPAND_LANE(R)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i * 16), _mm_or_si128(_mm_and_si128(x, mask), constant));
+    }
+    return n;
+  }
+};
+
+// 16-bit components: One pixel in the lower half of a register.
+template<>
+struct ExpandSimd<2>
+{
+  template<unsigned int CHANNELS, int R, int G, int B, int A>
+  static size_t run(void* dst, const void* src, size_t count, unsigned int oneBits)
+  {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+    unsigned char*       d = reinterpret_cast<unsigned char*>(dst);
+
+    const __m128i mask     = _mm_set_epi16(0, 0, 0, 0, (0 <= A) ? -1 : 0, (0 <= B) ? -1 : 0, (0 <= G) ? -1 : 0, (0 <= R) ? -1 : 0);
+    const __m128i constant = _mm_set_epi16(0, 0, 0, 0, (0 <= A) ?  0 : short(oneBits), 0, 0, 0);
+
+    const size_t n = expandLoads(count, CHANNELS, 4);
+    for (size_t i = 0; i < n; ++i)
+    {
+      __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s + i * CHANNELS * 2));
+      x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(EXPAND_LANE(A), EXPAND_LANE(B), EXPAND_LANE(G), EXPAND_LANE(R)));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(d + i * 8), _mm_or_si128(_mm_and_si128(x, mask), constant));
+    }
+    return n;
+  }
+};
+
+// 8-bit components: Four pixels per byte shuffle with SSSE3, otherwise one pixel per 32-bit integer.
+template<>
+struct ExpandSimd<1>
+{
+  // Byte of the source channel C of pixel P in a 16 byte block, 0x80 makes pshufb write zero.
+  template<unsigned int CHANNELS, int C>
+  static char byteIndex(const unsigned int p)
+  {
+    return (0 <= C) ? char(p * CHANNELS + EXPAND_LANE(C)) : char(0x80);
+  }
+
+  template<unsigned int CHANNELS, int R, int G, int B, int A>
+  static size_t run(void* dst, const void* src, size_t count, unsigned int oneBits)
+  {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+    unsigned char*       d = reinterpret_cast<unsigned char*>(dst);
+
+    const unsigned int alpha = (0 <= A) ? 0 : (oneBits << 24);
+
+    size_t i = 0;
+
+#if defined(__SSSE3__)
+    const __m128i shuffle = _mm_setr_epi8(byteIndex<CHANNELS, R>(0), byteIndex<CHANNELS, G>(0), byteIndex<CHANNELS, B>(0), byteIndex<CHANNELS, A>(0),
+                                          byteIndex<CHANNELS, R>(1), byteIndex<CHANNELS, G>(1), byteIndex<CHANNELS, B>(1), byteIndex<CHANNELS, A>(1),
+                                          byteIndex<CHANNELS, R>(2), byteIndex<CHANNELS, G>(2), byteIndex<CHANNELS, B>(2), byteIndex<CHANNELS, A>(2),
+                                          byteIndex<CHANNELS, R>(3), byteIndex<CHANNELS, G>(3), byteIndex<CHANNELS, B>(3), byteIndex<CHANNELS, A>(3));
+    const __m128i constant = _mm_set1_epi32(int(alpha));
+
+    // Four pixels per iteration, which load 16 bytes.
+    const size_t blocks = (16 <= count * CHANNELS) ? (count * CHANNELS - 16) / (4 * CHANNELS) + 1 : 0;
+    for (; i < blocks * 4; i += 4)
+    {
+      const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * CHANNELS));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i * 4), _mm_or_si128(_mm_shuffle_epi8(x, shuffle), constant));
+    }
+#endif
+
+    // x86 is little endian, channel k of the loaded pixel is at bit 8 * k.
+    const size_t n = expandLoads(count, CHANNELS, 4);
+    for (; i < n; ++i)
+    {
+      unsigned int x;
+      memcpy(&x, s + i * CHANNELS, 4);
+      const unsigned int r = (0 <= R) ? ((x >> (8 * EXPAND_LANE(R))) & 0xFF)       : 0;
+      const unsigned int g = (0 <= G) ? ((x >> (8 * EXPAND_LANE(G))) & 0xFF) <<  8 : 0;
+      const unsigned int b = (0 <= B) ? ((x >> (8 * EXPAND_LANE(B))) & 0xFF) << 16 : 0;
+      const unsigned int a = (0 <= A) ? ((x >> (8 * EXPAND_LANE(A))) & 0xFF) << 24 : alpha;
+      x = r | g | b | a;
+      memcpy(d + i * 4, &x, 4);
+    }
+    return n;
+  }
+};
+#endif // TEXTURE_SSE
+
+template<typename T, unsigned int CHANNELS, int R, int G, int B, int A>
+static void expandRGBA(void *dst, const void *src, size_t count)
+{
+  size_t done = 0;
+#if TEXTURE_SSE
+  const T one = getAlphaOne<T>();
+  unsigned int oneBits = 0;
+  memcpy(&oneBits, &one, sizeof(T));
+
+  done = ExpandSimd<sizeof(T)>::template run<CHANNELS, R, G, B, A>(dst, src, count, oneBits);
+#endif
+  expandScalar<T, CHANNELS, R, G, B, A>(reinterpret_cast<T*>(dst) + done * 4, reinterpret_cast<const T*>(src) + done * CHANNELS, count - done);
+}
+
+typedef void (*PFNEXPAND)(void *dst, const void *src, size_t count);
+
+// The lower bits of an encoding with the channel mapping and count, without type and flags.
+#define ENC_LAYOUT_MASK ((1u << ENC_TYPE_SHIFT) - 1)
+// The device layout produced by determineDeviceEncoding() for all formats.
+#define ENC_LAYOUT_RGBA (ENC_RED_0 | ENC_GREEN_1 | ENC_BLUE_2 | ENC_ALPHA_3 | ENC_LUM_NONE | ENC_CHANNELS_4)
+
+#define EXPAND_KERNELS(CHANNELS, R, G, B, A)          \
+  {                                                   \
+    expandRGBA<char,           CHANNELS, R, G, B, A>, \
+    expandRGBA<unsigned char,  CHANNELS, R, G, B, A>, \
+    expandRGBA<short,          CHANNELS, R, G, B, A>, \
+    expandRGBA<unsigned short, CHANNELS, R, G, B, A>, \
+    expandRGBA<int,            CHANNELS, R, G, B, A>, \
+    expandRGBA<unsigned int,   CHANNELS, R, G, B, A>, \
+    expandRGBA<float,          CHANNELS, R, G, B, A>  \
+  }
+
+struct ExpandKernels
+{
+  unsigned int hostLayout; // determineHostEncoding() & ENC_LAYOUT_MASK
+  unsigned int alphaOne;   // The ENC_ALPHA_ONE flag of the matching device encoding.
+  PFNEXPAND    pfn[7];     // Index is the type of both encodings.
+};
+
+// IL_RGBA needs no entry, that is the memcpy() path.
+static const ExpandKernels expandKernels[] =
+{
+  { ENC_RED_0    | ENC_GREEN_1    | ENC_BLUE_2    | ENC_ALPHA_NONE | ENC_LUM_NONE | ENC_CHANNELS_3, ENC_ALPHA_ONE, EXPAND_KERNELS(3,  0,  1,  2, -1) }, // IL_RGB
+  { ENC_RED_2    | ENC_GREEN_1    | ENC_BLUE_0    | ENC_ALPHA_NONE | ENC_LUM_NONE | ENC_CHANNELS_3, ENC_ALPHA_ONE, EXPAND_KERNELS(3,  2,  1,  0, -1) }, // IL_BGR
+  { ENC_RED_2    | ENC_GREEN_1    | ENC_BLUE_0    | ENC_ALPHA_3    | ENC_LUM_NONE | ENC_CHANNELS_4, 0,             EXPAND_KERNELS(4,  2,  1,  0,  3) }, // IL_BGRA
+  { ENC_RED_0    | ENC_GREEN_0    | ENC_BLUE_0    | ENC_ALPHA_NONE | ENC_LUM_NONE | ENC_CHANNELS_1, ENC_ALPHA_ONE, EXPAND_KERNELS(1,  0,  0,  0, -1) }, // IL_LUMINANCE
+  { ENC_RED_NONE | ENC_GREEN_NONE | ENC_BLUE_NONE | ENC_ALPHA_0    | ENC_LUM_NONE | ENC_CHANNELS_1, 0,             EXPAND_KERNELS(1, -1, -1, -1,  0) }, // IL_ALPHA
+  { ENC_RED_0    | ENC_GREEN_0    | ENC_BLUE_0    | ENC_ALPHA_1    | ENC_LUM_NONE | ENC_CHANNELS_2, 0,             EXPAND_KERNELS(2,  0,  0,  0,  1) }  // IL_LUMINANCE_ALPHA
+};
+
+
 // Finally the function which converts any loaded image into a texture format supported by CUDA (1, 2, 4 channels only).
 void Texture::convert(void *dst, const void *src, size_t elements, unsigned int hostEncoding) const
 {
@@ -916,19 +1377,40 @@ void Texture::convert(void *dst, const void *src, size_t elements, unsigned int
   if ((m_encoding & ~ENC_FIXED_POINT) == hostEncoding)
   {
     memcpy(dst, src, elements * getElementSize()); // The fastest path.
+    return;
   }
-  else
-  {
-    unsigned int dstType = (m_encoding   >> ENC_TYPE_SHIFT) & ENC_MASK;
-    unsigned int srcType = (hostEncoding >> ENC_TYPE_SHIFT) & ENC_MASK;
-    MY_ASSERT(dstType < 7 && srcType < 7); 
-          
-    PFNREMAP pfn = remappers[dstType][srcType];
 
-    (*pfn)(dst, src, elements, m_encoding, hostEncoding);
+  const unsigned int dstType = (m_encoding   >> ENC_TYPE_SHIFT) & ENC_MASK;
+  const unsigned int srcType = (hostEncoding >> ENC_TYPE_SHIFT) & ENC_MASK;
+
+  if (dstType == srcType && dstType < 7 && (m_encoding & ENC_LAYOUT_MASK) == ENC_LAYOUT_RGBA)
+  {
+    for (size_t i = 0; i < sizeof(expandKernels) / sizeof(expandKernels[0]); ++i)
+    {
+      if ((hostEncoding & ENC_LAYOUT_MASK) == expandKernels[i].hostLayout && (m_encoding & ENC_ALPHA_ONE) == expandKernels[i].alphaOne)
+      {
+        (*expandKernels[i].pfn[dstType])(dst, src, elements);
+        return;
+      }
+    }
   }
+
+  convertGeneric(dst, src, elements, hostEncoding);
+}
+
+// The remapper for any pair of encodings. Decodes the encodings per channel and pixel.
+void Texture::convertGeneric(void *dst, const void *src, size_t elements, unsigned int hostEncoding) const
+{
+  unsigned int dstType = (m_encoding   >> ENC_TYPE_SHIFT) & ENC_MASK;
+  unsigned int srcType = (hostEncoding >> ENC_TYPE_SHIFT) & ENC_MASK;
+  MY_ASSERT(dstType < 7 && srcType < 7); 
+        
+  PFNREMAP pfn = remappers[dstType][srcType];
+
+  (*pfn)(dst, src, elements, m_encoding, hostEncoding);
 }
 
+
 // The following functions are used to build the data needed for an importance sampled spherical HDR environment map. 
 // DAR FIXME Put this into a separate class derived from Texture.
 
@@ -977,6 +1459,29 @@ bool Texture::createEnvironment(const Picture* picture)
   return true;
 }
 
+// Creates a spherical environment from RGBA32F data with the bottom row first, e.g. decoded without DevIL on a worker thread.
+bool Texture::createEnvironment(const float* rgba, unsigned int width, unsigned int height)
+{
+  if (rgba == nullptr || width == 0 || height == 0)
+  {
+    std::cerr << "ERROR: Environment data is empty! Creating white dummy environment." << std::endl;
+    createEnvironment();
+    return false;
+  }
+
+  m_width  = width;
+  m_height = height;
+  m_depth  = 1;
+
+  m_encoding  = ENC_RED_0 | ENC_GREEN_1 | ENC_BLUE_2 | ENC_ALPHA_3 | ENC_LUM_NONE | ENC_CHANNELS_4 | ENC_ALPHA_ONE | ENC_TYPE_FLOAT;
+  m_format    = RT_FORMAT_FLOAT4;
+  m_readMode  = RT_TEXTURE_READ_ELEMENT_TYPE;
+  m_indexMode = RT_TEXTURE_INDEX_NORMALIZED_COORDINATES;
+
+  m_texels.assign(rgba, rgba + size_t(width) * height * 4);
+  return true;
+}
+
 // When not providing a pointer to a Picture, create dummy image data to fill the environment map sampler 
 // and CDF variables when another miss shader is used.
 // That allows to switch miss shader implementations without recompilation of the application.
@@ -1005,153 +1510,365 @@ void Texture::createEnvironment()
   }
 }
 
-// Implement a simple Gaussian 3x3 filter with sigma = 0.5
-// Needed for the CDF generation of the importance sampled HDR environment texture light.
-static float gaussianFilter(const float* rgba, unsigned int width, unsigned int height, unsigned int x, unsigned int y)
+// The 3x3 Gaussian filter with sigma = 0.5 used for the CDF generation of the importance sampled HDR environment texture light
+// is separable into these 1D weights: exp(-2) / (1 + 2 * exp(-2)) and 1 / (1 + 2 * exp(-2)).
+#define GAUSSIAN_OUTER  0.106507f
+#define GAUSSIAN_CENTER 0.786986f
+
+// Sum of the RGB channels per texel of one row. The division by three happens in the sine weight.
+static void intensityRow(const float* rgba, const unsigned int width, float* intensity)
 {
-  // Lookup is repeated in x and clamped to edge in y.
-  unsigned int left   = (0 < x)          ? x - 1 : width - 1; // repeat
-  unsigned int right  = (x < width - 1)  ? x + 1 : 0;         // repeat
-  unsigned int bottom = (0 < y)          ? y - 1 : y;         // clamp
-  unsigned int top    = (y < height - 1) ? y + 1 : y;         // clamp
-  
-  // Center
-  const float *p = rgba + (width * y + x) * 4;
-  float intensity = (p[0] + p[1] + p[2]) * 0.619347f;
-
-  // 4-neighbours
-  p = rgba + (width * bottom + x) * 4;
-  float f = p[0] + p[1] + p[2];
-  p = rgba + (width * y + left) * 4;
-  f += p[0] + p[1] + p[2];
-  p = rgba + (width * y + right) * 4;
-  f += p[0] + p[1] + p[2];
-  p = rgba + (width * top + x) * 4;
-  f += p[0] + p[1] + p[2];
-  intensity += f * 0.0838195f;
-
-  // 8-neighbours corners
-  p = rgba + (width * bottom + left) * 4;
-  f  = p[0] + p[1] + p[2];
-  p = rgba + (width * bottom + right) * 4;
-  f += p[0] + p[1] + p[2];
-  p = rgba + (width * top + left) * 4;
-  f += p[0] + p[1] + p[2];
-  p = rgba + (width * top + right) * 4;
-  f += p[0] + p[1] + p[2];
-  intensity += f * 0.0113437f;
-
-  return intensity / 3.0f;
+  unsigned int x = 0;
+#if TEXTURE_SSE
+  for (; x + 4 <= width; x += 4)
+  {
+    __m128 r = _mm_loadu_ps(rgba + x * 4);
+    __m128 g = _mm_loadu_ps(rgba + x * 4 + 4);
+    __m128 b = _mm_loadu_ps(rgba + x * 4 + 8);
+    __m128 a = _mm_loadu_ps(rgba + x * 4 + 12);
+    _MM_TRANSPOSE4_PS(r, g, b, a); // Four texels RGBA to RRRR, GGGG, BBBB, AAAA.
+    _mm_storeu_ps(intensity + x, _mm_add_ps(_mm_add_ps(r, g), b));
+  }
+#endif
+  for (; x < width; ++x)
+  {
+    const float *p = rgba + x * 4;
+    intensity[x] = p[0] + p[1] + p[2];
+  }
 }
- 
-// Create cumulative distribution function for importance sampling of spherical environment lights.
-// This is a textbook implementation for the CDF generation of a spherical HDR environment.
-// See "Physically Based Rendering" v2, chapter 14.6.5 on Infinite Area Lights.
-bool Texture::calculateCDF(optix::Context context)
+
+// Separable Gaussian filter of the center row with its lower and upper neighbour rows. Repeats horizontally.
+// Filtering keeps the piecewise linear function intact for samples with zero value next to non-zero values.
+static void filterRow(const float* lower, const float* center, const float* upper, const unsigned int width,
+                      float* vertical, float* filtered)
 {
-  if (m_texels.empty() || (m_texels.size() != m_width * m_height * 4))
+  unsigned int x = 0;
+#if TEXTURE_SSE
+  const __m128 outer4  = _mm_set1_ps(GAUSSIAN_OUTER);
+  const __m128 center4 = _mm_set1_ps(GAUSSIAN_CENTER);
+
+  for (; x + 4 <= width; x += 4)
   {
-    return false;
+    const __m128 v = _mm_add_ps(_mm_mul_ps(outer4, _mm_add_ps(_mm_loadu_ps(lower + x), _mm_loadu_ps(upper + x))),
+                                _mm_mul_ps(center4, _mm_loadu_ps(center + x)));
+    _mm_storeu_ps(vertical + x, v);
+  }
+#endif
+  for (; x < width; ++x)
+  {
+    vertical[x] = GAUSSIAN_OUTER * (lower[x] + upper[x]) + GAUSSIAN_CENTER * center[x];
   }
 
-  const float *rgba = m_texels.data();
+  // The interior has both neighbours inside the row.
+  x = 1;
+#if TEXTURE_SSE
+  for (; x + 5 <= width; x += 4)
+  {
+    const __m128 h = _mm_add_ps(_mm_mul_ps(outer4, _mm_add_ps(_mm_loadu_ps(vertical + x - 1), _mm_loadu_ps(vertical + x + 1))),
+                                _mm_mul_ps(center4, _mm_loadu_ps(vertical + x)));
+    _mm_storeu_ps(filtered + x, h);
+  }
+#endif
+  for (; x + 1 < width; ++x)
+  {
+    filtered[x] = GAUSSIAN_OUTER * (vertical[x - 1] + vertical[x + 1]) + GAUSSIAN_CENTER * vertical[x];
+  }
 
-  // The original data needs to be retained to calculate the PDF.
-  float *funcU = new float[m_width * m_height];
-  float *funcV = new float[m_height + 1];
+  // The first and last texels wrap around. (Also handles width 1.)
+  const unsigned int last = width - 1;
+  filtered[0] = GAUSSIAN_OUTER * (vertical[last] + vertical[(0 < last) ? 1 : 0]) + GAUSSIAN_CENTER * vertical[0];
+  if (0 < last)
+  {
+    filtered[last] = GAUSSIAN_OUTER * (vertical[last - 1] + vertical[0]) + GAUSSIAN_CENTER * vertical[last];
+  }
+}
 
-  float sum = 0.0f;
-  // First generate the function data.
-  for (unsigned int y = 0; y < m_height; ++y)
+// Vose's alias method: Distributes the count weights into count cells of equal probability 1/count,
+// each holding its own weight's share in .x and the index of one other weight filling the rest in .y.
+// See "Darts, Dice, and Coins: Sampling from a Discrete Distribution" by Keith Schwarz. 
+// The scratch vectors only avoid reallocations per row.
+template <typename T>
+static void createAliasTable(const T* weights, const unsigned int count, optix::float2* table,
+                             std::vector<double>& scaled, std::vector<unsigned int>& small, std::vector<unsigned int>& large)
+{
+  double sum = 0.0;
+  for (unsigned int i = 0; i < count; ++i)
   {
-    // Scale distibution by the sine to get the sampling uniform. (Avoid sampling more values near the poles.)
-    // See Physically Based Rendering v2, chapter 14.6.5 on Infinite Area Lights, page 728.
-    float sinTheta = float(sin(M_PI * (double(y) + 0.5) / double(m_height))); // Make this as accurate as possible.
+    sum += weights[i];
+  }
 
-    for (unsigned int x = 0; x < m_width; ++x)
+  if (sum <= 0.0) // All weights zero. Generate an equal distribution like the CDF.
+  {
+    for (unsigned int i = 0; i < count; ++i)
     {
-      // Filter to keep the piecewise linear function intact for samples with zero value next to non-zero values.
-      const float value = gaussianFilter(rgba, m_width, m_height, x, y);
-      funcU[y * m_width + x] = value * sinTheta;
-
-      // Compute integral over the actual function.
-      const float *p = rgba + (y * m_width + x) * 4;
-      const float intensity = (p[0] + p[1] + p[2]) / 3.0f;
-      sum += intensity * sinTheta;
+      table[i] = optix::make_float2(1.0f, float(i));
     }
+    return;
   }
 
-  // This integral is used inside the light sampling function (see sysEnvironmentIntegral).
-  m_integral = sum * 2.0f * M_PIf * M_PIf / float(m_width * m_height);
+  scaled.resize(count);
+  small.clear();
+  large.clear();
 
-  // Now generate the CDF data.
-  // Normalized 1D distributions in the rows of the 2D buffer, and the marginal CDF in the 1D buffer.
-  // Include the starting 0.0f and the ending 1.0f to avoid special cases during the continuous sampling.
-  float *cdfU = new float[(m_width + 1) * m_height];
-  float *cdfV = new float[m_height + 1];
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    scaled[i] = double(weights[i]) * double(count) / sum; // Average is 1.0.
+    if (scaled[i] < 1.0)
+    {
+      small.push_back(i);
+    }
+    else
+    {
+      large.push_back(i);
+    }
+  }
 
-  for (unsigned int y = 0; y < m_height; ++y)
+  while (!small.empty() && !large.empty())
   {
-    unsigned int row = y * (m_width + 1); // Watch the stride!
-    cdfU[row + 0] = 0.0f; // CDF starts at 0.0f.
+    const unsigned int s = small.back();
+    small.pop_back();
+    const unsigned int l = large.back();
+
+    table[s] = optix::make_float2(float(scaled[s]), float(l));
 
-    for (unsigned int x = 1; x <= m_width; ++x)
+    scaled[l] = (scaled[l] + scaled[s]) - 1.0; // The large cell donated the remainder of cell s.
+    if (scaled[l] < 1.0)
     {
-      unsigned int i = row + x;
-      cdfU[i] = cdfU[i - 1] + funcU[y * m_width + x - 1]; // Attention, funcU is only m_width wide! 
+      large.pop_back();
+      small.push_back(l);
     }
+  }
+
+  // Whatever is left is 1.0 up to rounding errors.
+  for (size_t i = 0; i < large.size(); ++i)
+  {
+    table[large[i]] = optix::make_float2(1.0f, float(large[i]));
+  }
+  for (size_t i = 0; i < small.size(); ++i)
+  {
+    table[small[i]] = optix::make_float2(1.0f, float(small[i]));
+  }
+}
+
+// Create cumulative distribution function for importance sampling of spherical environment lights.
+// This is a textbook implementation for the CDF generation of a spherical HDR environment.
+// See "Physically Based Rendering" v2, chapter 14.6.5 on Infinite Area Lights.
+// The host part only touches this Texture's own data and can run on a worker thread. 
+// The rows are independent and processed in parallel. All sums are accumulated in double precision
+// because the rows of big environments have thousands of texels and float prefix sums lose the small values.
+bool Texture::calculateCDF()
+{
+  if (m_texels.empty() || (m_texels.size() != m_width * m_height * 4))
+  {
+    return false;
+  }
+
+  const float *rgba = m_texels.data();
+
+  // Normalized 1D distributions in the rows of the 2D buffer, and the marginal CDF in the 1D buffer.
+  // Include the starting 0.0f and the ending 1.0f to avoid special cases during the continuous sampling.
+  m_cdfU.resize((m_width + 1) * m_height);
+  m_cdfV.resize(m_height + 1);
+
+  // Alias tables over the same function values for constant time sampling. (See sampleEnvironmentAlias().)
+  m_aliasU.clear();
+  m_aliasV.clear();
+  if (m_aliasTables)
+  {
+    m_aliasU.resize(m_width * m_height);
+    m_aliasV.resize(m_height);
+  }
+
+  std::vector<double> funcV(m_height);     // The row integrals are the function values of the marginal CDF.
+  std::vector<double> intensity(m_height); // Row sums of the unfiltered, sine weighted intensity for the environment integral.
 
-    const float integral = cdfU[row + m_width]; // The integral over this row is in the last element.
-    funcV[y] = integral;                        // Store this as function values of the marginal CDF.
+  sutil::parallelFor(m_height, 16, [&](size_t begin, size_t end, size_t)
+  {
+    // Intensity of three rows around the current one, the vertically filtered row, and the function values.
+    std::vector<float> rows(m_width * 3);
+    std::vector<float> vertical(m_width);
+    std::vector<float> funcU(m_width);
+
+    std::vector<double>       scaled;
+    std::vector<unsigned int> small;
+    std::vector<unsigned int> large;
+
+    float *lower  = rows.data();
+    float *center = lower  + m_width;
+    float *upper  = center + m_width;
 
-    if (integral != 0.0f)
+    for (unsigned int y = static_cast<unsigned int>(begin); y < static_cast<unsigned int>(end); ++y)
     {
-      for (unsigned int x = 1; x <= m_width; ++x)
+      const unsigned int bottom = (0 < y)            ? y - 1 : y; // clamp
+      const unsigned int top    = (y < m_height - 1) ? y + 1 : y; // clamp
+
+      if (y == begin)
       {
-        cdfU[row + x] /= integral;
+        intensityRow(rgba + size_t(m_width) * bottom * 4, m_width, lower);
+        intensityRow(rgba + size_t(m_width) * y      * 4, m_width, center);
       }
-    }
-    else // All texels were black in this row. Generate an equal distribution.
-    {
-      for (unsigned int x = 1; x <= m_width; ++x)
+      else // Slide the window one row up.
+      {
+        std::swap(lower, center);
+        std::swap(center, upper);
+      }
+      intensityRow(rgba + size_t(m_width) * top * 4, m_width, upper);
+
+      filterRow(lower, center, upper, m_width, vertical.data(), funcU.data());
+
+      // Scale distibution by the sine to get the sampling uniform. (Avoid sampling more values near the poles.)
+      // See Physically Based Rendering v2, chapter 14.6.5 on Infinite Area Lights, page 728.
+      const double sinTheta = sin(M_PI * (double(y) + 0.5) / double(m_height)); // Make this as accurate as possible.
+      const float  weight   = float(sinTheta / 3.0); // Intensity is the average of the RGB channels.
+
+      double sumFunc      = 0.0;
+      double sumIntensity = 0.0;
+      for (unsigned int x = 0; x < m_width; ++x)
+      {
+        funcU[x] *= weight;
+        sumFunc      += funcU[x];
+        sumIntensity += center[x];
+      }
+
+      funcV[y]     = sumFunc;
+      intensity[y] = sumIntensity * sinTheta / 3.0;
+
+      float *cdfU = m_cdfU.data() + y * (m_width + 1); // Watch the stride!
+      cdfU[0] = 0.0f; // CDF starts at 0.0f.
+
+      if (sumFunc != 0.0)
+      {
+        double cdf = 0.0;
+        for (unsigned int x = 1; x < m_width; ++x)
+        {
+          cdf += funcU[x - 1]; // Attention, funcU is only m_width wide! 
+          cdfU[x] = float(cdf / sumFunc);
+        }
+      }
+      else // All texels were black in this row. Generate an equal distribution.
+      {
+        for (unsigned int x = 1; x < m_width; ++x)
+        {
+          cdfU[x] = float(x) / float(m_width);
+        }
+      }
+      cdfU[m_width] = 1.0f; // Exactly, the sampling relies on it.
+
+      if (m_aliasTables)
       {
-        cdfU[row + x] = float(x) / float(m_width);
+        createAliasTable(funcU.data(), m_width, m_aliasU.data() + y * m_width, scaled, small, large);
       }
     }
+  });
+
+  // This integral is used inside the light sampling function (see sysEnvironmentIntegral).
+  double sum = 0.0;
+  for (unsigned int y = 0; y < m_height; ++y)
+  {
+    sum += intensity[y];
   }
+  m_integral = float(sum * 2.0 * M_PI * M_PI / double(m_width * m_height));
 
   // Now do the same thing with the marginal CDF.
-  cdfV[0] = 0.0f; // CDF starts at 0.0f.
-  for (unsigned int y = 1; y <= m_height; ++y)
+  double integral = 0.0; // The integral over this marginal CDF.
+  for (unsigned int y = 0; y < m_height; ++y)
   {
-    cdfV[y] = cdfV[y - 1] + funcV[y - 1];
+    integral += funcV[y];
   }
-        
-  const float integral = cdfV[m_height]; // The integral over this marginal CDF is in the last element.
-  funcV[m_height] = integral;            // For completeness, actually unused.
 
-  if (integral != 0.0f)
+  float *cdfV = m_cdfV.data();
+  cdfV[0] = 0.0f; // CDF starts at 0.0f.
+
+  if (integral != 0.0)
   {
-    for (unsigned int y = 1; y <= m_height; ++y)
+    double cdf = 0.0;
+    for (unsigned int y = 1; y < m_height; ++y)
     {
-      cdfV[y] /= integral;
+      cdf += funcV[y - 1];
+      cdfV[y] = float(cdf / integral);
     }
   }
   else // All texels were black in the whole image. Seriously? :-) Generate an equal distribution.
   {
-    for (unsigned int y = 1; y <= m_height; ++y)
+    for (unsigned int y = 1; y < m_height; ++y)
     {
       cdfV[y] = float(y) / float(m_height);
     }
   }
+  cdfV[m_height] = 1.0f;
+
+  if (m_aliasTables)
+  {
+    std::vector<double>       scaled;
+    std::vector<unsigned int> small;
+    std::vector<unsigned int> large;
+
+    createAliasTable(funcV.data(), m_height, m_aliasV.data(), scaled, small, large);
+  }
+
+  return true;
+}
+
+// Upload the RGBA32F environment texture data and the CDFs calculated before.
+// Doing this here no not duplicate the code in the createEnvironment routines.
+bool Texture::uploadEnvironment(optix::Context context)
+{
+  if (m_texels.size() != m_width * m_height * 4 || m_cdfU.size() != (m_width + 1) * m_height || m_cdfV.size() != m_height + 1)
+  {
+    return false;
+  }
+
+  const bool hasAlias = (m_aliasU.size() == m_width * m_height && m_aliasV.size() == m_height);
+
+  uploadEnvironment(context, m_texels.data(), m_cdfU.data(), m_cdfV.data(),
+                    (hasAlias) ? m_aliasU.data() : nullptr, (hasAlias) ? m_aliasV.data() : nullptr);
+
+  // The original float data and the host tables are not needed anymore.
+  m_texels.clear();
+  m_cdfU.clear();
+  m_cdfV.clear();
+  m_aliasU.clear();
+  m_aliasV.clear();
+
+  return true;
+}
+
+// Same from the memory mapped EnvironmentCache. The OptiX buffers are filled directly from the mapping.
+bool Texture::uploadEnvironment(optix::Context context, EnvironmentCache const& cache)
+{
+  if (!cache.isOpen())
+  {
+    return false;
+  }
+
+  m_width  = cache.getWidth();
+  m_height = cache.getHeight();
+  m_depth  = 1;
+
+  // Same as createEnvironment() from RGBA32F data.
+  m_encoding  = ENC_RED_0 | ENC_GREEN_1 | ENC_BLUE_2 | ENC_ALPHA_3 | ENC_LUM_NONE | ENC_CHANNELS_4 | ENC_ALPHA_ONE | ENC_TYPE_FLOAT;
+  m_format    = RT_FORMAT_FLOAT4;
+  m_readMode  = RT_TEXTURE_READ_ELEMENT_TYPE;
+  m_indexMode = RT_TEXTURE_INDEX_NORMALIZED_COORDINATES;
 
-  // Upload that RGBA32F environment texture data.
-  // Doing this here no not duplicate the code in the createEnvironment routines.
+  m_integral = cache.getIntegral();
+
+  // Only upload the alias tables when they would have been calculated.
+  const bool hasAlias = m_aliasTables && cache.getAlias_U() != nullptr;
+
+  uploadEnvironment(context, cache.getTexels(), cache.getCDF_U(), cache.getCDF_V(),
+                    (hasAlias) ? cache.getAlias_U() : nullptr, (hasAlias) ? cache.getAlias_V() : nullptr);
+  return true;
+}
+
+void Texture::uploadEnvironment(optix::Context context, const float* texels, const float* cdfU, const float* cdfV,
+                                const optix::float2* aliasU, const optix::float2* aliasV)
+{
   m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, m_width, m_height);
   m_buffer->setMipLevelCount(1);
 
   void *dst = m_buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-  memcpy(dst, m_texels.data(), m_width * m_height * sizeof(float) * 4);
+  memcpy(dst, texels, m_width * m_height * sizeof(float) * 4);
   m_buffer->unmap();
 
   m_sampler = context->createTextureSampler();
@@ -1178,15 +1895,65 @@ bool Texture::calculateCDF(optix::Context context)
   memcpy(buf, cdfV, (m_height + 1) * sizeof(float));
   m_bufferCDF_V->unmap();
 
-  delete [] cdfV;
-  delete [] cdfU;
-        
-  delete [] funcV;
-  delete [] funcU;
+  if (aliasU && aliasV)
+  {
+    m_bufferAlias_U = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT2, m_width, m_height); 
 
-  m_texels.clear(); // The original float data is not needed anymore.
+    buf = m_bufferAlias_U->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    memcpy(buf, aliasU, m_width * m_height * sizeof(optix::float2));
+    m_bufferAlias_U->unmap();
 
-  return true;
+    m_bufferAlias_V = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT2, m_height);
+
+    buf = m_bufferAlias_V->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    memcpy(buf, aliasV, m_height * sizeof(optix::float2));
+    m_bufferAlias_V->unmap();
+  }
+}
+
+void Texture::setAliasTables(bool enable)
+{
+  m_aliasTables = enable;
+}
+
+bool Texture::calculateCDF(optix::Context context)
+{
+  return calculateCDF() && uploadEnvironment(context);
+}
+
+// Explicitly destroy the OptiX objects, e.g. when replacing an environment at runtime.
+void Texture::destroy()
+{
+  if (m_sampler)
+  {
+    m_sampler->destroy();
+    m_sampler = nullptr;
+  }
+  if (m_buffer)
+  {
+    m_buffer->destroy();
+    m_buffer = nullptr;
+  }
+  if (m_bufferCDF_U)
+  {
+    m_bufferCDF_U->destroy();
+    m_bufferCDF_U = nullptr;
+  }
+  if (m_bufferCDF_V)
+  {
+    m_bufferCDF_V->destroy();
+    m_bufferCDF_V = nullptr;
+  }
+  if (m_bufferAlias_U)
+  {
+    m_bufferAlias_U->destroy();
+    m_bufferAlias_U = nullptr;
+  }
+  if (m_bufferAlias_V)
+  {
+    m_bufferAlias_V->destroy();
+    m_bufferAlias_V = nullptr;
+  }
 }
 
 float Texture::getIntegral() const
@@ -1204,3 +1971,38 @@ optix::Buffer Texture::getBufferCDF_V() const
 {
   return m_bufferCDF_V;
 }
+
+optix::Buffer Texture::getBufferAlias_U() const
+{
+  return m_bufferAlias_U;
+}
+
+optix::Buffer Texture::getBufferAlias_V() const
+{
+  return m_bufferAlias_V;
+}
+
+std::vector<float> const& Texture::getTexels() const
+{
+  return m_texels;
+}
+
+std::vector<float> const& Texture::getCDF_U() const
+{
+  return m_cdfU;
+}
+
+std::vector<float> const& Texture::getCDF_V() const
+{
+  return m_cdfV;
+}
+
+std::vector<optix::float2> const& Texture::getAlias_U() const
+{
+  return m_aliasU;
+}
+
+std::vector<optix::float2> const& Texture::getAlias_V() const
+{
+  return m_aliasV;
+}
@@ -0,0 +1,201 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/TextureCache.h"
+
+#include "inc/Picture.h"
+
+// DAR Canonical file paths from sutil.
+#include <sutil.h>
+
+#include <iostream>
+#include <sstream>
+
+#include "inc/MyAssert.h"
+
+
+TextureCache::TextureCache()
+: m_requests(0)
+, m_hits(0)
+, m_contentHits(0)
+, m_residentBytes(0)
+{
+}
+
+TextureCache::~TextureCache()
+{
+  MY_ASSERT(m_textures.empty()); // clear() must happen while the OptiX context exists.
+}
+
+Texture* TextureCache::acquire(optix::Context context, const std::string& filename, 
+                               const bool useSrgb, const bool useMipmaps, const bool useUnnormalized,
+                               const RTwrapmode wrapMode, const TextureCompression compression, const BlockQuality quality,
+                               const bool useCache)
+{
+  ++m_requests;
+
+  std::ostringstream settings;
+  settings << "|srgb " << useSrgb << "|mipmaps " << useMipmaps << "|unnormalized " << useUnnormalized << "|wrap " << int(wrapMode)
+           << "|compression " << int(compression) << "|quality " << int(quality);
+
+  const std::string keyFile = sutil::canonicalPath(filename) + settings.str();
+
+  std::map<std::string, Entry*>::const_iterator itFile = m_files.find(keyFile);
+  if (itFile != m_files.end())
+  {
+    ++m_hits;
+    ++itFile->second->references;
+    return itFile->second->texture;
+  }
+
+  Picture picture;
+  if (!picture.load(filename))
+  {
+    std::cerr << "ERROR: TextureCache::acquire() Loading " << filename << " failed." << std::endl;
+    return nullptr;
+  }
+
+  std::ostringstream content;
+  content << std::hex << picture.hashContent() << std::dec << settings.str();
+
+  const std::string keyContent = content.str();
+
+  std::map<std::string, Entry*>::const_iterator itContent = m_contents.find(keyContent);
+  if (itContent != m_contents.end())
+  {
+    ++m_contentHits;
+    ++itContent->second->references;
+    m_files[keyFile] = itContent->second;
+    return itContent->second->texture;
+  }
+
+  if (useMipmaps && picture.getNumberOfFaces(0) == 1)
+  {
+    picture.generateMipmaps(MIPMAP_FILTER_BOX, useSrgb);
+  }
+
+  Texture* texture = new Texture();
+  texture->setCompression(compression, quality, useCache);
+  if (!texture->createSampler(context, &picture, useSrgb, useMipmaps, useUnnormalized))
+  {
+    texture->destroy();
+    delete texture;
+    return nullptr;
+  }
+  // createSampler() clamps cubemaps and unnormalized coordinates. Repeat and mirror don't work there.
+  if (!picture.isCubemap() && !useUnnormalized)
+  {
+    texture->setWrapMode(wrapMode, wrapMode, wrapMode);
+  }
+
+  const size_t bytes = texture->getDeviceSize();
+
+  Entry* entry = new Entry;
+
+  entry->texture    = texture;
+  entry->references = 1;
+  entry->bytes      = bytes;
+  entry->content    = keyContent;
+
+  m_files[keyFile]       = entry;
+  m_contents[keyContent] = entry;
+  m_textures[texture]    = entry;
+
+  m_residentBytes += bytes;
+
+  return texture;
+}
+
+void TextureCache::release(Texture* texture)
+{
+  std::map<Texture*, Entry*>::iterator it = m_textures.find(texture);
+  if (it == m_textures.end())
+  {
+    MY_ASSERT(!"TextureCache::release() Texture not owned by the cache.");
+    return;
+  }
+
+  Entry* entry = it->second;
+  if (--entry->references == 0)
+  {
+    erase(entry);
+  }
+}
+
+void TextureCache::clear()
+{
+  while (!m_textures.empty())
+  {
+    erase(m_textures.begin()->second);
+  }
+}
+
+unsigned int TextureCache::getNumberOfRequests() const
+{
+  return m_requests;
+}
+
+float TextureCache::getHitRate() const
+{
+  return (m_requests) ? float(m_hits + m_contentHits) / float(m_requests) : 0.0f;
+}
+
+size_t TextureCache::getResidentBytes() const
+{
+  return m_residentBytes;
+}
+
+void TextureCache::printStatistics() const
+{
+  std::cout << "TextureCache: " << m_requests << " requests, " << m_hits << " hits, " << m_contentHits << " content hits (" 
+            << getHitRate() * 100.0f << "%), " << m_textures.size() << " textures, " << m_residentBytes << " bytes resident" << std::endl;
+}
+
+// Destroys the Texture and removes all keys referencing it.
+void TextureCache::erase(Entry* entry)
+{
+  for (std::map<std::string, Entry*>::iterator it = m_files.begin(); it != m_files.end(); )
+  {
+    if (it->second == entry)
+    {
+      it = m_files.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  m_contents.erase(entry->content);
+  m_textures.erase(entry->texture);
+
+  m_residentBytes -= entry->bytes;
+
+  entry->texture->destroy();
+  delete entry->texture;
+  delete entry;
+}
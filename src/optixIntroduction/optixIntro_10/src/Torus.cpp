@@ -26,7 +26,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "inc/Application.h"
+#include "inc/Shapes.h"
 
 #include <cstring>
 #include <iostream>
@@ -34,7 +34,7 @@
 
 #include "inc/MyAssert.h"
 
-optix::Geometry Application::createTorus(const int tessU, const int tessV, const float innerRadius, const float outerRadius)
+void generateTorus(const int tessU, const int tessV, const float innerRadius, const float outerRadius, std::vector<VertexAttributes>& attributes, std::vector<unsigned int>& indices)
 {
   MY_ASSERT(3 <= tessU && 3 <= tessV); 
 
@@ -51,10 +51,8 @@ optix::Geometry Application::createTorus(const int tessU, const int tessV, const
                 innerRadius
   */
 
-  std::vector<VertexAttributes> attributes;
   attributes.reserve((tessU + 1) * (tessV + 1));
 
-  std::vector<unsigned int> indices;
   indices.reserve(8 * tessU * tessV);
 
   const float u = (float) tessU;
@@ -109,7 +107,5 @@ optix::Geometry Application::createTorus(const int tessU, const int tessV, const
   }
 
   std::cout << "createTorus(): Vertices = " << attributes.size() <<  ", Triangles = " << indices.size() / 3 << std::endl;
-
-  return createGeometry(attributes, indices);
 }
 
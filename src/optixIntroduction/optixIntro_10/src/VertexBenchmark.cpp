@@ -0,0 +1,126 @@
+/* 
+ * Copyright (c) 2013-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "inc/VertexBenchmark.h"
+
+#include "inc/Scene.h"
+#include "inc/Timer.h"
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include "shaders/vertex_attributes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Number of runs of which the fastest counts.
+#define BENCHMARK_RUNS 5
+
+
+// Angle in degrees between two vectors. Zero length vectors have no direction to preserve.
+static float angleBetween(optix::float3 const& a, optix::float3 const& b)
+{
+  const float la = optix::length(a);
+  const float lb = optix::length(b);
+  if (la <= 0.0f || lb <= 0.0f)
+  {
+    return 0.0f;
+  }
+  return acosf(optix::clamp(optix::dot(a, b) / (la * lb), -1.0f, 1.0f)) * 180.0f / M_PIf;
+}
+
+// Half floats have 11 significant bits.
+static bool isHalfAccurate(const float original, const float unpacked)
+{
+  return fabsf(original - unpacked) <= fabsf(original) * (1.0f / 2048.0f) + 1.0e-7f;
+}
+
+
+bool benchmarkVertices()
+{
+  std::vector<SceneObject> objects;
+  createSceneObjects(objects);
+
+  bool passed = true;
+
+  std::cout << "benchmarkVertices(): Compact vertex attributes of the scene objects" << std::endl;
+
+  for (size_t o = 0; o < objects.size(); ++o)
+  {
+    std::vector<VertexAttributes> const& attributes = objects[o].attributes;
+
+    const size_t count = attributes.size();
+
+    std::vector<optix::float3>           positions(count);
+    std::vector<VertexAttributesCompact> compact(count);
+
+    double best = 1.0e30;
+    for (int run = 0; run < BENCHMARK_RUNS; ++run)
+    {
+      Timer timer;
+      timer.start();
+      for (size_t i = 0; i < count; ++i)
+      {
+        packVertexAttributes(attributes[i], positions[i], compact[i]);
+      }
+      best = std::min(best, timer.getTime());
+    }
+
+    float maxErrorTangent  = 0.0f; // Degrees.
+    float maxErrorNormal   = 0.0f; // Degrees.
+    float maxErrorTexcoord = 0.0f; // Absolute.
+    bool  isAccurate       = true;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      const VertexAttributes unpacked = unpackVertexAttributes(positions[i], compact[i]);
+
+      maxErrorTangent  = std::max(maxErrorTangent, angleBetween(attributes[i].tangent, unpacked.tangent));
+      maxErrorNormal   = std::max(maxErrorNormal,  angleBetween(attributes[i].normal,  unpacked.normal));
+      maxErrorTexcoord = std::max(maxErrorTexcoord, std::max(fabsf(attributes[i].texcoord.x - unpacked.texcoord.x),
+                                                             fabsf(attributes[i].texcoord.y - unpacked.texcoord.y)));
+
+      isAccurate = isAccurate && isHalfAccurate(attributes[i].texcoord.x, unpacked.texcoord.x)
+                              && isHalfAccurate(attributes[i].texcoord.y, unpacked.texcoord.y);
+    }
+    // Octahedral encoding with two snorm16 components is accurate to about 0.05 degrees.
+    isAccurate = isAccurate && maxErrorTangent < 0.1f && maxErrorNormal < 0.1f;
+
+    passed = passed && isAccurate;
+
+    std::cout << "  object " << o << ": " << count << " vertices, "
+              << count * (sizeof(optix::float3) + sizeof(VertexAttributesCompact)) << " bytes (compact), "
+              << count * sizeof(VertexAttributes) << " bytes (uncompressed), pack = " << best * 1000.0 << " ms"
+              << ", max. error tangent = " << maxErrorTangent << " deg, normal = " << maxErrorNormal << " deg, texcoord = " << maxErrorTexcoord
+              << ((isAccurate) ? "" : " FAILED") << std::endl;
+  }
+  return passed;
+}
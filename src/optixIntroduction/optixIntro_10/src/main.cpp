@@ -55,6 +55,16 @@
 #include "shaders/app_config.h"
 
 #include "inc/Application.h"
+#include "inc/BlockCache.h"
+#include "inc/ConvertBenchmark.h"
+#include "inc/CpuRenderer.h"
+#include "inc/EnvironmentCache.h"
+#include "inc/MipmapBenchmark.h"
+#include "inc/OrientationBenchmark.h"
+#include "inc/CompressionBenchmark.h"
+#include "inc/HDRBenchmark.h"
+#include "inc/SamplingBenchmark.h"
+#include "inc/VertexBenchmark.h"
 
 #include <sutil.h>
 
@@ -64,6 +74,7 @@
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 
 static Application* g_app = nullptr;
 
@@ -87,8 +98,20 @@ void printUsage(const std::string& argv0)
     "  -l | --light           Add an area light to the scene.\n"
     "  -m | --miss  <0|1|2>   Select the miss shader (0 = black, 1 = white, 2 = HDR texture.\n"
     "  -e | --env <filename>  Filename of a spherical HDR texture. Use with --miss 2.\n"
+    "  -k | --cache <mode>    Cache files next to their sources, <filename>.envcache with the --env CDFs and <image>.bccache with the --compress blocks:\n"
+    "                         off (default), on, or clear to rebuild them.\n"
+    "  -t | --compress <mode> Block compress the material textures: off (default), fast, normal, or high quality (needs OptiX 6.0).\n"
     "  -s | --stack <int>     Set the OptiX stack size (1024) (debug feature).\n"
     "  -f | --file <filename> Save image to file and exit.\n"
+    "  -c | --cpu             Render 64 samples per pixel on the CPU without OptiX, save the image and exit (miss 0 or 1, default 1).\n"
+    "  -b | --benchmark <name> Run a CPU benchmark and exit:\n"
+    "                         sampling: Test the CDFs and compare CDF and alias table sampling of the --env file (default: all bundled *.hdr files).\n"
+    "                         mipmaps:  Test and time the mipmap generation for all image formats and types.\n"
+    "                         convert:  Test and time the texture upload conversions for all image formats and types.\n"
+    "                         orientation: Test and time the image mirroring during loading on mipmapped cubemaps.\n"
+    "                         compression: Test and time the BC1, BC3, BC5, and BC6H encoders and print their PSNR.\n"
+    "                         vertices: Test the quantization error and time the packing of the compact vertex attributes.\n"
+    "                         hdr:      Compare the mapped, parallel HDR decoder against the stream reader on the --env file (default: all bundled *.hdr files).\n"
   "App Keystrokes:\n"
   "  SPACE  Toggles ImGui display.\n"
   "\n"
@@ -105,10 +128,16 @@ int main(int argc, char *argv[])
   int  stackSize    = 1024;  // Command line parameter just to be able to find the smallest working size.
   bool light        = false; // Add a geometric are light. Best used with miss 0 and 1.
   int  miss         = 2;     // Select the environment light (0 = black, no light; 1 = constant white environment; 3 = spherical environment texture.
+  bool hasMiss      = false; // The --cpu default is the constant white environment unless --miss is given.
   std::string environment = std::string(sutil::samplesDir()) + "/data/NV_Default_HDR_3000x1500.hdr";
 
   std::string filenameScreenshot;
   bool hasGUI = true;
+  bool cpu    = false; // Use the host reference renderer, which needs no OptiX device, window or OpenGL context.
+  std::string benchmark;  // CPU benchmarks, which need no OptiX device.
+  bool hasEnvironment = false;
+  std::string cache("off"); // Map the environment texels and CDFs and the compressed texture blocks from cache files next to their sources. Off by default, the environment cache is as big as the texels.
+  unsigned int compression = 0; // Block compression quality of the material textures, 0 = off.
   
   // Parse the command line parameters.
   for (int i = 1; i < argc; ++i)
@@ -175,7 +204,8 @@ int main(int argc, char *argv[])
       const int m = atoi(argv[++i]);
       if (0 <= m && m <= 2)
       {
-        miss = m;
+        miss    = m;
+        hasMiss = true;
       }
     }
     else if (arg == "-l" || arg == "--light")
@@ -191,6 +221,29 @@ int main(int argc, char *argv[])
         return 0;
       }
       environment = std::string(argv[++i]);
+      hasEnvironment = true;
+    }
+    else if (arg == "-k" || arg == "--cache")
+    {
+      if (i == argc - 1 || (std::string(argv[i + 1]) != "on" && std::string(argv[i + 1]) != "off" && std::string(argv[i + 1]) != "clear"))
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument on, off, or clear.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      cache = argv[++i];
+    }
+    else if (arg == "-t" || arg == "--compress")
+    {
+      const std::string mode((i < argc - 1) ? argv[i + 1] : "");
+      if (mode != "off" && mode != "fast" && mode != "normal" && mode != "high")
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument off, fast, normal, or high.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      compression = (mode == "fast") ? 1 : (mode == "normal") ? 2 : (mode == "high") ? 3 : 0;
+      ++i;
     }
     else if (arg == "-f" || arg == "--file")
     {
@@ -203,6 +256,20 @@ int main(int argc, char *argv[])
       filenameScreenshot = argv[++i];
       hasGUI = false; // Do not render the GUI when just taking a screenshot. (Automated QA feature.)
     }
+    else if (arg == "-c" || arg == "--cpu")
+    {
+      cpu = true;
+    }
+    else if (arg == "-b" || arg == "--benchmark")
+    {
+      if (i == argc - 1)
+      { 
+        std::cerr << "Option '" << arg << "' requires additional argument.\n";
+        printUsage(argv[0]);
+        return 0;
+      }
+      benchmark = argv[++i];
+    }
     else
     {
       std::cerr << "Unknown option '" << arg << "'\n";
@@ -211,6 +278,93 @@ int main(int argc, char *argv[])
     }
   }
 
+  if (benchmark == "mipmaps")
+  {
+    return (benchmarkMipmaps()) ? 0 : 5;
+  }
+  else if (benchmark == "convert")
+  {
+    return (benchmarkConvert()) ? 0 : 5;
+  }
+  else if (benchmark == "orientation")
+  {
+    return (benchmarkOrientation()) ? 0 : 5;
+  }
+  else if (benchmark == "compression")
+  {
+    return (benchmarkCompression()) ? 0 : 5;
+  }
+  else if (benchmark == "vertices")
+  {
+    return (benchmarkVertices()) ? 0 : 5;
+  }
+  else if (benchmark == "sampling" || benchmark == "hdr")
+  {
+    std::vector<std::string> filenames;
+    if (hasEnvironment)
+    {
+      filenames.push_back(environment);
+    }
+    else
+    {
+      filenames.push_back(std::string(sutil::samplesDir()) + "/data/CedarCity.hdr");
+      filenames.push_back(std::string(sutil::samplesDir()) + "/data/NV_Default_HDR_3000x1500.hdr");
+    }
+
+    bool passed = true;
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+      passed = ((benchmark == "sampling") ? benchmarkEnvironmentSampling(filenames[i]) : benchmarkHDRLoader(filenames[i])) && passed;
+    }
+    return (passed) ? 0 : 5;
+  }
+  else if (!benchmark.empty())
+  {
+    std::cerr << "Option '--benchmark' requires additional argument sampling, mipmaps, convert, orientation, compression, vertices, or hdr.\n";
+    printUsage(argv[0]);
+    return 0;
+  }
+
+  if (cpu)
+  {
+    ilInit(); // Only used to load the textures and to save the image.
+
+    if (!hasMiss)
+    {
+      miss = 1; // The CpuRenderer doesn't support the HDR environment texture.
+    }
+
+    CpuRenderer renderer(windowWidth, windowHeight, light, miss);
+    if (!renderer.isValid())
+    {
+      error_callback(4, "CpuRenderer initialization failed.");
+      ilShutDown();
+      return 4;
+    }
+
+    const int samples = 64; // Same number of samples per pixel as the --file screenshot.
+
+    const double t0 = sutil::currentTime();
+    for (int i = 0; i < samples; ++i)
+    {
+      renderer.render();
+    }
+    const double seconds = sutil::currentTime() - t0;
+
+    std::cout << "CpuRenderer: " << samples << " samples per pixel in " << seconds << " seconds, "
+              << double(windowWidth) * windowHeight * samples / seconds * 1.0e-6 << " Msamples/s" << std::endl;
+
+    if (!renderer.screenshot((filenameScreenshot.empty()) ? std::string("optixIntro_10_cpu.hdr") : filenameScreenshot))
+    {
+      error_callback(5, "CpuRenderer screenshot failed.");
+      ilShutDown();
+      return 5;
+    }
+
+    ilShutDown();
+    return 0;
+  }
+
   glfwSetErrorCallback(error_callback);
 
   if (!glfwInit())
@@ -238,8 +392,29 @@ int main(int argc, char *argv[])
 
   ilInit(); // Initialize DevIL once.
 
+  if (cache == "clear")
+  {
+    if (EnvironmentCache::clear(environment))
+    {
+      std::cout << "Removed " << EnvironmentCache::cacheFilename(environment) << std::endl;
+    }
+
+    const std::string textures[2] =
+    {
+      std::string(sutil::samplesDir()) + SCENE_TEXTURE_ALBEDO,
+      std::string(sutil::samplesDir()) + SCENE_TEXTURE_CUTOUT
+    };
+    for (int i = 0; i < 2; ++i)
+    {
+      if (BlockCache::clear(textures[i]))
+      {
+        std::cout << "Removed " << BlockCache::cacheFilename(textures[i]) << std::endl;
+      }
+    }
+  }
+
   g_app = new Application(window, windowWidth, windowHeight,
-                          devices, stackSize, interop, light, miss, environment);
+                          devices, stackSize, interop, light, miss, environment, cache != "off", compression);
 
   if (!g_app->isValid())
   {
@@ -277,6 +452,8 @@ int main(int argc, char *argv[])
     }
     else
     {
+      g_app->finishEnvironment(); // Don't take the screenshot with the preview environment.
+
       for (int i = 0; i < 64; ++i) // Accumulate 64 samples per pixel.
       {
         g_app->render();  // OptiX rendering and OpenGL texture update.
@@ -50,9 +50,9 @@
 #include <Camera.h>
 
 #include "Mesh.h"
+#include "photon_map.h"
 #include "ppm.h"
 #include "random.h"
-#include "select.h"
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw_gl2.h>
@@ -60,9 +60,13 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <limits>
+#include <random>
+#include <stdexcept>
 #include <stdint.h>
+#include <vector>
 
 using namespace optix;
 
@@ -73,12 +77,8 @@ const unsigned int MAX_PHOTON_COUNT = 2u;
 const unsigned int PHOTON_LAUNCH_DIM = 512u;
 const float LIGHT_THETA = 1.15f;
 const float LIGHT_PHI = 2.19f;
-
-enum SplitChoice {
-  RoundRobin,
-  HighestVariance,
-  LongestDim
-};
+const KDTreeLayout PHOTON_MAP_LAYOUT = LeftBalancedLayout;
+const float PHOTON_GRID_CELL_SIZE = 1.0f; // Twice the radius of rtpass_default_radius2, the radii only shrink.
 
 //------------------------------------------------------------------------------
 //
@@ -90,6 +90,7 @@ Context      context = 0;
 
 bool s_display_debug_buffer = false;
 bool s_print_timings = false;
+PhotonMapType s_photon_map_type = KDTreePhotonMap;
 
 
 //------------------------------------------------------------------------------
@@ -111,23 +112,6 @@ static unsigned int pow2roundup(unsigned int x)
   return x+1;
 }
 
-static int max_component(float3 a)
-{
-  if(a.x > a.y) {
-    if(a.x > a.z) {
-      return 0;
-    } else {
-      return 2;
-    }
-  } else {
-    if(a.y > a.z) {
-      return 1;
-    } else {
-      return 2;
-    }
-  }
-}
-
 static float3 sphericalToCartesian( float theta, float phi )
 {
   float cos_theta = cosf( theta );
@@ -247,7 +231,7 @@ void createContext( bool use_pbo, unsigned int photon_launch_dim, Buffer& photon
     // Photon pass
     const unsigned int num_photons = photon_launch_dim * photon_launch_dim * MAX_PHOTON_COUNT;
     photons_buffer = context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_USER, num_photons );
-    photons_buffer->setElementSize( sizeof( PhotonRecord ) );
+    photons_buffer->setElementSize( sizeof( PackedPhotonRecord ) );
     context["ppass_output_buffer"]->set( photons_buffer );
 
     {
@@ -275,10 +259,20 @@ void createContext( bool use_pbo, unsigned int photon_launch_dim, Buffer& photon
         Program exception_program = context->createProgramFromPTXFile( ptx_path, "gather_exception" );
         context->setExceptionProgram( gather, exception_program );
 
-        unsigned int photon_map_size = pow2roundup( num_photons ) - 1;
+        // The complete kd-tree needs a power of two minus one nodes, the left-balanced one and the hash grid a node per photon.
+        const bool complete_kd_tree = s_photon_map_type == KDTreePhotonMap && PHOTON_MAP_LAYOUT == CompleteLayout;
+        unsigned int photon_map_size = ( complete_kd_tree ) ? pow2roundup( num_photons ) - 1 : num_photons;
         photon_map_buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_USER, photon_map_size );
-        photon_map_buffer->setElementSize( sizeof( PhotonRecord ) );
+        photon_map_buffer->setElementSize( sizeof( PackedPhotonRecord ) );
         context["photon_map"]->set( photon_map_buffer );
+        context["photon_map_count"]->setUint( 0u );
+
+        // The hash grid has about a bucket per photon.
+        const unsigned int grid_size = ( s_photon_map_type == HashGridPhotonMap ) ? pow2roundup( num_photons ) : 1u;
+        context["photon_map_type"]->setUint( s_photon_map_type );
+        context["photon_grid_start"]->set( context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, grid_size ) );
+        context["photon_grid_count"]->set( context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, grid_size ) );
+        context["photon_grid_cell_size"]->setFloat( PHOTON_GRID_CELL_SIZE );
     }
 
 }
@@ -433,130 +427,36 @@ void createLight( PPMLight& light )
 //
 //------------------------------------------------------------------------------
 
-bool photonCmpX( PhotonRecord* r1, PhotonRecord* r2 ) { return r1->position.x < r2->position.x; }
-bool photonCmpY( PhotonRecord* r1, PhotonRecord* r2 ) { return r1->position.y < r2->position.y; }
-bool photonCmpZ( PhotonRecord* r1, PhotonRecord* r2 ) { return r1->position.z < r2->position.z; }
-
-
-void buildKDTree( PhotonRecord** photons, int start, int end, int depth, PhotonRecord* kd_tree, int current_root,
-                  SplitChoice split_choice, float3 bbmin, float3 bbmax)
-{
-  // If we have zero photons, this is a NULL node
-  if( end - start == 0 ) {
-    kd_tree[current_root].axis = PPM_NULL;
-    kd_tree[current_root].energy = make_float3( 0.0f );
-    return;
-  }
-
-  // If we have a single photon
-  if( end - start == 1 ) {
-    photons[start]->axis = PPM_LEAF;
-    kd_tree[current_root] = *(photons[start]);
-    return;
-  }
-
-  // Choose axis to split on
-  int axis;
-  switch(split_choice) {
-  case RoundRobin:
-    {
-      axis = depth%3;
-    }
-    break;
-  case HighestVariance:
-    {
-      float3 mean  = make_float3( 0.0f ); 
-      float3 diff2 = make_float3( 0.0f );
-      for(int i = start; i < end; ++i) {
-        float3 x     = photons[i]->position;
-        float3 delta = x - mean;
-        float3 n_inv = make_float3( 1.0f / ( static_cast<float>( i - start ) + 1.0f ) );
-        mean = mean + delta * n_inv;
-        diff2 += delta*( x - mean );
-      }
-      float3 n_inv = make_float3( 1.0f / ( static_cast<float>(end-start) - 1.0f ) );
-      float3 variance = diff2 * n_inv;
-      axis = max_component(variance);
-    }
-    break;
-  case LongestDim:
-    {
-      float3 diag = bbmax-bbmin;
-      axis = max_component(diag);
-    }
-    break;
-  default:
-    axis = -1;
-    std::cerr << "Unknown SplitChoice " << split_choice << " at "<<__FILE__<<":"<<__LINE__<<"\n";
-    exit(2);
-    break;
-  }
-
-  int median = (start+end) / 2;
-  PhotonRecord** start_addr = &(photons[start]);
-
-  switch( axis ) {
-  case 0:
-    select<PhotonRecord*, 0>( start_addr, 0, end-start-1, median-start );
-    photons[median]->axis = PPM_X;
-    break;
-  case 1:
-    select<PhotonRecord*, 1>( start_addr, 0, end-start-1, median-start );
-    photons[median]->axis = PPM_Y;
-    break;
-  case 2:
-    select<PhotonRecord*, 2>( start_addr, 0, end-start-1, median-start );
-    photons[median]->axis = PPM_Z;
-    break;
-  }
-
-  float3 rightMin = bbmin;
-  float3 leftMax  = bbmax;
-  if(split_choice == LongestDim) {
-    float3 midPoint = (*photons[median]).position;
-    switch( axis ) {
-      case 0:
-        rightMin.x = midPoint.x;
-        leftMax.x  = midPoint.x;
-        break;
-      case 1:
-        rightMin.y = midPoint.y;
-        leftMax.y  = midPoint.y;
-        break;
-      case 2:
-        rightMin.z = midPoint.z;
-        leftMax.z  = midPoint.z;
-        break;
-    }
-  }
-
-  kd_tree[current_root] = *(photons[median]);
-  buildKDTree( photons, start, median, depth+1, kd_tree, 2*current_root+1, split_choice, bbmin,  leftMax );
-  buildKDTree( photons, median+1, end, depth+1, kd_tree, 2*current_root+2, split_choice, rightMin, bbmax );
-}
-
 void createPhotonMap( Buffer photons_buffer, Buffer photon_map_buffer )
 {
   const SplitChoice split_choice = LongestDim;
 
-  PhotonRecord* photons_data    = reinterpret_cast<PhotonRecord*>( photons_buffer->map() );
-  PhotonRecord* photon_map_data = reinterpret_cast<PhotonRecord*>( photon_map_buffer->map() );
+  PackedPhotonRecord* photons_data    = reinterpret_cast<PackedPhotonRecord*>( photons_buffer->map() );
+  PackedPhotonRecord* photon_map_data = reinterpret_cast<PackedPhotonRecord*>( photon_map_buffer->map() );
 
   RTsize photon_map_size;
   photon_map_buffer->getSize( photon_map_size );
-  for( unsigned int i = 0; i < (unsigned int)photon_map_size; ++i ) {
-    photon_map_data[i].energy = make_float3( 0.0f );
-  }
-
-  // Push all valid photons to front of list
   RTsize num_photons;
   photons_buffer->getSize( num_photons );
-  unsigned int valid_photons = 0;
-  PhotonRecord** temp_photons = new PhotonRecord*[num_photons];
-  for( unsigned int i = 0; i < (unsigned int)num_photons; ++i ) {
-    if( fmaxf( photons_data[i].energy ) > 0.0f ) {
-      temp_photons[valid_photons++] = &photons_data[i];
-    }
+
+  unsigned int valid_photons;
+  if( s_photon_map_type == HashGridPhotonMap ) {
+    Buffer grid_start_buffer = context["photon_grid_start"]->getBuffer();
+    Buffer grid_count_buffer = context["photon_grid_count"]->getBuffer();
+    RTsize grid_size;
+    grid_start_buffer->getSize( grid_size );
+
+    valid_photons = buildPhotonGrid( photons_data, static_cast<unsigned int>( num_photons ),
+                                     photon_map_data, static_cast<unsigned int>( photon_map_size ),
+                                     reinterpret_cast<unsigned int*>( grid_start_buffer->map() ),
+                                     reinterpret_cast<unsigned int*>( grid_count_buffer->map() ),
+                                     static_cast<unsigned int>( grid_size ), PHOTON_GRID_CELL_SIZE, true );
+    grid_count_buffer->unmap();
+    grid_start_buffer->unmap();
+  } else {
+    valid_photons = buildPhotonMap( photons_data, static_cast<unsigned int>( num_photons ),
+                                    photon_map_data, static_cast<unsigned int>( photon_map_size ),
+                                    split_choice, PHOTON_MAP_LAYOUT, IndexBuilder, true );
   }
   if ( s_display_debug_buffer ) {
     std::cerr << " ** valid_photon/m_num_photons =  " 
@@ -564,28 +464,12 @@ void createPhotonMap( Buffer photons_buffer, Buffer photon_map_buffer )
               <<" ("<<valid_photons/static_cast<float>(num_photons)<<")\n";
   }
 
-  // Make sure we aren't at most 1 less than power of 2
-  valid_photons = (valid_photons >= (unsigned int) photon_map_size) ? (unsigned int) photon_map_size : valid_photons;
-
-  float3 bbmin = make_float3(0.0f);
-  float3 bbmax = make_float3(0.0f);
-  if( split_choice == LongestDim ) {
-    bbmin = make_float3(  std::numeric_limits<float>::max() );
-    bbmax = make_float3( -std::numeric_limits<float>::max() );
-    // Compute the bounds of the photons
-    for(unsigned int i = 0; i < valid_photons; ++i) {
-      float3 position = (*temp_photons[i]).position;
-      bbmin = fminf(bbmin, position);
-      bbmax = fmaxf(bbmax, position);
-    }
-  }
-
-  // Now build KD tree
-  buildKDTree( temp_photons, 0, valid_photons, 0, photon_map_data, 0, split_choice, bbmin, bbmax );
-
-  delete[] temp_photons;
   photon_map_buffer->unmap();
   photons_buffer->unmap();
+
+  // The gather program skips the nodes after the tree.  All nodes of the complete layout are valid or PPM_NULL.
+  const bool complete_kd_tree = s_photon_map_type == KDTreePhotonMap && PHOTON_MAP_LAYOUT == CompleteLayout;
+  context["photon_map_count"]->setUint( ( complete_kd_tree ) ? static_cast<unsigned int>( photon_map_size ) : valid_photons );
 }
 
 
@@ -903,6 +787,401 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, PPMLight& light, unsign
 }
 
 
+//------------------------------------------------------------------------------
+//
+// Host-side benchmarks (no OptiX context or window required)
+//
+//------------------------------------------------------------------------------
+
+// Photons spread like the ones of the ring scene: most of them on the floor plane, which gives
+// many equal y coordinates, the rest on a torus.  The photons which left the scene have no energy.
+static void makePhotons( std::vector<PackedPhotonRecord>& photons, unsigned int count, float survival, unsigned int seed )
+{
+  std::mt19937 rng( seed );
+  std::uniform_real_distribution<float> uniform( 0.0f, 1.0f );
+
+  photons.resize( count );
+  for( unsigned int i = 0; i < count; ++i ) {
+    PhotonRecord photon = PhotonRecord();
+    const float u = uniform( rng );
+    const float v = uniform( rng ) * 2.0f * M_PIf;
+    const float w = uniform( rng ) * 2.0f * M_PIf;
+    if( uniform( rng ) < 0.75f ) {
+      const float r = 150.0f * sqrtf( u );
+      photon.position = make_float3( r * cosf( v ), 0.0f, r * sinf( v ) );
+      photon.normal   = make_float3( 0.0f, 1.0f, 0.0f );
+    } else {
+      photon.normal   = make_float3( cosf( w ) * cosf( v ), sinf( w ), cosf( w ) * sinf( v ) );
+      photon.position = make_float3( 50.0f * cosf( v ), 25.0f, 50.0f * sinf( v ) ) + 10.0f * photon.normal;
+    }
+    photon.ray_dir = normalize( make_float3( u - 0.5f, -1.0f, 0.5f - u ) );
+    photon.energy  = ( uniform( rng ) < survival ) ? make_float3( 0.2f, 0.18f, 0.15f ) * ( u + 0.1f ) : make_float3( 0.0f );
+    photons[i] = packPhoton( photon );
+  }
+}
+
+
+// Times buildPhotonMap() on a copy of photons, since the build writes the photons' axis.
+static double timeBuildPhotonMap( const std::vector<PackedPhotonRecord>& photons, std::vector<PackedPhotonRecord>& photon_map,
+                                  KDTreeBuilder builder, bool parallel, int runs )
+{
+  double best = 1e30;
+  for( int i = 0; i < runs; ++i ) {
+    std::vector<PackedPhotonRecord> input( photons );
+    const double t0 = sutil::currentTime();
+    buildPhotonMap( input.data(), static_cast<unsigned int>( input.size() ),
+                    photon_map.data(), static_cast<unsigned int>( photon_map.size() ), LongestDim, CompleteLayout, builder, parallel );
+    best = std::min( best, sutil::currentTime() - t0 );
+  }
+  return best;
+}
+
+
+// Compares the single-threaded and the task-parallel kd-tree build.  Both need to give the same tree.
+bool benchmarkKdTree()
+{
+  const int runs = 3;
+  bool identical_all = true;
+  std::cerr << "Photon kd-tree build in ms per frame (best of " << runs << ", " << sutil::numThreads() << " threads):\n"
+            << "   photons |    serial |  parallel | speedup | identical\n";
+  for( unsigned int count = 1u << 16; count <= 1u << 22; count <<= 2 ) {
+    std::vector<PackedPhotonRecord> photons;
+    makePhotons( photons, count, 0.9f, count );
+
+    std::vector<PackedPhotonRecord> serial( pow2roundup( count ) - 1 );
+    std::vector<PackedPhotonRecord> parallel( serial.size() );
+    const double t_serial   = timeBuildPhotonMap( photons, serial,   PointerBuilder, false, runs );
+    const double t_parallel = timeBuildPhotonMap( photons, parallel, PointerBuilder, true,  runs );
+    const bool identical = memcmp( serial.data(), parallel.data(), serial.size() * sizeof( PackedPhotonRecord ) ) == 0;
+    identical_all = identical_all && identical;
+
+    std::cerr << "  " << std::setw( 8 ) << count
+              << " | " << std::setw( 9 ) << t_serial * 1000.0
+              << " | " << std::setw( 9 ) << t_parallel * 1000.0
+              << " | " << std::setw( 7 ) << t_serial / t_parallel
+              << " | " << ( identical ? "yes" : "NO" ) << std::endl;
+  }
+  return identical_all;
+}
+
+
+// Estimated memory traffic of a build in MB, assuming one partition pass over all photons per tree level.
+// The pointer builder reads a pointer and the record of record bytes behind it per comparison and copies the records
+// into the map.  The index builder reads all records once to extract 16 bytes of position and index per valid
+// photon, partitions those and gathers the records into the map once.
+static double estimateBuildTraffic( KDTreeBuilder builder, double record, unsigned int num_photons, unsigned int valid_photons,
+                                    unsigned int photon_map_size )
+{
+  unsigned int levels = 0;
+  while( ( 1u << levels ) - 1 < valid_photons )
+    ++levels;
+  const double n      = valid_photons;
+  double bytes;
+  if( builder == PointerBuilder ) {
+    bytes = num_photons * record          // Find the valid photons.
+          + photon_map_size * record      // Clear the map.
+          + n * levels * ( 8.0 + record ) // Partitions.
+          + n * 2.0 * record;             // Copy into the map.
+  } else {
+    bytes = num_photons * record          // Extract the positions.
+          + n * levels * 16.0             // Partitions.
+          + photon_map_size * 5.0         // Node indices and axes.
+          + n * record                    // Gather.
+          + photon_map_size * record;     // Write the map.
+  }
+  return bytes / ( 1024.0 * 1024.0 );
+}
+
+
+// Compares the pointer-based and the index-based kd-tree builder, both single-threaded.  Both need to give the same tree.
+bool benchmarkIndexBuilder()
+{
+  const int runs = 3;
+  bool identical_all = true;
+  std::cerr << "Photon kd-tree build in ms per frame (best of " << runs << ", single-threaded) and estimated traffic in MB:\n"
+            << "   photons |   pointer |     index | speedup | pointer MB |   index MB | identical\n";
+  for( unsigned int count = 1u << 16; count <= 1u << 22; count <<= 2 ) {
+    std::vector<PackedPhotonRecord> photons;
+    makePhotons( photons, count, 0.9f, count );
+
+    std::vector<PackedPhotonRecord> pointer( pow2roundup( count ) - 1 );
+    std::vector<PackedPhotonRecord> index( pointer.size() );
+    const double t_pointer = timeBuildPhotonMap( photons, pointer, PointerBuilder, false, runs );
+    const double t_index   = timeBuildPhotonMap( photons, index,   IndexBuilder,   false, runs );
+    const bool identical = memcmp( pointer.data(), index.data(), pointer.size() * sizeof( PackedPhotonRecord ) ) == 0;
+    identical_all = identical_all && identical;
+
+    unsigned int valid_photons = 0;
+    for( unsigned int i = 0; i < count; ++i )
+      valid_photons += photonHasEnergy( photons[i] ) ? 1 : 0;
+    valid_photons = std::min( valid_photons, static_cast<unsigned int>( pointer.size() ) );
+
+    std::cerr << "  " << std::setw( 8 ) << count
+              << " | " << std::setw( 9 ) << t_pointer * 1000.0
+              << " | " << std::setw( 9 ) << t_index * 1000.0
+              << " | " << std::setw( 7 ) << t_pointer / t_index
+              << " | " << std::setw( 10 ) << estimateBuildTraffic( PointerBuilder, sizeof( PackedPhotonRecord ), count, valid_photons, static_cast<unsigned int>( pointer.size() ) )
+              << " | " << std::setw( 10 ) << estimateBuildTraffic( IndexBuilder,   sizeof( PackedPhotonRecord ), count, valid_photons, static_cast<unsigned int>( pointer.size() ) )
+              << " | " << ( identical ? "yes" : "NO" ) << std::endl;
+  }
+  return identical_all;
+}
+
+
+// Compares the complete and the left-balanced kd-tree layout for different shares of photons with energy:
+// nodes the tree spans and nodes visited per gather query.  Both layouts need to find the same photons.
+bool benchmarkLayout()
+{
+  const unsigned int num_photons = PHOTON_LAUNCH_DIM * PHOTON_LAUNCH_DIM * MAX_PHOTON_COUNT;
+  const unsigned int num_queries = 1u << 16;
+  const float radius2 = 0.25f; // rtpass_default_radius2
+  const float survivals[] = { 0.9f, 0.5f, 0.25f, 0.1f }; // All photons don't fit into the complete layout.
+
+  bool identical_all = true;
+  std::cerr << "Photon map layouts for " << num_photons << " photons, " << num_queries << " queries with radius^2 " << radius2 << ":\n"
+            << "  survival |   photons | complete nodes (MB) | left-balanced nodes (MB) | complete steps | left-balanced steps | same photons\n";
+  for( size_t i = 0; i < sizeof( survivals ) / sizeof( survivals[0] ); ++i ) {
+    std::vector<PackedPhotonRecord> photons;
+    makePhotons( photons, num_photons, survivals[i], num_photons + static_cast<unsigned int>( i ) );
+
+    std::vector<PackedPhotonRecord> complete( pow2roundup( num_photons ) - 1 );
+    std::vector<PackedPhotonRecord> balanced( num_photons );
+    std::vector<PackedPhotonRecord> input( photons );
+    const unsigned int valid_photons =
+      buildPhotonMap( input.data(), num_photons, complete.data(), static_cast<unsigned int>( complete.size() ), LongestDim, CompleteLayout, IndexBuilder, true );
+    buildPhotonMap( input.data(), num_photons, balanced.data(), static_cast<unsigned int>( balanced.size() ), LongestDim, LeftBalancedLayout, IndexBuilder, true );
+
+    // Query around the photons like hit points on the same surfaces.
+    std::mt19937 rng( 7 );
+    std::uniform_int_distribution<unsigned int> pick( 0, std::max( valid_photons, 1u ) - 1 );
+    std::uniform_real_distribution<float> jitter( -1.0f, 1.0f );
+    unsigned long long steps_complete = 0;
+    unsigned long long steps_balanced = 0;
+    bool identical = true;
+    for( unsigned int q = 0; q < num_queries; ++q ) {
+      const float3 position = balanced[pick( rng )].position + make_float3( jitter( rng ), jitter( rng ), jitter( rng ) );
+      unsigned int steps;
+      const unsigned int found_complete = queryPhotonMap( complete.data(), static_cast<unsigned int>( complete.size() ), position, radius2, steps );
+      steps_complete += steps;
+      const unsigned int found_balanced = queryPhotonMap( balanced.data(), valid_photons, position, radius2, steps );
+      steps_balanced += steps;
+      identical = identical && found_complete == found_balanced;
+    }
+    identical_all = identical_all && identical;
+
+    // The complete tree reaches up to the next power of two minus one.
+    const unsigned int nodes_complete = pow2roundup( valid_photons + 1 ) - 1;
+    const double mb = sizeof( PackedPhotonRecord ) / ( 1024.0 * 1024.0 );
+    std::cerr << "  " << std::setw( 8 ) << survivals[i]
+              << " | " << std::setw( 9 ) << valid_photons
+              << " | " << std::setw( 9 ) << nodes_complete << " (" << std::setw( 6 ) << nodes_complete * mb << ")"
+              << " | " << std::setw( 13 ) << valid_photons << " (" << std::setw( 7 ) << valid_photons * mb << ")"
+              << " | " << std::setw( 14 ) << double( steps_complete ) / num_queries
+              << " | " << std::setw( 19 ) << double( steps_balanced ) / num_queries
+              << " | " << ( identical ? "yes" : "NO" ) << std::endl;
+  }
+  return identical_all;
+}
+
+
+// Compares the left-balanced kd-tree and the hash grid photon map: build time, and query time and photons
+// tested or nodes visited per query for shrinking radii.  Both need to find the same photons.
+bool benchmarkHashGrid()
+{
+  const unsigned int num_photons = PHOTON_LAUNCH_DIM * PHOTON_LAUNCH_DIM * MAX_PHOTON_COUNT;
+  const unsigned int num_queries = 1u << 16;
+  const float radii2[] = { 0.25f, 0.0625f, 0.01f }; // rtpass_default_radius2 and below, the radii only shrink.
+  const int runs = 3;
+
+  std::vector<PackedPhotonRecord> photons;
+  makePhotons( photons, num_photons, 0.9f, num_photons );
+
+  std::vector<PackedPhotonRecord> kd_tree( num_photons );
+  std::vector<PackedPhotonRecord> grid( num_photons );
+  std::vector<unsigned int> grid_start( pow2roundup( num_photons ) );
+  std::vector<unsigned int> grid_count( grid_start.size() );
+
+  double t_kd_tree = 1e30;
+  double t_grid    = 1e30;
+  unsigned int valid_photons = 0;
+  for( int i = 0; i < runs; ++i ) {
+    std::vector<PackedPhotonRecord> input( photons );
+    double t0 = sutil::currentTime();
+    valid_photons = buildPhotonMap( input.data(), num_photons, kd_tree.data(), num_photons,
+                                    LongestDim, LeftBalancedLayout, IndexBuilder, true );
+    t_kd_tree = std::min( t_kd_tree, sutil::currentTime() - t0 );
+
+    t0 = sutil::currentTime();
+    buildPhotonGrid( input.data(), num_photons, grid.data(), num_photons, grid_start.data(), grid_count.data(),
+                     static_cast<unsigned int>( grid_start.size() ), PHOTON_GRID_CELL_SIZE, true );
+    t_grid = std::min( t_grid, sutil::currentTime() - t0 );
+  }
+  std::cerr << "Photon map build of " << num_photons << " photons in ms (best of " << runs << ", " << sutil::numThreads() << " threads):\n"
+            << "  kd-tree " << t_kd_tree * 1000.0 << ", hash grid " << t_grid * 1000.0
+            << " (speedup " << t_kd_tree / t_grid << ")\n";
+
+  // Query around the photons like hit points on the same surfaces.
+  std::vector<float3> positions( num_queries );
+  std::mt19937 rng( 7 );
+  std::uniform_int_distribution<unsigned int> pick( 0, std::max( valid_photons, 1u ) - 1 );
+  std::uniform_real_distribution<float> jitter( -1.0f, 1.0f );
+  for( unsigned int q = 0; q < num_queries; ++q ) {
+    positions[q] = kd_tree[pick( rng )].position + make_float3( jitter( rng ), jitter( rng ), jitter( rng ) );
+  }
+
+  bool identical_all = true;
+  std::cerr << num_queries << " queries in ms, cell size " << PHOTON_GRID_CELL_SIZE << ":\n"
+            << "  radius^2 | kd-tree ms | hash grid ms | speedup | kd-tree steps | hash grid steps | photons | same photons\n";
+  for( size_t i = 0; i < sizeof( radii2 ) / sizeof( radii2[0] ); ++i ) {
+    std::vector<unsigned int> found_kd_tree( num_queries );
+    std::vector<unsigned int> found_grid( num_queries );
+    unsigned long long steps_kd_tree = 0;
+    unsigned long long steps_grid    = 0;
+    unsigned long long found         = 0;
+    unsigned int steps;
+
+    double t0 = sutil::currentTime();
+    for( unsigned int q = 0; q < num_queries; ++q ) {
+      found_kd_tree[q] = queryPhotonMap( kd_tree.data(), valid_photons, positions[q], radii2[i], steps );
+      steps_kd_tree += steps;
+    }
+    const double t_query_kd_tree = sutil::currentTime() - t0;
+
+    t0 = sutil::currentTime();
+    for( unsigned int q = 0; q < num_queries; ++q ) {
+      found_grid[q] = queryPhotonGrid( grid.data(), grid_start.data(), grid_count.data(), static_cast<unsigned int>( grid_start.size() ),
+                                       PHOTON_GRID_CELL_SIZE, positions[q], radii2[i], steps );
+      steps_grid += steps;
+      found      += found_grid[q];
+    }
+    const double t_query_grid = sutil::currentTime() - t0;
+
+    const bool identical = found_kd_tree == found_grid;
+    identical_all = identical_all && identical;
+    std::cerr << "  " << std::setw( 8 ) << radii2[i]
+              << " | " << std::setw( 10 ) << t_query_kd_tree * 1000.0
+              << " | " << std::setw( 12 ) << t_query_grid * 1000.0
+              << " | " << std::setw( 7 ) << t_query_kd_tree / t_query_grid
+              << " | " << std::setw( 13 ) << double( steps_kd_tree ) / num_queries
+              << " | " << std::setw( 15 ) << double( steps_grid ) / num_queries
+              << " | " << std::setw( 7 ) << double( found ) / num_queries
+              << " | " << ( identical ? "yes" : "NO" ) << std::endl;
+  }
+  return identical_all;
+}
+
+
+// Largest errors of the packed photon encodings.
+const float PACKED_NORMAL_ERROR  = 0.005f; // Degrees
+const float PACKED_RAY_DIR_ERROR = 0.02f;  // Degrees
+const float PACKED_ENERGY_ERROR  = 1.001f / 512.0f; // Of the largest component, with float rounding
+
+// Checks the errors of packPhoton() and unpackPhoton() on random photons and compares the photon map footprint and
+// estimated build traffic of PhotonRecords and PackedPhotonRecords.
+bool benchmarkPacking()
+{
+  const unsigned int count = 1u << 20;
+  const unsigned int axes[] = { 0u, PPM_X, PPM_Y, PPM_Z, PPM_LEAF, PPM_NULL };
+
+  std::mt19937 rng( 11 );
+  std::uniform_real_distribution<float> uniform( -1.0f, 1.0f );
+  std::uniform_real_distribution<float> magnitude( -12.0f, 12.0f ); // Of the largest energy component
+  const auto randomDirection = [&]() {
+    float3 v;
+    do {
+      v = make_float3( uniform( rng ), uniform( rng ), uniform( rng ) );
+    } while( dot( v, v ) > 1.0f || dot( v, v ) < 1.0e-4f );
+    return normalize( v );
+  };
+  const auto angle = [&]( float3 a, float3 b ) {
+    return atan2f( length( cross( a, b ) ), dot( a, b ) ) * 180.0f / M_PIf;
+  };
+
+  float max_normal_error  = 0.0f;
+  float max_ray_dir_error = 0.0f;
+  float max_energy_error  = 0.0f;
+  bool  exact = true;
+  for( unsigned int i = 0; i < count; ++i ) {
+    PhotonRecord photon = PhotonRecord();
+    photon.position = 100.0f * make_float3( uniform( rng ), uniform( rng ), uniform( rng ) );
+    photon.normal   = randomDirection();
+    photon.ray_dir  = randomDirection();
+    photon.energy   = make_float3( uniform( rng ) + 1.0f, uniform( rng ) + 1.0f, uniform( rng ) + 1.0f );
+    photon.energy   = photon.energy * ( exp2f( magnitude( rng ) ) / fmaxf( photon.energy ) );
+    photon.axis     = axes[i % ( sizeof( axes ) / sizeof( axes[0] ) )];
+
+    const PackedPhotonRecord packed   = packPhoton( photon );
+    const PhotonRecord       unpacked = unpackPhoton( packed );
+    max_normal_error  = std::max( max_normal_error,  angle( photon.normal,  unpacked.normal ) );
+    max_ray_dir_error = std::max( max_ray_dir_error, angle( photon.ray_dir, unpacked.ray_dir ) );
+    const float3 energy_error = unpacked.energy - photon.energy;
+    max_energy_error = std::max( max_energy_error, std::max( fmaxf( energy_error ), -fminf( energy_error ) ) / fmaxf( photon.energy ) );
+    exact = exact && memcmp( &photon.position, &unpacked.position, sizeof( float3 ) ) == 0
+                  && unpacked.axis == photon.axis && photonHasEnergy( packed );
+  }
+  PhotonRecord dark = PhotonRecord();
+  dark.normal  = make_float3( 0.0f, 1.0f, 0.0f );
+  dark.ray_dir = make_float3( 0.0f, -1.0f, 0.0f );
+  exact = exact && !photonHasEnergy( packPhoton( dark ) );
+
+  const bool passed = exact && max_normal_error <= PACKED_NORMAL_ERROR && max_ray_dir_error <= PACKED_RAY_DIR_ERROR &&
+                      max_energy_error <= PACKED_ENERGY_ERROR;
+  std::cerr << std::setprecision( 5 )
+            << "Packing of " << count << " random photons, largest errors (bound):\n"
+            << "  normal  " << max_normal_error  << " deg (" << PACKED_NORMAL_ERROR  << ")\n"
+            << "  ray_dir " << max_ray_dir_error << " deg (" << PACKED_RAY_DIR_ERROR << ")\n"
+            << "  energy  " << max_energy_error  << " of the largest component (" << PACKED_ENERGY_ERROR << ")\n"
+            << "  position, axis and energy validity " << ( exact ? "exact" : "CHANGED" ) << "\n"
+            << std::setprecision( 3 );
+
+  const unsigned int num_photons   = PHOTON_LAUNCH_DIM * PHOTON_LAUNCH_DIM * MAX_PHOTON_COUNT;
+  const unsigned int valid_photons = static_cast<unsigned int>( num_photons * 0.9f );
+  const double mb = 1.0 / ( 1024.0 * 1024.0 );
+  std::cerr << "Left-balanced photon map of " << num_photons << " photons in MB, " << valid_photons << " with energy:\n"
+            << "                         | " << std::setw( 2 ) << sizeof( PhotonRecord ) << " byte records | "
+            << std::setw( 2 ) << sizeof( PackedPhotonRecord ) << " byte records\n"
+            << "  photon map             | " << std::setw( 15 ) << num_photons * sizeof( PhotonRecord ) * mb
+            << " | " << std::setw( 15 ) << num_photons * sizeof( PackedPhotonRecord ) * mb << "\n"
+            << "  pointer build traffic  | " << std::setw( 15 ) << estimateBuildTraffic( PointerBuilder, sizeof( PhotonRecord ), num_photons, valid_photons, valid_photons )
+            << " | " << std::setw( 15 ) << estimateBuildTraffic( PointerBuilder, sizeof( PackedPhotonRecord ), num_photons, valid_photons, valid_photons ) << "\n"
+            << "  index build traffic    | " << std::setw( 15 ) << estimateBuildTraffic( IndexBuilder, sizeof( PhotonRecord ), num_photons, valid_photons, valid_photons )
+            << " | " << std::setw( 15 ) << estimateBuildTraffic( IndexBuilder, sizeof( PackedPhotonRecord ), num_photons, valid_photons, valid_photons ) << "\n"
+            << "  The packed records halve the traffic of the pointer builder only.  The index builder, which createPhotonMap()\n"
+            << "  uses, spends most of its traffic on partitioning 16 byte positions and indices, which the packing doesn't shrink." << std::endl;
+  return passed;
+}
+
+
+// Returns false for an unknown benchmark name, throws when a benchmark fails.
+bool runBenchmark( const std::string& name )
+{
+  std::cerr << std::fixed << std::setprecision( 3 );
+  if( name == "kdtree" ) {
+    if( !benchmarkKdTree() )
+      throw std::runtime_error( "The parallel photon kd-tree differs from the serial one" );
+  }
+  else if( name == "index" ) {
+    if( !benchmarkIndexBuilder() )
+      throw std::runtime_error( "The index-based photon kd-tree differs from the pointer-based one" );
+  }
+  else if( name == "layout" ) {
+    if( !benchmarkLayout() )
+      throw std::runtime_error( "The left-balanced photon map finds other photons than the complete one" );
+  }
+  else if( name == "grid" ) {
+    if( !benchmarkHashGrid() )
+      throw std::runtime_error( "The photon hash grid finds other photons than the kd-tree" );
+  }
+  else if( name == "packing" ) {
+    if( !benchmarkPacking() )
+      throw std::runtime_error( "Packed photons exceed their error bounds" );
+  }
+  else
+    return false;
+  return true;
+}
+
+
 //------------------------------------------------------------------------------
 //
 // Main
@@ -920,6 +1199,9 @@ void printUsageAndExit( const std::string& argv0 )
         "         --photon-dim <n>        Width and height of photon launch grid. Default = " << PHOTON_LAUNCH_DIM << ".\n"
         "  -ddb | --display-debug-buffer  Display debug buffer information to the shell.\n"
         "  -pt  | --print-timings         Print timing information.\n"
+        "  -g   | --hash-grid             Gather the photons from a hashed uniform grid instead of the kd-tree.\n"
+        "  -b   | --benchmark <name>      Run a host-side benchmark and exit.\n"
+        "                                 <name> is one of: kdtree, index, layout, grid, packing\n"
         "App Keystrokes:\n"
         "  q  Quit\n"
         "  s  Save image to '" << SAMPLE_NAME << ".png'\n"
@@ -936,6 +1218,7 @@ int main( int argc, char** argv )
     bool use_pbo = true;
     unsigned int photon_launch_dim = PHOTON_LAUNCH_DIM;
     std::string out_file;
+    std::string benchmark;
     for( int i=1; i<argc; ++i )
     {
         const std::string arg( argv[i] );
@@ -965,6 +1248,10 @@ int main( int argc, char** argv )
         {
             s_print_timings = true;
         }
+        else if( arg == "-g" || arg == "--hash-grid" )
+        {
+            s_photon_map_type = HashGridPhotonMap;
+        }
         else if( arg == "--photon-dim" )
         {
             if( i == argc-1 )
@@ -975,6 +1262,15 @@ int main( int argc, char** argv )
             int tmp = atoi( argv[++i] );
             if (tmp > 0) photon_launch_dim = static_cast<unsigned int>(tmp);
         }
+        else if( arg == "-b" || arg == "--benchmark" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            benchmark = argv[++i];
+        }
         else
         {
             std::cerr << "Unknown option '" << arg << "'\n";
@@ -983,6 +1279,24 @@ int main( int argc, char** argv )
         
     }
 
+    if( !benchmark.empty() )
+    {
+        try
+        {
+            if( !runBenchmark( benchmark ) )
+            {
+                std::cerr << "Unknown benchmark '" << benchmark << "'\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        catch( std::exception& e )
+        {
+            sutil::reportErrorMessage( e.what() );
+            return 1;
+        }
+        return 0;
+    }
+
     try
     {
         GLFWwindow* window = glfwInitialize();
@@ -0,0 +1,701 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-----------------------------------------------------------------------------
+//
+// photon_map.cpp: host-side construction of the photon kd-tree and hash grid
+//
+//-----------------------------------------------------------------------------
+
+#include "photon_map.h"
+#include "select.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+using namespace optix;
+
+// Subtrees with fewer photons are built on a single thread.
+const int PHOTON_BUILD_GRAIN = 1 << 14;
+
+
+static int max_component(float3 a)
+{
+  if(a.x > a.y) {
+    if(a.x > a.z) {
+      return 0;
+    } else {
+      return 2;
+    }
+  } else {
+    if(a.y > a.z) {
+      return 1;
+    } else {
+      return 2;
+    }
+  }
+}
+
+bool photonCmpX( PackedPhotonRecord* r1, PackedPhotonRecord* r2 ) { return r1->position.x < r2->position.x; }
+bool photonCmpY( PackedPhotonRecord* r1, PackedPhotonRecord* r2 ) { return r1->position.y < r2->position.y; }
+bool photonCmpZ( PackedPhotonRecord* r1, PackedPhotonRecord* r2 ) { return r1->position.z < r2->position.z; }
+
+
+// Chooses the split axis of the photons [start, end).  position(i) returns the position of photon i.
+template<class Position>
+static int chooseAxis( Position position, int start, int end, int depth, SplitChoice split_choice,
+                       float3 bbmin, float3 bbmax )
+{
+  int axis;
+  switch(split_choice) {
+  case RoundRobin:
+    {
+      axis = depth%3;
+    }
+    break;
+  case HighestVariance:
+    {
+      float3 mean  = make_float3( 0.0f ); 
+      float3 diff2 = make_float3( 0.0f );
+      for(int i = start; i < end; ++i) {
+        float3 x     = position( i );
+        float3 delta = x - mean;
+        float3 n_inv = make_float3( 1.0f / ( static_cast<float>( i - start ) + 1.0f ) );
+        mean = mean + delta * n_inv;
+        diff2 += delta*( x - mean );
+      }
+      float3 n_inv = make_float3( 1.0f / ( static_cast<float>(end-start) - 1.0f ) );
+      float3 variance = diff2 * n_inv;
+      axis = max_component(variance);
+    }
+    break;
+  case LongestDim:
+    {
+      float3 diag = bbmax-bbmin;
+      axis = max_component(diag);
+    }
+    break;
+  default:
+    axis = -1;
+    std::cerr << "Unknown SplitChoice " << split_choice << " at "<<__FILE__<<":"<<__LINE__<<"\n";
+    exit(2);
+    break;
+  }
+  return axis;
+}
+
+// Narrows the bounds of the children for LongestDim.
+static void splitBounds( int axis, SplitChoice split_choice, float3 midPoint, float3 bbmin, float3 bbmax,
+                         float3& leftMax, float3& rightMin )
+{
+  rightMin = bbmin;
+  leftMax  = bbmax;
+  if(split_choice == LongestDim) {
+    switch( axis ) {
+      case 0:
+        rightMin.x = midPoint.x;
+        leftMax.x  = midPoint.x;
+        break;
+      case 1:
+        rightMin.y = midPoint.y;
+        leftMax.y  = midPoint.y;
+        break;
+      case 2:
+        rightMin.z = midPoint.z;
+        leftMax.z  = midPoint.z;
+        break;
+    }
+  }
+}
+
+
+// Index of the median of the photons [start, end).  In the left-balanced layout the left subtree gets
+// all full levels of the tree and as much of the last level as fits, so the tree fills its nodes without gaps.
+static int splitIndex( int start, int end, KDTreeLayout layout )
+{
+  if( layout == CompleteLayout )
+    return (start+end) / 2;
+
+  const int count = end - start;
+  int full = 1; // Nodes in the full levels of the left subtree plus one.
+  while( 4 * full <= count )
+    full *= 2;
+  const int last = count - ( 2 * full - 1 ); // Nodes on the last level of the whole tree.
+  return start + ( full - 1 ) + std::min( last, full );
+}
+
+
+struct PointerPosition
+{
+  PackedPhotonRecord** photons;
+  float3 operator()( int i ) const { return photons[i]->position; }
+};
+
+// Chooses the split axis of photons[start, end) and moves the median photon into place with the smaller
+// photons before and the larger ones after it.  With threads > 1 the median selection runs in parallel.
+// Returns the index of the median.
+static int splitPhotons( PackedPhotonRecord** photons, int start, int end, int depth, SplitChoice split_choice,
+                         KDTreeLayout layout, float3 bbmin, float3 bbmax, float3& leftMax, float3& rightMin,
+                         unsigned int threads )
+{
+  const PointerPosition position = { photons };
+  const int axis = chooseAxis( position, start, end, depth, split_choice, bbmin, bbmax );
+
+  int median = splitIndex( start, end, layout );
+  PackedPhotonRecord** start_addr = &(photons[start]);
+
+  // Each of the threads scans at least one range of the partitions.
+  const size_t grain = std::max<size_t>( PHOTON_BUILD_GRAIN, (end - start) / std::max( threads, 1u ) );
+
+  switch( axis ) {
+  case 0:
+    if( threads > 1 )
+      selectParallel<PackedPhotonRecord*, 0>( start_addr, 0, end-start-1, median-start, grain );
+    else
+      select<PackedPhotonRecord*, 0>( start_addr, 0, end-start-1, median-start );
+    setPhotonAxis( *photons[median], PPM_X );
+    break;
+  case 1:
+    if( threads > 1 )
+      selectParallel<PackedPhotonRecord*, 1>( start_addr, 0, end-start-1, median-start, grain );
+    else
+      select<PackedPhotonRecord*, 1>( start_addr, 0, end-start-1, median-start );
+    setPhotonAxis( *photons[median], PPM_Y );
+    break;
+  case 2:
+    if( threads > 1 )
+      selectParallel<PackedPhotonRecord*, 2>( start_addr, 0, end-start-1, median-start, grain );
+    else
+      select<PackedPhotonRecord*, 2>( start_addr, 0, end-start-1, median-start );
+    setPhotonAxis( *photons[median], PPM_Z );
+    break;
+  }
+
+  splitBounds( axis, split_choice, photons[median]->position, bbmin, bbmax, leftMax, rightMin );
+  return median;
+}
+
+
+void buildKDTree( PackedPhotonRecord** photons, int start, int end, int depth, PackedPhotonRecord* kd_tree, int current_root,
+                  SplitChoice split_choice, float3 bbmin, float3 bbmax, KDTreeLayout layout )
+{
+  // If we have zero photons, this is a NULL node.  The left-balanced layout has no node there.
+  if( end - start == 0 ) {
+    if( layout == LeftBalancedLayout )
+      return;
+    setPhotonAxis( kd_tree[current_root], PPM_NULL );
+    kd_tree[current_root].energy = 0u;
+    return;
+  }
+
+  // If we have a single photon
+  if( end - start == 1 ) {
+    setPhotonAxis( *photons[start], PPM_LEAF );
+    kd_tree[current_root] = *(photons[start]);
+    return;
+  }
+
+  float3 leftMax;
+  float3 rightMin;
+  const int median = splitPhotons( photons, start, end, depth, split_choice, layout, bbmin, bbmax, leftMax, rightMin, 1 );
+
+  kd_tree[current_root] = *(photons[median]);
+  buildKDTree( photons, start, median, depth+1, kd_tree, 2*current_root+1, split_choice, bbmin,  leftMax, layout );
+  buildKDTree( photons, median+1, end, depth+1, kd_tree, 2*current_root+2, split_choice, rightMin, bbmax, layout );
+}
+
+
+void buildKDTreeParallel( PackedPhotonRecord** photons, int start, int end, int depth, PackedPhotonRecord* kd_tree, int current_root,
+                          SplitChoice split_choice, float3 bbmin, float3 bbmax, KDTreeLayout layout, unsigned int threads )
+{
+  // The two subtrees of a node touch disjoint ranges of photons and kd_tree, and the median splits
+  // evenly, so handing each subtree half of the threads keeps them all busy without any stealing.
+  if( threads <= 1 || end - start <= PHOTON_BUILD_GRAIN ) {
+    buildKDTree( photons, start, end, depth, kd_tree, current_root, split_choice, bbmin, bbmax, layout );
+    return;
+  }
+
+  float3 leftMax;
+  float3 rightMin;
+  const int median = splitPhotons( photons, start, end, depth, split_choice, layout, bbmin, bbmax, leftMax, rightMin, threads );
+
+  kd_tree[current_root] = *(photons[median]);
+
+  const unsigned int left_threads = threads / 2;
+  sutil::parallelInvoke(
+    [&]() { buildKDTreeParallel( photons, start, median, depth+1, kd_tree, 2*current_root+1, split_choice, bbmin, leftMax, layout, left_threads ); },
+    [&]() { buildKDTreeParallel( photons, median+1, end, depth+1, kd_tree, 2*current_root+2, split_choice, rightMin, bbmax, layout, threads - left_threads ); } );
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Index builder: medians are selected on SoA positions, the records are copied once
+//
+//------------------------------------------------------------------------------
+
+// Positions of the valid photons in SoA layout with the index of their PackedPhotonRecord, 16 bytes per photon.
+struct PhotonPositions
+{
+  float*        position[3];
+  unsigned int* index;
+
+  float3 operator()( int i ) const { return make_float3( position[0][i], position[1][i], position[2][i] ); }
+};
+
+// One entry per photon map node.
+struct PhotonNodes
+{
+  unsigned int*  index; // PackedPhotonRecord of the node.
+  unsigned char* axis;  // PPM_* flags of the node, 0 for nodes below the tree.
+};
+
+static inline void swapPhotons( const PhotonPositions& photons, int a, int b )
+{
+  swap( photons.position[0], a, b );
+  swap( photons.position[1], a, b );
+  swap( photons.position[2], a, b );
+  swap( photons.index, a, b );
+}
+
+// partition() on the SoA positions.  Gives the same order as partition() on the PackedPhotonRecord pointers.
+static int partitionIndexed( const PhotonPositions& photons, int axis, int left, int right, int pivotIndex )
+{
+  const float* key = photons.position[axis];
+  const float pivotValue = key[pivotIndex];
+  swapPhotons( photons, right, pivotIndex );
+  pivotIndex = right;
+  left--;
+  while(1) {
+    do {
+      left++;
+    } while( left < right && key[left] < pivotValue );
+    do {
+      right--;
+    } while( left < right && key[right] > pivotValue );
+    if( left < right ) {
+      swapPhotons( photons, left, right );
+    } else {
+      // Put the pivotValue back in place
+      swapPhotons( photons, left, pivotIndex );
+      return left;
+    }
+  }
+}
+
+// select() on the SoA positions.
+static void selectIndexed( const PhotonPositions& photons, int axis, int left, int right, int k )
+{
+  while(1) {
+    int pivotIndex = (left+right)/2;
+    int pivotNewIndex = partitionIndexed( photons, axis, left, right, pivotIndex );
+    if( k == pivotNewIndex )
+      return;
+    else if( k < pivotNewIndex )
+      right = pivotNewIndex-1;
+    else
+      left = pivotNewIndex+1;
+  }
+}
+
+// buildKDTreeParallel() on the SoA positions, recording only the photon index and axis of each node.
+static void buildKDTreeIndexed( const PhotonPositions& photons, int start, int end, int depth, const PhotonNodes& nodes,
+                                int current_root, SplitChoice split_choice, float3 bbmin, float3 bbmax,
+                                KDTreeLayout layout, unsigned int threads )
+{
+  // If we have zero photons, this is a NULL node.  The left-balanced layout has no node there.
+  if( end - start == 0 ) {
+    if( layout == CompleteLayout )
+      nodes.axis[current_root] = PPM_NULL;
+    return;
+  }
+
+  // If we have a single photon
+  if( end - start == 1 ) {
+    nodes.index[current_root] = photons.index[start];
+    nodes.axis[current_root]  = PPM_LEAF;
+    return;
+  }
+
+  const int axis   = chooseAxis( photons, start, end, depth, split_choice, bbmin, bbmax );
+  const int median = splitIndex( start, end, layout );
+  selectIndexed( photons, axis, start, end-1, median );
+
+  nodes.index[current_root] = photons.index[median];
+  nodes.axis[current_root]  = static_cast<unsigned char>( 1 << axis ); // PPM_X, PPM_Y or PPM_Z
+
+  float3 leftMax;
+  float3 rightMin;
+  splitBounds( axis, split_choice, photons( median ), bbmin, bbmax, leftMax, rightMin );
+
+  if( threads <= 1 || end - start <= PHOTON_BUILD_GRAIN ) {
+    buildKDTreeIndexed( photons, start, median, depth+1, nodes, 2*current_root+1, split_choice, bbmin, leftMax, layout, 1 );
+    buildKDTreeIndexed( photons, median+1, end, depth+1, nodes, 2*current_root+2, split_choice, rightMin, bbmax, layout, 1 );
+  } else {
+    const unsigned int left_threads = threads / 2;
+    sutil::parallelInvoke(
+      [&]() { buildKDTreeIndexed( photons, start, median, depth+1, nodes, 2*current_root+1, split_choice, bbmin, leftMax, layout, left_threads ); },
+      [&]() { buildKDTreeIndexed( photons, median+1, end, depth+1, nodes, 2*current_root+2, split_choice, rightMin, bbmax, layout, threads - left_threads ); } );
+  }
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Photon map
+//
+//------------------------------------------------------------------------------
+
+// Bounds of the count photons, position(i) returns the position of photon i.
+template<class Position>
+static void photonBounds( Position position, unsigned int count, size_t grain, float3& bbmin, float3& bbmax )
+{
+  std::vector<float3> range_min( sutil::numRanges( count, grain ), make_float3(  std::numeric_limits<float>::max() ) );
+  std::vector<float3> range_max( range_min.size(), make_float3( -std::numeric_limits<float>::max() ) );
+  sutil::parallelFor( count, grain, [&]( size_t begin, size_t end, size_t r ) {
+    for( size_t i = begin; i < end; ++i ) {
+      range_min[r] = fminf( range_min[r], position( static_cast<int>( i ) ) );
+      range_max[r] = fmaxf( range_max[r], position( static_cast<int>( i ) ) );
+    }
+  } );
+  bbmin = range_min[0];
+  bbmax = range_max[0];
+  for( size_t r = 1; r < range_min.size(); ++r ) {
+    bbmin = fminf( bbmin, range_min[r] );
+    bbmax = fmaxf( bbmax, range_max[r] );
+  }
+}
+
+
+// Counts the photons with energy.  valid_before[r] is the number of them before range r of
+// sutil::parallelFor( num_photons, grain ), the last entry the total.
+static void countValidPhotons( const PackedPhotonRecord* photons, unsigned int num_photons, size_t grain,
+                               std::vector<unsigned int>& valid_before )
+{
+  const size_t num_ranges = sutil::numRanges( num_photons, grain );
+  valid_before.assign( num_ranges + 1, 0 );
+  sutil::parallelFor( num_photons, grain, [&]( size_t begin, size_t end, size_t r ) {
+    unsigned int valid = 0;
+    for( size_t i = begin; i < end; ++i ) {
+      valid += photonHasEnergy( photons[i] ) ? 1 : 0;
+    }
+    valid_before[r + 1] = valid;
+  } );
+  for( size_t r = 0; r < num_ranges; ++r ) {
+    valid_before[r + 1] += valid_before[r];
+  }
+}
+
+
+unsigned int buildPhotonMap( PackedPhotonRecord* photons, unsigned int num_photons,
+                             PackedPhotonRecord* photon_map, unsigned int photon_map_size,
+                             SplitChoice split_choice, KDTreeLayout layout, KDTreeBuilder builder, bool parallel )
+{
+  const size_t grain = ( parallel ) ? PHOTON_BUILD_GRAIN : std::numeric_limits<size_t>::max();
+  const unsigned int threads = ( parallel ) ? sutil::numThreads() : 1;
+
+  // Find the valid photons, keeping their order.
+  const size_t num_ranges = sutil::numRanges( num_photons, grain );
+  std::vector<unsigned int> valid_before;
+  countValidPhotons( photons, num_photons, grain, valid_before );
+
+  // Make sure we aren't at most 1 less than power of 2
+  const unsigned int valid_photons = std::min( valid_before[num_ranges], photon_map_size );
+
+  // The left-balanced tree only uses the first valid_photons nodes.
+  const unsigned int num_nodes = ( layout == LeftBalancedLayout ) ? valid_photons : photon_map_size;
+
+  float3 bbmin = make_float3(0.0f);
+  float3 bbmax = make_float3(0.0f);
+
+  if( builder == PointerBuilder ) {
+    sutil::parallelFor( num_nodes, grain, [&]( size_t begin, size_t end, size_t ) {
+      for( size_t i = begin; i < end; ++i ) {
+        photon_map[i].energy = 0u;
+      }
+    } );
+
+    // Push all valid photons to front of list
+    std::vector<PackedPhotonRecord*> temp_photons( valid_before[num_ranges] );
+    sutil::parallelFor( num_photons, grain, [&]( size_t begin, size_t end, size_t r ) {
+      unsigned int valid = valid_before[r];
+      for( size_t i = begin; i < end; ++i ) {
+        if( photonHasEnergy( photons[i] ) ) {
+          temp_photons[valid++] = &photons[i];
+        }
+      }
+    } );
+
+    if( split_choice == LongestDim ) {
+      const PointerPosition position = { temp_photons.data() };
+      photonBounds( position, valid_photons, grain, bbmin, bbmax );
+    }
+
+    // Now build KD tree
+    buildKDTreeParallel( temp_photons.data(), 0, valid_photons, 0, photon_map, 0, split_choice, bbmin, bbmax, layout, threads );
+    return valid_photons;
+  }
+
+  // Extract the valid photons' positions, the only part of them the build reads.
+  std::vector<float>        positions( 3 * size_t( valid_before[num_ranges] ) );
+  std::vector<unsigned int> indices( valid_before[num_ranges] );
+
+  const PhotonPositions temp_photons = {
+    { positions.data(), positions.data() + indices.size(), positions.data() + 2 * indices.size() },
+    indices.data()
+  };
+  sutil::parallelFor( num_photons, grain, [&]( size_t begin, size_t end, size_t r ) {
+    unsigned int valid = valid_before[r];
+    for( size_t i = begin; i < end; ++i ) {
+      if( photonHasEnergy( photons[i] ) ) {
+        temp_photons.position[0][valid] = photons[i].position.x;
+        temp_photons.position[1][valid] = photons[i].position.y;
+        temp_photons.position[2][valid] = photons[i].position.z;
+        temp_photons.index[valid++]     = static_cast<unsigned int>( i );
+      }
+    }
+  } );
+
+  if( split_choice == LongestDim ) {
+    photonBounds( temp_photons, valid_photons, grain, bbmin, bbmax );
+  }
+
+  std::vector<unsigned int>  node_indices( num_nodes );
+  std::vector<unsigned char> node_axes( num_nodes, 0 );
+  const PhotonNodes nodes = { node_indices.data(), node_axes.data() };
+
+  buildKDTreeIndexed( temp_photons, 0, valid_photons, 0, nodes, 0, split_choice, bbmin, bbmax, layout, threads );
+
+  // Gather the records in one streaming pass over the photon map.
+  sutil::parallelFor( num_nodes, grain, [&]( size_t begin, size_t end, size_t ) {
+    for( size_t i = begin; i < end; ++i ) {
+      const unsigned char axis = nodes.axis[i];
+      if( axis & ( PPM_X | PPM_Y | PPM_Z | PPM_LEAF ) ) {
+        photon_map[i]      = photons[nodes.index[i]];
+        setPhotonAxis( photon_map[i], axis );
+      } else {
+        if( axis & PPM_NULL ) {
+          setPhotonAxis( photon_map[i], PPM_NULL );
+        }
+        photon_map[i].energy = 0u;
+      }
+    }
+  } );
+
+  return valid_photons;
+}
+
+
+unsigned int queryPhotonMap( const PackedPhotonRecord* photon_map, unsigned int photon_map_count,
+                             float3 position, float radius2, unsigned int& steps )
+{
+  unsigned int stack[64];
+  unsigned int stack_current = 0;
+  unsigned int node = 0;
+  unsigned int found = 0;
+
+  stack[stack_current++] = 0;
+  steps = 0;
+  do {
+    const unsigned int axis = ( node < photon_map_count ) ? photonAxis( photon_map[node] ) : PPM_NULL;
+    if( !( axis & PPM_NULL ) ) {
+      const PackedPhotonRecord& photon = photon_map[node];
+
+      float3 diff = position - photon.position;
+      float distance2 = dot(diff, diff);
+
+      if( distance2 <= radius2 ) {
+        ++found;
+      }
+
+      // Recurse
+      if( !( axis & PPM_LEAF ) ) {
+        float d;
+        if      ( axis & PPM_X ) d = diff.x;
+        else if ( axis & PPM_Y ) d = diff.y;
+        else                            d = diff.z;
+
+        // Calculate the next child selector. 0 is left, 1 is right.
+        // Children at or after photon_map_count don't exist.
+        int selector = d < 0.0f ? 0 : 1;
+        if( d*d < radius2 && (node<<1) + 2 - selector < photon_map_count ) {
+          stack[stack_current++] = (node<<1) + 2 - selector;
+        }
+
+        node = ( (node<<1) + 1 + selector < photon_map_count ) ? (node<<1) + 1 + selector : stack[--stack_current];
+      } else {
+        node = stack[--stack_current];
+      }
+    } else {
+      node = stack[--stack_current];
+    }
+    ++steps;
+  } while( node );
+
+  return found;
+}
+
+
+// Stably sorts keys and values by the lowest bits of the keys.  LSD radix sort with 8 bit digits: each range
+// of the input histograms its digits, and the prefix sums over digits and ranges give every range its own
+// output offsets, so the scatter runs in parallel too.
+static void radixSort( std::vector<unsigned int>& keys, std::vector<unsigned int>& values, unsigned int bits, size_t grain )
+{
+  const size_t count      = keys.size();
+  const size_t num_ranges = sutil::numRanges( count, grain );
+
+  std::vector<unsigned int> sorted_keys( count );
+  std::vector<unsigned int> sorted_values( count );
+  std::vector<size_t>       offsets( num_ranges * 256 );
+
+  for( unsigned int shift = 0; shift < bits; shift += 8 ) {
+    sutil::parallelFor( count, grain, [&]( size_t begin, size_t end, size_t r ) {
+      size_t* histogram = &offsets[r * 256];
+      std::fill( histogram, histogram + 256, size_t( 0 ) );
+      for( size_t i = begin; i < end; ++i ) {
+        ++histogram[( keys[i] >> shift ) & 0xFF];
+      }
+    } );
+
+    size_t sum = 0;
+    for( size_t digit = 0; digit < 256; ++digit ) {
+      for( size_t r = 0; r < num_ranges; ++r ) {
+        const size_t digit_count = offsets[r * 256 + digit];
+        offsets[r * 256 + digit] = sum;
+        sum += digit_count;
+      }
+    }
+
+    sutil::parallelFor( count, grain, [&]( size_t begin, size_t end, size_t r ) {
+      size_t* offset = &offsets[r * 256];
+      for( size_t i = begin; i < end; ++i ) {
+        const size_t j = offset[( keys[i] >> shift ) & 0xFF]++;
+        sorted_keys[j]   = keys[i];
+        sorted_values[j] = values[i];
+      }
+    } );
+
+    keys.swap( sorted_keys );
+    values.swap( sorted_values );
+  }
+}
+
+
+unsigned int buildPhotonGrid( PackedPhotonRecord* photons, unsigned int num_photons,
+                              PackedPhotonRecord* photon_map, unsigned int photon_map_size,
+                              unsigned int* grid_start, unsigned int* grid_count, unsigned int grid_size,
+                              float cell_size, bool parallel )
+{
+  const size_t grain = ( parallel ) ? PHOTON_BUILD_GRAIN : std::numeric_limits<size_t>::max();
+
+  std::vector<unsigned int> valid_before;
+  countValidPhotons( photons, num_photons, grain, valid_before );
+
+  // Key the valid photons by the bucket of their cell, keeping their order.
+  std::vector<unsigned int> keys( valid_before.back() );
+  std::vector<unsigned int> indices( valid_before.back() );
+  sutil::parallelFor( num_photons, grain, [&]( size_t begin, size_t end, size_t r ) {
+    unsigned int valid = valid_before[r];
+    for( size_t i = begin; i < end; ++i ) {
+      if( photonHasEnergy( photons[i] ) ) {
+        keys[valid]      = photonGridBucket( photons[i].position, cell_size, grid_size );
+        indices[valid++] = static_cast<unsigned int>( i );
+      }
+    }
+  } );
+
+  // Photons which don't fit are dropped.
+  const unsigned int valid_photons = std::min( valid_before.back(), photon_map_size );
+  keys.resize( valid_photons );
+  indices.resize( valid_photons );
+
+  unsigned int bits = 0;
+  while( ( 1u << bits ) < grid_size ) {
+    ++bits;
+  }
+  radixSort( keys, indices, bits, grain );
+
+  // Each bucket's photons are one run of the sorted keys.
+  sutil::parallelFor( grid_size, grain, [&]( size_t begin, size_t end, size_t ) {
+    for( size_t i = begin; i < end; ++i ) {
+      grid_start[i] = 0;
+      grid_count[i] = 0;
+    }
+  } );
+  sutil::parallelFor( valid_photons, grain, [&]( size_t begin, size_t end, size_t ) {
+    for( size_t i = begin; i < end; ++i ) {
+      if( i == 0 || keys[i] != keys[i - 1] ) {
+        grid_start[keys[i]] = static_cast<unsigned int>( i );
+      }
+    }
+  } );
+  sutil::parallelFor( valid_photons, grain, [&]( size_t begin, size_t end, size_t ) {
+    for( size_t i = begin; i < end; ++i ) {
+      if( i + 1 == valid_photons || keys[i + 1] != keys[i] ) {
+        grid_count[keys[i]] = static_cast<unsigned int>( i + 1 ) - grid_start[keys[i]];
+      }
+    }
+  } );
+
+  sutil::parallelFor( valid_photons, grain, [&]( size_t begin, size_t end, size_t ) {
+    for( size_t i = begin; i < end; ++i ) {
+      photon_map[i]      = photons[indices[i]];
+      setPhotonAxis( photon_map[i], PPM_LEAF );
+    }
+  } );
+
+  return valid_photons;
+}
+
+
+unsigned int queryPhotonGrid( const PackedPhotonRecord* photon_map,
+                              const unsigned int* grid_start, const unsigned int* grid_count, unsigned int grid_size,
+                              float cell_size, float3 position, float radius2, unsigned int& steps )
+{
+  unsigned int buckets[8];
+  const unsigned int num_buckets = photonGridBuckets( position, sqrtf( radius2 ), cell_size, grid_size, buckets );
+
+  unsigned int found = 0;
+  steps = num_buckets;
+  for( unsigned int b = 0; b < num_buckets; ++b ) {
+    const unsigned int begin = grid_start[buckets[b]];
+    const unsigned int end   = begin + grid_count[buckets[b]];
+    for( unsigned int i = begin; i < end; ++i ) {
+      float3 diff = position - photon_map[i].position;
+      if( dot(diff, diff) <= radius2 ) {
+        ++found;
+      }
+    }
+    steps += end - begin;
+  }
+
+  return found;
+}
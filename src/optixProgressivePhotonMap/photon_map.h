@@ -0,0 +1,94 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-----------------------------------------------------------------------------
+//
+// photon_map.h: host-side construction of the photon kd-tree and hash grid
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include "ppm.h"
+
+#include <Parallel.h> // from sutil
+
+enum SplitChoice {
+  RoundRobin,
+  HighestVariance,
+  LongestDim
+};
+
+enum KDTreeBuilder {
+  PointerBuilder, // Selects the medians on pointers to the PackedPhotonRecords.
+  IndexBuilder    // Selects the medians on SoA positions and photon indices, copies the PackedPhotonRecords once at the end.
+};
+
+enum KDTreeLayout {
+  CompleteLayout,    // Splits at the middle photon. Needs up to 2^k-1 nodes for the photons with PPM_NULL nodes in the gaps.
+  LeftBalancedLayout // Fills the last level from the left like Jensen's balanced photon map. Needs one node per photon.
+};
+
+// Builds the implicit kd-tree of photons[start, end) into kd_tree, rooted at current_root with its
+// children at 2*i+1 and 2*i+2.  Reorders photons and sets their axis.
+void buildKDTree( PackedPhotonRecord** photons, int start, int end, int depth, PackedPhotonRecord* kd_tree, int current_root,
+                  SplitChoice split_choice, optix::float3 bbmin, optix::float3 bbmax,
+                  KDTreeLayout layout = CompleteLayout );
+
+// Builds the identical tree as buildKDTree().  Subtrees of more than PHOTON_BUILD_GRAIN photons are built
+// concurrently, splitting threads among them, and the median selection of the levels above runs in parallel.
+void buildKDTreeParallel( PackedPhotonRecord** photons, int start, int end, int depth, PackedPhotonRecord* kd_tree, int current_root,
+                          SplitChoice split_choice, optix::float3 bbmin, optix::float3 bbmax,
+                          KDTreeLayout layout = CompleteLayout, unsigned int threads = sutil::numThreads() );
+
+// Builds the photon map of all photons with energy into photon_map, which has photon_map_size nodes.
+// Photons which don't fit are dropped.  Returns the number of photons in the map, which is also the
+// number of nodes of the left-balanced layout.  Both builders give the identical photon map.
+unsigned int buildPhotonMap( PackedPhotonRecord* photons, unsigned int num_photons,
+                             PackedPhotonRecord* photon_map, unsigned int photon_map_size,
+                             SplitChoice split_choice, KDTreeLayout layout, KDTreeBuilder builder, bool parallel );
+
+// Host reference of the traversal in the gather program.  Returns the number of photons within radius2 of
+// position and the number of visited nodes in steps.  Nodes at and after photon_map_count don't exist.
+unsigned int queryPhotonMap( const PackedPhotonRecord* photon_map, unsigned int photon_map_count,
+                             optix::float3 position, float radius2, unsigned int& steps );
+
+// Builds a hashed uniform grid of all photons with energy as an alternative to the kd-tree.  The photons are
+// radix sorted by the bucket of their cell into photon_map; grid_start and grid_count hold the first photon and the
+// number of photons of each of the grid_size buckets, a power of two.  Photons which don't fit are dropped.
+// Returns the number of photons in the map.  Queries must not have a radius above cell_size / 2.
+unsigned int buildPhotonGrid( PackedPhotonRecord* photons, unsigned int num_photons,
+                              PackedPhotonRecord* photon_map, unsigned int photon_map_size,
+                              unsigned int* grid_start, unsigned int* grid_count, unsigned int grid_size,
+                              float cell_size, bool parallel );
+
+// Host reference of the hash grid lookup in the gather program.  Returns the number of photons within radius2 of
+// position and the number of visited buckets and tested photons in steps.
+unsigned int queryPhotonGrid( const PackedPhotonRecord* photon_map,
+                              const unsigned int* grid_start, const unsigned int* grid_count, unsigned int grid_size,
+                              float cell_size, optix::float3 position, float radius2, unsigned int& steps );
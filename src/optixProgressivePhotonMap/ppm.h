@@ -26,6 +26,8 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#pragma once
+
 #include <optixu/optixu_math_namespace.h>
 
 #define  PPM_X         ( 1 << 0 )
@@ -45,6 +47,59 @@ enum RayTypes
     shadow_ray_type
 };
 
+enum PhotonMapType
+{
+    KDTreePhotonMap,
+    HashGridPhotonMap
+};
+
+// Bucket of the hashed photon grid for the integer cell coordinates.  grid_size is a power of two.
+static __host__ __device__ __inline__ unsigned int photonGridHash( int x, int y, int z, unsigned int grid_size )
+{
+  return ( static_cast<unsigned int>( x ) * 73856093u ^
+           static_cast<unsigned int>( y ) * 19349663u ^
+           static_cast<unsigned int>( z ) * 83492791u ) & ( grid_size - 1u );
+}
+
+// Bucket of the hashed photon grid cell which contains position.
+static __host__ __device__ __inline__ unsigned int photonGridBucket( const optix::float3& position, float cell_size, unsigned int grid_size )
+{
+  return photonGridHash( static_cast<int>( floorf( position.x / cell_size ) ),
+                         static_cast<int>( floorf( position.y / cell_size ) ),
+                         static_cast<int>( floorf( position.z / cell_size ) ), grid_size );
+}
+
+// Collects the distinct buckets of the hashed photon grid cells within radius of position and returns their number.
+// Cells at least twice as wide as the radius give at most 8 cells.
+static __host__ __device__ __inline__ unsigned int photonGridBuckets( const optix::float3& position, float radius, float cell_size,
+                                                                    unsigned int grid_size, unsigned int buckets[8] )
+{
+  const int x0 = static_cast<int>( floorf( ( position.x - radius ) / cell_size ) );
+  const int y0 = static_cast<int>( floorf( ( position.y - radius ) / cell_size ) );
+  const int z0 = static_cast<int>( floorf( ( position.z - radius ) / cell_size ) );
+  const int x1 = static_cast<int>( floorf( ( position.x + radius ) / cell_size ) );
+  const int y1 = static_cast<int>( floorf( ( position.y + radius ) / cell_size ) );
+  const int z1 = static_cast<int>( floorf( ( position.z + radius ) / cell_size ) );
+
+  unsigned int num_buckets = 0;
+  for( int z = z0; z <= z1 && z <= z0 + 1; ++z ) {
+    for( int y = y0; y <= y1 && y <= y0 + 1; ++y ) {
+      for( int x = x0; x <= x1 && x <= x0 + 1; ++x ) {
+        // Different cells can share a bucket, its photons must only be gathered once.
+        const unsigned int bucket = photonGridHash( x, y, z, grid_size );
+        bool found = false;
+        for( unsigned int i = 0; i < num_buckets; ++i ) {
+          found = found || buckets[i] == bucket;
+        }
+        if( !found ) {
+          buckets[num_buckets++] = bucket;
+        }
+      }
+    }
+  }
+  return num_buckets;
+}
+
 struct PPMLight
 {
   optix::uint   is_area_light;
@@ -96,7 +151,7 @@ struct HitPRD
 struct PhotonRecord
 {
   optix::float3 position;
-  optix::float3 normal;      // Pack this into 4 bytes
+  optix::float3 normal;
   optix::float3 ray_dir;
   optix::float3 energy;
   optix::uint   axis;
@@ -104,15 +159,129 @@ struct PhotonRecord
 };
 
 
+// 24 byte photon of the photon pass output and the photon map, see packPhoton().
 struct PackedPhotonRecord
 {
-  optix::float4 a;   // position.x, position.y, position.z, normal.x
-  optix::float4 b;   // normal.y,   normal.z,   ray_dir.x,  ray_dir.y
-  optix::float4 c;   // ray_dir.z,  energy.x,   energy.y,   energy.z
-  optix::float4 d;   // axis,       padding,    padding,    padding
+  optix::float3 position;
+  optix::uint   normal;    // Octahedral, 16 bits per component
+  optix::uint   ray_dir;   // Octahedral, 14 bits per component, the split axis in the top 4 bits
+  optix::uint   energy;    // RGB9E5
 };
 
 
+// Largest RGB9E5 component, (511/512) * 2^16.
+#define  PPM_RGB9E5_MAX 65408.0f
+
+// Octahedral encoding of the unit vector v with bits per component, the second component in the high bits.
+static __host__ __device__ __inline__ unsigned int encodeOctahedral( const optix::float3& v, unsigned int bits )
+{
+  const float l1 = fabsf( v.x ) + fabsf( v.y ) + fabsf( v.z );
+  float u = v.x / l1;
+  float w = v.y / l1;
+  if( v.z < 0.0f ) {
+    // Fold the lower hemisphere over the diagonals.
+    const float folded_u = ( 1.0f - fabsf( w ) ) * ( ( u >= 0.0f ) ? 1.0f : -1.0f );
+    const float folded_w = ( 1.0f - fabsf( u ) ) * ( ( w >= 0.0f ) ? 1.0f : -1.0f );
+    u = folded_u;
+    w = folded_w;
+  }
+  const float scale = static_cast<float>( ( 1u << bits ) - 1u );
+  const unsigned int qu = static_cast<unsigned int>( floorf( fminf( fmaxf( u * 0.5f + 0.5f, 0.0f ), 1.0f ) * scale + 0.5f ) );
+  const unsigned int qw = static_cast<unsigned int>( floorf( fminf( fmaxf( w * 0.5f + 0.5f, 0.0f ), 1.0f ) * scale + 0.5f ) );
+  return qu | ( qw << bits );
+}
+
+static __host__ __device__ __inline__ optix::float3 decodeOctahedral( unsigned int code, unsigned int bits )
+{
+  const unsigned int mask = ( 1u << bits ) - 1u;
+  const float scale = 2.0f / static_cast<float>( mask );
+  float u = static_cast<float>( code & mask ) * scale - 1.0f;
+  float w = static_cast<float>( ( code >> bits ) & mask ) * scale - 1.0f;
+  const float z = 1.0f - fabsf( u ) - fabsf( w );
+  if( z < 0.0f ) {
+    const float unfolded_u = ( 1.0f - fabsf( w ) ) * ( ( u >= 0.0f ) ? 1.0f : -1.0f );
+    const float unfolded_w = ( 1.0f - fabsf( u ) ) * ( ( w >= 0.0f ) ? 1.0f : -1.0f );
+    u = unfolded_u;
+    w = unfolded_w;
+  }
+  return optix::normalize( optix::make_float3( u, w, z ) );
+}
+
+// Shared exponent encoding of a color: 9 bit mantissas without implicit one and a 5 bit exponent biased by 15.
+// Components are clamped to [0, PPM_RGB9E5_MAX].  The error is at most 1/512 of the largest component if that is
+// at least 2^-15, smaller colors lose precision and those below 2^-25 round to zero.
+static __host__ __device__ __inline__ unsigned int encodeRGB9E5( const optix::float3& color )
+{
+  const float r = fminf( fmaxf( color.x, 0.0f ), PPM_RGB9E5_MAX );
+  const float g = fminf( fmaxf( color.y, 0.0f ), PPM_RGB9E5_MAX );
+  const float b = fminf( fmaxf( color.z, 0.0f ), PPM_RGB9E5_MAX );
+  const float max_component = fmaxf( fmaxf( r, g ), fmaxf( b, 1.0f / 65536.0f ) ); // Smallest exponent 2^-16
+
+  // The mantissas are the components scaled by 2^(24 - exponent).
+  int exponent = static_cast<int>( floorf( log2f( max_component ) ) ) + 16;
+  if( floorf( ldexpf( max_component, 24 - exponent ) + 0.5f ) >= 512.0f ) {
+    ++exponent;
+  }
+  const unsigned int rm = static_cast<unsigned int>( floorf( ldexpf( r, 24 - exponent ) + 0.5f ) );
+  const unsigned int gm = static_cast<unsigned int>( floorf( ldexpf( g, 24 - exponent ) + 0.5f ) );
+  const unsigned int bm = static_cast<unsigned int>( floorf( ldexpf( b, 24 - exponent ) + 0.5f ) );
+  return rm | ( gm << 9 ) | ( bm << 18 ) | ( static_cast<unsigned int>( exponent ) << 27 );
+}
+
+static __host__ __device__ __inline__ optix::float3 decodeRGB9E5( unsigned int code )
+{
+  const int exponent = static_cast<int>( code >> 27 ) - 24;
+  return optix::make_float3( ldexpf( static_cast<float>( code & 0x1FF ), exponent ),
+                             ldexpf( static_cast<float>( ( code >> 9 ) & 0x1FF ), exponent ),
+                             ldexpf( static_cast<float>( ( code >> 18 ) & 0x1FF ), exponent ) );
+}
+
+// Photons whose energy rounds to zero are dropped like the ones which left the scene.
+static __host__ __device__ __inline__ bool photonHasEnergy( const PackedPhotonRecord& photon )
+{
+  return ( photon.energy & 0x07FFFFFFu ) != 0u;
+}
+
+// PPM_X, PPM_Y, PPM_Z, PPM_LEAF, PPM_NULL or 0, stored as its bit index plus one.
+static __host__ __device__ __inline__ unsigned int photonAxis( const PackedPhotonRecord& photon )
+{
+  const unsigned int code = photon.ray_dir >> 28;
+  return ( code ) ? 1u << ( code - 1u ) : 0u;
+}
+
+static __host__ __device__ __inline__ void setPhotonAxis( PackedPhotonRecord& photon, unsigned int axis )
+{
+  unsigned int code = 0;
+  while( axis >> code ) {
+    ++code;
+  }
+  photon.ray_dir = ( photon.ray_dir & 0x0FFFFFFFu ) | ( code << 28 );
+}
+
+static __host__ __device__ __inline__ PackedPhotonRecord packPhoton( const PhotonRecord& photon )
+{
+  PackedPhotonRecord packed;
+  packed.position = photon.position;
+  packed.normal   = encodeOctahedral( photon.normal, 16 );
+  packed.ray_dir  = encodeOctahedral( photon.ray_dir, 14 );
+  packed.energy   = encodeRGB9E5( photon.energy );
+  setPhotonAxis( packed, photon.axis );
+  return packed;
+}
+
+static __host__ __device__ __inline__ PhotonRecord unpackPhoton( const PackedPhotonRecord& packed )
+{
+  PhotonRecord photon;
+  photon.position = packed.position;
+  photon.normal   = decodeOctahedral( packed.normal, 16 );
+  photon.ray_dir  = decodeOctahedral( packed.ray_dir & 0x0FFFFFFFu, 14 );
+  photon.energy   = decodeRGB9E5( packed.energy );
+  photon.axis     = photonAxis( packed );
+  photon.pad      = optix::make_float3( 0.0f );
+  return photon;
+}
+
+
 struct PhotonPRD
 {
   optix::float3 energy;
@@ -42,6 +42,11 @@ rtDeclareVariable(rtObject,      top_object, , );
 rtBuffer<float4, 2>              output_buffer;
 rtBuffer<float4, 2>              debug_buffer;
 rtBuffer<PackedPhotonRecord, 1>  photon_map;
+rtDeclareVariable(uint,          photon_map_count, , ); // Nodes in use, the left-balanced photon map has no PPM_NULL nodes.
+rtDeclareVariable(uint,          photon_map_type, , );  // KDTreePhotonMap or HashGridPhotonMap
+rtBuffer<uint, 1>                photon_grid_start;     // First photon of each hash grid bucket
+rtBuffer<uint, 1>                photon_grid_count;     // Number of photons of each hash grid bucket
+rtDeclareVariable(float,         photon_grid_cell_size, , );
 rtBuffer<PackedHitRecord, 2>     rtpass_output_buffer;
 rtBuffer<uint2, 2>               image_rnd_seeds;
 rtDeclareVariable(float,         scene_epsilon, , );
@@ -61,11 +66,10 @@ void accumulatePhoton( const PackedPhotonRecord& photon,
                        const float3& rec_atten_Kd,
                        uint& num_new_photons, float3& flux_M )
 {
-  float3 photon_energy = make_float3( photon.c.y, photon.c.z, photon.c.w );
-  float3 photon_normal = make_float3( photon.a.w, photon.b.x, photon.b.y );
+  float3 photon_normal = decodeOctahedral( photon.normal, 16 );
   float p_dot_hit = dot(photon_normal, rec_normal);
   if (p_dot_hit > 0.01f) { // Fudge factor for imperfect cornell box geom
-    float3 photon_ray_dir = make_float3( photon.b.z, photon.b.w, photon.c.x );
+    float3 photon_energy = decodeRGB9E5( photon.energy );
     float3 flux = photon_energy * rec_atten_Kd; // * -dot(photon_ray_dir, rec_normal);
     num_new_photons++;
     flux_M += flux;
@@ -106,60 +110,80 @@ RT_PROGRAM void gather()
     return;
   }
 
-  unsigned int stack[MAX_DEPTH];
-  unsigned int stack_current = 0;
-  unsigned int node = 0; // 0 is the start
+  uint num_new_photons = 0u;
+  float3 flux_M = make_float3( 0.0f, 0.0f, 0.0f );
+  uint loop_iter = 0;
+
+  if( photon_map_type == HashGridPhotonMap ) {
+    // The cells are at least twice as wide as the initial radius, so at most 8 buckets hold the photons.
+    uint buckets[8];
+    uint num_buckets = photonGridBuckets( rec_position, sqrtf( rec_radius2 ), photon_grid_cell_size,
+                                          static_cast<uint>( photon_grid_start.size() ), buckets );
+    for( uint b = 0; b < num_buckets; ++b ) {
+      uint begin = photon_grid_start[ buckets[b] ];
+      uint end   = begin + photon_grid_count[ buckets[b] ];
+      for( uint i = begin; i < end; ++i ) {
+        PackedPhotonRecord& photon = photon_map[ i ];
+
+        float3 diff = rec_position - photon.position;
+        if( dot(diff, diff) <= rec_radius2 ) {
+          accumulatePhoton(photon, rec_normal, rec_atten_Kd, num_new_photons, flux_M);
+        }
+        loop_iter++;
+      }
+    }
+  } else {
+    unsigned int stack[MAX_DEPTH];
+    unsigned int stack_current = 0;
+    unsigned int node = 0; // 0 is the start
 
 #define push_node(N) stack[stack_current++] = (N)
 #define pop_node()   stack[--stack_current]
 
-  push_node( 0 );
+    push_node( 0 );
 
-  int photon_map_size = photon_map.size(); // for debugging
+    int photon_map_size = photon_map.size(); // for debugging
 
-  uint num_new_photons = 0u;
-  float3 flux_M = make_float3( 0.0f, 0.0f, 0.0f );
-  uint loop_iter = 0;
-  do {
-
-    check( node < photon_map_size, make_float3( 1,0,0 ) );
-    PackedPhotonRecord& photon = photon_map[ node ];
-
-    uint axis = __float_as_int( photon.d.x );
-    if( !( axis & PPM_NULL ) ) {
+    do {
 
-      float3 photon_position = make_float3( photon.a );
-      float3 diff = rec_position - photon_position;
-      float distance2 = dot(diff, diff);
+      check( node < photon_map_size, make_float3( 1,0,0 ) );
+      uint axis = ( node < photon_map_count ) ? photonAxis( photon_map[ node ] ) : PPM_NULL;
+      if( !( axis & PPM_NULL ) ) {
+        PackedPhotonRecord& photon = photon_map[ node ];
 
-      if (distance2 <= rec_radius2) {
-        accumulatePhoton(photon, rec_normal, rec_atten_Kd, num_new_photons, flux_M);
-      }
+        float3 diff = rec_position - photon.position;
+        float distance2 = dot(diff, diff);
 
-      // Recurse
-      if( !( axis & PPM_LEAF ) ) {
-        float d;
-        if      ( axis & PPM_X ) d = diff.x;
-        else if ( axis & PPM_Y ) d = diff.y;
-        else                      d = diff.z;
-
-        // Calculate the next child selector. 0 is left, 1 is right.
-        int selector = d < 0.0f ? 0 : 1;
-        if( d*d < rec_radius2 ) {
-          check( stack_current+1 < MAX_DEPTH, make_float3( 0,1,0) );
-          push_node( (node<<1) + 2 - selector );
+        if (distance2 <= rec_radius2) {
+          accumulatePhoton(photon, rec_normal, rec_atten_Kd, num_new_photons, flux_M);
         }
 
-        check( stack_current+1 < MAX_DEPTH, make_float3( 0,1,1) );
-        node = (node<<1) + 1 + selector;
+        // Recurse
+        if( !( axis & PPM_LEAF ) ) {
+          float d;
+          if      ( axis & PPM_X ) d = diff.x;
+          else if ( axis & PPM_Y ) d = diff.y;
+          else                      d = diff.z;
+
+          // Calculate the next child selector. 0 is left, 1 is right.
+          // Children at or after photon_map_count don't exist.
+          int selector = d < 0.0f ? 0 : 1;
+          if( d*d < rec_radius2 && (node<<1) + 2 - selector < photon_map_count ) {
+            check( stack_current+1 < MAX_DEPTH, make_float3( 0,1,0) );
+            push_node( (node<<1) + 2 - selector );
+          }
+
+          check( stack_current+1 < MAX_DEPTH, make_float3( 0,1,1) );
+          node = ( (node<<1) + 1 + selector < photon_map_count ) ? (node<<1) + 1 + selector : pop_node();
+        } else {
+          node = pop_node();
+        }
       } else {
         node = pop_node();
       }
-    } else {
-      node = pop_node();
-    }
-    loop_iter++;
-  } while ( node );
+      loop_iter++;
+    } while ( node );
+  }
 
   // Compute new N,R
   float R2 = rec_radius2;
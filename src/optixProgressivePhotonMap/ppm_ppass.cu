@@ -44,7 +44,7 @@ rtDeclareVariable(rtObject,      top_object, , );
 //
 // Ray generation program
 //
-rtBuffer<PhotonRecord, 1>        ppass_output_buffer;
+rtBuffer<PackedPhotonRecord, 1>  ppass_output_buffer;
 rtBuffer<uint2, 2>               photon_rnd_seeds;
 rtDeclareVariable(uint,          max_depth, , );
 rtDeclareVariable(uint,          max_photon_count, , );
@@ -155,7 +155,7 @@ RT_PROGRAM void ppass_camera()
 
   // Initialize our photons
   for(unsigned int i = 0; i < max_photon_count; ++i) {
-    ppass_output_buffer[i+pm_index].energy = make_float3(0.0f);
+    ppass_output_buffer[i+pm_index].energy = 0u; // RGB9E5 zero
   }
 
   PhotonPRD prd;
@@ -193,11 +193,13 @@ RT_PROGRAM void ppass_closest_hit()
   if( fmaxf( Kd ) > 0.0f ) {
     // We hit a diffuse surface; record hit if it has bounced at least once
     if( hit_record.ray_depth > 0 ) {
-      PhotonRecord& rec = ppass_output_buffer[hit_record.pm_index + hit_record.num_deposits];
+      PhotonRecord rec;
       rec.position = hit_point;
       rec.normal = ffnormal;
       rec.ray_dir = ray.direction;
       rec.energy = hit_record.energy;
+      rec.axis = 0u;
+      ppass_output_buffer[hit_record.pm_index + hit_record.num_deposits] = packPhoton( rec );
       hit_record.num_deposits++;
     }
 
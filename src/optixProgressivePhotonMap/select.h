@@ -20,6 +20,9 @@
  */
 
 #include <cstdlib>  // rand()
+#include <vector>
+
+#include <Parallel.h> // from sutil
 
 template<class Elem> __inline void swap(Elem* list, int a, int b)
 {
@@ -37,7 +40,7 @@ template<class Elem> __inline int mid_component(Elem a[3])
 #if 1
 #define ElemIndex(rec, index) ( (&(rec->position.x))[index] )
 #else
-float ElemIndex(const PhotonRecord* rec, int index) { return (&(rec->position.x))[index]; }
+float ElemIndex(const PackedPhotonRecord* rec, int index) { return (&(rec->position.x))[index]; }
 #endif
 //#define ElemIndex(elem, index) ( elem )
 
@@ -219,3 +222,99 @@ end procedure
       left = pivotNewIndex+1;
   }
 }
+
+/*
+  Returns the same index and leaves the list in the same order as partition(), but scans
+  and swaps in parallel.
+
+  partition() swaps the i-th element >= pivotValue counted from the left with the i-th
+  element <= pivotValue counted from the right, as long as the first is left of the
+  second.  Neither scan ever reaches an element an earlier swap has moved, so both
+  sequences can be collected from the list up front, and the swaps are independent.
+  The pivot ends up where the left scan stops after the last swap.
+*/
+template<class Elem, int axis> int partitionParallel(Elem* list, int left, int right, int pivotIndex, size_t grain)
+{
+  Elem pivotValue = list[pivotIndex];
+  swap(list, right, pivotIndex);
+
+  const size_t count = right - left; // The scanned elements, without the pivot.
+  const size_t num_ranges = sutil::numRanges(count, grain);
+  std::vector<size_t> highs_before(num_ranges + 1, 0); // Elements >= pivotValue in the ranges before.
+  std::vector<size_t> lows_before(num_ranges + 1, 0);  // Elements <= pivotValue in the ranges before.
+
+  sutil::parallelFor(count, grain, [&](size_t begin, size_t end, size_t r) {
+    size_t highs = 0;
+    size_t lows  = 0;
+    for(size_t i = left + begin; i < left + end; ++i) {
+      highs += (ElemIndex(list[i],axis) >= ElemIndex(pivotValue,axis)) ? 1 : 0;
+      lows  += (ElemIndex(list[i],axis) <= ElemIndex(pivotValue,axis)) ? 1 : 0;
+    }
+    highs_before[r + 1] = highs;
+    lows_before[r + 1]  = lows;
+  });
+  for(size_t r = 0; r < num_ranges; ++r) {
+    highs_before[r + 1] += highs_before[r];
+    lows_before[r + 1]  += lows_before[r];
+  }
+
+  // highs in ascending, lows in descending order, the order of the two scans.
+  std::vector<int> highs(highs_before[num_ranges]);
+  std::vector<int> lows(lows_before[num_ranges]);
+  sutil::parallelFor(count, grain, [&](size_t begin, size_t end, size_t r) {
+    size_t h = highs_before[r];
+    size_t l = lows.size() - 1 - lows_before[r];
+    for(size_t i = left + begin; i < left + end; ++i) {
+      if (ElemIndex(list[i],axis) >= ElemIndex(pivotValue,axis))
+        highs[h++] = static_cast<int>(i);
+      if (ElemIndex(list[i],axis) <= ElemIndex(pivotValue,axis))
+        lows[l--] = static_cast<int>(i);
+    }
+  });
+
+  // highs[i] < lows[i] holds for a prefix of the pairs, those are the swaps.
+  size_t lo = 0;
+  size_t hi = std::min(highs.size(), lows.size());
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if (highs[mid] < lows[mid])
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  const size_t num_swaps = lo;
+
+  sutil::parallelFor(num_swaps, grain, [&](size_t begin, size_t end, size_t) {
+    for(size_t i = begin; i < end; ++i)
+      swap(list, highs[i], lows[i]);
+  });
+
+  // The left scan stops at the next element >= pivotValue or at the last swapped one from the right.
+  int storeIndex = (num_swaps) ? lows[num_swaps - 1] : right;
+  if (num_swaps < highs.size())
+    storeIndex = std::min(storeIndex, highs[num_swaps]);
+
+  // Put the pivotValue back in place
+  swap(list, storeIndex, right);
+  return storeIndex;
+}
+
+/*
+  select() with the partitions of more than grain elements done by partitionParallel().
+  Gives the identical list order as select().
+*/
+template<class Elem, int axis> Elem selectParallel(Elem* list, int left, int right, int k, size_t grain)
+{
+  while(1) {
+    int pivotIndex = (left+right)/2;
+    int pivotNewIndex = (static_cast<size_t>(right - left) > grain)
+                      ? partitionParallel<Elem,axis>(list, left, right, pivotIndex, grain)
+                      : partition<Elem,axis>(list, left, right, pivotIndex);
+    if (k == pivotNewIndex)
+      return list[k];
+    else if (k < pivotNewIndex)
+      right = pivotNewIndex-1;
+    else
+      left = pivotNewIndex+1;
+  }
+}
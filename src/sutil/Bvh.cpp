@@ -0,0 +1,535 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Bvh.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+
+namespace
+{
+
+const int      BINS          = 16;
+const uint32_t MAX_LEAF_SIZE = 8;        // Larger leaves are split even if SAH disagrees
+const size_t   GRAIN         = 1u << 14; // Triangles per range for parallel loops and tasks
+
+
+BvhNode* allocNodes( size_t count )
+{
+  void* ptr = 0;
+#if defined(_WIN32)
+  ptr = _aligned_malloc( count * sizeof( BvhNode ), 64 );
+#else
+  if( posix_memalign( &ptr, 64, count * sizeof( BvhNode ) ) != 0 )
+    ptr = 0;
+#endif
+  if( !ptr )
+    throw std::bad_alloc();
+  return static_cast<BvhNode*>( ptr );
+}
+
+
+void freeNodes( BvhNode* nodes )
+{
+#if defined(_WIN32)
+  _aligned_free( nodes );
+#else
+  free( nodes );
+#endif
+}
+
+
+// Axis aligned box.  The comparisons are written so that NaN coordinates of
+// broken triangles are ignored instead of poisoning the bounds.
+struct Box
+{
+  float lo[3];
+  float hi[3];
+
+  void reset()
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      lo[k] =  std::numeric_limits<float>::infinity();
+      hi[k] = -std::numeric_limits<float>::infinity();
+    }
+  }
+
+  void grow( const float* p )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      lo[k] = p[k] < lo[k] ? p[k] : lo[k];
+      hi[k] = p[k] > hi[k] ? p[k] : hi[k];
+    }
+  }
+
+  void grow( const Box& b )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      lo[k] = b.lo[k] < lo[k] ? b.lo[k] : lo[k];
+      hi[k] = b.hi[k] > hi[k] ? b.hi[k] : hi[k];
+    }
+  }
+
+  float area() const
+  {
+    const float dx = hi[0] - lo[0];
+    const float dy = hi[1] - lo[1];
+    const float dz = hi[2] - lo[2];
+    if( !( dx >= 0.0f && dy >= 0.0f && dz >= 0.0f ) )
+      return 0.0f;
+    return 2.0f * ( dx * dy + dy * dz + dz * dx );
+  }
+};
+
+
+// Centroid bounds of a range of triangles.  Centroids are box centers.
+struct RangeBounds
+{
+  Box bounds;
+  Box centroids;
+
+  void reset()
+  {
+    bounds.reset();
+    centroids.reset();
+  }
+};
+
+
+// A triangle's bounds together with its number, so that the builder
+// partitions and scans contiguous memory.
+struct PrimRef
+{
+  Box      box;
+  uint32_t prim;
+};
+
+
+struct Bin
+{
+  Box      box;
+  uint32_t count;
+};
+
+
+class Builder
+{
+public:
+  Builder( PrimRef* refs, BvhNode* nodes )
+    : m_refs( refs )
+    , m_nodes( nodes )
+    , m_next_node( 1 )
+    , m_spawn_depth( 2 )
+  {
+    for( unsigned int n = 1; n < sutil::numThreads(); n *= 2 )
+      ++m_spawn_depth;
+  }
+
+  uint32_t numNodes() const { return m_next_node; }
+
+  void buildNode( uint32_t node, uint32_t begin, uint32_t end, int depth )
+  {
+    const uint32_t count = end - begin;
+
+    RangeBounds range;
+    computeBounds( begin, end, range );
+    setBounds( m_nodes[node], range.bounds );
+
+    int   axis  = -1;
+    int   split = 0;
+    float cost  = std::numeric_limits<float>::infinity();
+    if( count > 1 )
+      findSplit( begin, end, range.centroids, axis, split, cost );
+
+    // Leaf versus split with unit traversal and intersection costs
+    const float area = range.bounds.area();
+    if( count <= MAX_LEAF_SIZE && ( axis < 0 || !( 1.0f + cost / area < float( count ) ) ) )
+    {
+      m_nodes[node].first = begin;
+      m_nodes[node].count = count;
+      return;
+    }
+
+    uint32_t middle = begin + count / 2; // All centroids coincide: split the range in half
+    if( axis >= 0 )
+    {
+      const float lo    = range.centroids.lo[axis];
+      const float scale = binScale( range.centroids, axis );
+      middle = static_cast<uint32_t>( std::partition( m_refs + begin, m_refs + end, [&]( const PrimRef& ref )
+      {
+        return binIndex( centroid( ref.box, axis ), lo, scale ) <= split;
+      } ) - m_refs );
+    }
+
+    const uint32_t left = m_next_node.fetch_add( 2 );
+    m_nodes[node].first = left;
+    m_nodes[node].count = 0;
+
+    if( count > GRAIN && depth < m_spawn_depth )
+    {
+      sutil::parallelInvoke(
+        [this, left, begin, middle, depth]() { buildNode( left, begin, middle, depth + 1 ); },
+        [this, left, middle, end, depth]() { buildNode( left + 1, middle, end, depth + 1 ); } );
+    }
+    else
+    {
+      buildNode( left, begin, middle, depth + 1 );
+      buildNode( left + 1, middle, end, depth + 1 );
+    }
+  }
+
+private:
+  static float centroid( const Box& box, int axis )
+  {
+    return 0.5f * ( box.lo[axis] + box.hi[axis] );
+  }
+
+  static float binScale( const Box& centroids, int axis )
+  {
+    return float( BINS ) * 0.9999f / ( centroids.hi[axis] - centroids.lo[axis] );
+  }
+
+  // NaN centroids end up in bin 0.
+  static int binIndex( float c, float lo, float scale )
+  {
+    const float f = ( c - lo ) * scale;
+    return f > 0.0f ? ( f < float( BINS ) ? int( f ) : BINS - 1 ) : 0;
+  }
+
+  static void setBounds( BvhNode& node, const Box& box )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      node.bbox_min[k] = box.lo[k];
+      node.bbox_max[k] = box.hi[k];
+    }
+  }
+
+  void computeBounds( uint32_t begin, uint32_t end, RangeBounds& result ) const
+  {
+    // Most nodes are small and use a single range on the stack
+    const size_t num_ranges = sutil::numRanges( end - begin, 4 * GRAIN );
+    RangeBounds              local;
+    std::vector<RangeBounds> heap( num_ranges > 1 ? num_ranges : 0 );
+    RangeBounds*             partial = num_ranges > 1 ? &heap[0] : &local;
+
+    sutil::parallelFor( end - begin, 4 * GRAIN, [&]( size_t b, size_t e, size_t r )
+    {
+      RangeBounds& rb = partial[r];
+      rb.reset();
+      for( size_t i = begin + b; i < begin + e; ++i )
+      {
+        const Box& box = m_refs[i].box;
+        const float c[3] = { centroid( box, 0 ), centroid( box, 1 ), centroid( box, 2 ) };
+        rb.bounds.grow( box );
+        rb.centroids.grow( c );
+      }
+    } );
+
+    result.reset();
+    for( size_t r = 0; r < num_ranges; ++r )
+    {
+      result.bounds.grow( partial[r].bounds );
+      result.centroids.grow( partial[r].centroids );
+    }
+  }
+
+  // Finds the cheapest split plane between two bins over all three axes.
+  // cost is the unnormalized SAH, the sum of the child areas times their
+  // triangle counts.  axis is -1 if the centroid bounds are a single point.
+  void findSplit( uint32_t begin, uint32_t end, const Box& centroids, int& axis, int& split, float& cost ) const
+  {
+    const size_t num_ranges = sutil::numRanges( end - begin, 4 * GRAIN );
+    Bin              local[3 * BINS];
+    std::vector<Bin> heap( num_ranges > 1 ? num_ranges * 3 * BINS : 0 );
+    Bin*             partial = num_ranges > 1 ? &heap[0] : local;
+
+    sutil::parallelFor( end - begin, 4 * GRAIN, [&]( size_t b, size_t e, size_t r )
+    {
+      Bin* bins = &partial[r * 3 * BINS];
+      for( int i = 0; i < 3 * BINS; ++i )
+      {
+        bins[i].box.reset();
+        bins[i].count = 0;
+      }
+
+      for( int a = 0; a < 3; ++a )
+      {
+        if( !( centroids.hi[a] > centroids.lo[a] ) )
+          continue;
+        const float lo    = centroids.lo[a];
+        const float scale = binScale( centroids, a );
+        for( size_t i = begin + b; i < begin + e; ++i )
+        {
+          const Box& box = m_refs[i].box;
+          Bin& bin = bins[a * BINS + binIndex( centroid( box, a ), lo, scale )];
+          bin.box.grow( box );
+          ++bin.count;
+        }
+      }
+    } );
+
+    for( size_t r = 1; r < num_ranges; ++r )
+    {
+      for( int i = 0; i < 3 * BINS; ++i )
+      {
+        partial[i].box.grow( partial[r * 3 * BINS + i].box );
+        partial[i].count += partial[r * 3 * BINS + i].count;
+      }
+    }
+
+    for( int a = 0; a < 3; ++a )
+    {
+      if( !( centroids.hi[a] > centroids.lo[a] ) )
+        continue;
+
+      const Bin* bins = &partial[a * BINS];
+
+      // right_cost[i] is the cost of bins i+1 .. BINS-1
+      float right_cost[BINS];
+      Box   box;
+      box.reset();
+      uint32_t n = 0;
+      for( int i = BINS - 1; i > 0; --i )
+      {
+        box.grow( bins[i].box );
+        n += bins[i].count;
+        right_cost[i - 1] = n ? box.area() * float( n ) : std::numeric_limits<float>::infinity();
+      }
+
+      box.reset();
+      n = 0;
+      for( int i = 0; i < BINS - 1; ++i )
+      {
+        box.grow( bins[i].box );
+        n += bins[i].count;
+        if( !n )
+          continue;
+        const float c = box.area() * float( n ) + right_cost[i];
+        if( c < cost )
+        {
+          cost  = c;
+          axis  = a;
+          split = i;
+        }
+      }
+    }
+  }
+
+  PrimRef*                m_refs;
+  BvhNode*                m_nodes;
+  std::atomic<uint32_t>   m_next_node;
+  int                     m_spawn_depth;
+};
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// Bvh
+//
+//------------------------------------------------------------------------------
+
+Bvh::Bvh()
+  : m_nodes( 0 )
+  , m_num_nodes( 0 )
+  , m_prim_indices( 0 )
+  , m_num_prims( 0 )
+{
+}
+
+
+Bvh::~Bvh()
+{
+  clear();
+}
+
+
+void Bvh::clear()
+{
+  freeNodes( m_nodes );
+  delete [] m_prim_indices;
+  m_nodes        = 0;
+  m_num_nodes    = 0;
+  m_prim_indices = 0;
+  m_num_prims    = 0;
+}
+
+
+void Bvh::build( const Mesh& mesh )
+{
+  build( mesh.positions, mesh.num_vertices, 3 * sizeof( float ), mesh.tri_indices, mesh.num_triangles );
+}
+
+
+void Bvh::build( const float* positions, int32_t num_vertices, size_t vertex_stride,
+                 const int32_t* tri_indices, int32_t num_triangles )
+{
+  clear();
+  if( num_triangles <= 0 )
+    return;
+
+  const char* base = reinterpret_cast<const char*>( positions );
+
+  // Triangle bounds, checking the indices on the way
+  std::vector<PrimRef> refs( num_triangles );
+  std::atomic<bool> bad_index( false );
+  sutil::parallelFor( num_triangles, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t i = begin; i < end; ++i )
+    {
+      refs[i].prim = static_cast<uint32_t>( i );
+      refs[i].box.reset();
+      for( int k = 0; k < 3; ++k )
+      {
+        const int32_t v = tri_indices[3 * i + k];
+        if( v < 0 || v >= num_vertices )
+        {
+          bad_index = true;
+          return;
+        }
+        refs[i].box.grow( reinterpret_cast<const float*>( base + v * vertex_stride ) );
+      }
+    }
+  } );
+  if( bad_index )
+    throw std::runtime_error( "Bvh::build(): triangle index out of range" );
+
+  m_num_prims = static_cast<uint32_t>( num_triangles );
+
+  // Nodes are allocated in pairs from a shared counter while subtrees are
+  // built concurrently.  A binary tree with at most one triangle per leaf has
+  // 2n-1 nodes, plus the unused one after the root.
+  std::vector<BvhNode> tmp( 2 * size_t( m_num_prims ) );
+  Builder builder( &refs[0], &tmp[0] );
+  builder.buildNode( 0, 0, m_num_prims, 0 );
+
+  m_prim_indices = new uint32_t[m_num_prims];
+  for( uint32_t i = 0; i < m_num_prims; ++i )
+    m_prim_indices[i] = refs[i].prim;
+  std::vector<PrimRef>().swap( refs );
+
+  // Lay the nodes out in depth-first order, which also makes the numbering
+  // independent of the order in which the tasks allocated them.
+  m_num_nodes = builder.numNodes() + 1;
+  m_nodes     = allocNodes( m_num_nodes );
+  m_nodes[0]  = tmp[0];
+  m_nodes[1]  = BvhNode();
+  uint32_t next = 2;
+
+  std::vector<uint32_t> stack( 1, 0 );
+  while( !stack.empty() )
+  {
+    BvhNode& node = m_nodes[stack.back()];
+    stack.pop_back();
+    if( node.isLeaf() )
+      continue;
+
+    m_nodes[next]     = tmp[node.first];
+    m_nodes[next + 1] = tmp[node.first + 1];
+    node.first        = next;
+    stack.push_back( next + 1 );
+    stack.push_back( next );
+    next += 2;
+  }
+}
+
+
+float Bvh::sahCost( float traversal_cost, float intersection_cost ) const
+{
+  if( !m_num_nodes )
+    return 0.0f;
+
+  double cost = 0.0;
+  for( uint32_t i = 0; i < m_num_nodes; ++i )
+  {
+    if( i == 1 )
+      continue;
+    const BvhNode& node = m_nodes[i];
+    Box box;
+    std::copy( node.bbox_min, node.bbox_min + 3, box.lo );
+    std::copy( node.bbox_max, node.bbox_max + 3, box.hi );
+    cost += box.area() * ( node.isLeaf() ? intersection_cost * node.count : traversal_cost );
+  }
+
+  Box root;
+  std::copy( m_nodes[0].bbox_min, m_nodes[0].bbox_min + 3, root.lo );
+  std::copy( m_nodes[0].bbox_max, m_nodes[0].bbox_max + 3, root.hi );
+  const double root_area = root.area();
+  return root_area > 0.0 ? float( cost / root_area ) : intersection_cost * m_num_prims;
+}
+
+
+BvhStats Bvh::stats() const
+{
+  BvhStats stats;
+  stats.num_nodes     = m_num_nodes;
+  stats.num_leaves    = 0;
+  stats.max_depth     = 0;
+  stats.max_leaf_size = 0;
+  stats.sah_cost      = sahCost();
+  stats.memory        = m_num_nodes * sizeof( BvhNode ) + m_num_prims * sizeof( uint32_t );
+
+  if( !m_num_nodes )
+    return stats;
+
+  std::vector<std::pair<uint32_t, uint32_t> > stack( 1, std::make_pair( 0u, 0u ) );
+  while( !stack.empty() )
+  {
+    const BvhNode& node  = m_nodes[stack.back().first];
+    const uint32_t depth = stack.back().second;
+    stack.pop_back();
+
+    stats.max_depth = std::max( stats.max_depth, depth );
+    if( node.isLeaf() )
+    {
+      ++stats.num_leaves;
+      stats.max_leaf_size = std::max( stats.max_leaf_size, node.count );
+    }
+    else
+    {
+      stack.push_back( std::make_pair( node.first,     depth + 1 ) );
+      stack.push_back( std::make_pair( node.first + 1, depth + 1 ) );
+    }
+  }
+  return stats;
+}
@@ -0,0 +1,111 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <sutilapi.h>
+#include "Mesh.h"
+
+#include <cstddef>
+#include <stdint.h>
+
+
+//------------------------------------------------------------------------------
+//
+// Host-side bounding volume hierarchy over triangles, built with binned SAH
+//
+//------------------------------------------------------------------------------
+
+// 32 bytes, so that the two children of a node share one 64 byte cache line.
+struct BvhNode
+{
+  float               bbox_min[3];
+  uint32_t            first;          // Interior: index of the left child, the right one follows it
+                                      // Leaf: first entry of its triangles in Bvh::primIndices()
+  float               bbox_max[3];
+  uint32_t            count;          // Number of triangles in a leaf, 0 for interior nodes
+
+  bool isLeaf() const { return count != 0; }
+};
+
+
+struct BvhStats
+{
+  uint32_t            num_nodes;      // Including the unused node after the root
+  uint32_t            num_leaves;
+  uint32_t            max_depth;
+  uint32_t            max_leaf_size;
+  float               sah_cost;       // See Bvh::sahCost()
+  size_t              memory;         // Bytes for nodes and triangle indices
+};
+
+
+class Bvh
+{
+public:
+  SUTILAPI Bvh();
+  SUTILAPI ~Bvh();
+
+  // Builds the hierarchy over num_triangles triangles whose three vertex
+  // indices are stored consecutively in tri_indices.  The position of vertex i
+  // is the float x,y,z at byte offset i * vertex_stride from positions, so
+  // interleaved layouts like the intro samples' VertexAttributes (stride 48)
+  // work as well as tightly packed ones (stride 12).  Large ranges are split
+  // concurrently; the resulting tree does not depend on the thread count.
+  // Throws std::runtime_error on out of range indices.
+  SUTILAPI void build( const float* positions, int32_t num_vertices, size_t vertex_stride,
+                       const int32_t* tri_indices, int32_t num_triangles );
+
+  SUTILAPI void build( const Mesh& mesh );
+
+  SUTILAPI void clear();
+
+  // Nodes in depth-first order.  The root is node 0, node 1 is unused and all
+  // sibling pairs start at an even index of the 64 byte aligned array.
+  const BvhNode*      nodes() const        { return m_nodes; }
+  uint32_t            numNodes() const     { return m_num_nodes; }
+
+  // Triangle numbers referenced by the leaves.
+  const uint32_t*     primIndices() const  { return m_prim_indices; }
+  uint32_t            numPrims() const     { return m_num_prims; }
+
+  // Expected cost of a random ray through the root bounds: the surface area
+  // weighted traversal and intersection costs of all nodes, relative to the
+  // root.
+  SUTILAPI float      sahCost( float traversal_cost = 1.0f, float intersection_cost = 1.0f ) const;
+
+  SUTILAPI BvhStats   stats() const;
+
+private:
+  Bvh( const Bvh& );
+  Bvh& operator=( const Bvh& );
+
+  BvhNode*            m_nodes;
+  uint32_t            m_num_nodes;
+  uint32_t*           m_prim_indices;
+  uint32_t            m_num_prims;
+};
@@ -0,0 +1,378 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "BvhIntersector.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  include <emmintrin.h>
+#  define BVH_INTERSECTOR_SSE 1
+#endif
+
+
+namespace
+{
+
+const size_t GRAIN = 256; // Packets per parallel range
+
+
+//------------------------------------------------------------------------------
+//
+// Four float lanes, SSE or plain C++.  Comparisons return lanes with all bits
+// set where true, as _mm_cmp*_ps do.
+//
+//------------------------------------------------------------------------------
+
+#if defined( BVH_INTERSECTOR_SSE )
+
+struct Lanes
+{
+  __m128 v;
+
+  Lanes() {}
+  Lanes( __m128 x ) : v( x ) {}
+  explicit Lanes( float f ) : v( _mm_set1_ps( f ) ) {}
+};
+
+inline Lanes operator+( Lanes a, Lanes b ) { return _mm_add_ps( a.v, b.v ); }
+inline Lanes operator-( Lanes a, Lanes b ) { return _mm_sub_ps( a.v, b.v ); }
+inline Lanes operator*( Lanes a, Lanes b ) { return _mm_mul_ps( a.v, b.v ); }
+inline Lanes operator/( Lanes a, Lanes b ) { return _mm_div_ps( a.v, b.v ); }
+inline Lanes operator&( Lanes a, Lanes b ) { return _mm_and_ps( a.v, b.v ); }
+inline Lanes operator<( Lanes a, Lanes b ) { return _mm_cmplt_ps( a.v, b.v ); }
+inline Lanes operator<=( Lanes a, Lanes b ) { return _mm_cmple_ps( a.v, b.v ); }
+inline Lanes operator>( Lanes a, Lanes b ) { return _mm_cmpgt_ps( a.v, b.v ); }
+inline Lanes operator>=( Lanes a, Lanes b ) { return _mm_cmpge_ps( a.v, b.v ); }
+inline Lanes lanesMin( Lanes a, Lanes b ) { return _mm_min_ps( a.v, b.v ); }
+inline Lanes lanesMax( Lanes a, Lanes b ) { return _mm_max_ps( a.v, b.v ); }
+inline Lanes select( Lanes mask, Lanes a, Lanes b ) { return _mm_or_ps( _mm_and_ps( mask.v, a.v ), _mm_andnot_ps( mask.v, b.v ) ); }
+inline int   bits( Lanes mask ) { return _mm_movemask_ps( mask.v ); }
+inline Lanes load( const float* p ) { return _mm_loadu_ps( p ); }
+inline void  store( float* p, Lanes a ) { _mm_storeu_ps( p, a.v ); }
+
+#else
+
+struct Lanes
+{
+  float v[4];
+
+  Lanes() {}
+  explicit Lanes( float f ) { v[0] = v[1] = v[2] = v[3] = f; }
+};
+
+inline float maskLane( bool b )
+{
+  const uint32_t u = b ? 0xFFFFFFFFu : 0u;
+  float f;
+  memcpy( &f, &u, sizeof( f ) );
+  return f;
+}
+
+inline bool laneSet( float f )
+{
+  uint32_t u;
+  memcpy( &u, &f, sizeof( u ) );
+  return u != 0;
+}
+
+#define LANES_OP( op, expr )                                  \
+  inline Lanes op( Lanes a, Lanes b )                         \
+  {                                                           \
+    Lanes r;                                                  \
+    for( int i = 0; i < 4; ++i )                              \
+      r.v[i] = expr;                                          \
+    return r;                                                 \
+  }
+
+LANES_OP( operator+,  a.v[i] + b.v[i] )
+LANES_OP( operator-,  a.v[i] - b.v[i] )
+LANES_OP( operator*,  a.v[i] * b.v[i] )
+LANES_OP( operator/,  a.v[i] / b.v[i] )
+LANES_OP( operator&,  maskLane( laneSet( a.v[i] ) && laneSet( b.v[i] ) ) )
+LANES_OP( operator<,  maskLane( a.v[i] <  b.v[i] ) )
+LANES_OP( operator<=, maskLane( a.v[i] <= b.v[i] ) )
+LANES_OP( operator>,  maskLane( a.v[i] >  b.v[i] ) )
+LANES_OP( operator>=, maskLane( a.v[i] >= b.v[i] ) )
+LANES_OP( lanesMin,   a.v[i] < b.v[i] ? a.v[i] : b.v[i] )
+LANES_OP( lanesMax,   a.v[i] > b.v[i] ? a.v[i] : b.v[i] )
+
+#undef LANES_OP
+
+inline Lanes select( Lanes mask, Lanes a, Lanes b )
+{
+  Lanes r;
+  for( int i = 0; i < 4; ++i )
+    r.v[i] = laneSet( mask.v[i] ) ? a.v[i] : b.v[i];
+  return r;
+}
+
+inline int bits( Lanes mask )
+{
+  int r = 0;
+  for( int i = 0; i < 4; ++i )
+    r |= laneSet( mask.v[i] ) ? 1 << i : 0;
+  return r;
+}
+
+inline Lanes load( const float* p ) { Lanes r; memcpy( r.v, p, sizeof( r.v ) ); return r; }
+inline void  store( float* p, Lanes a ) { memcpy( p, a.v, sizeof( a.v ) ); }
+
+#endif
+
+
+// Four rays in SoA layout.  Unused lanes have an empty interval.
+struct Packet
+{
+  Lanes    org[3];
+  Lanes    dir[3];
+  Lanes    inv_dir[3];
+  Lanes    tmin;
+  Lanes    tmax;          // Shrinks to the closest hit so far
+  Lanes    beta;
+  Lanes    gamma;
+  int32_t  prim[4];
+  float    dir_sum[3];    // Picks the traversal order of the children
+};
+
+
+// Slab test against the current [tmin, tmax] of each ray.
+inline int intersectBox( const BvhNode& node, const Packet& p )
+{
+  Lanes tnear = p.tmin;
+  Lanes tfar  = p.tmax;
+  for( int k = 0; k < 3; ++k )
+  {
+    const Lanes t0 = ( Lanes( node.bbox_min[k] ) - p.org[k] ) * p.inv_dir[k];
+    const Lanes t1 = ( Lanes( node.bbox_max[k] ) - p.org[k] ) * p.inv_dir[k];
+    tnear = lanesMax( tnear, lanesMin( t0, t1 ) );
+    tfar  = lanesMin( tfar,  lanesMax( t0, t1 ) );
+  }
+  return bits( tnear <= tfar );
+}
+
+
+inline void cross( const float* a, const float* b, float* r )
+{
+  r[0] = a[1] * b[2] - a[2] * b[1];
+  r[1] = a[2] * b[0] - a[0] * b[2];
+  r[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+
+// optix::intersect_triangle, evaluated with the same operations for four rays.
+inline void intersectTriangle( const float* p0, const float* p1, const float* p2, int32_t prim, Packet& p )
+{
+  const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+  const float e1[3] = { p0[0] - p2[0], p0[1] - p2[1], p0[2] - p2[2] };
+  float n[3];
+  cross( e1, e0, n );
+
+  const Lanes r = Lanes( 1.0f ) / ( Lanes( n[0] ) * p.dir[0] + Lanes( n[1] ) * p.dir[1] + Lanes( n[2] ) * p.dir[2] );
+
+  Lanes e2[3];
+  for( int k = 0; k < 3; ++k )
+    e2[k] = r * ( Lanes( p0[k] ) - p.org[k] );
+
+  const Lanes i0 = p.dir[1] * e2[2] - p.dir[2] * e2[1];
+  const Lanes i1 = p.dir[2] * e2[0] - p.dir[0] * e2[2];
+  const Lanes i2 = p.dir[0] * e2[1] - p.dir[1] * e2[0];
+
+  const Lanes beta  = i0 * Lanes( e1[0] ) + i1 * Lanes( e1[1] ) + i2 * Lanes( e1[2] );
+  const Lanes gamma = i0 * Lanes( e0[0] ) + i1 * Lanes( e0[1] ) + i2 * Lanes( e0[2] );
+  const Lanes t     = Lanes( n[0] ) * e2[0] + Lanes( n[1] ) * e2[1] + Lanes( n[2] ) * e2[2];
+
+  const Lanes zero( 0.0f );
+  const Lanes hit = ( t < p.tmax ) & ( t > p.tmin ) & ( beta >= zero ) & ( gamma >= zero ) & ( beta + gamma <= Lanes( 1.0f ) );
+  const int   mask = bits( hit );
+  if( !mask )
+    return;
+
+  p.tmax  = select( hit, t,     p.tmax );
+  p.beta  = select( hit, beta,  p.beta );
+  p.gamma = select( hit, gamma, p.gamma );
+  for( int i = 0; i < 4; ++i )
+    if( mask & ( 1 << i ) )
+      p.prim[i] = prim;
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// BvhIntersector
+//
+//------------------------------------------------------------------------------
+
+BvhIntersector::BvhIntersector( const Bvh& bvh, const float* positions, size_t vertex_stride, const int32_t* tri_indices )
+  : m_bvh( bvh )
+  , m_positions( reinterpret_cast<const char*>( positions ) )
+  , m_vertex_stride( vertex_stride )
+  , m_tri_indices( tri_indices )
+  , m_stack_size( bvh.stats().max_depth + 2 )
+{
+}
+
+
+BvhIntersector::BvhIntersector( const Bvh& bvh, const Mesh& mesh )
+  : m_bvh( bvh )
+  , m_positions( reinterpret_cast<const char*>( mesh.positions ) )
+  , m_vertex_stride( 3 * sizeof( float ) )
+  , m_tri_indices( mesh.tri_indices )
+  , m_stack_size( bvh.stats().max_depth + 2 )
+{
+}
+
+
+void BvhIntersector::intersect( const HostRay* rays, HostHit* hits, size_t count ) const
+{
+  const size_t num_packets = ( count + 3 ) / 4;
+  sutil::parallelFor( num_packets, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    std::vector<uint32_t> stack( m_stack_size );
+    for( size_t i = begin; i < end; ++i )
+      intersectPacket( rays + 4 * i, hits + 4 * i, std::min<size_t>( 4, count - 4 * i ), &stack[0] );
+  } );
+}
+
+
+void BvhIntersector::intersect( const HostRay& ray, HostHit& hit ) const
+{
+  uint32_t local_stack[128];
+  std::vector<uint32_t> heap_stack;
+  uint32_t* stack = local_stack;
+  if( m_stack_size > 128 )
+  {
+    heap_stack.resize( m_stack_size );
+    stack = &heap_stack[0];
+  }
+  intersectPacket( &ray, &hit, 1, stack );
+}
+
+
+void BvhIntersector::intersectPacket( const HostRay* rays, HostHit* hits, size_t count, uint32_t* stack ) const
+{
+  // Transpose the rays into lanes
+  float org[3][4], dir[3][4], inv_dir[3][4], tmin[4], tmax[4];
+  Packet p;
+  p.dir_sum[0] = p.dir_sum[1] = p.dir_sum[2] = 0.0f;
+  for( int i = 0; i < 4; ++i )
+  {
+    const bool  used = size_t( i ) < count;
+    const float zero[3] = { 0.0f, 0.0f, 0.0f };
+    const float* o = used ? rays[i].origin    : zero;
+    const float* d = used ? rays[i].direction : zero;
+    for( int k = 0; k < 3; ++k )
+    {
+      org[k][i] = o[k];
+      dir[k][i] = d[k];
+      // Avoid 0 * inf in the slab test for axis-parallel rays
+      const float dk = ( d[k] > -1e-20f && d[k] < 1e-20f ) ? ( d[k] < 0.0f ? -1e-20f : 1e-20f ) : d[k];
+      inv_dir[k][i] = 1.0f / dk;
+      p.dir_sum[k] += d[k];
+    }
+    tmin[i]   = used ? rays[i].tmin :  0.0f;
+    tmax[i]   = used ? rays[i].tmax : -1.0f;
+    p.prim[i] = -1;
+  }
+  for( int k = 0; k < 3; ++k )
+  {
+    p.org[k]     = load( org[k] );
+    p.dir[k]     = load( dir[k] );
+    p.inv_dir[k] = load( inv_dir[k] );
+  }
+  p.tmin  = load( tmin );
+  p.tmax  = load( tmax );
+  p.beta  = Lanes( 0.0f );
+  p.gamma = Lanes( 0.0f );
+
+  const BvhNode*  nodes = m_bvh.nodes();
+  const uint32_t* prims = m_bvh.primIndices();
+
+  // Boxes are tested when a node is popped, so that far children are culled
+  // against the closest hit found meanwhile.
+  uint32_t sp = 0;
+  if( m_bvh.numNodes() )
+    stack[sp++] = 0;
+  while( sp )
+  {
+    const BvhNode& node = nodes[stack[--sp]];
+    if( !intersectBox( node, p ) )
+      continue;
+
+    if( node.isLeaf() )
+    {
+      for( uint32_t i = node.first; i < node.first + node.count; ++i )
+      {
+        const int32_t* tri = m_tri_indices + 3 * size_t( prims[i] );
+        intersectTriangle( reinterpret_cast<const float*>( m_positions + tri[0] * m_vertex_stride ),
+                           reinterpret_cast<const float*>( m_positions + tri[1] * m_vertex_stride ),
+                           reinterpret_cast<const float*>( m_positions + tri[2] * m_vertex_stride ),
+                           static_cast<int32_t>( prims[i] ), p );
+      }
+      continue;
+    }
+
+    // Visit the child closer to the packet's origin first
+    const BvhNode& left  = nodes[node.first];
+    const BvhNode& right = nodes[node.first + 1];
+    float order = 0.0f;
+    for( int k = 0; k < 3; ++k )
+      order += ( right.bbox_min[k] + right.bbox_max[k] - left.bbox_min[k] - left.bbox_max[k] ) * p.dir_sum[k];
+    const uint32_t first = order >= 0.0f ? node.first : node.first + 1;
+    stack[sp++] = node.first + node.first + 1 - first;
+    stack[sp++] = first;
+  }
+
+  float t[4], beta[4], gamma[4];
+  store( t,     p.tmax );
+  store( beta,  p.beta );
+  store( gamma, p.gamma );
+  for( size_t i = 0; i < count; ++i )
+  {
+    HostHit& hit   = hits[i];
+    hit.prim_index = p.prim[i];
+    hit.t          = t[i];
+    hit.beta       = beta[i];
+    hit.gamma      = gamma[i];
+    hit.geometric_normal[0] = hit.geometric_normal[1] = hit.geometric_normal[2] = 0.0f;
+    if( hit.prim_index >= 0 )
+    {
+      const int32_t* tri = m_tri_indices + 3 * size_t( hit.prim_index );
+      const float*   p0  = reinterpret_cast<const float*>( m_positions + tri[0] * m_vertex_stride );
+      const float*   p1  = reinterpret_cast<const float*>( m_positions + tri[1] * m_vertex_stride );
+      const float*   p2  = reinterpret_cast<const float*>( m_positions + tri[2] * m_vertex_stride );
+      const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+      const float e1[3] = { p0[0] - p2[0], p0[1] - p2[1], p0[2] - p2[2] };
+      cross( e1, e0, hit.geometric_normal );
+    }
+  }
+}
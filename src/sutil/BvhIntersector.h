@@ -0,0 +1,90 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <sutilapi.h>
+#include "Bvh.h"
+#include "Mesh.h"
+
+#include <cstddef>
+#include <stdint.h>
+
+
+//------------------------------------------------------------------------------
+//
+// Host-side closest hit ray casting against a Bvh, four rays at a time
+//
+//------------------------------------------------------------------------------
+
+struct HostRay
+{
+  float               origin[3];
+  float               tmin;
+  float               direction[3];
+  float               tmax;
+};
+
+
+// The attributes intersection_triangle_indexed.cu and triangle_mesh.cu get
+// from optix::intersect_triangle for the closest hit.
+struct HostHit
+{
+  float               t;
+  float               beta;                 // Barycentric coordinate of the second vertex
+  float               gamma;                // Barycentric coordinate of the third vertex
+  float               geometric_normal[3];  // cross( p0 - p2, p1 - p0 ), not normalized
+  int32_t             prim_index;           // -1 if the ray missed
+};
+
+
+class BvhIntersector
+{
+public:
+  // The positions and indices are the ones the Bvh was built from and must
+  // stay valid while the intersector is used.
+  SUTILAPI BvhIntersector( const Bvh& bvh, const float* positions, size_t vertex_stride, const int32_t* tri_indices );
+  SUTILAPI BvhIntersector( const Bvh& bvh, const Mesh& mesh );
+
+  // Finds the closest hit in ( tmin, tmax ) for each ray.  Groups of four
+  // consecutive rays are traced together as a packet with SSE, so coherent
+  // rays should be adjacent.  Packets are distributed over all cores.
+  SUTILAPI void intersect( const HostRay* rays, HostHit* hits, size_t count ) const;
+
+  // Finds the closest hit of a single ray on the calling thread, for callers
+  // which distribute their own work over the cores.
+  SUTILAPI void intersect( const HostRay& ray, HostHit& hit ) const;
+
+private:
+  void intersectPacket( const HostRay* rays, HostHit* hits, size_t count, uint32_t* stack ) const;
+
+  const Bvh&          m_bvh;
+  const char*         m_positions;
+  size_t              m_vertex_stride;
+  const int32_t*      m_tri_indices;
+  uint32_t            m_stack_size;
+};
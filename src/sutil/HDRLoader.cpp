@@ -27,13 +27,24 @@
  */
 
 #include "HDRLoader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
 
 #include <math.h>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <cstdlib>
 
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  include <emmintrin.h>
+#  define HDR_LOADER_SSE 1
+#endif
+
 //-----------------------------------------------------------------------------
 //  
 //  HDRLoader class definition
@@ -67,21 +78,75 @@ namespace {
     unsigned char v[4];
   };
 
+  const int HDR_EXPON_BIAS = 128;
+
+  // Scanlines outside this width range are never run-length encoded
+  const size_t MinLen = 8, MaxLen = 0x7fff;
+
   inline void RGBEtoFloats(const RGBe &RV, float *FV, float inv_img_exposure)
   {
     if(RV.e == 0)
       FV[0] = FV[1] = FV[2] = 0.0f;
     else {
-      const int HDR_EXPON_BIAS = 128;
       float s = (float)ldexp(1.0, (int(RV.e)-(HDR_EXPON_BIAS+8)));
       s *= inv_img_exposure;
       FV[0] = (RV.r + 0.5f)*s;
       FV[1] = (RV.g + 0.5f)*s;
       FV[2] = (RV.b + 0.5f)*s;
     }
+    FV[3] = 1.0f;
+  }
+
+
+  // The scale factor of RGBEtoFloats for each of the 256 exponents, computed
+  // the same way so that the table lookup gives bit-identical results.
+  void makeExponentTable(float *table, float inv_img_exposure)
+  {
+    table[0] = 0.0f;
+    for(int e=1; e<256; e++) {
+      float s = (float)ldexp(1.0, (e-(HDR_EXPON_BIAS+8)));
+      table[e] = s * inv_img_exposure;
+    }
+  }
+
+
+  // Converts count pixels with an exponent table.  The SSE path widens four
+  // pixels at a time from bytes to floats and writes one float4 per pixel.
+  void RGBEtoFloats(const RGBe *RV, float *FV, size_t count, const float *table)
+  {
+    size_t i = 0;
+#if defined( HDR_LOADER_SSE )
+    const __m128i zero = _mm_setzero_si128();
+    const __m128  half = _mm_set1_ps(0.5f);
+    const __m128  rgb  = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    const __m128  one  = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+    for( ; i+4 <= count; i += 4) {
+      const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(RV + i));
+      const __m128i lo    = _mm_unpacklo_epi8(bytes, zero);
+      const __m128i hi    = _mm_unpackhi_epi8(bytes, zero);
+      const __m128i pixels[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                                  _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+      for(int k=0; k<4; k++) {
+        __m128 f = _mm_add_ps(_mm_cvtepi32_ps(pixels[k]), half);
+        f = _mm_mul_ps(f, _mm_set1_ps(table[RV[i+k].e]));
+        _mm_storeu_ps(FV + (i+k)*4, _mm_or_ps(_mm_and_ps(f, rgb), one));
+      }
+    }
+#endif
+    for( ; i<count; i++) {
+      const float s = table[RV[i].e];
+      FV[i*4+0] = (RV[i].r + 0.5f)*s;
+      FV[i*4+1] = (RV[i].g + 0.5f)*s;
+      FV[i*4+2] = (RV[i].b + 0.5f)*s;
+      FV[i*4+3] = 1.0f;
+    }
   }
 
 
+  //---------------------------------------------------------------------------
+  // Stream reader
+  //---------------------------------------------------------------------------
+
   void ReadScanlineNoRLE(std::ifstream &inf, RGBe *RGBEline, const size_t wid)
   {
     inf.read(reinterpret_cast<char *>(RGBEline), wid * sizeof(RGBe));
@@ -90,7 +155,6 @@ namespace {
 
   void ReadScanline(std::ifstream &inf, RGBe *RGBEline, const size_t wid)
   {
-    const size_t MinLen = 8, MaxLen = 0x7fff;
     if(wid<MinLen || wid>MaxLen) return ReadScanlineNoRLE(inf, RGBEline, wid);
     char c0, c1, c2, c3;
     inf.get(c0);
@@ -106,7 +170,7 @@ namespace {
       return ReadScanlineNoRLE(inf, RGBEline, wid); // Found an old-format scanline
     }
 
-    if(size_t(size_t(c2)<<8 | size_t(c3)) != wid) throw HDRError("Scanline width inconsistent");
+    if(size_t(size_t((unsigned char)c2)<<8 | size_t((unsigned char)c3)) != wid) throw HDRError("Scanline width inconsistent");
 
     // This scanline is RLE.
     for(unsigned int ch=0; ch<4; ch++) {
@@ -119,9 +183,11 @@ namespace {
           inf.get(pix);
           if(inf.eof()) throw HDRError("Premature file end in ReadScanline 3");
           code = code & 0x7f;
+          if(x + code > wid) throw HDRError("Scanline overrun");
           while(code--)
             RGBEline[x++].v[ch] = pix;
         } else { // Arbitrary span
+          if(code == 0 || x + code > wid) throw HDRError("Scanline overrun");
           while(code--) {
             inf.get(reinterpret_cast<char &>(RGBEline[x++].v[ch]));
             if(inf.eof()) throw HDRError("Premature file end in ReadScanline 4");
@@ -130,67 +196,276 @@ namespace {
       }
     }
   }
+
+
+  //---------------------------------------------------------------------------
+  // Memory reader
+  //---------------------------------------------------------------------------
+
+  // std::getline() on a memory range.  Returns false at the end of the range.
+  bool readLine(const char *data, size_t size, size_t &pos, std::string &s)
+  {
+    if(pos >= size) {
+      s.clear();
+      return false;
+    }
+    const char *begin = data + pos;
+    const char *end   = static_cast<const char *>(memchr(begin, '\n', size - pos));
+    if(!end) end = data + size;
+    s.assign(begin, end);
+    pos = std::min(size, size_t(end - data) + 1);
+    return true;
+  }
+
+  // HDRLoader::getLine() on a memory range: skips comments and blank lines but
+  // returns empty lines.
+  void getHeaderLine(const char *data, size_t size, size_t &pos, std::string &s)
+  {
+    for (;;) {
+      if ( !readLine( data, size, pos, s ) )
+        return;
+      if(s.empty()) return;
+      std::string::size_type index = s.find_first_not_of( "\n\r\t " );
+      if ( index != std::string::npos && s[index] != '#' )
+        break;
+    }
+  }
+
+  // True if the scanline starting at pos is in the new run-length format
+  inline bool isRLEScanline(const unsigned char *data, size_t size, size_t pos, const size_t wid)
+  {
+    return wid>=MinLen && wid<=MaxLen && pos+4 <= size &&
+           data[pos] == 2 && data[pos+1] == 2 && !(data[pos+2]&0x80);
+  }
+
+  // Returns the file offset just past the scanline starting at pos, walking
+  // the run-length codes without decoding them.
+  size_t skipScanline(const unsigned char *data, size_t size, size_t pos, const size_t wid)
+  {
+    if(!isRLEScanline(data, size, pos, wid)) {
+      const size_t end = pos + wid * sizeof(RGBe);
+      if(end > size) throw HDRError("Premature file end in ReadScanlineNoRLE");
+      return end; // Found an old-format scanline
+    }
+
+    if((size_t(data[pos+2])<<8 | size_t(data[pos+3])) != wid) throw HDRError("Scanline width inconsistent");
+    pos += 4;
+
+    for(unsigned int ch=0; ch<4; ch++) {
+      for(size_t x=0; x<wid; ) {
+        if(pos >= size) throw HDRError("Premature file end in ReadScanline 2");
+        const unsigned char code = data[pos++];
+        const size_t count = (code > 0x80) ? code & 0x7f : code;
+        if(count == 0 || x + count > wid) throw HDRError("Scanline overrun");
+        pos += (code > 0x80) ? 1 : count;
+        x   += count;
+      }
+    }
+    if(pos > size) throw HDRError("Premature file end in ReadScanline 4");
+    return pos;
+  }
+
+  // Decodes the scanline data[begin, end) located by skipScanline().
+  void decodeScanline(const unsigned char *data, size_t begin, size_t end, RGBe *RGBEline, const size_t wid)
+  {
+    if(!isRLEScanline(data, end, begin, wid)) {
+      memcpy(RGBEline, data + begin, wid * sizeof(RGBe));
+      return;
+    }
+
+    const unsigned char *p = data + begin + 4;
+    for(unsigned int ch=0; ch<4; ch++) {
+      for(size_t x=0; x<wid; ) {
+        unsigned char code = *p++;
+        if(code > 0x80) { // RLE span
+          const unsigned char pix = *p++;
+          code = code & 0x7f;
+          while(code--)
+            RGBEline[x++].v[ch] = pix;
+        } else { // Arbitrary span
+          while(code--)
+            RGBEline[x++].v[ch] = *p++;
+        }
+      }
+    }
+  }
 };
 
-HDRLoader::HDRLoader( const std::string& filename )
-: m_nx( 0u ), m_ny( 0u ), m_raster( 0 )
+HDRLoader::HDRLoader( const std::string& filename, bool use_stream_reader, unsigned int max_width )
+: m_nx( 0u ), m_ny( 0u ), m_source_nx( 0u ), m_source_ny( 0u ), m_raster( 0 )
 {
   if ( filename.empty() ) return;
 
-  // Open file
   try {
-    std::ifstream inf(filename.c_str(), std::ios::binary);
+    if ( use_stream_reader )
+      readStream( filename );
+    else
+      readMapped( filename, max_width );
+  } catch ( const HDRError& err  ) {
+    std::cerr << "HDRLoader( '" << filename << "' ) failed to load file: " << err.Er << '\n';
+    delete [] m_raster;
+    m_raster = 0;
+  }
+}
+
 
-    if(!inf.is_open()) throw HDRError("Couldn't open file " + filename);
+void HDRLoader::readStream( const std::string& filename )
+{
+  // Open file
+  std::ifstream inf(filename.c_str(), std::ios::binary);
 
-    std::string magic, comment;
-    float exposure = 1.0f;
+  if(!inf.is_open()) throw HDRError("Couldn't open file " + filename);
 
-    std::getline(inf, magic);
-    if(magic != "#?RADIANCE") throw HDRError("File isn't Radiance.");
-    for (;;) {
-      getLine(inf, comment);
+  std::string magic, comment;
+  float exposure = 1.0f;
 
-      // VS2010 doesn't let you look at the 0th element of a 0 length string, so this was tripping
-      // debug asserts
-      if (comment.empty()) break;
-      if(comment[0] == '#') continue;
+  std::getline(inf, magic);
+  if(magic != "#?RADIANCE") throw HDRError("File isn't Radiance.");
+  for (;;) {
+    getLine(inf, comment);
 
-      if(comment.find("FORMAT") != std::string::npos) {
-        if(comment != "FORMAT=32-bit_rle_rgbe") throw HDRError("Can only handle RGBe, not XYZe.");
-        continue;
-      }
+    // VS2010 doesn't let you look at the 0th element of a 0 length string, so this was tripping
+    // debug asserts
+    if (comment.empty()) break;
+    if(comment[0] == '#') continue;
 
-      size_t ofs = comment.find("EXPOSURE=");
-      if(ofs != std::string::npos) {
-        exposure = (float)atof(comment.c_str()+ofs+9);
-      }
+    if(comment.find("FORMAT") != std::string::npos) {
+      if(comment != "FORMAT=32-bit_rle_rgbe") throw HDRError("Can only handle RGBe, not XYZe.");
+      continue;
+    }
+
+    size_t ofs = comment.find("EXPOSURE=");
+    if(ofs != std::string::npos) {
+      exposure = (float)atof(comment.c_str()+ofs+9);
     }
-    
-    std::string major, minor;
-    inf >> minor >> m_ny >> major >> m_nx;
-    if(minor != "-Y" || major != "+X") throw "Can only handle -Y +X ordering";
-    if(m_nx <= 0 || m_ny <= 0) throw "Invalid image dimensions";
-    getLine(inf, comment); // Read the last newline of the header
+  }
+  
+  std::string major, minor;
+  inf >> minor >> m_ny >> major >> m_nx;
+  if(minor != "-Y" || major != "+X") throw HDRError("Can only handle -Y +X ordering");
+  if(m_nx <= 0 || m_ny <= 0) throw HDRError("Invalid image dimensions");
+  m_source_nx = m_nx;
+  m_source_ny = m_ny;
+  getLine(inf, comment); // Read the last newline of the header
 
-    RGBe *RGBERaster = new RGBe[m_nx * m_ny];
+  RGBe *RGBERaster = new RGBe[m_nx * m_ny];
 
+  try {
     for(unsigned int y=0; y<m_ny; y++) {
       ReadScanline(inf, RGBERaster + m_nx*y, m_nx);
     }
+  } catch ( ... ) {
+    delete[] RGBERaster;
+    throw;
+  }
+
+  m_raster = new float[m_nx * m_ny * 4];
+
+  float inv_img_exposure = 1.0f / exposure;
+  for(unsigned int i=0; i<m_nx*m_ny; i++) {
+    RGBEtoFloats(RGBERaster[i], m_raster + i*4, inv_img_exposure);
+  }
+  delete[] RGBERaster;
+}
 
-    m_raster = new float[m_nx * m_ny * 4];
 
-    float inv_img_exposure = 1.0f / exposure;
-    for(unsigned int i=0; i<m_nx*m_ny; i++) {
-      RGBEtoFloats(RGBERaster[i], m_raster + i*4, inv_img_exposure);
+void HDRLoader::readMapped( const std::string& filename, unsigned int max_width )
+{
+  MappedFile file;
+  if(!file.open(filename)) throw HDRError("Couldn't open file " + filename);
+
+  const char  *data = file.data();
+  const size_t size = file.size();
+  size_t       pos  = 0;
+
+  std::string magic, comment;
+  float exposure = 1.0f;
+
+  readLine(data, size, pos, magic);
+  if(magic != "#?RADIANCE") throw HDRError("File isn't Radiance.");
+  for (;;) {
+    getHeaderLine(data, size, pos, comment);
+
+    if (comment.empty()) break;
+    if(comment[0] == '#') continue;
+
+    if(comment.find("FORMAT") != std::string::npos) {
+      if(comment != "FORMAT=32-bit_rle_rgbe") throw HDRError("Can only handle RGBe, not XYZe.");
+      continue;
     }
-    delete[] RGBERaster;
-  } catch ( const HDRError& err  ) {
-    std::cerr << "HDRLoader( '" << filename << "' ) failed to load file: " << err.Er << '\n';
-    delete [] m_raster;
-    m_raster = 0;
+
+    size_t ofs = comment.find("EXPOSURE=");
+    if(ofs != std::string::npos) {
+      exposure = (float)atof(comment.c_str()+ofs+9);
+    }
+  }
+
+  std::string resolution, major, minor;
+  getHeaderLine(data, size, pos, resolution);
+  std::istringstream iss(resolution);
+  iss >> minor >> m_ny >> major >> m_nx;
+  if(minor != "-Y" || major != "+X") throw HDRError("Can only handle -Y +X ordering");
+  if(!iss || m_nx <= 0 || m_ny <= 0) throw HDRError("Invalid image dimensions");
+  m_source_nx = m_nx;
+  m_source_ny = m_ny;
+
+  // The scanlines have no length prefix, so their offsets are found in one
+  // sequential pass before decoding them in parallel.
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+  std::vector<size_t> offsets(m_ny + 1);
+  offsets[0] = pos;
+  for(unsigned int y=0; y<m_ny; y++) {
+    offsets[y+1] = skipScanline(bytes, size, offsets[y], m_nx);
   }
+
+  float table[256];
+  makeExponentTable(table, 1.0f / exposure);
+
+  const size_t nx = m_nx;
+  if(max_width && m_nx > max_width) {
+    // Box filter n texels of every n-th scanline, centered in its block of
+    // scanlines.  The last block in each direction may be partial.
+    const size_t n = (nx + max_width - 1) / max_width;
+    m_nx = static_cast<unsigned int>((nx + n - 1) / n);
+    const size_t ny = m_ny;
+    m_ny = static_cast<unsigned int>((ny + n - 1) / n);
+    m_raster = new float[size_t(m_nx) * m_ny * 4];
+
+    sutil::parallelFor(m_ny, 16, [&](size_t begin, size_t end, size_t)
+    {
+      std::vector<RGBe>  line(nx);
+      std::vector<float> texels(nx * 4);
+      for(size_t j=begin; j<end; j++) {
+        const size_t y = std::min(j*n + n/2, ny - 1);
+        decodeScanline(bytes, offsets[y], offsets[y+1], &line[0], nx);
+        RGBEtoFloats(&line[0], &texels[0], nx, table);
+
+        float *dst = m_raster + j*m_nx*4;
+        for(size_t i=0; i<m_nx; i++) {
+          const size_t x0 = i*n, x1 = std::min(x0 + n, nx);
+          float sum[3] = { 0.0f, 0.0f, 0.0f };
+          for(size_t x=x0; x<x1; x++)
+            for(int c=0; c<3; c++)
+              sum[c] += texels[x*4+c];
+          for(int c=0; c<3; c++)
+            dst[i*4+c] = sum[c] / float(x1 - x0);
+          dst[i*4+3] = 1.0f;
+        }
+      }
+    });
+    return;
+  }
+
+  m_raster = new float[nx * m_ny * 4];
+
+  sutil::parallelFor(m_ny, 16, [&](size_t begin, size_t end, size_t)
+  {
+    std::vector<RGBe> line(nx);
+    for(size_t y=begin; y<end; y++) {
+      decodeScanline(bytes, offsets[y], offsets[y+1], &line[0], nx);
+      RGBEtoFloats(&line[0], m_raster + y*nx*4, nx, table);
+    }
+  });
 }
 
 
@@ -218,6 +493,18 @@ unsigned int HDRLoader::height()const
 }
 
 
+unsigned int HDRLoader::sourceWidth()const
+{
+  return m_source_nx;
+}
+
+
+unsigned int HDRLoader::sourceHeight()const
+{
+  return m_source_ny;
+}
+
+
 float* HDRLoader::raster()const
 {
   return m_raster;
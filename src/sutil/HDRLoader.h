@@ -53,22 +53,41 @@ SUTILAPI optix::TextureSampler loadHDRTexture( optix::Context context,
 //
 //-----------------------------------------------------------------------------
 
+// Loads a Radiance RGBE (.hdr) file into an RGBA float raster, top row first.
+// The file is memory mapped, the scanline offsets are found in one sequential
+// pass and the run-length decoding and float conversion of the scanlines are
+// then spread over all cores.  use_stream_reader selects the original
+// byte-by-byte std::ifstream reader instead, which is kept as a reference for
+// benchmarks; both produce identical rasters.
+//
+// A non-zero max_width loads a quick preview with the mapped reader: for images
+// wider than that only every n-th scanline is decoded, and n neighboring texels
+// of it are box filtered, with n chosen so that the raster fits into max_width.
+// sourceWidth() and sourceHeight() return the resolution stored in the file, so
+// width() < sourceWidth() tells whether the raster was downsampled.
 class HDRLoader
 {
 public:
-  SUTILAPI HDRLoader( const std::string& filename );
+  SUTILAPI HDRLoader( const std::string& filename, bool use_stream_reader=false, unsigned int max_width=0 );
   SUTILAPI ~HDRLoader();
 
   SUTILAPI bool           failed()const;
   SUTILAPI unsigned int   width()const;
   SUTILAPI unsigned int   height()const;
+  SUTILAPI unsigned int   sourceWidth()const;
+  SUTILAPI unsigned int   sourceHeight()const;
   SUTILAPI float*         raster()const;
 
 private:
   unsigned int   m_nx;
   unsigned int   m_ny;
+  unsigned int   m_source_nx;
+  unsigned int   m_source_ny;
   float*         m_raster;
 
+  void readStream( const std::string& filename );
+  void readMapped( const std::string& filename, unsigned int max_width );
+
   static void getLine( std::ifstream& file_in, std::string& s );
 
 };
@@ -0,0 +1,203 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MappedFile.h"
+
+#if defined( _WIN32 )
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <algorithm>
+
+
+namespace
+{
+
+void fnv1a( uint64_t& hash, const char* data, size_t size )
+{
+  for( size_t i = 0; i < size; ++i )
+  {
+    hash ^= static_cast<unsigned char>( data[i] );
+    hash *= 1099511628211ull;
+  }
+}
+
+} // namespace
+
+
+MappedFile::MappedFile()
+  : m_data( 0 )
+  , m_size( 0 )
+#if defined( _WIN32 )
+  , m_file( 0 )
+  , m_mapping( 0 )
+#endif
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+
+bool MappedFile::open( const std::string& filename )
+{
+  close();
+
+#if defined( _WIN32 )
+  HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+  if( file == INVALID_HANDLE_VALUE )
+    return false;
+
+  LARGE_INTEGER size;
+  if( !GetFileSizeEx( file, &size ) || size.QuadPart == 0 )
+  {
+    CloseHandle( file );
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+  if( !mapping )
+  {
+    CloseHandle( file );
+    return false;
+  }
+
+  void* data = MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 );
+  if( !data )
+  {
+    CloseHandle( mapping );
+    CloseHandle( file );
+    return false;
+  }
+
+  m_file    = file;
+  m_mapping = mapping;
+  m_data    = static_cast<char*>( data );
+  m_size    = static_cast<size_t>( size.QuadPart );
+#else
+  const int fd = ::open( filename.c_str(), O_RDONLY );
+  if( fd < 0 )
+    return false;
+
+  struct stat st;
+  if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+  {
+    ::close( fd );
+    return false;
+  }
+
+  void* data = mmap( 0, static_cast<size_t>( st.st_size ), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+  ::close( fd ); // The mapping keeps its own reference to the file.
+  if( data == MAP_FAILED )
+    return false;
+
+  m_data = static_cast<char*>( data );
+  m_size = static_cast<size_t>( st.st_size );
+#endif
+
+  return true;
+}
+
+
+void MappedFile::close()
+{
+  if( !m_data )
+    return;
+
+#if defined( _WIN32 )
+  UnmapViewOfFile( m_data );
+  CloseHandle( static_cast<HANDLE>( m_mapping ) );
+  CloseHandle( static_cast<HANDLE>( m_file ) );
+  m_file    = 0;
+  m_mapping = 0;
+#else
+  munmap( m_data, m_size );
+#endif
+
+  m_data = 0;
+  m_size = 0;
+}
+
+
+bool MappedFile::stat( const std::string& filename, uint64_t& size, int64_t& mtime )
+{
+#if defined( _WIN32 )
+  struct _stat64 st;
+  if( _stat64( filename.c_str(), &st ) != 0 )
+    return false;
+#else
+  struct stat st;
+  if( ::stat( filename.c_str(), &st ) != 0 )
+    return false;
+#endif
+
+  size  = static_cast<uint64_t>( st.st_size );
+  mtime = static_cast<int64_t>( st.st_mtime );
+  return true;
+}
+
+
+bool MappedFile::hash( const std::string& filename, uint64_t& hash )
+{
+  MappedFile file;
+  if( !file.open( filename ) )
+    return false;
+
+  const size_t FULL_LIMIT = 16u << 20;
+  const size_t HEAD_TAIL  =  4u << 20;
+  const size_t BLOCK      =  4u << 10;
+  const size_t NUM_BLOCKS = 256;
+
+  hash = 14695981039346656037ull;
+  const size_t size = file.size();
+  if( size <= FULL_LIMIT )
+  {
+    fnv1a( hash, file.data(), size );
+  }
+  else
+  {
+    fnv1a( hash, file.data(), HEAD_TAIL );
+    const size_t stride = ( size - 2 * HEAD_TAIL ) / NUM_BLOCKS;
+    for( size_t i = 0; i < NUM_BLOCKS; ++i )
+      fnv1a( hash, file.data() + HEAD_TAIL + i * stride, std::min( BLOCK, stride ) );
+    fnv1a( hash, file.data() + size - HEAD_TAIL, HEAD_TAIL );
+  }
+  return true;
+}
@@ -0,0 +1,77 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+
+//------------------------------------------------------------------------------
+//
+// Whole-file, copy-on-write memory mapping.  Pages may be written through
+// data(), but changes are private to the process and never reach the file.
+//
+//------------------------------------------------------------------------------
+class MappedFile
+{
+public:
+  SUTILAPI MappedFile();
+  SUTILAPI ~MappedFile();
+
+  // Maps the given file.  Returns false if the file cannot be opened or is empty.
+  SUTILAPI bool open( const std::string& filename );
+  SUTILAPI void close();
+
+  bool         isOpen() const { return m_data != 0; }
+  char*        data()   const { return m_data; }
+  size_t       size()   const { return m_size; }
+
+  // Query size and modification time of a file without opening it.
+  // Returns false if the file does not exist.
+  SUTILAPI static bool stat( const std::string& filename, uint64_t& size, int64_t& mtime );
+
+  // 64-bit FNV-1a content hash of a file, used to validate caches built from
+  // it.  Files up to 16 MB are hashed completely, larger ones through their
+  // first and last 4 MB plus 256 evenly spaced 4 KB blocks.
+  SUTILAPI static bool hash( const std::string& filename, uint64_t& hash );
+
+private:
+  MappedFile( const MappedFile& );             // Not copyable
+  MappedFile& operator=( const MappedFile& );
+
+  char*        m_data;
+  size_t       m_size;
+#if defined( _WIN32 )
+  void*        m_file;
+  void*        m_mapping;
+#endif
+};
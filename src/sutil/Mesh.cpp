@@ -31,8 +31,10 @@
 #include <optixu/optixu_math_stream_namespace.h>
 
 #include "Mesh.h" 
+#include "MeshCache.h"
+#include "ObjParser.h"
+#include "PlyParser.h"
 #include "rply-1.01/rply.h"
-#include "tinyobjloader/tiny_obj_loader.h"
 #include <algorithm>
 #include <iostream>
 #include <locale>
@@ -40,6 +42,15 @@
 #include <stdint.h>
 #include <vector>
 
+#if defined( _WIN32 )
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#  include <psapi.h>
+#else
+#  include <sys/resource.h>
+#endif
+
 //------------------------------------------------------------------------------
 //
 // Helpers 
@@ -107,6 +118,27 @@ bool checkValid( const Mesh& mesh )
 }
 
 
+// Peak resident memory of the process in bytes, 0 if unknown
+uint64_t peakMemoryUsage()
+{
+#if defined( _WIN32 )
+  PROCESS_MEMORY_COUNTERS counters;
+  if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+    return 0;
+  return counters.PeakWorkingSetSize;
+#else
+  struct rusage usage;
+  if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+    return 0;
+#  if defined( __APPLE__ )
+  return static_cast<uint64_t>( usage.ru_maxrss );         // bytes
+#  else
+  return static_cast<uint64_t>( usage.ru_maxrss ) * 1024u; // kilobytes
+#  endif
+#endif
+}
+
+
 std::string directoryOfFilePath( const std::string& filepath )                 
 {                                                                              
   size_t slash_pos, backslash_pos;                                             
@@ -293,10 +325,12 @@ void applyLoadXForm( Mesh& mesh, const float* load_xform )
 class MeshLoader::Impl
 {
 public:
-  Impl( const std::string& filename );
+  Impl( const std::string& filename, bool use_cache );
   
   void scanMesh( Mesh& mesh );
   void loadMesh( Mesh& mesh, const float* load_xform );
+  void loadMesh( Mesh& mesh, MeshSink& sink, const float* load_xform );
+  bool mapMesh( Mesh& mesh, const float* load_xform );
 
   void scanMeshOBJ( Mesh& mesh );
   void scanMeshPLY( Mesh& mesh );
@@ -312,14 +346,17 @@ private:
   };
   std::string                         m_filename;
   FileType                            m_filetype;
+
+  bool                                m_use_cache;
+  MeshCache                           m_cache;
   
-  std::vector<tinyobj::shape_t>       m_shapes;
-  std::vector<tinyobj::material_t>    m_materials;
+  ObjParser                           m_obj;
 };
 
 
-MeshLoader::Impl::Impl( const std::string& filename )
+MeshLoader::Impl::Impl( const std::string& filename, bool use_cache )
   : m_filename( filename )
+  , m_use_cache( use_cache )
 {
    if( fileIsOBJ( m_filename ) )
      m_filetype = OBJ;
@@ -334,6 +371,12 @@ void MeshLoader::Impl::scanMesh( Mesh& mesh )
 {
   clearMesh( mesh );
 
+  if( m_use_cache && m_filetype != UNKNOWN && m_cache.open( m_filename ) )
+  {
+    m_cache.scan( mesh );
+    return;
+  }
+
   if( m_filetype == OBJ )
     scanMeshOBJ( mesh );
   else if( m_filetype == PLY )
@@ -356,14 +399,52 @@ void MeshLoader::Impl::loadMesh( Mesh& mesh, const float* load_xform )
   mesh.bbox_min[0] = mesh.bbox_min[1] = mesh.bbox_min[2] =  1e16f;
   mesh.bbox_max[0] = mesh.bbox_max[1] = mesh.bbox_max[2] = -1e16f;
 
-  if( m_filetype == OBJ )
-    loadMeshOBJ( mesh );
-  else if( m_filetype == PLY )
-    loadMeshPLY( mesh );
+  if( m_cache.isOpen() )
+  {
+    m_cache.load( mesh );
+  }
   else
-    throw std::runtime_error( "MeshLoader: Unsupported file type for '" + m_filename + "'" );
+  {
+    if( m_filetype == OBJ )
+      loadMeshOBJ( mesh );
+    else if( m_filetype == PLY )
+      loadMeshPLY( mesh );
+    else
+      throw std::runtime_error( "MeshLoader: Unsupported file type for '" + m_filename + "'" );
 
+    if( m_use_cache )
+      MeshCache::write( m_filename,
+                        m_filetype == OBJ ? m_obj.materialLibraries() : std::vector<std::string>(),
+                        mesh );
+
+    // The parse results are not needed any more; a later loadMesh parses again
+    m_obj.clear();
+  }
+
+  applyLoadXForm( mesh, load_xform );
+}
+
+
+void MeshLoader::Impl::loadMesh( Mesh& mesh, MeshSink& sink, const float* load_xform )
+{
+  scanMesh( mesh );
+  sink.map( mesh );
+  loadMesh( mesh, load_xform );
+  sink.unmap( mesh );
+}
+
+
+bool MeshLoader::Impl::mapMesh( Mesh& mesh, const float* load_xform )
+{
+  if( !m_cache.isOpen() && ( m_filetype == UNKNOWN || !m_cache.open( m_filename ) ) )
+    return false;
+
+  clearMesh( mesh );
+  m_cache.map( mesh );
+
+  // The mapping is copy-on-write, so transforming in place leaves the cache file untouched.
   applyLoadXForm( mesh, load_xform );
+  return true;
 }
 
 
@@ -392,28 +473,34 @@ void MeshLoader::Impl::scanMeshPLY( Mesh& mesh )
 
 void MeshLoader::Impl::loadMeshPLY( Mesh& mesh )
 {
-  p_ply ply = ply_open( m_filename.c_str(), 0 );                       
+  // Plain binary layouts are copied straight from the mapped file, anything
+  // else goes through the rply callbacks
+  PlyParser fast_parser;
+  if( !fast_parser.open( m_filename ) || !fast_parser.load( mesh ) )
+  {
+    p_ply ply = ply_open( m_filename.c_str(), 0 );                       
 
-  if( !ply )
-    throw std::runtime_error( "MeshLoader: Unable to open '" + m_filename + "'" );
+    if( !ply )
+      throw std::runtime_error( "MeshLoader: Unable to open '" + m_filename + "'" );
 
-  if( !ply_read_header( ply ) )
-    throw std::runtime_error( "MeshLoader: Unable to read PLY header '" + m_filename + "'" );
-  
-  PlyData ply_data = {0};
-  ply_data.mesh = &mesh;
-
-  ply_set_read_cb( ply, "vertex", "x",  plyLoadVertex, &ply_data, 0 );
-  ply_set_read_cb( ply, "vertex", "y",  plyLoadVertex, &ply_data, 1 );
-  ply_set_read_cb( ply, "vertex", "z",  plyLoadVertex, &ply_data, 2 );
-  ply_set_read_cb( ply, "vertex", "nx", plyLoadVertex, &ply_data, 3 );
-  ply_set_read_cb( ply, "vertex", "ny", plyLoadVertex, &ply_data, 4 );
-  ply_set_read_cb( ply, "vertex", "nz", plyLoadVertex, &ply_data, 5 );
-  ply_set_read_cb( ply, "face", "vertex_indices", plyLoadFace, &ply_data, 0);
-
-  if( !ply_read( ply ) ) 
-    throw std::runtime_error( "MeshLoader: Error parsing ply file (" + m_filename + ")" );
-  ply_close( ply );
+    if( !ply_read_header( ply ) )
+      throw std::runtime_error( "MeshLoader: Unable to read PLY header '" + m_filename + "'" );
+    
+    PlyData ply_data = {0};
+    ply_data.mesh = &mesh;
+
+    ply_set_read_cb( ply, "vertex", "x",  plyLoadVertex, &ply_data, 0 );
+    ply_set_read_cb( ply, "vertex", "y",  plyLoadVertex, &ply_data, 1 );
+    ply_set_read_cb( ply, "vertex", "z",  plyLoadVertex, &ply_data, 2 );
+    ply_set_read_cb( ply, "vertex", "nx", plyLoadVertex, &ply_data, 3 );
+    ply_set_read_cb( ply, "vertex", "ny", plyLoadVertex, &ply_data, 4 );
+    ply_set_read_cb( ply, "vertex", "nz", plyLoadVertex, &ply_data, 5 );
+    ply_set_read_cb( ply, "face", "vertex_indices", plyLoadFace, &ply_data, 0);
+
+    if( !ply_read( ply ) ) 
+      throw std::runtime_error( "MeshLoader: Error parsing ply file (" + m_filename + ")" );
+    ply_close( ply );
+  }
 
 
   // Fill in default white matte material
@@ -434,52 +521,19 @@ void MeshLoader::Impl::loadMeshPLY( Mesh& mesh )
 
 void MeshLoader::Impl::scanMeshOBJ( Mesh& mesh )
 {
-  if( m_shapes.empty() )
-  {
-    std::string err;
-    bool ret = tinyobj::LoadObj( 
-        m_shapes,
-        m_materials,
-        err, 
-        m_filename.c_str(),
-        directoryOfFilePath( m_filename ).c_str()
-        );
-
-    if( !err.empty() )
-      std::cerr << err << std::endl;
-
-    if( !ret )
-      throw std::runtime_error( "MeshLoader: " + err );
-  }
+  if( !m_obj.isParsed() )
+    m_obj.parse( m_filename );
 
-  //
-  // Iterate over all shapes and sum up number of vertices and triangles
-  //
-  uint64_t num_groups_with_normals   = 0;
-  uint64_t num_groups_with_texcoords = 0;
-  for( std::vector<tinyobj::shape_t>::const_iterator it = m_shapes.begin();
-       it < m_shapes.end();
-       ++it )
-  {
-    const tinyobj::shape_t & shape = *it;
-
-    mesh.num_triangles += static_cast<int32_t>(shape.mesh.indices.size()) / 3;
-    mesh.num_vertices  += static_cast<int32_t>(shape.mesh.positions.size()) / 3;
-
-    if( !shape.mesh.normals.empty() )
-      ++num_groups_with_normals; 
-
-    if( !shape.mesh.texcoords.empty() )
-      ++num_groups_with_texcoords; 
-  }
+  mesh.num_triangles = m_obj.numTriangles();
+  mesh.num_vertices  = m_obj.numVertices();
 
   //
-  // We ignore normals and texcoords unless they are present for all shapes
+  // We ignore normals and texcoords unless they are present for all groups
   //
 
-  if( num_groups_with_normals != 0 )
+  if( m_obj.numGroupsWithNormals() != 0 )
   {
-    if( num_groups_with_normals != m_shapes.size() )
+    if( !m_obj.hasNormals() )
       std::cerr << "MeshLoader - WARNING: mesh '" << m_filename 
                 << "' has normals for some groups but not all.  "
                 << "Ignoring all normals." << std::endl;
@@ -488,9 +542,9 @@ void MeshLoader::Impl::scanMeshOBJ( Mesh& mesh )
 
   }
   
-  if( num_groups_with_texcoords != 0 )
+  if( m_obj.numGroupsWithTexcoords() != 0 )
   {
-    if( num_groups_with_texcoords != m_shapes.size() )
+    if( !m_obj.hasTexcoords() )
       std::cerr << "MeshLoader - WARNING: mesh '" << m_filename 
                 << "' has texcoords for some groups but not all.  "
                 << "Ignoring all texcoords." << std::endl;
@@ -498,86 +552,44 @@ void MeshLoader::Impl::scanMeshOBJ( Mesh& mesh )
       mesh.has_texcoords = true;
   }
 
-  mesh.num_materials = (int32_t) m_materials.size();
+  mesh.num_materials = (int32_t) m_obj.materials().size();
 }
 
 
 void MeshLoader::Impl::loadMeshOBJ( Mesh& mesh )
 {
-  uint32_t vrt_offset = 0;
-  uint32_t tri_offset = 0;
-  for( std::vector<tinyobj::shape_t>::const_iterator it = m_shapes.begin();
-       it < m_shapes.end();
-       ++it )
-  {
-    const tinyobj::shape_t & shape = *it;
-    for( uint64_t i = 0; i < shape.mesh.positions.size() / 3; ++i )
-    {
-      const float x = shape.mesh.positions[i*3+0];
-      const float y = shape.mesh.positions[i*3+1];
-      const float z = shape.mesh.positions[i*3+2];
-
-      mesh.bbox_min[0] = std::min<float>( mesh.bbox_min[0], x );
-      mesh.bbox_min[1] = std::min<float>( mesh.bbox_min[1], y );
-      mesh.bbox_min[2] = std::min<float>( mesh.bbox_min[2], z );
+  if( !m_obj.isParsed() )
+    m_obj.parse( m_filename );
 
-      mesh.bbox_max[0] = std::max<float>( mesh.bbox_max[0], x );
-      mesh.bbox_max[1] = std::max<float>( mesh.bbox_max[1], y );
-      mesh.bbox_max[2] = std::max<float>( mesh.bbox_max[2], z );
+  m_obj.load( mesh );
 
-      mesh.positions[ vrt_offset*3 + i*3+0 ] = x; 
-      mesh.positions[ vrt_offset*3 + i*3+1 ] = y; 
-      mesh.positions[ vrt_offset*3 + i*3+2 ] = z; 
-    }
-
-    if( mesh.has_normals )
-      for( uint64_t i = 0; i < shape.mesh.normals.size(); ++i )
-        mesh.normals[ vrt_offset*3 + i ] = shape.mesh.normals[i];
-    
-    if( mesh.has_texcoords )
-      for( uint64_t i = 0; i < shape.mesh.texcoords.size(); ++i )
-        mesh.texcoords[ vrt_offset*2 + i ] = shape.mesh.texcoords[i];
-    
-    for( uint64_t i = 0; i < shape.mesh.indices.size() / 3; ++i )
-    {
-      mesh.tri_indices[ tri_offset*3 + i*3+0 ] = shape.mesh.indices[i*3+0] + vrt_offset;
-      mesh.tri_indices[ tri_offset*3 + i*3+1 ] = shape.mesh.indices[i*3+1] + vrt_offset;
-      mesh.tri_indices[ tri_offset*3 + i*3+2 ] = shape.mesh.indices[i*3+2] + vrt_offset;
-      mesh.mat_indices[ tri_offset + i ] = shape.mesh.material_ids[i] >= 0 ? 
-                                           shape.mesh.material_ids[i]      :
-                                           0; 
-    }
-
-    vrt_offset += static_cast<uint32_t>(shape.mesh.positions.size()) / 3;
-    tri_offset += static_cast<uint32_t>(shape.mesh.indices.size()) / 3;
-  }
-
-  for( uint64_t i = 0; i < m_materials.size(); ++i )
+  const std::vector<tinyobj::material_t>& materials = m_obj.materials();
+  for( uint64_t i = 0; i < materials.size(); ++i )
   {
     MaterialParams mat_params;
 
-    mat_params.name   = m_materials[i].name;
+    mat_params.name   = materials[i].name;
 
-    mat_params.Kd_map = m_materials[i].diffuse_texname.empty() ? "" :
-                        directoryOfFilePath( m_filename ) + m_materials[i].diffuse_texname;
+    mat_params.Kd_map = materials[i].diffuse_texname.empty() ? "" :
+                        directoryOfFilePath( m_filename ) + materials[i].diffuse_texname;
 
-    mat_params.Kd[0]  = m_materials[i].diffuse[0];
-    mat_params.Kd[1]  = m_materials[i].diffuse[1];
-    mat_params.Kd[2]  = m_materials[i].diffuse[2];
+    mat_params.Kd[0]  = materials[i].diffuse[0];
+    mat_params.Kd[1]  = materials[i].diffuse[1];
+    mat_params.Kd[2]  = materials[i].diffuse[2];
     
-    mat_params.Ks[0]  = m_materials[i].specular[0];
-    mat_params.Ks[1]  = m_materials[i].specular[1];
-    mat_params.Ks[2]  = m_materials[i].specular[2];
+    mat_params.Ks[0]  = materials[i].specular[0];
+    mat_params.Ks[1]  = materials[i].specular[1];
+    mat_params.Ks[2]  = materials[i].specular[2];
 
-    mat_params.Ka[0]  = m_materials[i].ambient[0];
-    mat_params.Ka[1]  = m_materials[i].ambient[1];
-    mat_params.Ka[2]  = m_materials[i].ambient[2];
+    mat_params.Ka[0]  = materials[i].ambient[0];
+    mat_params.Ka[1]  = materials[i].ambient[1];
+    mat_params.Ka[2]  = materials[i].ambient[2];
 
-    mat_params.Kr[0]  = m_materials[i].specular[0];
-    mat_params.Kr[1]  = m_materials[i].specular[1];
-    mat_params.Kr[2]  = m_materials[i].specular[2];
+    mat_params.Kr[0]  = materials[i].specular[0];
+    mat_params.Kr[1]  = materials[i].specular[1];
+    mat_params.Kr[2]  = materials[i].specular[2];
 
-    mat_params.exp    = m_materials[i].shininess;
+    mat_params.exp    = materials[i].shininess;
 
     mesh.mat_params[i] = mat_params;
   }
@@ -617,6 +629,8 @@ void printMeshInfo( const Mesh& mesh, std::ostream& out )
       << "\tbbox max     : ( " << mesh.bbox_max[0] << ", "
                                << mesh.bbox_max[1] << ", "
                                << mesh.bbox_max[2] << " )"
+                               << std::endl
+      << "\tpeak memory  : " << peakMemoryUsage() / ( 1024 * 1024 ) << " MB (host, process-wide)"
                                << std::endl;
   /*
   if( mesh.positions )
@@ -685,8 +699,8 @@ SUTILAPI void freeMesh( Mesh& mesh )
 //
 //------------------------------------------------------------------------------
 
-MeshLoader::MeshLoader( const std::string& filename )
-  : p_impl( new Impl( filename ) )
+MeshLoader::MeshLoader( const std::string& filename, bool use_cache )
+  : p_impl( new Impl( filename, use_cache ) )
 {
 }
 
@@ -708,6 +722,18 @@ void MeshLoader::loadMesh( Mesh& mesh, const float* load_xform )
   p_impl->loadMesh( mesh, load_xform );
 }
 
+
+void MeshLoader::loadMesh( Mesh& mesh, MeshSink& sink, const float* load_xform )
+{
+  p_impl->loadMesh( mesh, sink, load_xform );
+}
+
+
+bool MeshLoader::mapMesh( Mesh& mesh, const float* load_xform )
+{
+  return p_impl->mapMesh( mesh, load_xform );
+}
+
 //------------------------------------------------------------------------------
 //
 // Mesh Loader convenience  functions
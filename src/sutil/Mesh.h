@@ -101,19 +101,56 @@ SUTILAPI void printMaterialInfo( const MaterialParams& mat, std::ostream& out =
 SUTILAPI void printMeshInfo    ( const Mesh& mesh,          std::ostream& out = std::cout );
 
 
+//------------------------------------------------------------------------------
+//
+// Mesh Sink
+//
+//------------------------------------------------------------------------------
+// Destination memory for MeshLoader::loadMesh( Mesh&, MeshSink& ).  map() is
+// called once the counts in mesh are known and must point the mesh arrays,
+// including mat_params, at caller memory such as mapped buffers or an arena.
+// The loader writes straight into them and then calls unmap(), which hands the
+// completed mesh off and releases the arrays.
+class MeshSink
+{
+public:
+  virtual ~MeshSink() {}
+  virtual void map( Mesh& mesh ) = 0;
+  virtual void unmap( Mesh& mesh ) = 0;
+};
+
+
 //------------------------------------------------------------------------------
 //
 // Mesh Loader
 //
 //------------------------------------------------------------------------------
+// With use_cache set, the loader reads a valid binary cache next to the source
+// file (see MeshCache.h) instead of parsing the source, and writes one after
+// parsing.  It is off by default, so samples only write files next to their
+// data when asked to.
 class MeshLoader
 {
 public:
-  SUTILAPI MeshLoader( const std::string& filename );
+  SUTILAPI MeshLoader( const std::string& filename, bool use_cache=false );
   SUTILAPI ~MeshLoader();
   SUTILAPI void scanMesh( Mesh& mesh );
   SUTILAPI void loadMesh( Mesh& mesh, const float* load_xform=0 );
 
+  // Scans the mesh and loads it into the memory provided by sink instead of a
+  // host mesh that would be copied again.  The mesh cache and binary PLY files
+  // are copied straight from the mapped file.  OBJ files still keep their full
+  // parse state (attribute pools and deduplicated corners) until the sink is
+  // filled, since the vertex count is only known after deduplication.  Parse
+  // state is released before sink.unmap() is called.
+  SUTILAPI void loadMesh( Mesh& mesh, MeshSink& sink, const float* load_xform=0 );
+
+  // Points the mesh arrays directly into the memory-mapped cache without
+  // parsing or copying.  Returns false if there is no valid cache; use
+  // scanMesh/allocMesh/loadMesh then.  The arrays are owned by the loader and
+  // valid for its lifetime, so freeMesh must not be called on the mesh.
+  SUTILAPI bool mapMesh( Mesh& mesh, const float* load_xform=0 );
+
 private:
   class Impl;
   Impl* p_impl;
@@ -0,0 +1,450 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+
+//------------------------------------------------------------------------------
+//
+// File layout
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+const char     CACHE_MAGIC[8] = { 'S', 'U', 'T', 'I', 'L', 'M', 'S', 'H' };
+const uint64_t CACHE_ALIGNMENT = 4096; // Every section starts on a page boundary
+
+enum Section
+{
+  SECTION_POSITIONS = 0,
+  SECTION_NORMALS,
+  SECTION_TEXCOORDS,
+  SECTION_TRI_INDICES,
+  SECTION_MAT_INDICES,
+  SECTION_MATERIALS,    // Serialized MaterialParams
+  SECTION_SOURCES,      // Stamps of the source file and its dependencies
+  NUM_SECTIONS
+};
+
+struct CacheHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  int32_t  num_vertices;
+  int32_t  num_triangles;
+  int32_t  num_materials;
+  uint32_t has_normals;
+  uint32_t has_texcoords;
+  float    bbox_min[3];
+  float    bbox_max[3];
+  uint32_t pad;
+  uint64_t file_size;
+  uint64_t offset[NUM_SECTIONS];
+  uint64_t size[NUM_SECTIONS];
+};
+
+
+struct SourceStamp
+{
+  uint64_t size;
+  int64_t  mtime;
+  uint64_t hash;
+};
+
+
+uint64_t alignUp( uint64_t x )
+{
+  return ( x + CACHE_ALIGNMENT - 1 ) & ~( CACHE_ALIGNMENT - 1 );
+}
+
+
+std::string directoryOf( const std::string& path )
+{
+  const size_t pos = path.find_last_of( "/\\" );
+  return pos == std::string::npos ? std::string() : path.substr( 0, pos + 1 );
+}
+
+
+bool stampFile( const std::string& filename, SourceStamp& stamp )
+{
+  return MappedFile::stat( filename, stamp.size, stamp.mtime ) &&
+         MappedFile::hash( filename, stamp.hash );
+}
+
+
+//
+// Serialization helpers for the variable sized sections
+//
+
+void putString( std::vector<char>& out, const std::string& s )
+{
+  const uint32_t len = static_cast<uint32_t>( s.size() );
+  out.insert( out.end(), reinterpret_cast<const char*>( &len ), reinterpret_cast<const char*>( &len ) + sizeof( len ) );
+  out.insert( out.end(), s.begin(), s.end() );
+}
+
+
+template <typename T>
+void putValue( std::vector<char>& out, const T& value )
+{
+  out.insert( out.end(), reinterpret_cast<const char*>( &value ), reinterpret_cast<const char*>( &value ) + sizeof( T ) );
+}
+
+
+class Reader
+{
+public:
+  Reader( const char* begin, uint64_t size ) : m_cur( begin ), m_end( begin + size ) {}
+
+  bool getString( std::string& s )
+  {
+    uint32_t len;
+    if( !getValue( len ) || static_cast<uint64_t>( m_end - m_cur ) < len )
+      return false;
+    s.assign( m_cur, len );
+    m_cur += len;
+    return true;
+  }
+
+  template <typename T>
+  bool getValue( T& value )
+  {
+    if( static_cast<size_t>( m_end - m_cur ) < sizeof( T ) )
+      return false;
+    memcpy( &value, m_cur, sizeof( T ) );
+    m_cur += sizeof( T );
+    return true;
+  }
+
+private:
+  const char* m_cur;
+  const char* m_end;
+};
+
+
+void serializeMaterials( const Mesh& mesh, const std::string& source_dir, std::vector<char>& out )
+{
+  for( int32_t i = 0; i < mesh.num_materials; ++i )
+  {
+    const MaterialParams& mat = mesh.mat_params[i];
+    putString( out, mat.name );
+
+    // Texture paths are made relative to the source so that moving a model
+    // directory together with its cache keeps the cache usable.
+    const bool relative = !source_dir.empty() && mat.Kd_map.compare( 0, source_dir.size(), source_dir ) == 0;
+    putValue( out, static_cast<uint32_t>( relative ) );
+    putString( out, relative ? mat.Kd_map.substr( source_dir.size() ) : mat.Kd_map );
+
+    out.insert( out.end(), reinterpret_cast<const char*>( mat.Kd ), reinterpret_cast<const char*>( mat.Kd ) + sizeof( mat.Kd ) );
+    out.insert( out.end(), reinterpret_cast<const char*>( mat.Ks ), reinterpret_cast<const char*>( mat.Ks ) + sizeof( mat.Ks ) );
+    out.insert( out.end(), reinterpret_cast<const char*>( mat.Kr ), reinterpret_cast<const char*>( mat.Kr ) + sizeof( mat.Kr ) );
+    out.insert( out.end(), reinterpret_cast<const char*>( mat.Ka ), reinterpret_cast<const char*>( mat.Ka ) + sizeof( mat.Ka ) );
+    putValue( out, mat.exp );
+  }
+}
+
+
+const CacheHeader& header( const MappedFile& file )
+{
+  return *reinterpret_cast<const CacheHeader*>( file.data() );
+}
+
+
+const char* section( const MappedFile& file, Section s )
+{
+  return file.data() + header( file ).offset[s];
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// MeshCache
+//
+//------------------------------------------------------------------------------
+
+std::string MeshCache::cacheFilename( const std::string& source )
+{
+  return source + ".meshcache";
+}
+
+
+bool MeshCache::write( const std::string&              source,
+                       const std::vector<std::string>& dependencies,
+                       const Mesh&                     mesh )
+{
+  const std::string source_dir = directoryOf( source );
+
+  // Stamp of the source file itself (empty name) followed by all dependencies
+  std::vector<char> sources;
+  SourceStamp stamp;
+  if( !stampFile( source, stamp ) )
+    return false;
+  putString( sources, std::string() );
+  putValue( sources, stamp );
+  for( size_t i = 0; i < dependencies.size(); ++i )
+  {
+    if( !stampFile( dependencies[i], stamp ) )
+      continue;
+    const std::string& dep = dependencies[i];
+    putString( sources, dep.compare( 0, source_dir.size(), source_dir ) == 0 ? dep.substr( source_dir.size() ) : dep );
+    putValue( sources, stamp );
+  }
+
+  std::vector<char> materials;
+  serializeMaterials( mesh, source_dir, materials );
+
+  const char* data[NUM_SECTIONS] =
+  {
+    reinterpret_cast<const char*>( mesh.positions ),
+    reinterpret_cast<const char*>( mesh.has_normals   ? mesh.normals   : 0 ),
+    reinterpret_cast<const char*>( mesh.has_texcoords ? mesh.texcoords : 0 ),
+    reinterpret_cast<const char*>( mesh.tri_indices ),
+    reinterpret_cast<const char*>( mesh.mat_indices ),
+    materials.empty() ? 0 : &materials[0],
+    &sources[0]
+  };
+
+  CacheHeader hdr;
+  memset( &hdr, 0, sizeof( hdr ) );
+  memcpy( hdr.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) );
+  hdr.version       = VERSION;
+  hdr.header_size   = sizeof( CacheHeader );
+  hdr.num_vertices  = mesh.num_vertices;
+  hdr.num_triangles = mesh.num_triangles;
+  hdr.num_materials = mesh.num_materials;
+  hdr.has_normals   = mesh.has_normals;
+  hdr.has_texcoords = mesh.has_texcoords;
+  std::copy( mesh.bbox_min, mesh.bbox_min + 3, hdr.bbox_min );
+  std::copy( mesh.bbox_max, mesh.bbox_max + 3, hdr.bbox_max );
+
+  hdr.size[SECTION_POSITIONS]   = sizeof( float )   * 3 * mesh.num_vertices;
+  hdr.size[SECTION_NORMALS]     = mesh.has_normals   ? sizeof( float ) * 3 * mesh.num_vertices : 0;
+  hdr.size[SECTION_TEXCOORDS]   = mesh.has_texcoords ? sizeof( float ) * 2 * mesh.num_vertices : 0;
+  hdr.size[SECTION_TRI_INDICES] = sizeof( int32_t ) * 3 * mesh.num_triangles;
+  hdr.size[SECTION_MAT_INDICES] = sizeof( int32_t ) * 1 * mesh.num_triangles;
+  hdr.size[SECTION_MATERIALS]   = materials.size();
+  hdr.size[SECTION_SOURCES]     = sources.size();
+
+  uint64_t offset = alignUp( sizeof( CacheHeader ) );
+  for( int s = 0; s < NUM_SECTIONS; ++s )
+  {
+    hdr.offset[s] = offset;
+    offset = alignUp( offset + hdr.size[s] );
+  }
+  hdr.file_size = offset;
+
+  // Write to a temporary file first so that concurrent readers never see a
+  // partially written cache.
+  const std::string filename = cacheFilename( source );
+  const std::string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream out( tmp_filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if( !out )
+      return false;
+
+    const std::vector<char> padding( CACHE_ALIGNMENT, 0 );
+    out.write( reinterpret_cast<const char*>( &hdr ), sizeof( hdr ) );
+    uint64_t pos = sizeof( hdr );
+    for( int s = 0; s < NUM_SECTIONS; ++s )
+    {
+      out.write( &padding[0], static_cast<std::streamsize>( hdr.offset[s] - pos ) );
+      if( hdr.size[s] )
+        out.write( data[s], static_cast<std::streamsize>( hdr.size[s] ) );
+      pos = hdr.offset[s] + hdr.size[s];
+    }
+    out.write( &padding[0], static_cast<std::streamsize>( hdr.file_size - pos ) );
+
+    if( !out )
+    {
+      out.close();
+      remove( tmp_filename.c_str() );
+      return false;
+    }
+  }
+
+  remove( filename.c_str() );
+  if( rename( tmp_filename.c_str(), filename.c_str() ) != 0 )
+  {
+    remove( tmp_filename.c_str() );
+    return false;
+  }
+  return true;
+}
+
+
+bool MeshCache::open( const std::string& source )
+{
+  close();
+
+  if( !m_file.open( cacheFilename( source ) ) )
+    return false;
+
+  m_source_dir = directoryOf( source );
+
+  const CacheHeader& hdr = header( m_file );
+  bool valid = m_file.size() >= sizeof( CacheHeader )             &&
+               memcmp( hdr.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) ) == 0 &&
+               hdr.version     == VERSION                         &&
+               hdr.header_size == sizeof( CacheHeader )           &&
+               hdr.file_size   == m_file.size();
+
+  // The array sections must match the counts exactly, since load() copies
+  // them into buffers sized from the counts, and every section has to lie
+  // within the file.
+  valid = valid && hdr.num_vertices >= 0 && hdr.num_triangles >= 0 && hdr.num_materials >= 0;
+  if( valid )
+  {
+    const uint64_t num_vertices  = static_cast<uint64_t>( hdr.num_vertices );
+    const uint64_t num_triangles = static_cast<uint64_t>( hdr.num_triangles );
+    valid = hdr.size[SECTION_POSITIONS]   == sizeof( float )   * 3 * num_vertices                         &&
+            hdr.size[SECTION_NORMALS]     == ( hdr.has_normals   ? sizeof( float ) * 3 * num_vertices : 0 ) &&
+            hdr.size[SECTION_TEXCOORDS]   == ( hdr.has_texcoords ? sizeof( float ) * 2 * num_vertices : 0 ) &&
+            hdr.size[SECTION_TRI_INDICES] == sizeof( int32_t ) * 3 * num_triangles                        &&
+            hdr.size[SECTION_MAT_INDICES] == sizeof( int32_t ) * 1 * num_triangles;
+  }
+
+  for( int s = 0; valid && s < NUM_SECTIONS; ++s )
+    valid = hdr.offset[s] <= hdr.file_size && hdr.size[s] <= hdr.file_size - hdr.offset[s];
+
+  // Compare all recorded source stamps against the files on disk
+  if( valid )
+  {
+    Reader reader( section( m_file, SECTION_SOURCES ), hdr.size[SECTION_SOURCES] );
+    std::string name;
+    SourceStamp recorded;
+    while( valid && reader.getString( name ) && reader.getValue( recorded ) )
+    {
+      SourceStamp current;
+      valid = stampFile( name.empty() ? source : m_source_dir + name, current ) &&
+              current.size  == recorded.size  &&
+              current.mtime == recorded.mtime &&
+              current.hash  == recorded.hash;
+    }
+  }
+
+  if( valid )
+    readMaterials();
+
+  if( !valid || static_cast<int32_t>( m_materials.size() ) != hdr.num_materials )
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+
+void MeshCache::close()
+{
+  m_file.close();
+  m_source_dir.clear();
+  m_materials.clear();
+}
+
+
+void MeshCache::readMaterials()
+{
+  const CacheHeader& hdr = header( m_file );
+  Reader reader( section( m_file, SECTION_MATERIALS ), hdr.size[SECTION_MATERIALS] );
+
+  m_materials.clear();
+  for( int32_t i = 0; i < hdr.num_materials; ++i )
+  {
+    MaterialParams mat;
+    uint32_t relative;
+    if( !reader.getString( mat.name )   ||
+        !reader.getValue( relative )    ||
+        !reader.getString( mat.Kd_map ) ||
+        !reader.getValue( mat.Kd )      ||
+        !reader.getValue( mat.Ks )      ||
+        !reader.getValue( mat.Kr )      ||
+        !reader.getValue( mat.Ka )      ||
+        !reader.getValue( mat.exp ) )
+      return;
+
+    if( relative )
+      mat.Kd_map = m_source_dir + mat.Kd_map;
+    m_materials.push_back( mat );
+  }
+}
+
+
+void MeshCache::scan( Mesh& mesh ) const
+{
+  const CacheHeader& hdr = header( m_file );
+  mesh.num_vertices  = hdr.num_vertices;
+  mesh.num_triangles = hdr.num_triangles;
+  mesh.num_materials = hdr.num_materials;
+  mesh.has_normals   = hdr.has_normals   != 0;
+  mesh.has_texcoords = hdr.has_texcoords != 0;
+}
+
+
+void MeshCache::load( Mesh& mesh ) const
+{
+  const CacheHeader& hdr = header( m_file );
+
+  memcpy( mesh.positions,   section( m_file, SECTION_POSITIONS   ), hdr.size[SECTION_POSITIONS] );
+  memcpy( mesh.tri_indices, section( m_file, SECTION_TRI_INDICES ), hdr.size[SECTION_TRI_INDICES] );
+  memcpy( mesh.mat_indices, section( m_file, SECTION_MAT_INDICES ), hdr.size[SECTION_MAT_INDICES] );
+  if( mesh.has_normals )
+    memcpy( mesh.normals,   section( m_file, SECTION_NORMALS     ), hdr.size[SECTION_NORMALS] );
+  if( mesh.has_texcoords )
+    memcpy( mesh.texcoords, section( m_file, SECTION_TEXCOORDS   ), hdr.size[SECTION_TEXCOORDS] );
+
+  std::copy( m_materials.begin(), m_materials.end(), mesh.mat_params );
+  std::copy( hdr.bbox_min, hdr.bbox_min + 3, mesh.bbox_min );
+  std::copy( hdr.bbox_max, hdr.bbox_max + 3, mesh.bbox_max );
+}
+
+
+void MeshCache::map( Mesh& mesh )
+{
+  scan( mesh );
+
+  const CacheHeader& hdr = header( m_file );
+  mesh.positions   = reinterpret_cast<float*>  ( m_file.data() + hdr.offset[SECTION_POSITIONS] );
+  mesh.normals     = mesh.has_normals   ? reinterpret_cast<float*>( m_file.data() + hdr.offset[SECTION_NORMALS] )   : 0;
+  mesh.texcoords   = mesh.has_texcoords ? reinterpret_cast<float*>( m_file.data() + hdr.offset[SECTION_TEXCOORDS] ) : 0;
+  mesh.tri_indices = reinterpret_cast<int32_t*>( m_file.data() + hdr.offset[SECTION_TRI_INDICES] );
+  mesh.mat_indices = reinterpret_cast<int32_t*>( m_file.data() + hdr.offset[SECTION_MAT_INDICES] );
+  mesh.mat_params  = m_materials.empty() ? 0 : &m_materials[0];
+
+  std::copy( hdr.bbox_min, hdr.bbox_min + 3, mesh.bbox_min );
+  std::copy( hdr.bbox_max, hdr.bbox_max + 3, mesh.bbox_max );
+}
@@ -0,0 +1,87 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+
+
+//------------------------------------------------------------------------------
+//
+// Binary mesh cache written next to a mesh source file (<source>.meshcache).
+//
+// The cache holds the untransformed result of MeshLoader::loadMesh with every
+// array starting on a page boundary, so a valid cache can be memory-mapped and
+// used in place.  It is considered stale when the size, modification time or
+// content hash of the source file, or of any material library it references,
+// no longer matches.
+//
+//------------------------------------------------------------------------------
+class MeshCache
+{
+public:
+  // Version 2: OBJ meshes come from sutil::ObjParser, which fills missing
+  // per-vertex normals and texcoords with zeros.
+  static const uint32_t VERSION = 2;
+
+  // Cache file path for the given mesh source file
+  static std::string cacheFilename( const std::string& source );
+
+  // Writes the cache for source from a loaded, untransformed mesh.  dependencies
+  // are additional files (e.g. OBJ material libraries) the mesh was built from.
+  // Failure (read-only directory, full disk) is not an error; returns false.
+  static bool write( const std::string&              source,
+                     const std::vector<std::string>& dependencies,
+                     const Mesh&                     mesh );
+
+  // Maps and validates the cache of source.  Returns false if the cache is
+  // missing, of a different version, or stale.
+  bool open( const std::string& source );
+  void close();
+  bool isOpen() const { return m_file.isOpen(); }
+
+  // Same contracts as MeshLoader::scanMesh and MeshLoader::loadMesh
+  // (without load transform).
+  void scan( Mesh& mesh ) const;
+  void load( Mesh& mesh ) const;
+
+  // Points the mesh arrays into the mapping.  mat_params points into storage
+  // owned by this object.  Valid until close().
+  void map( Mesh& mesh );
+
+private:
+  MappedFile                  m_file;
+  std::string                 m_source_dir;
+  std::vector<MaterialParams> m_materials;
+
+  void readMaterials();
+};
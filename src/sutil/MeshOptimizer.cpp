@@ -0,0 +1,603 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MeshOptimizer.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const size_t   GRAIN     = 1u << 16;
+const uint64_t EMPTY     = UINT64_MAX;
+const int      MAX_KEY   = 8;        // 3 position, 3 normal and 2 texcoord components
+const size_t   CLUSTER   = 1u << 16; // Triangles per independently reordered cluster
+
+
+// Comparison key of a vertex.  Exact keys are the float bits with -0 folded
+// into +0, epsilon keys are the attributes in units of epsilon, rounded.
+class VertexKey
+{
+public:
+  VertexKey( const Mesh& mesh, float epsilon )
+    : m_mesh( mesh )
+    , m_inv_epsilon( epsilon > 0.0f ? 1.0 / epsilon : 0.0 )
+  {
+  }
+
+  int get( int32_t vertex, uint64_t* key ) const
+  {
+    int n = 0;
+    add( m_mesh.positions + 3 * vertex, 3, key, n );
+    if( m_mesh.has_normals )
+      add( m_mesh.normals + 3 * vertex, 3, key, n );
+    if( m_mesh.has_texcoords )
+      add( m_mesh.texcoords + 2 * vertex, 2, key, n );
+    return n;
+  }
+
+  bool equal( int32_t a, int32_t b ) const
+  {
+    uint64_t key_a[MAX_KEY], key_b[MAX_KEY];
+    const int n = get( a, key_a );
+    get( b, key_b );
+    return memcmp( key_a, key_b, n * sizeof( uint64_t ) ) == 0;
+  }
+
+  uint64_t hash( int32_t vertex ) const
+  {
+    uint64_t key[MAX_KEY];
+    const int n = get( vertex, key );
+    uint64_t h = 0xcbf29ce484222325ull;
+    for( int k = 0; k < n; ++k )
+    {
+      h ^= key[k];
+      h *= 0x100000001b3ull;
+      h ^= h >> 29;
+    }
+    return h;
+  }
+
+private:
+  void add( const float* values, int count, uint64_t* key, int& n ) const
+  {
+    for( int k = 0; k < count; ++k )
+    {
+      if( m_inv_epsilon > 0.0 )
+      {
+        const double q = std::floor( values[k] * m_inv_epsilon + 0.5 );
+        if( q != q )
+          key[n++] = 1ull << 63;  // All NaNs are alike
+        else
+          key[n++] = static_cast<uint64_t>( static_cast<int64_t>( std::max( -9.0e18, std::min( 9.0e18, q ) ) ) );
+      }
+      else
+      {
+        const float x = values[k] + 0.0f;
+        uint32_t bits;
+        memcpy( &bits, &x, sizeof( bits ) );
+        key[n++] = bits;
+      }
+    }
+  }
+
+  const Mesh& m_mesh;
+  double      m_inv_epsilon;
+};
+
+
+void checkIndices( const Mesh& mesh, const std::string& caller )
+{
+  const size_t num_indices = 3 * static_cast<size_t>( mesh.num_triangles );
+  std::vector<char> range_valid( sutil::numRanges( num_indices, GRAIN ), 1 );
+  sutil::parallelFor( num_indices, GRAIN, [&]( size_t begin, size_t end, size_t r )
+  {
+    for( size_t i = begin; i < end; ++i )
+      if( mesh.tri_indices[i] < 0 || mesh.tri_indices[i] >= mesh.num_vertices )
+        range_valid[r] = 0;
+  } );
+  for( size_t r = 0; r < range_valid.size(); ++r )
+    if( !range_valid[r] )
+      throw std::runtime_error( caller + ": Invalid triangle index" );
+}
+
+
+void moveVertex( float* attribute, int components, int32_t from, int32_t to )
+{
+  if( attribute )
+    for( int k = 0; k < components; ++k )
+      attribute[components * to + k] = attribute[components * from + k];
+}
+
+// Spreads the low 10 bits of x to every third bit
+inline uint32_t expandBits( uint32_t x )
+{
+  x = ( x * 0x00010001u ) & 0xFF0000FFu;
+  x = ( x * 0x00000101u ) & 0x0F00F00Fu;
+  x = ( x * 0x00000011u ) & 0xC30C30C3u;
+  x = ( x * 0x00000005u ) & 0x49249249u;
+  return x;
+}
+
+
+// Triangles sorted by the Morton code of their centroids
+void mortonOrder( const Mesh& mesh, std::vector<uint32_t>& order )
+{
+  const size_t num_vertices  = mesh.num_vertices;
+  const size_t num_triangles = mesh.num_triangles;
+
+  struct BBox
+  {
+    float min[3];
+    float max[3];
+  };
+  std::vector<BBox> bboxes( sutil::numRanges( num_vertices, GRAIN ) );
+  sutil::parallelFor( num_vertices, GRAIN, [&]( size_t begin, size_t end, size_t r )
+  {
+    BBox& bbox = bboxes[r];
+    std::copy( mesh.positions + 3 * begin, mesh.positions + 3 * begin + 3, bbox.min );
+    std::copy( mesh.positions + 3 * begin, mesh.positions + 3 * begin + 3, bbox.max );
+    for( size_t v = begin; v < end; ++v )
+      for( int k = 0; k < 3; ++k )
+      {
+        bbox.min[k] = std::min( bbox.min[k], mesh.positions[3 * v + k] );
+        bbox.max[k] = std::max( bbox.max[k], mesh.positions[3 * v + k] );
+      }
+  } );
+
+  float origin[3], scale[3];
+  for( int k = 0; k < 3; ++k )
+  {
+    float lo = bboxes[0].min[k], hi = bboxes[0].max[k];
+    for( size_t r = 1; r < bboxes.size(); ++r )
+    {
+      lo = std::min( lo, bboxes[r].min[k] );
+      hi = std::max( hi, bboxes[r].max[k] );
+    }
+    origin[k] = lo;
+    scale[k]  = hi > lo ? 1023.0f / ( 3.0f * ( hi - lo ) ) : 0.0f;  // Centroids are vertex sums / 3
+  }
+
+  std::vector<uint64_t> keys( num_triangles );
+  sutil::parallelFor( num_triangles, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t t = begin; t < end; ++t )
+    {
+      uint32_t cell[3];
+      for( int k = 0; k < 3; ++k )
+      {
+        const float sum = mesh.positions[3 * mesh.tri_indices[3 * t + 0] + k] +
+                          mesh.positions[3 * mesh.tri_indices[3 * t + 1] + k] +
+                          mesh.positions[3 * mesh.tri_indices[3 * t + 2] + k];
+        const float x = ( sum - 3.0f * origin[k] ) * scale[k];
+        cell[k] = x > 0.0f ? std::min( static_cast<uint32_t>( x ), 1023u ) : 0u;  // Also catches NaN
+      }
+      const uint32_t code = ( expandBits( cell[0] ) << 2 ) | ( expandBits( cell[1] ) << 1 ) | expandBits( cell[2] );
+      keys[t] = ( static_cast<uint64_t>( code ) << 32 ) | t;
+    }
+  } );
+  sutil::parallelSort( keys.data(), keys.size(), GRAIN );
+
+  order.resize( num_triangles );
+  for( size_t t = 0; t < num_triangles; ++t )
+    order[t] = static_cast<uint32_t>( keys[t] );
+}
+
+
+// Tipsify on the triangles in tris, which are reordered in place.  Follows the
+// pseudo code of the paper: fan around the current vertex, then continue with
+// the adjacent vertex that is most likely still in the cache, and fall back to
+// recently used vertices (dead ends) or a scan over all vertices.
+void tipsify( const Mesh& mesh, uint32_t* tris, size_t num_tris, int cache_size )
+{
+  if( num_tris == 0 )
+    return;
+
+  // Number the vertices of the cluster locally
+  const size_t num_corners = 3 * num_tris;
+  std::vector<uint64_t> corner_keys( num_corners );
+  for( size_t c = 0; c < num_corners; ++c )
+    corner_keys[c] = ( static_cast<uint64_t>( mesh.tri_indices[3 * tris[c / 3] + c % 3] ) << 32 ) | c;
+  std::sort( corner_keys.begin(), corner_keys.end() );
+
+  std::vector<uint32_t> local( num_corners );
+  uint32_t num_vertices = 0;
+  for( size_t i = 0; i < num_corners; ++i )
+  {
+    if( i > 0 && ( corner_keys[i] >> 32 ) != ( corner_keys[i - 1] >> 32 ) )
+      ++num_vertices;
+    local[static_cast<uint32_t>( corner_keys[i] )] = num_vertices;
+  }
+  ++num_vertices;
+  std::vector<uint64_t>().swap( corner_keys );
+
+  // Vertex to triangle adjacency
+  std::vector<uint32_t> live( num_vertices, 0 );
+  for( size_t c = 0; c < num_corners; ++c )
+    ++live[local[c]];
+  std::vector<uint32_t> adjacency_begin( num_vertices + 1, 0 );
+  for( uint32_t v = 0; v < num_vertices; ++v )
+    adjacency_begin[v + 1] = adjacency_begin[v] + live[v];
+  std::vector<uint32_t> adjacency( num_corners );
+  {
+    std::vector<uint32_t> fill( adjacency_begin.begin(), adjacency_begin.end() - 1 );
+    for( size_t c = 0; c < num_corners; ++c )
+      adjacency[fill[local[c]]++] = static_cast<uint32_t>( c / 3 );
+  }
+
+  std::vector<int64_t>  stamp( num_vertices, 0 );
+  std::vector<char>     emitted( num_tris, 0 );
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  output.reserve( num_tris );
+
+  int64_t  time   = cache_size + 1;
+  uint32_t cursor = 0;
+  int64_t  fan    = local[0];
+  while( fan >= 0 )
+  {
+    candidates.clear();
+    for( uint32_t a = adjacency_begin[fan]; a < adjacency_begin[fan + 1]; ++a )
+    {
+      const uint32_t t = adjacency[a];
+      if( emitted[t] )
+        continue;
+      for( int k = 0; k < 3; ++k )
+      {
+        const uint32_t v = local[3 * t + k];
+        dead_end.push_back( v );
+        candidates.push_back( v );
+        --live[v];
+        if( time - stamp[v] > cache_size )
+          stamp[v] = time++;
+      }
+      emitted[t] = 1;
+      output.push_back( t );
+    }
+
+    // Prefer the candidate that stays in the cache longest after its fan
+    fan = -1;
+    int64_t best = -1;
+    for( size_t i = 0; i < candidates.size(); ++i )
+    {
+      const uint32_t v = candidates[i];
+      if( live[v] == 0 )
+        continue;
+      int64_t priority = 0;
+      if( time - stamp[v] + 2 * static_cast<int64_t>( live[v] ) <= cache_size )
+        priority = time - stamp[v];
+      if( priority > best )
+      {
+        best = priority;
+        fan  = v;
+      }
+    }
+
+    // Otherwise a recently used vertex, otherwise the next one with live triangles
+    while( fan < 0 && !dead_end.empty() )
+    {
+      const uint32_t v = dead_end.back();
+      dead_end.pop_back();
+      if( live[v] > 0 )
+        fan = v;
+    }
+    while( fan < 0 && cursor < num_vertices )
+    {
+      if( live[cursor] > 0 )
+        fan = cursor;
+      ++cursor;
+    }
+  }
+
+  const std::vector<uint32_t> original( tris, tris + num_tris );
+  for( size_t i = 0; i < num_tris; ++i )
+    tris[i] = original[output[i]];
+}
+
+
+// FIFO cache simulation over the triangles in the given order, or in mesh
+// order if order is null
+float cacheMissRatio( const Mesh& mesh, const uint32_t* order, int cache_size )
+{
+  if( mesh.num_triangles == 0 )
+    return 0.0f;
+
+  // A vertex is cached if fewer than cache_size misses happened since its own
+  std::vector<uint64_t> stamp( mesh.num_vertices, 0 );
+  uint64_t misses = 0;
+  for( size_t t = 0; t < static_cast<size_t>( mesh.num_triangles ); ++t )
+  {
+    const int32_t* tri = mesh.tri_indices + 3 * ( order ? order[t] : t );
+    for( int k = 0; k < 3; ++k )
+    {
+      uint64_t& s = stamp[tri[k]];
+      if( s == 0 || misses - s >= static_cast<uint64_t>( cache_size ) )
+        s = ++misses;
+    }
+  }
+  return static_cast<float>( static_cast<double>( misses ) / mesh.num_triangles );
+}
+
+
+// Moves element i of an array with the given number of components to
+// new_index[i]
+template <typename T>
+void permute( T* data, int components, const std::vector<uint32_t>& new_index )
+{
+  const size_t count = new_index.size();
+  const std::vector<T> original( data, data + components * count );
+  sutil::parallelFor( count, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t i = begin; i < end; ++i )
+      for( int k = 0; k < components; ++k )
+        data[components * new_index[i] + k] = original[components * i + k];
+  } );
+}
+
+} // end anonymous namespace
+
+
+//------------------------------------------------------------------------------
+//
+// Vertex welding
+//
+// Every vertex inserts itself into a concurrent hash table, where each key
+// ends up holding its smallest vertex index.  Table entries hold 32 bits of
+// the key's hash above the vertex index, so most probes are resolved without
+// comparing attributes.
+//
+//------------------------------------------------------------------------------
+
+MeshWeldStats weldVertices( Mesh& mesh, float epsilon )
+{
+  const size_t num_vertices  = mesh.num_vertices;
+  const size_t num_indices   = 3 * static_cast<size_t>( mesh.num_triangles );
+
+  MeshWeldStats stats;
+  stats.vertices_before = mesh.num_vertices;
+  stats.vertices_after  = mesh.num_vertices;
+  stats.bytes_saved     = 0;
+  if( num_vertices == 0 )
+    return stats;
+
+  checkIndices( mesh, "weldVertices" );
+
+  const VertexKey key( mesh, epsilon );
+
+  size_t table_size = 64;
+  while( table_size < 2 * num_vertices )
+    table_size *= 2;
+  const size_t mask = table_size - 1;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> table( new std::atomic<uint64_t>[table_size] );
+  sutil::parallelFor( table_size, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t i = begin; i < end; ++i )
+      table[i].store( EMPTY, std::memory_order_relaxed );
+  } );
+
+  // Insert, remembering the slot of every vertex
+  std::vector<uint32_t> first( num_vertices );
+  sutil::parallelFor( num_vertices, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t v = begin; v < end; ++v )
+    {
+      const uint64_t hash  = key.hash( static_cast<int32_t>( v ) );
+      const uint64_t tag   = hash & 0xFFFFFFFF00000000ull;
+      uint64_t       entry = tag | v;
+      size_t         slot  = hash & mask;
+      for( ; ; slot = ( slot + 1 ) & mask )
+      {
+        uint64_t cur = table[slot].load( std::memory_order_relaxed );
+        if( cur == EMPTY )
+        {
+          if( table[slot].compare_exchange_strong( cur, entry ) )
+            break;
+          // Lost the race; cur now holds the winner
+        }
+        const int32_t other = static_cast<int32_t>( static_cast<uint32_t>( cur ) );
+        if( ( cur & 0xFFFFFFFF00000000ull ) == tag && key.equal( other, static_cast<int32_t>( v ) ) )
+        {
+          // Same tag, so the smaller entry is the smaller vertex index
+          while( entry < cur && !table[slot].compare_exchange_weak( cur, entry ) ) {}
+          break;
+        }
+      }
+      first[v] = static_cast<uint32_t>( slot );
+    }
+  } );
+
+  // Replace the slots by the first vertex with the same key
+  std::vector<size_t> range_count( sutil::numRanges( num_vertices, GRAIN ), 0 );
+  sutil::parallelFor( num_vertices, GRAIN, [&]( size_t begin, size_t end, size_t r )
+  {
+    for( size_t v = begin; v < end; ++v )
+    {
+      first[v] = static_cast<uint32_t>( table[first[v]].load( std::memory_order_relaxed ) );
+      range_count[r] += first[v] == v;
+    }
+  } );
+  table.reset();
+
+  // Number the surviving vertices in order, then point the others at them
+  std::vector<size_t> range_base( range_count.size() );
+  size_t num_welded = 0;
+  for( size_t r = 0; r < range_count.size(); ++r )
+  {
+    range_base[r] = num_welded;
+    num_welded   += range_count[r];
+  }
+
+  std::vector<uint32_t> remap( num_vertices );
+  sutil::parallelFor( num_vertices, GRAIN, [&]( size_t begin, size_t end, size_t r )
+  {
+    uint32_t index = static_cast<uint32_t>( range_base[r] );
+    for( size_t v = begin; v < end; ++v )
+      if( first[v] == v )
+        remap[v] = index++;
+  } );
+  sutil::parallelFor( num_vertices, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t v = begin; v < end; ++v )
+      if( first[v] != v )
+        remap[v] = remap[first[v]];
+  } );
+
+  if( num_welded == num_vertices )
+    return stats;
+
+  // Surviving vertices only ever move towards the front, so a forward pass
+  // can compact the arrays in place
+  for( size_t v = 0; v < num_vertices; ++v )
+  {
+    if( first[v] != v || remap[v] == v )
+      continue;
+    const int32_t from = static_cast<int32_t>( v );
+    const int32_t to   = static_cast<int32_t>( remap[v] );
+    moveVertex( mesh.positions, 3, from, to );
+    moveVertex( mesh.has_normals   ? mesh.normals   : 0, 3, from, to );
+    moveVertex( mesh.has_texcoords ? mesh.texcoords : 0, 2, from, to );
+  }
+
+  sutil::parallelFor( num_indices, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t i = begin; i < end; ++i )
+      mesh.tri_indices[i] = static_cast<int32_t>( remap[mesh.tri_indices[i]] );
+  } );
+
+  const uint64_t vertex_size = 3 * sizeof( float ) +
+                               ( mesh.has_normals   ? 3 * sizeof( float ) : 0 ) +
+                               ( mesh.has_texcoords ? 2 * sizeof( float ) : 0 );
+
+  mesh.num_vertices     = static_cast<int32_t>( num_welded );
+  stats.vertices_after  = mesh.num_vertices;
+  stats.bytes_saved     = vertex_size * ( num_vertices - num_welded );
+  return stats;
+}
+
+
+void printWeldStats( const MeshWeldStats& stats, std::ostream& out )
+{
+  const double removed = stats.vertices_before ?
+                         100.0 * ( stats.vertices_before - stats.vertices_after ) / stats.vertices_before : 0.0;
+  out << "Vertex weld:" << std::endl
+      << "\tvertices before: " << stats.vertices_before << std::endl
+      << "\tvertices after : " << stats.vertices_after  << " (" << removed << "% removed)" << std::endl
+      << "\tbytes saved    : " << stats.bytes_saved     << std::endl;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Vertex cache optimization
+//
+//------------------------------------------------------------------------------
+
+float vertexCacheMissRatio( const Mesh& mesh, int cache_size )
+{
+  checkIndices( mesh, "vertexCacheMissRatio" );
+  return cacheMissRatio( mesh, 0, cache_size );
+}
+
+
+void optimizeVertexCache( Mesh& mesh, int cache_size )
+{
+  checkIndices( mesh, "optimizeVertexCache" );
+  const size_t num_triangles = mesh.num_triangles;
+  const size_t num_vertices  = mesh.num_vertices;
+  if( num_triangles == 0 )
+    return;
+
+  // Reorder clusters of triangles, concurrently
+  std::vector<uint32_t> order;
+  if( num_triangles > CLUSTER )
+  {
+    mortonOrder( mesh, order );
+  }
+  else
+  {
+    order.resize( num_triangles );
+    for( size_t t = 0; t < num_triangles; ++t )
+      order[t] = static_cast<uint32_t>( t );
+  }
+
+  const size_t num_clusters = ( num_triangles + CLUSTER - 1 ) / CLUSTER;
+  sutil::parallelFor( num_clusters, 1, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t c = begin; c < end; ++c )
+    {
+      const size_t first = num_triangles * c / num_clusters;
+      const size_t last  = num_triangles * ( c + 1 ) / num_clusters;
+      tipsify( mesh, order.data() + first, last - first, cache_size );
+    }
+  } );
+
+  // Meshes that already have good locality can come out worse when split
+  // into clusters, keep those as they are
+  if( cacheMissRatio( mesh, order.data(), cache_size ) >= cacheMissRatio( mesh, 0, cache_size ) )
+    return;
+
+  std::vector<uint32_t> new_triangle( num_triangles );
+  for( size_t t = 0; t < num_triangles; ++t )
+    new_triangle[order[t]] = static_cast<uint32_t>( t );
+  std::vector<uint32_t>().swap( order );
+  permute( mesh.tri_indices, 3, new_triangle );
+  permute( mesh.mat_indices, 1, new_triangle );
+  std::vector<uint32_t>().swap( new_triangle );
+
+  // Number vertices in order of first use, unused ones last
+  const uint32_t UNUSED = UINT32_MAX;
+  std::vector<uint32_t> new_vertex( num_vertices, UNUSED );
+  uint32_t next = 0;
+  for( size_t i = 0; i < 3 * num_triangles; ++i )
+  {
+    uint32_t& v = new_vertex[mesh.tri_indices[i]];
+    if( v == UNUSED )
+      v = next++;
+    mesh.tri_indices[i] = static_cast<int32_t>( v );
+  }
+  for( size_t v = 0; v < num_vertices; ++v )
+    if( new_vertex[v] == UNUSED )
+      new_vertex[v] = next++;
+
+  permute( mesh.positions, 3, new_vertex );
+  if( mesh.has_normals )
+    permute( mesh.normals, 3, new_vertex );
+  if( mesh.has_texcoords )
+    permute( mesh.texcoords, 2, new_vertex );
+}
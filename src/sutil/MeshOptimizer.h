@@ -0,0 +1,77 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+#include "Mesh.h"
+
+#include <iostream>
+#include <stdint.h>
+
+
+//------------------------------------------------------------------------------
+//
+// Optional post-load passes on a Mesh.  They work on meshes in host memory
+// (allocMesh or any other writable arrays) and run multi-threaded.
+//
+//------------------------------------------------------------------------------
+
+struct MeshWeldStats
+{
+  int32_t             vertices_before;
+  int32_t             vertices_after;
+  uint64_t            bytes_saved;    // Vertex attribute bytes no longer needed
+};
+
+
+// Merges vertices with identical positions, normals and texcoords and remaps
+// tri_indices accordingly.  With epsilon > 0, attributes are compared after
+// rounding to the nearest multiple of epsilon, so vertices closer than about
+// epsilon are merged as well.  The first vertex of each group is kept with its
+// original attributes and the vertex order is otherwise preserved.  The
+// surviving vertices are moved to the front of the existing arrays and
+// num_vertices is reduced; the arrays are not reallocated.
+SUTILAPI MeshWeldStats weldVertices( Mesh& mesh, float epsilon = 0.0f );
+
+SUTILAPI void printWeldStats( const MeshWeldStats& stats, std::ostream& out = std::cout );
+
+
+// Average cache miss ratio: vertices processed per triangle when the indices
+// are fed through a FIFO post-transform cache of cache_size entries.  Ranges
+// from 3 (no reuse) down to about 0.5 for well-ordered regular meshes.
+SUTILAPI float vertexCacheMissRatio( const Mesh& mesh, int cache_size = 16 );
+
+// Reorders triangles for post-transform vertex cache locality with Tipsify
+// (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw", 2007), then renumbers vertices in order of first use so
+// that attribute fetches are close to sequential.  Large meshes are first
+// sorted along a Morton curve and split into clusters of a fixed size that are
+// reordered concurrently; the result does not depend on the thread count.
+// The mesh is left alone if the new order would not lower the miss ratio.
+SUTILAPI void optimizeVertexCache( Mesh& mesh, int cache_size = 16 );
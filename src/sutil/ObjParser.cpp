@@ -0,0 +1,877 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+//
+// Line parsing.  These mirror the tinyobj parsing functions, but are bounded
+// by the end of the line instead of relying on a terminating '\0'.
+//
+//------------------------------------------------------------------------------
+
+inline bool isSpace( char c )   { return c == ' ' || c == '\t'; }
+inline bool isNewLine( char c ) { return c == '\r' || c == '\n' || c == '\0'; }
+
+
+inline const char* skip( const char* s, const char* end, const char* set )
+{
+  while( s < end && strchr( set, *s ) && *s )
+    ++s;
+  return s;
+}
+
+
+inline const char* skipUntil( const char* s, const char* end, const char* set )
+{
+  while( s < end && !strchr( set, *s ) )
+    ++s;
+  return s;
+}
+
+
+inline bool isDigit( const char* s, const char* end )
+{
+  return s < end && *s >= '0' && *s <= '9';
+}
+
+
+// pow( 10.0, -k ) for the digits after the decimal point.  Filled by pow()
+// itself so that the parsed values are bit-identical to tinyobj's.
+struct NegativePowersOf10
+{
+  double value[32];
+  NegativePowersOf10() { for( int k = 0; k < 32; ++k ) value[k] = pow( 10.0, -k ); }
+  double operator()( int k ) const { return k < 32 ? value[k] : pow( 10.0, -k ); }
+};
+
+
+// Same grammar and arithmetic as tinyobj's tryParseDouble()
+bool tryParseDouble( const char* s, const char* s_end, double* result )
+{
+  static const NegativePowersOf10 pow10_neg;
+
+  if( s >= s_end )
+    return false;
+
+  double      mantissa = 0.0;
+  int         exponent = 0;
+  char        sign     = '+';
+  char        exp_sign = '+';
+  const char* curr     = s;
+  int         read     = 0;
+
+  if( *curr == '+' || *curr == '-' )
+    sign = *curr++;
+  else if( !isDigit( curr, s_end ) )
+    return false;
+
+  while( isDigit( curr, s_end ) )
+  {
+    mantissa *= 10;
+    mantissa += static_cast<int>( *curr - 0x30 );
+    ++curr; ++read;
+  }
+  if( read == 0 )
+    return false;
+
+  if( curr != s_end )
+  {
+    bool has_exponent = false;
+    if( *curr == '.' )
+    {
+      ++curr;
+      read = 1;
+      while( isDigit( curr, s_end ) )
+      {
+        mantissa += static_cast<int>( *curr - 0x30 ) * pow10_neg( read );
+        ++read; ++curr;
+      }
+      has_exponent = curr != s_end && ( *curr == 'e' || *curr == 'E' );
+    }
+    else
+    {
+      has_exponent = *curr == 'e' || *curr == 'E';
+    }
+
+    if( has_exponent )
+    {
+      ++curr;
+      if( curr != s_end && ( *curr == '+' || *curr == '-' ) )
+        exp_sign = *curr++;
+      else if( !isDigit( curr, s_end ) )
+        return false;
+
+      read = 0;
+      while( isDigit( curr, s_end ) )
+      {
+        exponent *= 10;
+        exponent += static_cast<int>( *curr - 0x30 );
+        ++curr; ++read;
+      }
+      exponent *= ( exp_sign == '+' ? 1 : -1 );
+      if( read == 0 )
+        return false;
+    }
+  }
+
+  *result = ( sign == '+' ? 1 : -1 ) * ldexp( mantissa * pow( 5.0, exponent ), exponent );
+  return true;
+}
+
+
+inline float parseFloat( const char*& token, const char* eol )
+{
+  token = skip( token, eol, " \t" );
+  const char* end = skipUntil( token, eol, " \t\r" );
+  double value = 0.0;
+  tryParseDouble( token, end, &value );
+  token = end;
+  return static_cast<float>( value );
+}
+
+
+// Same as atoi(), but bounded
+inline int parseInt( const char* s, const char* end )
+{
+  while( s < end && isspace( static_cast<unsigned char>( *s ) ) )
+    ++s;
+  bool negative = false;
+  if( s < end && ( *s == '+' || *s == '-' ) )
+    negative = *s++ == '-';
+  int value = 0;
+  while( isDigit( s, end ) )
+    value = value * 10 + ( *s++ - '0' );
+  return negative ? -value : value;
+}
+
+
+// First whitespace delimited word, like sscanf( token, "%s", ... )
+inline std::string parseWord( const char* token, const char* eol )
+{
+  while( token < eol && isspace( static_cast<unsigned char>( *token ) ) )
+    ++token;
+  const char* end = token;
+  while( end < eol && !isspace( static_cast<unsigned char>( *end ) ) )
+    ++end;
+  return std::string( token, end );
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Chunk parsing
+//
+//------------------------------------------------------------------------------
+
+typedef ObjParser::Corner Corner;
+
+struct Event
+{
+  enum Type
+  {
+    USEMTL = 0,
+    GROUP,     // 'g' or 'o', both start a new group
+    MTLLIB
+  };
+
+  Type        type;
+  size_t      triangle; // Chunk-local triangle count when the event occurred
+  std::string name;
+};
+
+
+struct Chunk
+{
+  const char*         begin;
+  const char*         end;
+
+  std::vector<float>  v;
+  std::vector<float>  vn;
+  std::vector<float>  vt;
+  std::vector<Corner> corners;  // 3 per triangle after fan triangulation
+  std::vector<Event>  events;
+
+  // Negative (relative) indices are resolved against the chunk-local attribute
+  // counts while parsing.  These entries (3*corner + component) have to be
+  // offset by the number of attributes in all preceding chunks.
+  std::vector<size_t> relative;
+};
+
+
+enum Component
+{
+  COMPONENT_V  = 0,
+  COMPONENT_VT = 1,
+  COMPONENT_VN = 2
+};
+
+
+// Make index zero based.  Returns true if the index is relative to n.
+inline bool fixIndex( int idx, int n, int32_t& result )
+{
+  if( idx > 0 )  { result = idx - 1; return false; }
+  if( idx == 0 ) { result = 0;       return false; }
+  result = n + idx;
+  return true;
+}
+
+
+// One face vertex: i, i/j/k, i//k or i/j, like tinyobj's parseTriple()
+inline void parseTriple( const char*& token, const char* eol, const Chunk& chunk,
+                         Corner& corner, unsigned int& relative )
+{
+  const int vsize  = static_cast<int>( chunk.v.size()  / 3 );
+  const int vtsize = static_cast<int>( chunk.vt.size() / 2 );
+  const int vnsize = static_cast<int>( chunk.vn.size() / 3 );
+
+  corner.v = corner.vt = corner.vn = -1;
+  relative = 0;
+
+  relative |= fixIndex( parseInt( token, eol ), vsize, corner.v ) << COMPONENT_V;
+  token = skipUntil( token, eol, "/ \t\r" );
+  if( token >= eol || token[0] != '/' )
+    return;
+  ++token;
+
+  // i//k
+  if( token < eol && token[0] == '/' )
+  {
+    ++token;
+    relative |= fixIndex( parseInt( token, eol ), vnsize, corner.vn ) << COMPONENT_VN;
+    token = skipUntil( token, eol, "/ \t\r" );
+    return;
+  }
+
+  // i/j/k or i/j
+  relative |= fixIndex( parseInt( token, eol ), vtsize, corner.vt ) << COMPONENT_VT;
+  token = skipUntil( token, eol, "/ \t\r" );
+  if( token >= eol || token[0] != '/' )
+    return;
+
+  // i/j/k
+  ++token;
+  relative |= fixIndex( parseInt( token, eol ), vnsize, corner.vn ) << COMPONENT_VN;
+  token = skipUntil( token, eol, "/ \t\r" );
+}
+
+
+void parseLine( Chunk& chunk, const char* token, const char* eol,
+                std::vector<Corner>& face, std::vector<unsigned int>& face_relative )
+{
+  token = skip( token, eol, " \t" );
+  if( token >= eol || token[0] == '\0' || token[0] == '#' )
+    return;
+
+  const size_t n = eol - token;
+  const bool space1 = n > 1 && isSpace( token[1] );
+  const bool space2 = n > 2 && isSpace( token[2] );
+  const bool space6 = n > 6 && isSpace( token[6] );
+
+  if( token[0] == 'v' && space1 )
+  {
+    token += 2;
+    const float x = parseFloat( token, eol );
+    const float y = parseFloat( token, eol );
+    const float z = parseFloat( token, eol );
+    chunk.v.push_back( x );
+    chunk.v.push_back( y );
+    chunk.v.push_back( z );
+  }
+  else if( space2 && token[0] == 'v' && token[1] == 'n' )
+  {
+    token += 3;
+    const float x = parseFloat( token, eol );
+    const float y = parseFloat( token, eol );
+    const float z = parseFloat( token, eol );
+    chunk.vn.push_back( x );
+    chunk.vn.push_back( y );
+    chunk.vn.push_back( z );
+  }
+  else if( space2 && token[0] == 'v' && token[1] == 't' )
+  {
+    token += 3;
+    const float x = parseFloat( token, eol );
+    const float y = parseFloat( token, eol );
+    chunk.vt.push_back( x );
+    chunk.vt.push_back( y );
+  }
+  else if( token[0] == 'f' && space1 )
+  {
+    token += 2;
+    token = skip( token, eol, " \t" );
+
+    face.clear();
+    face_relative.clear();
+    while( token < eol && !isNewLine( token[0] ) )
+    {
+      Corner corner;
+      unsigned int relative;
+      parseTriple( token, eol, chunk, corner, relative );
+      face.push_back( corner );
+      face_relative.push_back( relative );
+      token = skip( token, eol, " \t\r" );
+    }
+
+    // Polygon -> triangle fan conversion
+    for( size_t k = 2; k < face.size(); ++k )
+    {
+      const size_t fan[3] = { 0, k - 1, k };
+      for( int i = 0; i < 3; ++i )
+      {
+        const unsigned int relative = face_relative[fan[i]];
+        for( int c = 0; c < 3; ++c )
+          if( relative & ( 1u << c ) )
+            chunk.relative.push_back( 3 * chunk.corners.size() + c );
+        chunk.corners.push_back( face[fan[i]] );
+      }
+    }
+  }
+  else if( space6 && strncmp( token, "usemtl", 6 ) == 0 )
+  {
+    Event event = { Event::USEMTL, chunk.corners.size() / 3, parseWord( token + 7, eol ) };
+    chunk.events.push_back( event );
+  }
+  else if( space6 && strncmp( token, "mtllib", 6 ) == 0 )
+  {
+    Event event = { Event::MTLLIB, chunk.corners.size() / 3, parseWord( token + 7, eol ) };
+    chunk.events.push_back( event );
+  }
+  else if( ( token[0] == 'g' || token[0] == 'o' ) && space1 )
+  {
+    Event event = { Event::GROUP, chunk.corners.size() / 3, std::string() };
+    chunk.events.push_back( event );
+  }
+
+  // Ignore unknown commands
+}
+
+
+void parseChunk( Chunk& chunk )
+{
+  std::vector<Corner>       face;
+  std::vector<unsigned int> face_relative;
+
+  const char* line = chunk.begin;
+  while( line < chunk.end )
+  {
+    const char* eol = static_cast<const char*>( memchr( line, '\n', chunk.end - line ) );
+    if( !eol )
+      eol = chunk.end;
+    const char* next = eol + 1;
+
+    // Trim a trailing '\r' of '\r\n' line endings
+    if( eol > line && eol[-1] == '\r' )
+      --eol;
+
+    parseLine( chunk, line, eol, face, face_relative );
+    line = next;
+  }
+}
+
+
+// Chunks start right after a newline, so no line is split between two chunks
+std::vector<Chunk> splitChunks( const char* data, size_t size )
+{
+  const size_t CHUNK_GRAIN = 1u << 20;
+  const size_t num_chunks = sutil::numRanges( size, CHUNK_GRAIN );
+
+  std::vector<Chunk> chunks( num_chunks );
+  const char* begin = data;
+  for( size_t i = 0; i < num_chunks; ++i )
+  {
+    const char* end = data + size * ( i + 1 ) / num_chunks;
+    if( end < begin )
+      end = begin;
+    if( i + 1 < num_chunks )
+    {
+      const char* eol = static_cast<const char*>( memchr( end, '\n', data + size - end ) );
+      end = eol ? eol + 1 : data + size;
+    }
+    chunks[i].begin = begin;
+    chunks[i].end   = end;
+    begin = end;
+  }
+  return chunks;
+}
+
+
+void initMaterial( tinyobj::material_t& material )
+{
+  material = tinyobj::material_t();
+  for( int i = 0; i < 3; ++i )
+  {
+    material.ambient[i]       = 0.0f;
+    material.diffuse[i]       = 0.7f;
+    material.specular[i]      = 0.0f;
+    material.transmittance[i] = 0.0f;
+    material.emission[i]      = 0.0f;
+  }
+  material.shininess = 1.0f;
+  material.ior       = 1.0f;
+  material.dissolve  = 1.0f;
+  material.illum     = 0;
+  material.dummy     = 0;
+}
+
+
+std::string directoryOf( const std::string& path )
+{
+  const size_t pos = path.find_last_of( "/\\" );
+  return pos == std::string::npos ? std::string() : path.substr( 0, pos + 1 );
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// ObjParser
+//
+//------------------------------------------------------------------------------
+
+ObjParser::ObjParser()
+  : m_parsed( false )
+  , m_has_normals( false )
+  , m_has_texcoords( false )
+  , m_num_groups( 0 )
+  , m_num_groups_with_normals( 0 )
+  , m_num_groups_with_texcoords( 0 )
+{
+}
+
+
+void ObjParser::parse( const std::string& filename )
+{
+  MappedFile file;
+  if( !file.open( filename ) )
+    throw std::runtime_error( "MeshLoader: Cannot open file [" + filename + "]" );
+
+  //
+  // Parse all chunks concurrently
+  //
+  std::vector<Chunk> chunks = splitChunks( file.data(), file.size() );
+  sutil::parallelFor( chunks.size(), 1, [&chunks]( size_t begin, size_t end, size_t )
+  {
+    for( size_t i = begin; i < end; ++i )
+      parseChunk( chunks[i] );
+  } );
+
+  // Chunks keep their text range, but nothing reads it any more
+  file.close();
+
+  //
+  // Prefix sums of the per-chunk counts
+  //
+  std::vector<size_t> v_base( chunks.size() ), vt_base( chunks.size() ), vn_base( chunks.size() ), tri_base( chunks.size() );
+  size_t num_v = 0, num_vt = 0, num_vn = 0, num_corners = 0;
+  for( size_t i = 0; i < chunks.size(); ++i )
+  {
+    v_base[i]   = num_v;
+    vt_base[i]  = num_vt;
+    vn_base[i]  = num_vn;
+    tri_base[i] = num_corners / 3;
+    num_v       += chunks[i].v.size()  / 3;
+    num_vt      += chunks[i].vt.size() / 2;
+    num_vn      += chunks[i].vn.size() / 3;
+    num_corners += chunks[i].corners.size();
+  }
+
+  // Corner indices and the bucket_end offsets in dedupCorners are 32 bits wide
+  if( num_corners > ( 1u << 31 ) )
+    throw std::runtime_error( "MeshLoader: Too many triangles in '" + filename + "'" );
+
+  //
+  // Resolve groups, materials and material libraries in file order
+  //
+  const std::string dir = directoryOf( filename );
+  std::map<std::string, int> material_map;
+  int32_t material = -1;
+
+  m_materials.clear();
+  m_material_libraries.clear();
+  m_runs.clear();
+  Run first_run = { 0, material };
+  m_runs.push_back( first_run );
+  for( size_t i = 0; i < chunks.size(); ++i )
+  {
+    for( size_t e = 0; e < chunks[i].events.size(); ++e )
+    {
+      const Event& event = chunks[i].events[e];
+      if( event.type == Event::MTLLIB )
+      {
+        std::string err;
+        tinyobj::MaterialFileReader reader( dir );
+        reader( event.name, m_materials, material_map, err );
+        if( !err.empty() )
+          std::cerr << err << std::endl;
+        m_material_libraries.push_back( dir + event.name );
+        continue;
+      }
+
+      if( event.type == Event::USEMTL )
+      {
+        std::map<std::string, int>::const_iterator it = material_map.find( event.name );
+        material = it != material_map.end() ? it->second : -1;
+      }
+
+      const Run run = { tri_base[i] + event.triangle, material };
+      if( m_runs.back().first_triangle == run.first_triangle )
+        m_runs.back() = run;  // Previous group is empty
+      else
+        m_runs.push_back( run );
+    }
+  }
+
+  if( m_materials.empty() )
+  {
+    tinyobj::material_t mat;
+    initMaterial( mat );
+    m_materials.push_back( mat );
+  }
+
+  //
+  // Offset relative indices and validate all indices in place
+  //
+  sutil::parallelFor( chunks.size(), 1, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t i = begin; i < end; ++i )
+    {
+      Chunk& chunk = chunks[i];
+      const int32_t base[3] = { static_cast<int32_t>( v_base[i] ),
+                                static_cast<int32_t>( vt_base[i] ),
+                                static_cast<int32_t>( vn_base[i] ) };
+      for( size_t r = 0; r < chunk.relative.size(); ++r )
+      {
+        int32_t* corner = &chunk.corners[chunk.relative[r] / 3].v;
+        corner[chunk.relative[r] % 3] += base[chunk.relative[r] % 3];
+      }
+      std::vector<size_t>().swap( chunk.relative );
+
+      for( size_t c = 0; c < chunk.corners.size(); ++c )
+      {
+        const Corner& corner = chunk.corners[c];
+        if( corner.v  <  0 || corner.v  >= static_cast<int32_t>( num_v  ) ||
+            corner.vt < -1 || corner.vt >= static_cast<int32_t>( num_vt ) ||
+            corner.vn < -1 || corner.vn >= static_cast<int32_t>( num_vn ) )
+          throw std::runtime_error( "MeshLoader: Invalid face index in '" + filename + "'" );
+      }
+    }
+  } );
+
+  //
+  // Concatenate the chunks, releasing each one as soon as it is appended so
+  // that the parsed data is never held twice
+  //
+  m_v.clear();
+  m_vt.clear();
+  m_vn.clear();
+  m_v.reserve( 3 * num_v );
+  m_vt.reserve( 2 * num_vt );
+  m_vn.reserve( 3 * num_vn );
+  std::vector<Corner> corners;
+  corners.reserve( num_corners );
+  for( size_t i = 0; i < chunks.size(); ++i )
+  {
+    Chunk& chunk = chunks[i];
+    m_v.insert( m_v.end(), chunk.v.begin(), chunk.v.end() );
+    m_vt.insert( m_vt.end(), chunk.vt.begin(), chunk.vt.end() );
+    m_vn.insert( m_vn.end(), chunk.vn.begin(), chunk.vn.end() );
+    corners.insert( corners.end(), chunk.corners.begin(), chunk.corners.end() );
+    std::vector<float>().swap( chunk.v );
+    std::vector<float>().swap( chunk.vt );
+    std::vector<float>().swap( chunk.vn );
+    std::vector<Corner>().swap( chunk.corners );
+  }
+  chunks.clear();
+
+  //
+  // Normals and texcoords are used only if every group has some
+  //
+  std::vector<unsigned char> run_flags( m_runs.size(), 0 );
+  for( size_t r = 0; r < m_runs.size(); ++r )
+  {
+    const size_t first = 3 * m_runs[r].first_triangle;
+    const size_t last  = r + 1 < m_runs.size() ? 3 * m_runs[r + 1].first_triangle : num_corners;
+    if( first == last )
+      continue;
+    run_flags[r] = 1;
+    for( size_t c = first; c < last && run_flags[r] != 7; ++c )
+      run_flags[r] |= ( corners[c].vn >= 0 ? 2 : 0 ) | ( corners[c].vt >= 0 ? 4 : 0 );
+  }
+
+  m_num_groups = m_num_groups_with_normals = m_num_groups_with_texcoords = 0;
+  for( size_t r = 0; r < run_flags.size(); ++r )
+  {
+    m_num_groups                += ( run_flags[r] & 1 ) != 0;
+    m_num_groups_with_normals   += ( run_flags[r] & 2 ) != 0;
+    m_num_groups_with_texcoords += ( run_flags[r] & 4 ) != 0;
+  }
+  m_has_normals   = m_num_groups_with_normals   != 0 && m_num_groups_with_normals   == m_num_groups;
+  m_has_texcoords = m_num_groups_with_texcoords != 0 && m_num_groups_with_texcoords == m_num_groups;
+
+  dedupCorners( corners );
+
+  if( m_vertices.size() > static_cast<size_t>( INT32_MAX ) )
+    throw std::runtime_error( "MeshLoader: Too many vertices in '" + filename + "'" );
+
+  m_parsed = true;
+}
+
+
+void ObjParser::clear()
+{
+  std::vector<float>().swap( m_v );
+  std::vector<float>().swap( m_vn );
+  std::vector<float>().swap( m_vt );
+  std::vector<Corner>().swap( m_vertices );
+  std::vector<uint32_t>().swap( m_tri_vertices );
+  std::vector<Run>().swap( m_runs );
+  std::vector<tinyobj::material_t>().swap( m_materials );
+  std::vector<std::string>().swap( m_material_libraries );
+
+  m_parsed        = false;
+  m_has_normals   = false;
+  m_has_texcoords = false;
+  m_num_groups    = m_num_groups_with_normals = m_num_groups_with_texcoords = 0;
+}
+
+
+size_t ObjParser::runOf( size_t triangle ) const
+{
+  if( m_runs.size() == 1 )
+    return 0;
+  Run key = { triangle, 0 };
+  return std::upper_bound( m_runs.begin(), m_runs.end(), key,
+                           []( const Run& a, const Run& b ) { return a.first_triangle < b.first_triangle; } )
+         - m_runs.begin() - 1;
+}
+
+
+// Corners with the same (v, vt, vn) in the same group become one vertex.
+// Vertices are numbered in order of their first corner like tinyobj does:
+//   1. Corners are bucketed by position index, counting sort style.
+//   2. Each bucket is sorted by (group, vt, vn, corner), which puts the first
+//      corner of every vertex in front of its duplicates.
+//   3. A prefix sum over the first uses yields the vertex numbers.
+// Besides the corners this needs 8 bytes per corner and 4 per position.
+void ObjParser::dedupCorners( const std::vector<Corner>& corners )
+{
+  const size_t num_corners = corners.size();
+  const size_t num_v       = m_v.size() / 3;
+  const size_t GRAIN       = 1u << 16;
+
+  // 1. Bucket the corners by position.  The order within a bucket depends on
+  //    thread timing, but the sort below makes the result deterministic.
+  std::unique_ptr<std::atomic<uint32_t>[]> bucket_end( new std::atomic<uint32_t>[num_v + 1] );
+  sutil::parallelFor( num_v + 1, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t v = begin; v < end; ++v )
+      bucket_end[v].store( 0, std::memory_order_relaxed );
+  } );
+  sutil::parallelFor( num_corners, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t c = begin; c < end; ++c )
+      bucket_end[corners[c].v + 1].fetch_add( 1, std::memory_order_relaxed );
+  } );
+  for( size_t v = 0; v < num_v; ++v )
+    bucket_end[v + 1].store( bucket_end[v + 1].load( std::memory_order_relaxed ) +
+                             bucket_end[v].load( std::memory_order_relaxed ), std::memory_order_relaxed );
+
+  // bucket_end[v] starts out as the begin of bucket v and ends up as its end
+  std::unique_ptr<uint32_t[]> buckets( new uint32_t[num_corners] );
+  sutil::parallelFor( num_corners, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t c = begin; c < end; ++c )
+      buckets[bucket_end[corners[c].v].fetch_add( 1, std::memory_order_relaxed )] = static_cast<uint32_t>( c );
+  } );
+
+  // 2. Find the first corner of each corner's vertex
+  struct Key
+  {
+    size_t   run;
+    int32_t  vt;
+    int32_t  vn;
+    uint32_t corner;
+
+    bool operator<( const Key& other ) const
+    {
+      if( run != other.run ) return run < other.run;
+      if( vt  != other.vt  ) return vt  < other.vt;
+      if( vn  != other.vn  ) return vn  < other.vn;
+      return corner < other.corner;
+    }
+  };
+
+  std::unique_ptr<uint32_t[]> first( new uint32_t[num_corners] );
+  sutil::parallelFor( num_v, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    std::vector<Key> keys;
+    for( size_t v = begin; v < end; ++v )
+    {
+      const uint32_t bucket_begin = v ? bucket_end[v - 1].load( std::memory_order_relaxed ) : 0;
+      const uint32_t bucket_size  = bucket_end[v].load( std::memory_order_relaxed ) - bucket_begin;
+
+      keys.resize( bucket_size );
+      for( uint32_t i = 0; i < bucket_size; ++i )
+      {
+        const uint32_t c = buckets[bucket_begin + i];
+        const Key key = { runOf( c / 3 ), corners[c].vt, corners[c].vn, c };
+        keys[i] = key;
+      }
+      std::sort( keys.begin(), keys.end() );
+
+      for( uint32_t i = 0, head = 0; i < bucket_size; ++i )
+      {
+        if( keys[i].run != keys[head].run || keys[i].vt != keys[head].vt || keys[i].vn != keys[head].vn )
+          head = i;
+        first[keys[i].corner] = keys[head].corner;
+      }
+    }
+  } );
+  bucket_end.reset();
+
+  // 3. Number the vertices.  The bucket array is reused to map first corners
+  //    to vertex numbers.
+  std::vector<size_t> range_count( sutil::numRanges( num_corners, GRAIN ), 0 );
+  sutil::parallelFor( num_corners, GRAIN, [&]( size_t begin, size_t end, size_t r )
+  {
+    for( size_t c = begin; c < end; ++c )
+      range_count[r] += first[c] == c;
+  } );
+
+  std::vector<size_t> range_base( range_count.size() );
+  size_t num_vertices = 0;
+  for( size_t r = 0; r < range_count.size(); ++r )
+  {
+    range_base[r] = num_vertices;
+    num_vertices += range_count[r];
+  }
+
+  m_vertices.resize( num_vertices );
+  uint32_t* vertex_of_first = buckets.get();
+  sutil::parallelFor( num_corners, GRAIN, [&]( size_t begin, size_t end, size_t r )
+  {
+    size_t vertex = range_base[r];
+    for( size_t c = begin; c < end; ++c )
+    {
+      if( first[c] == c )
+      {
+        m_vertices[vertex] = corners[c];
+        vertex_of_first[c] = static_cast<uint32_t>( vertex++ );
+      }
+    }
+  } );
+
+  m_tri_vertices.resize( num_corners );
+  sutil::parallelFor( num_corners, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t c = begin; c < end; ++c )
+      m_tri_vertices[c] = vertex_of_first[first[c]];
+  } );
+}
+
+
+void ObjParser::load( Mesh& mesh ) const
+{
+  const size_t GRAIN = 1u << 16;
+  const size_t num_vertices = m_vertices.size();
+
+  struct BBox
+  {
+    float min[3];
+    float max[3];
+  };
+  std::vector<BBox> bboxes( sutil::numRanges( num_vertices, GRAIN ) );
+
+  sutil::parallelFor( num_vertices, GRAIN, [&]( size_t begin, size_t end, size_t r )
+  {
+    BBox& bbox = bboxes[r];
+    std::copy( mesh.bbox_min, mesh.bbox_min + 3, bbox.min );
+    std::copy( mesh.bbox_max, mesh.bbox_max + 3, bbox.max );
+
+    for( size_t i = begin; i < end; ++i )
+    {
+      const Corner& vertex = m_vertices[i];
+      for( int k = 0; k < 3; ++k )
+      {
+        const float x = m_v[3 * vertex.v + k];
+        mesh.positions[3 * i + k] = x;
+        bbox.min[k] = std::min<float>( bbox.min[k], x );
+        bbox.max[k] = std::max<float>( bbox.max[k], x );
+      }
+
+      if( mesh.has_normals )
+        for( int k = 0; k < 3; ++k )
+          mesh.normals[3 * i + k] = vertex.vn >= 0 ? m_vn[3 * vertex.vn + k] : 0.0f;
+
+      if( mesh.has_texcoords )
+        for( int k = 0; k < 2; ++k )
+          mesh.texcoords[2 * i + k] = vertex.vt >= 0 ? m_vt[2 * vertex.vt + k] : 0.0f;
+    }
+  } );
+
+  for( size_t r = 0; r < bboxes.size(); ++r )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      mesh.bbox_min[k] = std::min<float>( mesh.bbox_min[k], bboxes[r].min[k] );
+      mesh.bbox_max[k] = std::max<float>( mesh.bbox_max[k], bboxes[r].max[k] );
+    }
+  }
+
+  const size_t num_triangles = m_tri_vertices.size() / 3;
+  sutil::parallelFor( num_triangles, GRAIN, [&]( size_t begin, size_t end, size_t )
+  {
+    size_t run = runOf( begin );
+    for( size_t t = begin; t < end; ++t )
+    {
+      while( run + 1 < m_runs.size() && m_runs[run + 1].first_triangle <= t )
+        ++run;
+      mesh.mat_indices[t] = m_runs[run].material >= 0 ? m_runs[run].material : 0;
+      for( int k = 0; k < 3; ++k )
+        mesh.tri_indices[3 * t + k] = static_cast<int32_t>( m_tri_vertices[3 * t + k] );
+    }
+  } );
+}
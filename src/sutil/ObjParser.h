@@ -0,0 +1,120 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include "tinyobjloader/tiny_obj_loader.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+//------------------------------------------------------------------------------
+//
+// Multi-threaded OBJ parser used by MeshLoader.
+//
+// The file is memory-mapped and split into newline-aligned chunks which are
+// parsed concurrently.  Groups ('g', 'o', 'usemtl') and material libraries are
+// resolved in file order afterwards, and corners with identical (v, vt, vn)
+// within a group are merged into one vertex by bucketing them by position
+// index and sorting each bucket.  The result matches tinyobj::LoadObj followed by the former per-shape copy in
+// MeshLoader: same vertex order, indices, materials and bit-identical floats.
+// Only material libraries are still parsed by tinyobj::LoadMtl.
+//
+//------------------------------------------------------------------------------
+class ObjParser
+{
+public:
+  ObjParser();
+
+  // Parses filename and the material libraries it references.
+  // Throws std::runtime_error on failure.
+  void parse( const std::string& filename );
+
+  // Releases everything parse() produced
+  void clear();
+
+  bool    isParsed()     const { return m_parsed; }
+
+  int32_t numVertices()  const { return static_cast<int32_t>( m_vertices.size() ); }
+  int32_t numTriangles() const { return static_cast<int32_t>( m_tri_vertices.size() / 3 ); }
+  bool    hasNormals()   const { return m_has_normals; }
+  bool    hasTexcoords() const { return m_has_texcoords; }
+
+  // Number of non-empty groups, and of those with any normals or texcoords
+  size_t  numGroups()              const { return m_num_groups; }
+  size_t  numGroupsWithNormals()   const { return m_num_groups_with_normals; }
+  size_t  numGroupsWithTexcoords() const { return m_num_groups_with_texcoords; }
+
+  const std::vector<tinyobj::material_t>& materials()         const { return m_materials; }
+  const std::vector<std::string>&         materialLibraries() const { return m_material_libraries; }
+
+  // Fills positions, normals, texcoords, tri_indices, mat_indices and the
+  // bbox of a mesh allocated for numVertices()/numTriangles().
+  void load( Mesh& mesh ) const;
+
+  // Index triple of one triangle corner, -1 for absent vt/vn
+  struct Corner
+  {
+    int32_t v;
+    int32_t vt;
+    int32_t vn;
+  };
+
+  // Triangles from first_triangle up to the next run's belong to one group
+  struct Run
+  {
+    size_t  first_triangle;
+    int32_t material;
+  };
+
+private:
+  void dedupCorners( const std::vector<Corner>& corners );
+  size_t runOf( size_t triangle ) const;
+
+  bool                              m_parsed;
+
+  std::vector<float>                m_v;             // Attribute pools as found in the file
+  std::vector<float>                m_vn;
+  std::vector<float>                m_vt;
+
+  std::vector<Corner>               m_vertices;      // Unique corners in first-use order
+  std::vector<uint32_t>             m_tri_vertices;  // Vertex index of every triangle corner
+  std::vector<Run>                  m_runs;
+
+  bool                              m_has_normals;
+  bool                              m_has_texcoords;
+  size_t                            m_num_groups;
+  size_t                            m_num_groups_with_normals;
+  size_t                            m_num_groups_with_texcoords;
+
+  std::vector<tinyobj::material_t>  m_materials;
+  std::vector<std::string>          m_material_libraries;
+};
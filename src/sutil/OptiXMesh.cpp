@@ -29,7 +29,9 @@
 #include <optixu/optixu_math_namespace.h>
 
 #include "Mesh.h"
+#include "MeshOptimizer.h"
 #include "OptiXMesh.h"
+#include "SamplerCache.h"
 #include "sutil.h"
 #include <algorithm>
 #include <cstring>
@@ -80,7 +82,7 @@ void setupMeshLoaderInputs(
 }
 
 
-void unmap( MeshBuffers& buffers, Mesh& mesh )
+void unmapMeshLoaderInputs( MeshBuffers& buffers, Mesh& mesh )
 {
   buffers.tri_indices->unmap();
   buffers.mat_indices->unmap();
@@ -126,17 +128,19 @@ optix::Material createOptiXMaterial(
     optix::Program         closest_hit,
     optix::Program         any_hit,
     const MaterialParams&  mat_params,
-    bool                   use_textures
+    bool                   use_textures,
+    SamplerCache&          sampler_cache
     )
 {
   optix::Material mat = context->createMaterial();
   mat->setClosestHitProgram( 0u, closest_hit );             
   mat->setAnyHitProgram( 1u, any_hit ) ;    
 
+  // Materials sharing a Kd_map (or a default color) share its sampler
   if( use_textures )
-    mat[ "Kd_map"]->setTextureSampler( sutil::loadTexture( context, mat_params.Kd_map, optix::make_float3(mat_params.Kd) ) );
+    mat[ "Kd_map"]->setTextureSampler( sampler_cache.acquire( mat_params.Kd_map, optix::make_float3(mat_params.Kd) ) );
   else
-    mat[ "Kd_map"]->setTextureSampler( sutil::loadTexture( context, "", optix::make_float3(mat_params.Kd) ) );
+    mat[ "Kd_map"]->setTextureSampler( sampler_cache.acquire( "", optix::make_float3(mat_params.Kd) ) );
 
   mat[ "Kd_mapped" ]->setInt( use_textures  );
   mat[ "Kd"        ]->set3fv( mat_params.Kd );
@@ -195,13 +199,18 @@ void translateMeshToOptiX(
     optix::Program any_hit     = optix_mesh.any_hit;
     createMaterialPrograms( ctx, have_textures, closest_hit, any_hit );
 
+    // Without a cache shared across meshes, still share the textures among this mesh's materials
+    SamplerCache  local_cache( ctx );
+    SamplerCache& sampler_cache = optix_mesh.sampler_cache ? *optix_mesh.sampler_cache : local_cache;
+
     for( int32_t i = 0; i < mesh.num_materials; ++i )
       optix_materials.push_back( createOptiXMaterial(
             ctx,
             closest_hit,
             any_hit,
             mesh.mat_params[i],
-            have_textures ) );
+            have_textures,
+            sampler_cache ) );
   }
 
   optix::Geometry geometry = ctx->createGeometry();  
@@ -226,6 +235,43 @@ void translateMeshToOptiX(
 }
 
 
+// Copies all arrays between meshes with the same counts
+void copyMeshData( const Mesh& src, Mesh& dst )
+{
+  std::copy( src.positions,   src.positions   + 3*src.num_vertices,  dst.positions );
+  if( src.has_normals )
+    std::copy( src.normals,   src.normals     + 3*src.num_vertices,  dst.normals );
+  if( src.has_texcoords )
+    std::copy( src.texcoords, src.texcoords   + 2*src.num_vertices,  dst.texcoords );
+  std::copy( src.tri_indices, src.tri_indices + 3*src.num_triangles, dst.tri_indices );
+  std::copy( src.mat_indices, src.mat_indices +   src.num_triangles, dst.mat_indices );
+  std::copy( src.mat_params,  src.mat_params  +   src.num_materials, dst.mat_params );
+}
+
+
+// Lets MeshLoader write straight into mapped OptiX buffers
+class MeshBufferSink : public MeshSink
+{
+public:
+  explicit MeshBufferSink( OptiXMesh& optix_mesh ) : m_optix_mesh( optix_mesh ) {}
+
+  void map( Mesh& mesh )
+  {
+    setupMeshLoaderInputs( m_optix_mesh.context, m_buffers, mesh );
+  }
+
+  void unmap( Mesh& mesh )
+  {
+    translateMeshToOptiX( mesh, m_buffers, m_optix_mesh );
+    unmapMeshLoaderInputs( m_buffers, mesh );
+  }
+
+private:
+  OptiXMesh&  m_optix_mesh;
+  MeshBuffers m_buffers;
+};
+
+
 } // namespace end
 
 
@@ -240,18 +286,28 @@ void loadMesh(
     throw std::runtime_error( "OptiXMesh: loadMesh() requires valid OptiX context" );
   }
 
-  optix::Context context = optix_mesh.context;
-
   Mesh mesh;
-  MeshLoader loader( filename );
-  loader.scanMesh( mesh );
-
-  MeshBuffers buffers;
-  setupMeshLoaderInputs( context, buffers, mesh );
+  MeshLoader loader( filename, optix_mesh.use_mesh_cache );
+  MeshBufferSink sink( optix_mesh );
+  if( !optix_mesh.weld_vertices && !optix_mesh.optimize_vertex_cache )
+  {
+    loader.loadMesh( mesh, sink, load_xform.getData() );
+    return;
+  }
 
+  // Welding changes the vertex count and reordering needs scratch space, so
+  // the mesh goes through host memory
+  loader.scanMesh( mesh );
+  allocMesh( mesh );
   loader.loadMesh( mesh, load_xform.getData() );
-
-  translateMeshToOptiX( mesh, buffers, optix_mesh );
-
-  unmap( buffers, mesh );
+  if( optix_mesh.weld_vertices )
+    printWeldStats( weldVertices( mesh, optix_mesh.weld_epsilon ) );
+  if( optix_mesh.optimize_vertex_cache )
+    optimizeVertexCache( mesh );
+
+  Mesh processed = mesh;
+  sink.map( processed );
+  copyMeshData( mesh, processed );
+  freeMesh( mesh );
+  sink.unmap( processed );
 }
@@ -34,6 +34,8 @@
 #include <optixu/optixpp_namespace.h>
 #include <optixu/optixu_matrix_namespace.h>
 
+class SamplerCache;
+
 
 //------------------------------------------------------------------------------
 //
@@ -50,6 +52,8 @@
 //------------------------------------------------------------------------------
 struct OptiXMesh
 {
+  OptiXMesh() : use_mesh_cache( false ), weld_vertices( false ), weld_epsilon( 0.0f ), optimize_vertex_cache( false ), sampler_cache( 0 ), num_triangles( 0 ) {}
+
   // Input
   optix::Context               context;       // required
   optix::Material              material;      // optional single matl override
@@ -60,6 +64,12 @@ struct OptiXMesh
   optix::Program               closest_hit;   // optional multi matl override
   optix::Program               any_hit;       // optional
 
+  bool                         use_mesh_cache; // optional, reads and writes <filename>.meshcache, see MeshCache.h
+  bool                         weld_vertices; // optional, see weldVertices() in MeshOptimizer.h
+  float                        weld_epsilon;  //
+  bool                         optimize_vertex_cache; // optional, see optimizeVertexCache()
+  SamplerCache*                sampler_cache; // optional, shares Kd_map samplers across meshes, see SamplerCache.h
+
   // Output
   optix::GeometryInstance      geom_instance;
   optix::float3                bbox_min;
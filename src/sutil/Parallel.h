@@ -0,0 +1,179 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+
+//------------------------------------------------------------------------------
+//
+// Minimal fork-join helpers for the host-side loaders
+//
+//------------------------------------------------------------------------------
+
+namespace sutil
+{
+
+// Number of hardware threads, at least 1.  Queried once, since
+// hardware_concurrency() reads the system configuration on every call.
+inline unsigned int numThreads()
+{
+  static const unsigned int n = std::max( 1u, std::thread::hardware_concurrency() );
+  return n;
+}
+
+
+// Number of ranges parallelFor splits count elements into, given that each
+// range should hold at least grain elements.
+inline size_t numRanges( size_t count, size_t grain )
+{
+  const size_t n = grain ? count / grain : count;
+  return std::max<size_t>( 1, std::min<size_t>( n, numThreads() ) );
+}
+
+
+// Splits [0, count) into numRanges( count, grain ) contiguous ranges and calls
+// func( begin, end, range_index ) for each of them concurrently.  Returns when
+// all ranges are done.  The first exception thrown by func is rethrown.
+template <typename Func>
+void parallelFor( size_t count, size_t grain, Func func )
+{
+  const size_t num_ranges = numRanges( count, grain );
+  if( num_ranges == 1 )
+  {
+    func( size_t( 0 ), count, size_t( 0 ) );
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors( num_ranges );
+  std::vector<std::thread>        threads;
+  threads.reserve( num_ranges - 1 );
+
+  for( size_t r = 0; r < num_ranges; ++r )
+  {
+    const size_t begin = count * r / num_ranges;
+    const size_t end   = count * ( r + 1 ) / num_ranges;
+    auto task = [&func, &errors, begin, end, r]()
+    {
+      try
+      {
+        func( begin, end, r );
+      }
+      catch( ... )
+      {
+        errors[r] = std::current_exception();
+      }
+    };
+
+    // The calling thread works on the last range itself
+    if( r + 1 < num_ranges )
+      threads.push_back( std::thread( task ) );
+    else
+      task();
+  }
+
+  for( size_t i = 0; i < threads.size(); ++i )
+    threads[i].join();
+
+  for( size_t r = 0; r < num_ranges; ++r )
+    if( errors[r] )
+      std::rethrow_exception( errors[r] );
+}
+
+// Calls func0() on a new thread and func1() on the calling thread and returns
+// when both are done.  The first exception thrown is rethrown.
+template <typename Func0, typename Func1>
+void parallelInvoke( Func0 func0, Func1 func1 )
+{
+  std::exception_ptr error;
+  std::thread thread( [&func0, &error]()
+  {
+    try
+    {
+      func0();
+    }
+    catch( ... )
+    {
+      error = std::current_exception();
+    }
+  } );
+
+  try
+  {
+    func1();
+  }
+  catch( ... )
+  {
+    thread.join();
+    throw;
+  }
+  thread.join();
+
+  if( error )
+    std::rethrow_exception( error );
+}
+
+// Sorts data[0, count) by sorting numRanges( count, grain ) ranges concurrently
+// and then merging neighboring ranges pairwise, also concurrently.
+template <typename T>
+void parallelSort( T* data, size_t count, size_t grain )
+{
+  std::vector<size_t> bounds( numRanges( count, grain ) + 1 );
+  for( size_t r = 0; r < bounds.size(); ++r )
+    bounds[r] = count * r / ( bounds.size() - 1 );
+
+  parallelFor( bounds.size() - 1, 1, [&]( size_t begin, size_t end, size_t )
+  {
+    for( size_t r = begin; r < end; ++r )
+      std::sort( data + bounds[r], data + bounds[r + 1] );
+  } );
+
+  while( bounds.size() > 2 )
+  {
+    const size_t num_pairs = ( bounds.size() - 1 ) / 2;
+    parallelFor( num_pairs, 1, [&]( size_t begin, size_t end, size_t )
+    {
+      for( size_t p = begin; p < end; ++p )
+        std::inplace_merge( data + bounds[2 * p], data + bounds[2 * p + 1], data + bounds[2 * p + 2] );
+    } );
+
+    std::vector<size_t> merged;
+    for( size_t r = 0; r < bounds.size(); r += 2 )
+      merged.push_back( bounds[r] );
+    if( merged.back() != count )
+      merged.push_back( count );
+    bounds.swap( merged );
+  }
+}
+
+} // end namespace sutil
@@ -0,0 +1,415 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PlyParser.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  include <emmintrin.h>
+#  define PLY_PARSER_SSE 1
+#endif
+
+
+namespace
+{
+
+const size_t  FACE_SIZE  = 1 + 3 * sizeof( int32_t ); // uint8 count followed by three indices
+const size_t  GRAIN      = 1 << 16;                   // Minimum number of records per thread
+const size_t  BLOCK      = 1024;                      // Vertices copied before updating the bbox
+
+
+struct Property
+{
+  std::string name;
+  std::string type;
+  size_t      offset;
+};
+
+
+struct Element
+{
+  std::string           name;
+  uint64_t              count;
+  size_t                size;                         // Bytes per record if there are no lists
+  std::vector<Property> properties;
+  bool                  has_list;
+  std::string           list_name;
+  size_t                list_count_size;
+  size_t                list_index_size;
+};
+
+
+// Size in bytes of a PLY scalar type, 0 if unknown
+size_t typeSize( const std::string& type )
+{
+  if( type == "char"   || type == "uchar"  || type == "int8"    || type == "uint8"   ) return 1;
+  if( type == "short"  || type == "ushort" || type == "int16"   || type == "uint16"  ) return 2;
+  if( type == "int"    || type == "uint"   || type == "int32"   || type == "uint32"  ) return 4;
+  if( type == "float"  || type == "float32" ) return 4;
+  if( type == "double" || type == "float64" ) return 8;
+  return 0;
+}
+
+
+bool isFloat( const std::string& type )
+{
+  return type == "float" || type == "float32";
+}
+
+
+bool isLittleEndian()
+{
+  const uint16_t one = 1;
+  return *reinterpret_cast<const uint8_t*>( &one ) == 1;
+}
+
+
+// Byte offset of three consecutive float properties named a, b, c, -1 if the
+// element does not have all of them in that layout.
+int32_t consecutiveFloats( const Element& element, const char* a, const char* b, const char* c )
+{
+  const char* names[3] = { a, b, c };
+  size_t      offsets[3];
+  for( int k = 0; k < 3; ++k )
+  {
+    size_t p = 0;
+    while( p < element.properties.size() && element.properties[p].name != names[k] )
+      ++p;
+    if( p == element.properties.size() || !isFloat( element.properties[p].type ) )
+      return -1;
+    offsets[k] = element.properties[p].offset;
+  }
+  if( offsets[1] != offsets[0] + 4 || offsets[2] != offsets[0] + 8 )
+    return -1;
+  return static_cast<int32_t>( offsets[0] );
+}
+
+
+// Grows bbox_min/bbox_max by count xyz triples.  Values are compared the same
+// way as std::min( bbox, value ) and std::max( bbox, value ), so NaNs are
+// skipped just like in the rply callbacks.
+void growBounds( const float* p, size_t count, float* bbox_min, float* bbox_max )
+{
+  size_t i = 0;
+#if defined( PLY_PARSER_SSE )
+  if( count >= 4 )
+  {
+    // Four xyz triples fill three registers: x0y0z0x1 y1z1x2y2 z2x3y3z3
+    __m128 min0 = _mm_setr_ps( bbox_min[0], bbox_min[1], bbox_min[2], bbox_min[0] );
+    __m128 min1 = _mm_setr_ps( bbox_min[1], bbox_min[2], bbox_min[0], bbox_min[1] );
+    __m128 min2 = _mm_setr_ps( bbox_min[2], bbox_min[0], bbox_min[1], bbox_min[2] );
+    __m128 max0 = _mm_setr_ps( bbox_max[0], bbox_max[1], bbox_max[2], bbox_max[0] );
+    __m128 max1 = _mm_setr_ps( bbox_max[1], bbox_max[2], bbox_max[0], bbox_max[1] );
+    __m128 max2 = _mm_setr_ps( bbox_max[2], bbox_max[0], bbox_max[1], bbox_max[2] );
+    for( ; i + 4 <= count; i += 4, p += 12 )
+    {
+      const __m128 a = _mm_loadu_ps( p + 0 );
+      const __m128 b = _mm_loadu_ps( p + 4 );
+      const __m128 c = _mm_loadu_ps( p + 8 );
+      min0 = _mm_min_ps( a, min0 );
+      min1 = _mm_min_ps( b, min1 );
+      min2 = _mm_min_ps( c, min2 );
+      max0 = _mm_max_ps( a, max0 );
+      max1 = _mm_max_ps( b, max1 );
+      max2 = _mm_max_ps( c, max2 );
+    }
+
+    float lo[12], hi[12];
+    _mm_storeu_ps( lo + 0, min0 ); _mm_storeu_ps( lo + 4, min1 ); _mm_storeu_ps( lo + 8, min2 );
+    _mm_storeu_ps( hi + 0, max0 ); _mm_storeu_ps( hi + 4, max1 ); _mm_storeu_ps( hi + 8, max2 );
+    for( int k = 0; k < 12; ++k )
+    {
+      bbox_min[k % 3] = std::min( bbox_min[k % 3], lo[k] );
+      bbox_max[k % 3] = std::max( bbox_max[k % 3], hi[k] );
+    }
+  }
+#endif
+  for( ; i < count; ++i, p += 3 )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      bbox_min[k] = std::min( bbox_min[k], p[k] );
+      bbox_max[k] = std::max( bbox_max[k], p[k] );
+    }
+  }
+}
+
+} // end anonymous namespace
+
+
+//------------------------------------------------------------------------------
+//
+// PlyParser
+//
+//------------------------------------------------------------------------------
+
+PlyParser::PlyParser()
+  : m_num_vertices( 0 )
+  , m_vertex_data( 0 )
+  , m_vertex_stride( 0 )
+  , m_position_offset( -1 )
+  , m_normal_offset( -1 )
+  , m_num_faces( 0 )
+  , m_face_data( 0 )
+{
+}
+
+
+bool PlyParser::open( const std::string& filename )
+{
+  close();
+  if( !isLittleEndian() || !m_file.open( filename ) )
+    return false;
+  if( !parseHeader() )
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+
+void PlyParser::close()
+{
+  m_file.close();
+  m_num_vertices    = 0;
+  m_position_offset = -1;
+  m_normal_offset   = -1;
+  m_num_faces       = 0;
+}
+
+
+bool PlyParser::parseHeader()
+{
+  const char*  data = m_file.data();
+  const size_t size = m_file.size();
+
+  std::vector<Element> elements;
+  size_t pos  = 0;
+  bool   done = false;
+  for( int line_number = 0; !done; ++line_number )
+  {
+    const char* line = data + pos;
+    const char* eol  = static_cast<const char*>( memchr( line, '\n', size - pos ) );
+    if( !eol )
+      return false;
+    pos = eol - data + 1;
+
+    std::istringstream in( std::string( line, eol ) );
+    std::string keyword;
+    in >> keyword;
+
+    if( line_number == 0 )
+    {
+      if( keyword != "ply" )
+        return false;
+    }
+    else if( keyword == "format" )
+    {
+      std::string format;
+      in >> format;
+      if( format != "binary_little_endian" )
+        return false;
+    }
+    else if( keyword == "element" )
+    {
+      Element element;
+      in >> element.name >> element.count;
+      if( in.fail() )
+        return false;
+      element.size            = 0;
+      element.has_list        = false;
+      element.list_count_size = 0;
+      element.list_index_size = 0;
+      elements.push_back( element );
+    }
+    else if( keyword == "property" )
+    {
+      if( elements.empty() )
+        return false;
+      Element& element = elements.back();
+
+      std::string type;
+      in >> type;
+      if( type == "list" )
+      {
+        std::string count_type, index_type;
+        in >> count_type >> index_type >> element.list_name;
+        if( in.fail() || element.has_list )
+          return false;
+        element.has_list        = true;
+        element.list_count_size = typeSize( count_type );
+        element.list_index_size = typeSize( index_type );
+        if( element.list_count_size == 0 || element.list_index_size == 0 )
+          return false;
+      }
+      else
+      {
+        Property property;
+        property.type   = type;
+        property.offset = element.size;
+        in >> property.name;
+        const size_t type_size = typeSize( type );
+        if( in.fail() || type_size == 0 )
+          return false;
+        element.size += type_size;
+        element.properties.push_back( property );
+      }
+    }
+    else if( keyword == "end_header" )
+    {
+      done = true;
+    }
+    else if( keyword != "comment" && keyword != "obj_info" && !keyword.empty() )
+    {
+      return false;
+    }
+  }
+
+  // Locate the vertex and face records, skipping over fixed-size elements
+  bool have_vertices = false;
+  bool have_faces    = false;
+  for( size_t e = 0; e < elements.size() && !( have_vertices && have_faces ); ++e )
+  {
+    const Element& element = elements[e];
+    if( element.count > 0x7fffffff )
+      return false;
+
+    if( element.name == "vertex" )
+    {
+      if( element.has_list || have_vertices )
+        return false;
+      m_position_offset = consecutiveFloats( element, "x", "y", "z" );
+      if( m_position_offset < 0 )
+        return false;
+      m_normal_offset = consecutiveFloats( element, "nx", "ny", "nz" );
+      for( size_t p = 0; p < element.properties.size() && m_normal_offset < 0; ++p )
+        if( element.properties[p].name == "nx" )
+          return false; // Normals in a layout the copy below does not handle
+
+      m_num_vertices  = static_cast<int32_t>( element.count );
+      m_vertex_data   = pos;
+      m_vertex_stride = element.size;
+      have_vertices   = true;
+      pos += element.size * element.count;
+    }
+    else if( element.name == "face" )
+    {
+      // Only triangles are handled, so every face has the same size
+      if( !element.has_list || !element.properties.empty() || element.list_name != "vertex_indices" ||
+          element.list_count_size != 1 || element.list_index_size != sizeof( int32_t ) || have_faces )
+        return false;
+      m_num_faces  = static_cast<int32_t>( element.count );
+      m_face_data  = pos;
+      have_faces   = true;
+      pos += FACE_SIZE * element.count;
+    }
+    else
+    {
+      if( element.has_list )
+        return false;
+      pos += element.size * element.count;
+    }
+  }
+
+  return have_vertices && have_faces && pos <= size;
+}
+
+
+bool PlyParser::load( Mesh& mesh ) const
+{
+  if( !isOpen() || mesh.num_vertices != m_num_vertices || mesh.num_triangles != m_num_faces ||
+      mesh.has_normals != hasNormals() )
+    return false;
+
+  const char* data = m_file.data();
+
+  // Faces first: if one of them is not a triangle, nothing but the indices
+  // (which the caller's fallback rewrites) has been touched.  Each range starts
+  // at a correct record unless an earlier range has already found a polygon.
+  std::vector<char> triangles_only( sutil::numRanges( m_num_faces, GRAIN ), 1 );
+  sutil::parallelFor( m_num_faces, GRAIN, [&]( size_t begin, size_t end, size_t range )
+  {
+    const char* src = data + m_face_data + begin * FACE_SIZE;
+    int32_t*    dst = mesh.tri_indices + 3 * begin;
+    for( size_t i = begin; i < end; ++i, src += FACE_SIZE, dst += 3 )
+    {
+      if( src[0] != 3 )
+      {
+        triangles_only[range] = 0;
+        return;
+      }
+      memcpy( dst, src + 1, 3 * sizeof( int32_t ) );
+    }
+  } );
+  if( std::find( triangles_only.begin(), triangles_only.end(), 0 ) != triangles_only.end() )
+    return false;
+
+  // Vertices, with the bbox of every range grown block by block while the
+  // copied positions are still in cache
+  const size_t num_ranges = sutil::numRanges( m_num_vertices, GRAIN );
+  std::vector<float> range_bbox( 6 * num_ranges );
+  for( size_t r = 0; r < num_ranges; ++r )
+    for( int k = 0; k < 3; ++k )
+    {
+      range_bbox[6 * r + k]     = mesh.bbox_min[k];
+      range_bbox[6 * r + 3 + k] = mesh.bbox_max[k];
+    }
+
+  sutil::parallelFor( m_num_vertices, GRAIN, [&]( size_t begin, size_t end, size_t range )
+  {
+    const char* src = data + m_vertex_data + begin * m_vertex_stride;
+    for( size_t block = begin; block < end; block += BLOCK )
+    {
+      const size_t block_end = std::min( block + BLOCK, end );
+      float* positions = mesh.positions + 3 * block;
+      float* normals   = mesh.has_normals ? mesh.normals + 3 * block : 0;
+      for( size_t i = block; i < block_end; ++i, src += m_vertex_stride )
+      {
+        memcpy( positions + 3 * ( i - block ), src + m_position_offset, 3 * sizeof( float ) );
+        if( normals )
+          memcpy( normals + 3 * ( i - block ), src + m_normal_offset, 3 * sizeof( float ) );
+      }
+      growBounds( positions, block_end - block, &range_bbox[6 * range], &range_bbox[6 * range + 3] );
+    }
+  } );
+
+  for( size_t r = 0; r < num_ranges; ++r )
+    for( int k = 0; k < 3; ++k )
+    {
+      mesh.bbox_min[k] = std::min( mesh.bbox_min[k], range_bbox[6 * r + k] );
+      mesh.bbox_max[k] = std::max( mesh.bbox_max[k], range_bbox[6 * r + 3 + k] );
+    }
+
+  return true;
+}
@@ -0,0 +1,88 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+
+//------------------------------------------------------------------------------
+//
+// Fast reader for binary little-endian PLY files with a fixed-size layout.
+//
+// The file is memory-mapped, and vertex and face records are copied into the
+// mesh by strided block copies on multiple threads instead of going through
+// one rply callback per scalar.  Supported are consecutive float x/y/z (and
+// optionally nx/ny/nz) among any other fixed-size vertex properties, and
+// triangle faces with a single 'vertex_indices' list of 8-bit count and 32-bit
+// indices.  Anything else is left to the rply path in MeshLoader.
+//
+//------------------------------------------------------------------------------
+class PlyParser
+{
+public:
+  PlyParser();
+
+  // Maps filename and parses its header.  Returns false if the file cannot be
+  // mapped or its layout is not supported.
+  bool open( const std::string& filename );
+  void close();
+
+  bool    isOpen()       const { return m_file.isOpen(); }
+  int32_t numVertices()  const { return m_num_vertices; }
+  int32_t numTriangles() const { return m_num_faces; }
+  bool    hasNormals()   const { return m_normal_offset >= 0; }
+
+  // Fills positions, normals, tri_indices and the bbox of a mesh allocated for
+  // numVertices()/numTriangles().  Returns false without touching the vertex
+  // data or bbox if the file turns out to contain faces that are not
+  // triangles, in which case the caller has to fall back to rply.
+  bool load( Mesh& mesh ) const;
+
+private:
+  PlyParser( const PlyParser& );             // Not copyable
+  PlyParser& operator=( const PlyParser& );
+
+  bool parseHeader();
+
+  MappedFile  m_file;
+
+  int32_t     m_num_vertices;
+  size_t      m_vertex_data;      // Byte offset of the first vertex record
+  size_t      m_vertex_stride;
+  int32_t     m_position_offset;  // Byte offset of x within a record, y and z follow
+  int32_t     m_normal_offset;    // Byte offset of nx, or -1
+
+  int32_t     m_num_faces;
+  size_t      m_face_data;        // Byte offset of the first face record
+};
@@ -0,0 +1,193 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SamplerCache.h"
+
+#include <iomanip>
+#include <sstream>
+
+
+namespace
+{
+
+// 64-bit FNV-1a
+uint64_t hashBytes( const void* data, size_t size, uint64_t hash = 14695981039346656037ull )
+{
+  const unsigned char* p = static_cast<const unsigned char*>( data );
+  for( size_t i = 0; i < size; ++i )
+  {
+    hash ^= p[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+
+// Hash of the format, extents and texels of the first buffer of a sampler
+uint64_t hashTexels( optix::TextureSampler sampler, size_t& bytes )
+{
+  optix::Buffer buffer = sampler->getBuffer( 0u, 0u );
+
+  RTsize width  = 0;
+  RTsize height = 0;
+  buffer->getSize( width, height );
+
+  const RTformat format = buffer->getFormat();
+  const uint64_t dims[3] = { static_cast<uint64_t>( format ), width, height };
+
+  bytes = static_cast<size_t>( width * height * buffer->getElementSize() );
+
+  const void* texels = buffer->map( 0u, RT_BUFFER_MAP_READ );
+  const uint64_t hash = hashBytes( texels, bytes, hashBytes( dims, sizeof( dims ) ) );
+  buffer->unmap();
+
+  return hash;
+}
+
+} // namespace
+
+
+SamplerCache::SamplerCache( optix::Context context )
+  : m_context( context ),
+    m_requests( 0 ),
+    m_hits( 0 ),
+    m_content_hits( 0 ),
+    m_resident_bytes( 0 )
+{
+}
+
+
+SamplerCache::~SamplerCache()
+{
+  clear();
+}
+
+
+optix::TextureSampler SamplerCache::acquire( const std::string& filename, const optix::float3& default_color )
+{
+  ++m_requests;
+
+  // The default color is part of the key, files that fail to load are shared per color
+  std::ostringstream key;
+  key << ( filename.empty() ? filename : sutil::canonicalPath( filename ) )
+      << '|' << default_color.x << ',' << default_color.y << ',' << default_color.z;
+
+  std::map<std::string, Entry*>::iterator it = m_files.find( key.str() );
+  if( it != m_files.end() )
+  {
+    ++m_hits;
+    ++it->second->references;
+    return it->second->sampler;
+  }
+
+  optix::TextureSampler sampler = sutil::loadTexture( m_context, filename, default_color );
+
+  size_t bytes = 0;
+  const uint64_t content = hashTexels( sampler, bytes );
+
+  std::map<uint64_t, Entry*>::iterator jt = m_contents.find( content );
+  if( jt != m_contents.end() )
+  {
+    // Same texels under another name, keep the resident copy
+    optix::Buffer buffer = sampler->getBuffer( 0u, 0u );
+    sampler->destroy();
+    buffer->destroy();
+
+    ++m_content_hits;
+    ++jt->second->references;
+    m_files[key.str()] = jt->second;
+    return jt->second->sampler;
+  }
+
+  Entry* entry      = new Entry;
+  entry->sampler    = sampler;
+  entry->references = 1;
+  entry->bytes      = bytes;
+  entry->content    = content;
+
+  m_files[key.str()]          = entry;
+  m_contents[content]         = entry;
+  m_samplers[sampler->get()]  = entry;
+  m_resident_bytes           += bytes;
+
+  return sampler;
+}
+
+
+void SamplerCache::release( optix::TextureSampler sampler )
+{
+  std::map<RTtexturesampler, Entry*>::iterator it = m_samplers.find( sampler->get() );
+  if( it == m_samplers.end() )
+    return;
+
+  Entry* entry = it->second;
+  if( --entry->references == 0 )
+  {
+    optix::Buffer buffer = sampler->getBuffer( 0u, 0u );
+    erase( entry );
+    sampler->destroy();
+    buffer->destroy();
+  }
+}
+
+
+void SamplerCache::clear()
+{
+  while( !m_samplers.empty() )
+    erase( m_samplers.begin()->second );
+  m_resident_bytes = 0;
+}
+
+
+void SamplerCache::printStatistics( std::ostream& out ) const
+{
+  const double rate = m_requests ? 100.0 * double( m_hits + m_content_hits ) / double( m_requests ) : 0.0;
+
+  std::ostringstream line;
+  line << "SamplerCache: " << m_requests << " requests, " << m_hits << " hits, "
+       << m_content_hits << " content hits (" << std::fixed << std::setprecision( 1 ) << rate << "%), "
+       << m_samplers.size() << " textures, " << m_resident_bytes / 1024 << " KB resident";
+  out << line.str() << std::endl;
+}
+
+
+// Removes all keys which refer to entry and deletes it
+void SamplerCache::erase( Entry* entry )
+{
+  for( std::map<std::string, Entry*>::iterator it = m_files.begin(); it != m_files.end(); )
+  {
+    if( it->second == entry )
+      m_files.erase( it++ );
+    else
+      ++it;
+  }
+  m_contents.erase( entry->content );
+  m_samplers.erase( entry->sampler->get() );
+  m_resident_bytes -= entry->bytes;
+  delete entry;
+}
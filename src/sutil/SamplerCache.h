@@ -0,0 +1,97 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutil.h>
+#include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include <map>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+
+
+//------------------------------------------------------------------------------
+//
+// Shares the TextureSamplers of sutil::loadTexture() among the users of one
+// context, e.g. all OBJ materials which reference the same Kd_map atlas.
+//
+// Requests are keyed on the canonical path of the file and the default color,
+// which only matters when loading fails.  A new file is decoded and uploaded
+// once; when its texels turn out to be identical to an already resident
+// texture (the same image under a different name), the new upload is dropped
+// and the resident sampler is shared instead.
+//
+// Entries are reference counted.  release() destroys the sampler and its
+// buffer when the last user is gone; the destructor and clear() only forget
+// the entries, since materials may still reference the samplers.
+//
+//------------------------------------------------------------------------------
+class SamplerCache
+{
+public:
+  SUTILAPI explicit SamplerCache( optix::Context context );
+  SUTILAPI ~SamplerCache();
+
+  SUTILAPI optix::TextureSampler acquire( const std::string& filename, const optix::float3& default_color );
+  SUTILAPI void                  release( optix::TextureSampler sampler );
+  SUTILAPI void                  clear();
+
+  // Statistics
+  unsigned int requests() const      { return m_requests; }
+  unsigned int hits() const          { return m_hits; }          // Served without loading
+  unsigned int contentHits() const   { return m_content_hits; }  // Loaded, but shared by content
+  size_t       residentBytes() const { return m_resident_bytes; }
+  SUTILAPI void printStatistics( std::ostream& out ) const;
+
+private:
+  struct Entry
+  {
+    optix::TextureSampler sampler;
+    unsigned int          references;
+    size_t                bytes;
+    uint64_t              content;    // Hash of format, extents and texels
+  };
+
+  optix::Context                     m_context;
+  std::map<std::string, Entry*>      m_files;     // Key: canonical path and default color
+  std::map<uint64_t, Entry*>         m_contents;
+  std::map<RTtexturesampler, Entry*> m_samplers;
+
+  unsigned int m_requests;
+  unsigned int m_hits;
+  unsigned int m_content_hits;
+  size_t       m_resident_bytes;
+
+  SamplerCache( const SamplerCache& );            // Not copyable
+  SamplerCache& operator=( const SamplerCache& );
+
+  void erase( Entry* entry );
+};
@@ -48,6 +48,7 @@
 
 #include <optixu/optixu_math_namespace.h>
 
+#include <climits>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -728,6 +729,21 @@ void sutil::displayFps( unsigned int frame_count )
 }
 
 
+std::string sutil::canonicalPath( const std::string& filename )
+{
+#if defined(_WIN32)
+    char path[_MAX_PATH];
+    if( _fullpath( path, filename.c_str(), _MAX_PATH ) != NULL && GetFileAttributesA( path ) != INVALID_FILE_ATTRIBUTES )
+        return std::string( path );
+#else
+    char path[PATH_MAX];
+    if( realpath( filename.c_str(), path ) != NULL )
+        return std::string( path );
+#endif
+    return filename;
+}
+
+
 optix::TextureSampler sutil::loadTexture( optix::Context context,
         const std::string& filename, optix::float3 default_color )
 {
@@ -143,6 +143,12 @@ void SUTILAPI displayBufferGL(
 void SUTILAPI displayFps(
         unsigned total_frame_count );    // total frame count
 
+// Absolute path of filename with "." and ".." (and on Linux and Apple symbolic
+// links) resolved, so that different spellings of one file compare equal.
+// Returns filename unchanged if the file does not exist.
+std::string SUTILAPI canonicalPath(
+        const std::string& filename );
+
 // Create on OptiX TextureSampler for the given image file.  If the filename is
 // empty or if loading the file fails, return 1x1 texture with default color.
 optix::TextureSampler SUTILAPI loadTexture(